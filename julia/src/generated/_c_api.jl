@@ -19,6 +19,7 @@ mts_data_origin_t = UInt64
 
 mts_create_array_callback_t = Ptr{Cvoid}  # TODO: actual type
 mts_realloc_buffer_t = Ptr{Cvoid}         # TODO: actual type
+mts_profiling_callback_t = Ptr{Cvoid}     # TODO: actual type
 
 # ====== Enf of manual definitions ====== #
 
@@ -30,6 +31,13 @@ MTS_IO_ERROR = 2
 MTS_SERIALIZATION_ERROR = 3
 MTS_BUFFER_SIZE_ERROR = 254
 MTS_INTERNAL_ERROR = 255
+MTS_DTYPE_F64 = 1
+MTS_DTYPE_F32 = 2
+MTS_DTYPE_F16 = 3
+MTS_DTYPE_BF16 = 4
+MTS_COMPRESSION_NONE = 0
+MTS_COMPRESSION_DEFLATE = 1
+MTS_COMPRESSION_ZSTD = 2
 
 
 # ===== Enum definitions
@@ -42,6 +50,9 @@ end
 struct mts_tensormap_t
 end
 
+struct mts_tensormap_writer_t
+end
+
 struct mts_labels_t
     internal_ptr_ :: Ptr{Cvoid}
     names :: Ptr{Ptr{Cchar}}
@@ -66,6 +77,17 @@ struct mts_array_t
     copy :: Ptr{Cvoid} #= (Ptr{Cvoid}, Ptr{mts_array_t}) -> mts_status_t =#
     destroy :: Ptr{Cvoid} #= (Ptr{Cvoid}) -> Cvoid =#
     move_samples_from :: Ptr{Cvoid} #= (Ptr{Cvoid}, Ptr{Cvoid}, Ptr{mts_sample_mapping_t}, UIntptr, UIntptr, UIntptr) -> mts_status_t =#
+    typed_data :: Ptr{Cvoid} #= (Ptr{Cvoid}, Ptr{Ptr{Cvoid}}, Ptr{Int32}) -> mts_status_t =#
+    create_typed :: Ptr{Cvoid} #= (Ptr{Cvoid}, Ptr{UIntptr}, UIntptr, Int32, Ptr{mts_array_t}) -> mts_status_t =#
+end
+
+struct mts_memory_usage_t
+    values :: UIntptr
+    gradients_values :: UIntptr
+    labels_values :: UIntptr
+    labels_positions :: UIntptr
+    gradients_metadata :: UIntptr
+    metadata :: UIntptr
 end
 
 
@@ -88,6 +110,22 @@ function mts_version()
     )
 end
 
+function mts_set_max_threads(n_threads::UIntptr)
+    ccall((:mts_set_max_threads, libmetatensor), 
+        Cvoid,
+        (UIntptr,),
+        n_threads
+    )
+end
+
+function mts_get_max_threads()
+    ccall((:mts_get_max_threads, libmetatensor), 
+        UIntptr,
+        (),
+        
+    )
+end
+
 function mts_last_error()
     ccall((:mts_last_error, libmetatensor), 
         Ptr{Cchar},
@@ -96,6 +134,14 @@ function mts_last_error()
     )
 end
 
+function mts_set_profiling_callback(callback::mts_profiling_callback_t)
+    ccall((:mts_set_profiling_callback, libmetatensor), 
+        Cvoid,
+        (mts_profiling_callback_t,),
+        callback
+    )
+end
+
 function mts_labels_position(labels::mts_labels_t, values::Ptr{Int32}, values_count::UIntptr, result::Ptr{Int64})
     ccall((:mts_labels_position, libmetatensor), 
         mts_status_t,
@@ -104,6 +150,14 @@ function mts_labels_position(labels::mts_labels_t, values::Ptr{Int32}, values_co
     )
 end
 
+function mts_labels_positions(labels::mts_labels_t, values::Ptr{Int32}, values_count::UIntptr, result::Ptr{Int64}, result_count::UIntptr)
+    ccall((:mts_labels_positions, libmetatensor), 
+        mts_status_t,
+        (mts_labels_t, Ptr{Int32}, UIntptr, Ptr{Int64}, UIntptr,),
+        labels, values, values_count, result, result_count
+    )
+end
+
 function mts_labels_create(labels::Ptr{mts_labels_t})
     ccall((:mts_labels_create, libmetatensor), 
         mts_status_t,
@@ -112,6 +166,14 @@ function mts_labels_create(labels::Ptr{mts_labels_t})
     )
 end
 
+function mts_labels_create_assume_unique(labels::Ptr{mts_labels_t})
+    ccall((:mts_labels_create_assume_unique, libmetatensor), 
+        mts_status_t,
+        (Ptr{mts_labels_t},),
+        labels
+    )
+end
+
 function mts_labels_set_user_data(labels::mts_labels_t, user_data::Ptr{Cvoid}, user_data_delete::Ptr{Cvoid} #= (Ptr{Cvoid}) -> Cvoid =#)
     ccall((:mts_labels_set_user_data, libmetatensor), 
         mts_status_t,
@@ -152,6 +214,14 @@ function mts_labels_intersection(first::mts_labels_t, second::mts_labels_t, resu
     )
 end
 
+function mts_labels_memory_usage(labels::mts_labels_t, usage::Ptr{mts_memory_usage_t})
+    ccall((:mts_labels_memory_usage, libmetatensor), 
+        mts_status_t,
+        (mts_labels_t, Ptr{mts_memory_usage_t},),
+        labels, usage
+    )
+end
+
 function mts_labels_free(labels::Ptr{mts_labels_t})
     ccall((:mts_labels_free, libmetatensor), 
         mts_status_t,
@@ -200,6 +270,14 @@ function mts_block_copy(block::Ptr{mts_block_t})
     )
 end
 
+function mts_block_slice_samples(block::Ptr{mts_block_t}, start::UIntptr, stop::UIntptr)
+    ccall((:mts_block_slice_samples, libmetatensor), 
+        Ptr{mts_block_t},
+        (Ptr{mts_block_t}, UIntptr, UIntptr,),
+        block, start, stop
+    )
+end
+
 function mts_block_labels(block::Ptr{mts_block_t}, axis::UIntptr, labels::Ptr{mts_labels_t})
     ccall((:mts_block_labels, libmetatensor), 
         mts_status_t,
@@ -240,6 +318,14 @@ function mts_block_gradients_list(block::Ptr{mts_block_t}, parameters::Ptr{Ptr{P
     )
 end
 
+function mts_block_memory_usage(block::Ptr{mts_block_t}, usage::Ptr{mts_memory_usage_t})
+    ccall((:mts_block_memory_usage, libmetatensor), 
+        mts_status_t,
+        (Ptr{mts_block_t}, Ptr{mts_memory_usage_t},),
+        block, usage
+    )
+end
+
 function mts_tensormap(keys::mts_labels_t, blocks::Ptr{Ptr{mts_block_t}}, blocks_count::UIntptr)
     ccall((:mts_tensormap, libmetatensor), 
         Ptr{mts_tensormap_t},
@@ -288,6 +374,14 @@ function mts_tensormap_blocks_matching(tensor::Ptr{mts_tensormap_t}, block_index
     )
 end
 
+function mts_tensormap_blocks_matching_many(tensor::Ptr{mts_tensormap_t}, block_selection::Ptr{Int64}, count::UIntptr, selection::mts_labels_t)
+    ccall((:mts_tensormap_blocks_matching_many, libmetatensor), 
+        mts_status_t,
+        (Ptr{mts_tensormap_t}, Ptr{Int64}, UIntptr, mts_labels_t,),
+        tensor, block_selection, count, selection
+    )
+end
+
 function mts_tensormap_keys_to_properties(tensor::Ptr{mts_tensormap_t}, keys_to_move::mts_labels_t, sort_samples::Cbool)
     ccall((:mts_tensormap_keys_to_properties, libmetatensor), 
         Ptr{mts_tensormap_t},
@@ -312,6 +406,22 @@ function mts_tensormap_keys_to_samples(tensor::Ptr{mts_tensormap_t}, keys_to_mov
     )
 end
 
+function mts_tensormap_join_samples(tensors::Ptr{Ptr{mts_tensormap_t}}, tensors_count::UIntptr, new_dimension::Ptr{Cchar})
+    ccall((:mts_tensormap_join_samples, libmetatensor), 
+        Ptr{mts_tensormap_t},
+        (Ptr{Ptr{mts_tensormap_t}}, UIntptr, Ptr{Cchar},),
+        tensors, tensors_count, new_dimension
+    )
+end
+
+function mts_tensormap_memory_usage(tensor::Ptr{mts_tensormap_t}, usage::Ptr{mts_memory_usage_t})
+    ccall((:mts_tensormap_memory_usage, libmetatensor), 
+        mts_status_t,
+        (Ptr{mts_tensormap_t}, Ptr{mts_memory_usage_t},),
+        tensor, usage
+    )
+end
+
 function mts_labels_load(path::Ptr{Cchar}, labels::Ptr{mts_labels_t})
     ccall((:mts_labels_load, libmetatensor), 
         mts_status_t,
@@ -352,6 +462,38 @@ function mts_tensormap_load(path::Ptr{Cchar}, create_array::mts_create_array_cal
     )
 end
 
+function mts_tensormap_load_selection(path::Ptr{Cchar}, selection::mts_labels_t, create_array::mts_create_array_callback_t)
+    ccall((:mts_tensormap_load_selection, libmetatensor), 
+        Ptr{mts_tensormap_t},
+        (Ptr{Cchar}, mts_labels_t, mts_create_array_callback_t,),
+        path, selection, create_array
+    )
+end
+
+function mts_tensormap_load_parallel(path::Ptr{Cchar}, n_threads::UIntptr, create_array::mts_create_array_callback_t)
+    ccall((:mts_tensormap_load_parallel, libmetatensor), 
+        Ptr{mts_tensormap_t},
+        (Ptr{Cchar}, UIntptr, mts_create_array_callback_t,),
+        path, n_threads, create_array
+    )
+end
+
+function mts_tensormap_load_mmap(path::Ptr{Cchar})
+    ccall((:mts_tensormap_load_mmap, libmetatensor), 
+        Ptr{mts_tensormap_t},
+        (Ptr{Cchar},),
+        path
+    )
+end
+
+function mts_tensormap_load_shm(name::Ptr{Cchar})
+    ccall((:mts_tensormap_load_shm, libmetatensor), 
+        Ptr{mts_tensormap_t},
+        (Ptr{Cchar},),
+        name
+    )
+end
+
 function mts_tensormap_load_buffer(buffer::Ptr{UInt8}, buffer_count::UIntptr, create_array::mts_create_array_callback_t)
     ccall((:mts_tensormap_load_buffer, libmetatensor), 
         Ptr{mts_tensormap_t},
@@ -368,6 +510,30 @@ function mts_tensormap_save(path::Ptr{Cchar}, tensor::Ptr{mts_tensormap_t})
     )
 end
 
+function mts_tensormap_save_compressed(path::Ptr{Cchar}, tensor::Ptr{mts_tensormap_t}, compression::Int32, level::Int32, n_threads::UIntptr)
+    ccall((:mts_tensormap_save_compressed, libmetatensor), 
+        mts_status_t,
+        (Ptr{Cchar}, Ptr{mts_tensormap_t}, Int32, Int32, UIntptr,),
+        path, tensor, compression, level, n_threads
+    )
+end
+
+function mts_tensormap_save_shm(name::Ptr{Cchar}, tensor::Ptr{mts_tensormap_t})
+    ccall((:mts_tensormap_save_shm, libmetatensor), 
+        mts_status_t,
+        (Ptr{Cchar}, Ptr{mts_tensormap_t},),
+        name, tensor
+    )
+end
+
+function mts_tensormap_remove_shm(name::Ptr{Cchar})
+    ccall((:mts_tensormap_remove_shm, libmetatensor), 
+        mts_status_t,
+        (Ptr{Cchar},),
+        name
+    )
+end
+
 function mts_tensormap_save_buffer(buffer::Ptr{Ptr{UInt8}}, buffer_count::Ptr{UIntptr}, realloc_user_data::Ptr{Cvoid}, realloc::mts_realloc_buffer_t, tensor::Ptr{mts_tensormap_t})
     ccall((:mts_tensormap_save_buffer, libmetatensor), 
         mts_status_t,
@@ -375,3 +541,35 @@ function mts_tensormap_save_buffer(buffer::Ptr{Ptr{UInt8}}, buffer_count::Ptr{UI
         buffer, buffer_count, realloc_user_data, realloc, tensor
     )
 end
+
+function mts_tensormap_writer(path::Ptr{Cchar}, keys_names::Ptr{Ptr{Cchar}}, keys_names_count::UIntptr)
+    ccall((:mts_tensormap_writer, libmetatensor), 
+        Ptr{mts_tensormap_writer_t},
+        (Ptr{Cchar}, Ptr{Ptr{Cchar}}, UIntptr,),
+        path, keys_names, keys_names_count
+    )
+end
+
+function mts_tensormap_writer_add_block(writer::Ptr{mts_tensormap_writer_t}, key::Ptr{Int32}, key_count::UIntptr, block::Ptr{mts_block_t})
+    ccall((:mts_tensormap_writer_add_block, libmetatensor), 
+        mts_status_t,
+        (Ptr{mts_tensormap_writer_t}, Ptr{Int32}, UIntptr, Ptr{mts_block_t},),
+        writer, key, key_count, block
+    )
+end
+
+function mts_tensormap_writer_finish(writer::Ptr{mts_tensormap_writer_t})
+    ccall((:mts_tensormap_writer_finish, libmetatensor), 
+        mts_status_t,
+        (Ptr{mts_tensormap_writer_t},),
+        writer
+    )
+end
+
+function mts_tensormap_writer_free(writer::Ptr{mts_tensormap_writer_t})
+    ccall((:mts_tensormap_writer_free, libmetatensor), 
+        mts_status_t,
+        (Ptr{mts_tensormap_writer_t},),
+        writer
+    )
+end
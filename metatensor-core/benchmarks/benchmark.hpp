@@ -0,0 +1,223 @@
+#ifndef METATENSOR_BENCHMARK_HPP
+#define METATENSOR_BENCHMARK_HPP
+
+#include <cmath>
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+
+/// Minimal benchmark harness shared by the metatensor and metatensor-torch
+/// benchmarks. Each benchmark is a function called repeatedly until enough
+/// time was spent, and the results are printed to the standard output. The
+/// results can also be written to a JSON file to be tracked over time.
+namespace metatensor_benchmarks {
+
+/// Prevent the compiler from optimizing away the computation of `value`
+template <typename T>
+inline void do_not_optimize(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "g"(&value) : "memory");
+#else
+    static volatile const void* sink = nullptr;
+    sink = static_cast<const void*>(&value);
+#endif
+}
+
+/// Timing results for a single benchmark. All times are in nanoseconds.
+struct Result {
+    std::string name;
+    size_t iterations;
+    double mean;
+    double median;
+    double min;
+    double max;
+    double stddev;
+    /// number of bytes processed by each iteration, or 0
+    size_t bytes;
+};
+
+class Runner {
+public:
+    /// Create a new runner, parsing the command line arguments:
+    ///
+    /// - `--filter <string>`: only run benchmarks containing this string in
+    ///   their name;
+    /// - `--json <path>`: write the results to the given file in JSON format;
+    /// - `--min-time <seconds>`: minimal time to spend on each benchmark.
+    Runner(std::string suite, int argc, char** argv): suite_(std::move(suite)) {
+        for (int i=1; i<argc; i++) {
+            auto arg = std::string(argv[i]);
+            if (arg == "--help" || arg == "-h") {
+                std::cout << "usage: " << argv[0] << " [--filter <string>] [--json <path>] [--min-time <seconds>]\n";
+                std::exit(0);
+            }
+
+            if (i + 1 >= argc) {
+                throw std::runtime_error("missing value for argument " + arg);
+            }
+
+            if (arg == "--filter") {
+                filter_ = argv[++i];
+            } else if (arg == "--json") {
+                json_path_ = argv[++i];
+            } else if (arg == "--min-time") {
+                min_time_ = std::stod(argv[++i]);
+            } else {
+                throw std::runtime_error("unknown argument " + arg);
+            }
+        }
+    }
+
+    /// Add metadata to the JSON output, such as the version of the library
+    void add_context(std::string key, std::string value) {
+        context_.emplace_back(std::move(key), std::move(value));
+    }
+
+    /// Run `function` repeatedly and record the time it takes. If `bytes` is
+    /// not 0, the throughput is also reported.
+    template <typename Function>
+    void run(const std::string& name, Function function, size_t bytes = 0) {
+        if (!filter_.empty() && name.find(filter_) == std::string::npos) {
+            return;
+        }
+
+        // warmup
+        function();
+
+        auto times = std::vector<double>();
+        auto total = 0.0;
+        while ((total < min_time_ * 1e9 || times.size() < MIN_ITERATIONS) && times.size() < MAX_ITERATIONS) {
+            auto start = std::chrono::steady_clock::now();
+            function();
+            auto stop = std::chrono::steady_clock::now();
+
+            auto elapsed = std::chrono::duration<double, std::nano>(stop - start).count();
+            times.push_back(elapsed);
+            total += elapsed;
+        }
+
+        std::sort(times.begin(), times.end());
+        auto result = Result();
+        result.name = name;
+        result.iterations = times.size();
+        result.mean = total / static_cast<double>(times.size());
+        result.median = times[times.size() / 2];
+        result.min = times.front();
+        result.max = times.back();
+        result.bytes = bytes;
+
+        auto variance = 0.0;
+        for (auto time: times) {
+            variance += (time - result.mean) * (time - result.mean);
+        }
+        result.stddev = std::sqrt(variance / static_cast<double>(times.size()));
+
+        std::cout << std::left << std::setw(50) << name
+                  << " median " << format_time(result.median)
+                  << " mean " << format_time(result.mean)
+                  << " ± " << format_time(result.stddev);
+        if (bytes != 0) {
+            auto throughput = static_cast<double>(bytes) / (result.median * 1e-9) / (1024.0 * 1024.0);
+            std::cout << " (" << std::fixed << std::setprecision(1) << throughput << " MiB/s)";
+        }
+        std::cout << std::endl;
+
+        results_.emplace_back(std::move(result));
+    }
+
+    /// Write the results to the JSON file if requested, and return the exit
+    /// code for `main`
+    int finish() const {
+        if (json_path_.empty()) {
+            return 0;
+        }
+
+        auto file = std::ofstream(json_path_);
+        if (!file) {
+            std::cerr << "failed to open " << json_path_ << std::endl;
+            return 1;
+        }
+
+        file << std::setprecision(17);
+        file << "{\n  \"suite\": " << json_string(suite_) << ",\n";
+        file << "  \"context\": {";
+        for (size_t i=0; i<context_.size(); i++) {
+            file << (i == 0 ? "\n" : ",\n");
+            file << "    " << json_string(context_[i].first) << ": " << json_string(context_[i].second);
+        }
+        file << "\n  },\n";
+
+        file << "  \"benchmarks\": [";
+        for (size_t i=0; i<results_.size(); i++) {
+            const auto& result = results_[i];
+            file << (i == 0 ? "\n" : ",\n");
+            file << "    {\"name\": " << json_string(result.name)
+                 << ", \"iterations\": " << result.iterations
+                 << ", \"unit\": \"ns\""
+                 << ", \"mean\": " << result.mean
+                 << ", \"median\": " << result.median
+                 << ", \"min\": " << result.min
+                 << ", \"max\": " << result.max
+                 << ", \"stddev\": " << result.stddev
+                 << ", \"bytes\": " << result.bytes
+                 << "}";
+        }
+        file << "\n  ]\n}\n";
+
+        return 0;
+    }
+
+private:
+    static constexpr size_t MIN_ITERATIONS = 5;
+    static constexpr size_t MAX_ITERATIONS = 100000;
+
+    static std::string format_time(double time) {
+        auto output = std::ostringstream();
+        output << std::fixed << std::setprecision(2);
+        if (time < 1e3) {
+            output << time << " ns";
+        } else if (time < 1e6) {
+            output << time / 1e3 << " us";
+        } else if (time < 1e9) {
+            output << time / 1e6 << " ms";
+        } else {
+            output << time / 1e9 << " s";
+        }
+        return output.str();
+    }
+
+    static std::string json_string(const std::string& value) {
+        auto output = std::string("\"");
+        for (auto c: value) {
+            if (c == '"' || c == '\\') {
+                output += '\\';
+                output += c;
+            } else if (c == '\n') {
+                output += "\\n";
+            } else {
+                output += c;
+            }
+        }
+        output += '"';
+        return output;
+    }
+
+    std::string suite_;
+    std::string filter_;
+    std::string json_path_;
+    double min_time_ = 0.5;
+
+    std::vector<std::pair<std::string, std::string>> context_;
+    std::vector<Result> results_;
+};
+
+}
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef METATENSOR_BENCHMARKS_HPP
+#define METATENSOR_BENCHMARKS_HPP
+
+#include <metatensor.hpp>
+
+#include "benchmark.hpp"
+
+namespace metatensor_benchmarks {
+    /// Create a `TensorMap` with `n_keys_a x n_keys_b` blocks, using
+    /// ("key_a", "key_b") as keys. Each block contains `n_samples` samples
+    /// ("system", "atom"), one "xyz" component of size 3 and `n_properties`
+    /// properties ("n").
+    ///
+    /// If `shared_samples` is `true`, all the blocks use the same samples.
+    /// Otherwise, blocks with different "key_b" have partially overlapping
+    /// samples.
+    metatensor::TensorMap create_tensor(
+        int32_t n_keys_a,
+        int32_t n_keys_b,
+        int32_t n_samples,
+        int32_t n_properties,
+        bool shared_samples = false
+    );
+
+    void labels_benchmarks(Runner& runner);
+    void tensor_benchmarks(Runner& runner);
+    void io_benchmarks(Runner& runner);
+}
+
+#endif
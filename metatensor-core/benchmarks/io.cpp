@@ -0,0 +1,92 @@
+#include <cstdio>
+#include <fstream>
+#include <utility>
+
+#include "benchmarks.hpp"
+
+using namespace metatensor_benchmarks;
+
+void metatensor_benchmarks::io_benchmarks(Runner& runner) {
+    auto tensor = create_tensor(10, 10, 500, 32);
+
+    auto buffer = metatensor::io::save_buffer(tensor);
+    auto size = buffer.size();
+
+    runner.run("io::save_buffer", [&]() {
+        auto saved = metatensor::io::save_buffer(tensor);
+        do_not_optimize(saved);
+    }, size);
+
+    runner.run("io::load_buffer", [&]() {
+        auto loaded = metatensor::io::load_buffer(buffer);
+        do_not_optimize(loaded);
+    }, size);
+
+    auto path = std::string("metatensor-benchmark.mts");
+    runner.run("io::save", [&]() {
+        metatensor::io::save(path, tensor);
+    }, size);
+
+    runner.run("io::load", [&]() {
+        auto loaded = metatensor::io::load(path);
+        do_not_optimize(loaded);
+    }, size);
+
+    runner.run("io::load_mmap", [&]() {
+        auto loaded = metatensor::io::load_mmap(path);
+        do_not_optimize(loaded);
+    }, size);
+
+    runner.run("io::load_parallel", [&]() {
+        auto loaded = metatensor::io::load_parallel(path, 0);
+        do_not_optimize(loaded);
+    }, size);
+
+    auto selection = metatensor::Labels({"key_a"}, {{3}});
+    runner.run("io::load_selection", [&]() {
+        auto loaded = metatensor::io::load_selection(path, selection);
+        do_not_optimize(loaded);
+    });
+
+    auto compressions = std::vector<std::pair<std::string, int32_t>>{
+        {"deflate", MTS_COMPRESSION_DEFLATE},
+        {"zstd", MTS_COMPRESSION_ZSTD},
+    };
+    for (const auto& entry: compressions) {
+        auto name = entry.first;
+        auto compression = entry.second;
+
+        runner.run("io::save_compressed/" + name, [&]() {
+            metatensor::io::save_compressed(path, tensor, compression);
+        }, size);
+
+        // record the size of the compressed file, to compare it with `size`
+        auto file = std::ifstream(path, std::ios::binary | std::ios::ate);
+        auto file_size = static_cast<long long>(file.tellg());
+        file.close();
+
+        std::cout << "io::save_compressed/" << name << ": " << file_size << " bytes ";
+        std::cout << "(uncompressed: " << size << " bytes)" << std::endl;
+        runner.add_context("file_size/" + name, std::to_string(file_size));
+
+        runner.run("io::load/" + name, [&]() {
+            auto loaded = metatensor::io::load(path);
+            do_not_optimize(loaded);
+        }, size);
+
+        runner.run("io::load_parallel/" + name, [&]() {
+            auto loaded = metatensor::io::load_parallel(path, 0);
+            do_not_optimize(loaded);
+        }, size);
+    }
+    runner.add_context("file_size/uncompressed", std::to_string(size));
+
+    std::remove(path.c_str());
+
+    runner.run("io::save_shm+load_shm", [&]() {
+        metatensor::io::save_shm("benchmark", tensor);
+        auto loaded = metatensor::io::load_shm("benchmark");
+        do_not_optimize(loaded);
+    }, size);
+    metatensor::io::remove_shm("benchmark");
+}
@@ -0,0 +1,51 @@
+#include "benchmarks.hpp"
+
+using namespace metatensor_benchmarks;
+
+static std::vector<int32_t> labels_entries(int32_t count) {
+    auto values = std::vector<int32_t>();
+    values.reserve(3 * static_cast<size_t>(count));
+    for (int32_t i=0; i<count; i++) {
+        values.push_back(i / 1000);
+        values.push_back(i % 1000);
+        values.push_back(i % 7);
+    }
+    return values;
+}
+
+void metatensor_benchmarks::labels_benchmarks(Runner& runner) {
+    auto names = std::vector<std::string>{"system", "atom", "type"};
+
+    for (auto count: {1000, 100000}) {
+        auto values = labels_entries(count);
+        auto size = static_cast<size_t>(count);
+        auto suffix = "/" + std::to_string(count);
+
+        runner.run("Labels::create" + suffix, [&]() {
+            auto labels = metatensor::Labels(names, values.data(), size);
+            do_not_optimize(labels);
+        }, values.size() * sizeof(int32_t));
+
+        runner.run("Labels::create_assume_unique" + suffix, [&]() {
+            auto labels = metatensor::Labels(names, values.data(), size, metatensor::assume_unique{});
+            do_not_optimize(labels);
+        }, values.size() * sizeof(int32_t));
+
+        auto labels = metatensor::Labels(names, values.data(), size);
+
+        // the first call to `position` builds the positions hash map
+        labels.position(values.data(), 3);
+
+        runner.run("Labels::position" + suffix, [&]() {
+            for (size_t i=0; i<size; i+=97) {
+                auto position = labels.position(values.data() + 3 * i, 3);
+                do_not_optimize(position);
+            }
+        });
+
+        runner.run("Labels::positions" + suffix, [&]() {
+            auto positions = labels.positions(values.data(), size);
+            do_not_optimize(positions);
+        }, values.size() * sizeof(int32_t));
+    }
+}
@@ -0,0 +1,73 @@
+#include <exception>
+
+#include "benchmarks.hpp"
+
+using namespace metatensor_benchmarks;
+
+metatensor::TensorMap metatensor_benchmarks::create_tensor(
+    int32_t n_keys_a,
+    int32_t n_keys_b,
+    int32_t n_samples,
+    int32_t n_properties,
+    bool shared_samples
+) {
+    auto keys = std::vector<int32_t>();
+    auto blocks = std::vector<metatensor::TensorBlock>();
+    for (int32_t key_a=0; key_a<n_keys_a; key_a++) {
+        for (int32_t key_b=0; key_b<n_keys_b; key_b++) {
+            keys.push_back(key_a);
+            keys.push_back(key_b);
+
+            auto samples = std::vector<int32_t>();
+            for (int32_t i=0; i<n_samples; i++) {
+                samples.push_back(i / 32);
+                if (shared_samples) {
+                    samples.push_back(i % 32);
+                } else {
+                    // different blocks have partially overlapping samples
+                    samples.push_back(i % 32 + key_b);
+                }
+            }
+
+            auto properties = std::vector<int32_t>();
+            for (int32_t i=0; i<n_properties; i++) {
+                properties.push_back(i);
+            }
+
+            auto shape = std::vector<uintptr_t>{
+                static_cast<uintptr_t>(n_samples),
+                3,
+                static_cast<uintptr_t>(n_properties),
+            };
+
+            blocks.emplace_back(
+                std::unique_ptr<metatensor::SimpleDataArray>(new metatensor::SimpleDataArray(shape, 1.0)),
+                metatensor::Labels({"system", "atom"}, samples.data(), static_cast<size_t>(n_samples)),
+                std::vector<metatensor::Labels>{metatensor::Labels({"xyz"}, {{0}, {1}, {2}})},
+                metatensor::Labels({"n"}, properties.data(), static_cast<size_t>(n_properties))
+            );
+        }
+    }
+
+    auto n_keys = static_cast<size_t>(n_keys_a) * static_cast<size_t>(n_keys_b);
+    return metatensor::TensorMap(
+        metatensor::Labels({"key_a", "key_b"}, keys.data(), n_keys),
+        std::move(blocks)
+    );
+}
+
+int main(int argc, char** argv) {
+    try {
+        auto runner = Runner("metatensor-core", argc, argv);
+        runner.add_context("metatensor-core", mts_version());
+
+        labels_benchmarks(runner);
+        tensor_benchmarks(runner);
+        io_benchmarks(runner);
+
+        return runner.finish();
+    } catch (const std::exception& e) {
+        std::cerr << "error: " << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,57 @@
+#include "benchmarks.hpp"
+
+using namespace metatensor_benchmarks;
+
+void metatensor_benchmarks::tensor_benchmarks(Runner& runner) {
+    auto tensor = create_tensor(20, 10, 200, 16);
+
+    auto keys = tensor.keys();
+    const auto& entries = keys.values();
+    runner.run("TensorMap::blocks_matching/full", [&]() {
+        for (size_t i=0; i<keys.count(); i++) {
+            auto selection = metatensor::Labels({"key_a", "key_b"}, {{entries(i, 0), entries(i, 1)}});
+            auto matching = tensor.blocks_matching(selection);
+            do_not_optimize(matching);
+        }
+    });
+
+    auto partial = metatensor::Labels({"key_b"}, {{3}});
+    runner.run("TensorMap::blocks_matching/partial", [&]() {
+        auto matching = tensor.blocks_matching(partial);
+        do_not_optimize(matching);
+    });
+
+    runner.run("TensorMap::keys_to_properties", [&]() {
+        auto moved = tensor.keys_to_properties("key_b");
+        do_not_optimize(moved);
+    });
+
+    // when all the blocks share the same samples, the samples of the merged
+    // blocks do not need to be computed
+    auto shared = create_tensor(20, 10, 200, 16, /*shared_samples=*/true);
+    runner.run("TensorMap::keys_to_properties/shared_samples", [&]() {
+        auto moved = shared.keys_to_properties("key_b");
+        do_not_optimize(moved);
+    });
+
+    runner.run("TensorMap::keys_to_samples", [&]() {
+        auto moved = tensor.keys_to_samples("key_b");
+        do_not_optimize(moved);
+    });
+
+    runner.run("TensorMap::components_to_properties", [&]() {
+        auto moved = tensor.components_to_properties("xyz");
+        do_not_optimize(moved);
+    });
+
+    // join 10 tensors with the same keys, as done when batching systems
+    auto tensors = std::vector<metatensor::TensorMap>();
+    for (size_t i=0; i<10; i++) {
+        tensors.push_back(create_tensor(5, 4, 200, 16));
+    }
+
+    runner.run("TensorMap::join_samples", [&]() {
+        auto joined = metatensor::TensorMap::join_samples(tensors, "tensor");
+        do_not_optimize(joined);
+    });
+}
@@ -39,6 +39,9 @@ if (@METATENSOR_INSTALL_BOTH_STATIC_SHARED@ OR @BUILD_SHARED_LIBS@)
     )
 
     target_compile_features(metatensor::shared INTERFACE cxx_std_11)
+    # `TensorMap::for_each_block` in metatensor.hpp uses std::thread
+    find_package(Threads REQUIRED)
+    target_link_libraries(metatensor::shared INTERFACE Threads::Threads)
 
     if (WIN32)
         if (NOT EXISTS ${METATENSOR_IMPLIB_LOCATION})
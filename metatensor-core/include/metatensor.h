@@ -45,6 +45,44 @@
  */
 #define MTS_INTERNAL_ERROR 255
 
+/**
+ * The data is stored as 64-bit IEEE-754 floating point values
+ */
+#define MTS_DTYPE_F64 1
+
+/**
+ * The data is stored as 32-bit IEEE-754 floating point values
+ */
+#define MTS_DTYPE_F32 2
+
+/**
+ * The data is stored as 16-bit IEEE-754 floating point values
+ */
+#define MTS_DTYPE_F16 3
+
+/**
+ * The data is stored as 16-bit brain floating point values (bfloat16)
+ */
+#define MTS_DTYPE_BF16 4
+
+/**
+ * Store the data without compression. Uncompressed arrays can be used
+ * directly when loading files with memory mapping.
+ */
+#define MTS_COMPRESSION_NONE 0
+
+/**
+ * Compress the data with the DEFLATE algorithm, supported by all ZIP readers
+ */
+#define MTS_COMPRESSION_DEFLATE 1
+
+/**
+ * Compress the data with the Zstandard algorithm, which is faster than
+ * DEFLATE for the same compression ratio, but is not supported by all ZIP
+ * readers (in particular Python's `zipfile` and thus numpy)
+ */
+#define MTS_COMPRESSION_ZSTD 2
+
 /**
  * Basic building block for tensor map. A single block contains a n-dimensional
  * `mts_array_t`, and n sets of `mts_labels_t` (one for each dimension).
@@ -60,6 +98,11 @@ typedef struct mts_block_t mts_block_t;
  */
 typedef struct mts_tensormap_t mts_tensormap_t;
 
+/**
+ * Opaque type used to write a tensor map to a file one block at a time.
+ */
+typedef struct mts_tensormap_writer_t mts_tensormap_writer_t;
+
 /**
  * Status type returned by all functions in the C API.
  *
@@ -143,6 +186,11 @@ typedef struct mts_sample_mapping_t {
  * **WARNING**: all function implementations **MUST** be thread-safe, and can
  * be called from multiple threads at the same time. The `mts_array_t` itself
  * might be moved from one thread to another.
+ *
+ * This struct is passed by value, so adding fields changes the ABI. The
+ * `typed_data` and `create_typed` fields were added in metatensor-core
+ * 0.2.0, and arrays defined with older versions of this header are not
+ * compatible with this version of the library.
  */
 typedef struct mts_array_t {
   /**
@@ -224,8 +272,77 @@ typedef struct mts_array_t {
                                     uintptr_t samples_count,
                                     uintptr_t property_start,
                                     uintptr_t property_end);
+  /**
+   * Get a pointer to the underlying data storage in `data`, and the type
+   * of the data (one of the `MTS_DTYPE_XXX` constants) in `dtype`.
+   *
+   * Contrary to `data`, this function is not limited to 64-bit floating
+   * point values. It is allowed to fail if the data is not accessible in
+   * RAM, or not stored as a C-contiguous array. This function can be set
+   * to `NULL`, in which case the data is accessed through `data`.
+   */
+  mts_status_t (*typed_data)(void *array, void **data, int32_t *dtype);
+  /**
+   * Create a new array with the same options as the current one (data
+   * location, etc.), the requested `shape` and the requested `dtype` (one
+   * of the `MTS_DTYPE_XXX` constants); and store it in `new_array`. The
+   * number of elements in the `shape` array should be given in
+   * `shape_count`.
+   *
+   * The new array should be filled with zeros. If the array does not
+   * support the requested `dtype`, this function should leave `new_array`
+   * untouched and return a successful status. This function can be set to
+   * `NULL` if only 64-bit floating point values are supported.
+   */
+  mts_status_t (*create_typed)(const void *array,
+                               const uintptr_t *shape,
+                               uintptr_t shape_count,
+                               int32_t dtype,
+                               struct mts_array_t *new_array);
 } mts_array_t;
 
+/**
+ * Memory used by some metatensor data structure, broken down by category.
+ *
+ * All sizes are given in bytes. `Labels` shared between multiple blocks or
+ * gradients (for example the properties of a gradient, which are always the
+ * same as the properties of the corresponding block) are only counted once.
+ */
+typedef struct mts_memory_usage_t {
+  /**
+   * Memory used by the values arrays of the blocks. This assumes that the
+   * arrays contain 64-bit floating point values, since `mts_array_t` does
+   * not give a way to query the data type without accessing the data.
+   */
+  uintptr_t values;
+  /**
+   * Memory used by the values arrays of the gradients, with the same
+   * caveat as `values` regarding the data type.
+   */
+  uintptr_t gradients_values;
+  /**
+   * Memory used by the entries of `Labels`, i.e. keys, samples, components
+   * and properties of the blocks
+   */
+  uintptr_t labels_values;
+  /**
+   * Memory used by the hash maps used to find the position of entries in
+   * `Labels`, and to find the blocks matching a selection in `TensorMap`
+   */
+  uintptr_t labels_positions;
+  /**
+   * Memory used by `Labels` only used by gradients (both the entries and
+   * the hash maps), and which are not counted in `labels_values` and
+   * `labels_positions`
+   */
+  uintptr_t gradients_metadata;
+  /**
+   * Memory used by everything else: labels names, gradient parameters
+   * names and the fixed size part of the data structures
+   */
+  uintptr_t metadata;
+} mts_memory_usage_t;
+
 /**
  * Function pointer to grow in-memory buffers for `mts_tensormap_save_buffer`
  * and `mts_labels_save_buffer`.
@@ -249,12 +366,27 @@ typedef uint8_t *(*mts_realloc_buffer_t)(void *user_data, uint8_t *ptr, uintptr_
  *
  * The newly created array should contains 64-bit floating points (`double`)
  * data, and live on CPU, since metatensor will use `mts_array_t.data` to get
- * the data pointer and write to it.
+ * the data pointer and write to it. If the file contains data stored with
+ * another type and the array implements `mts_array_t.create_typed`, this
+ * function will be used to create arrays of the same type as the file;
+ * otherwise the data is converted to 64-bit floating points.
  */
 typedef mts_status_t (*mts_create_array_callback_t)(const uintptr_t *shape,
                                                     uintptr_t shape_count,
                                                     struct mts_array_t *array);
 
+/**
+ * Function pointer called when entering and leaving some of the functions in
+ * metatensor, to integrate metatensor with external profilers.
+ *
+ * `name` is the name of the function (e.g.
+ * `"mts_tensormap_keys_to_properties"`). It is a static NULL-terminated
+ * string, which stays valid until the program exits. `enter` will be `true`
+ * when entering the function, and `false` when leaving it. The calls are
+ * always properly nested, and made from the thread calling metatensor.
+ */
+typedef void (*mts_profiling_callback_t)(const char *name, bool enter);
+
 #ifdef __cplusplus
 extern "C" {
 #endif // __cplusplus
@@ -276,6 +408,25 @@ void mts_disable_panic_printing(void);
  */
 const char *mts_version(void);
 
+/**
+ * Set the maximal number of threads metatensor can use for operations running
+ * in parallel, such as `mts_tensormap_keys_to_properties` and
+ * `mts_tensormap_keys_to_samples`.
+ *
+ * Setting `n_threads` to 0 (the default) uses all the available cores, and
+ * setting it to 1 runs everything on the calling thread. Only the Labels are
+ * computed in parallel, the functions in `mts_array_t` are always called from
+ * the thread calling metatensor.
+ */
+void mts_set_max_threads(uintptr_t n_threads);
+
+/**
+ * Get the maximal number of threads metatensor can use for operations running
+ * in parallel, as set by `mts_set_max_threads`. A value of 0 means that all
+ * the available cores are used.
+ */
+uintptr_t mts_get_max_threads(void);
+
 /**
  * Get the last error message that was created on the current thread.
  *
@@ -283,6 +434,21 @@ const char *mts_version(void);
  */
 const char *mts_last_error(void);
 
+/**
+ * Register a `callback` that will be called when entering and leaving some of
+ * the functions in metatensor, such as `mts_tensormap_keys_to_properties` or
+ * `mts_tensormap_load`. This can be used to integrate with external
+ * profilers, and attribute time to metatensor operations.
+ *
+ * Only a single callback can be registered at a given time, and calling this
+ * function again replaces the previous callback. Setting `callback` to `NULL`
+ * (the default) disables profiling.
+ *
+ * @param callback function to call when entering and leaving functions, or
+ *        `NULL` to disable profiling
+ */
+void mts_set_profiling_callback(mts_profiling_callback_t callback);
+
 /**
  * Get the position of the entry defined by the `values` array in the given set
  * of `labels`. This operation is only available if the labels correspond to a
@@ -303,6 +469,34 @@ mts_status_t mts_labels_position(struct mts_labels_t labels,
                                  uintptr_t values_count,
                                  int64_t *result);
 
+/**
+ * Get the positions of multiple entries in the given set of `labels`. This
+ * operation is only available if the labels correspond to a set of Rust Labels
+ * (i.e. `labels.internal_ptr_` is not NULL).
+ *
+ * The entries to lookup are given in `values`, as a row-major 2D array of
+ * shape `(result_count, labels.size)`. This gives the same result as calling
+ * `mts_labels_position` for each entry, in a single call.
+ *
+ * @param labels set of labels with an associated Rust data structure
+ * @param values array containing the entries to lookup
+ * @param values_count size of the values array, this should be
+ *                     `result_count * labels.size`
+ * @param result array of size `result_count`, that will be filled with the
+ *               position of the corresponding entry in the labels, or -1 if
+ *               the entry was not found
+ * @param result_count number of entries to lookup
+ *
+ * @returns The status code of this operation. If the status is not
+ *          `MTS_SUCCESS`, you can use `mts_last_error()` to get the full
+ *          error message.
+ */
+mts_status_t mts_labels_positions(struct mts_labels_t labels,
+                                  const int32_t *values,
+                                  uintptr_t values_count,
+                                  int64_t *result,
+                                  uintptr_t result_count);
+
 /**
  * Finish the creation of `mts_labels_t` by associating it to Rust-owned
  * labels.
@@ -321,6 +515,27 @@ mts_status_t mts_labels_position(struct mts_labels_t labels,
  */
 mts_status_t mts_labels_create(struct mts_labels_t *labels);
 
+/**
+ * Finish the creation of `mts_labels_t` by associating it to Rust-owned
+ * labels, assuming all the entries in `labels.values` are unique.
+ *
+ * This is the same as `mts_labels_create`, but skips the check for duplicated
+ * entries, which is useful when creating large labels with entries known to
+ * be unique. If there are duplicated entries, `mts_labels_position` can
+ * return the position of any of them, and other functions using these labels
+ * might give wrong results.
+ *
+ * This function allocates memory which must be released `mts_labels_free` when
+ * you don't need it anymore.
+ *
+ * @param labels new set of labels containing pointers to user-managed memory
+ *        on input, and pointers to Rust-managed memory on output.
+ * @returns The status code of this operation. If the status is not
+ *          `MTS_SUCCESS`, you can use `mts_last_error()` to get the full
+ *          error message.
+ */
+mts_status_t mts_labels_create_assume_unique(struct mts_labels_t *labels);
+
 /**
  * Update the registered user data in `labels`
  *
@@ -331,6 +546,9 @@ mts_status_t mts_labels_create(struct mts_labels_t *labels);
  * Any existing user data will be released (by calling the provided
  * `user_data_delete` function) before overwriting with the new data.
  *
+ * This function fails for labels stored inside a block (e.g. labels obtained
+ * from `mts_block_labels`), since these can be shared with other blocks.
+ *
  * @param labels set of labels where we want to add user data
  * @param user_data pointer to the data
  * @param user_data_delete function pointer that will be used (if not NULL)
@@ -447,6 +665,23 @@ mts_status_t mts_labels_intersection(struct mts_labels_t first,
                                      int64_t *second_mapping,
                                      uintptr_t second_mapping_count);
 
+/**
+ * Get the memory used by `labels`, in bytes. This operation is only
+ * available if the labels correspond to a set of Rust Labels (i.e.
+ * `labels.internal_ptr_` is not NULL).
+ *
+ * Only the memory managed by metatensor is counted, the user data associated
+ * with the labels (see `mts_labels_set_user_data`) is not.
+ *
+ * @param labels set of labels with an associated Rust data structure
+ * @param usage pointer to be filled with the memory used by the labels
+ *
+ * @returns The status code of this operation. If the status is not
+ *          `MTS_SUCCESS`, you can use `mts_last_error()` to get the full
+ *          error message.
+ */
+mts_status_t mts_labels_memory_usage(struct mts_labels_t labels, struct mts_memory_usage_t *usage);
+
 /**
  * Decrease the reference count of `labels`, and release the corresponding
  * memory once the reference count reaches 0.
@@ -492,6 +727,10 @@ mts_status_t mts_get_data_origin(mts_data_origin_t origin, char *buffer, uintptr
  * The memory allocated by this function and the blocks should be released
  * using `mts_block_free`, or moved into a tensor map using `mts_tensormap`.
  *
+ * Labels without user data are interned when creating the block: if another
+ * block already uses labels with the same names and values, the new block
+ * will share them instead of keeping a separate copy.
+ *
  * @param data array handle containing the data for this block. The block takes
  *             ownership of the array, and will release it with
  *             `array.destroy(array.ptr)` when it no longer needs it.
@@ -539,6 +778,32 @@ mts_status_t mts_block_free(struct mts_block_t *block);
  */
 struct mts_block_t *mts_block_copy(const struct mts_block_t *block);
 
+/**
+ * Create a new `mts_block_t` containing the samples in the `[start, stop)`
+ * range of `block`, and the corresponding gradients.
+ *
+ * The new samples labels are built from the entries of the current samples
+ * without checking for duplicated entries, and the values and gradients data
+ * are moved with a single call to `mts_array_t.move_samples_from` using a
+ * contiguous range of samples. The arrays are created with the `create`
+ * function of the values array of `block`. The `"sample"` dimension of the
+ * gradients samples is shifted to refer to the samples of the new block.
+ *
+ * The memory allocated by this function and the blocks should be released
+ * using `mts_block_free`, or moved into a tensor map using `mts_tensormap`.
+ *
+ * @param block existing block to slice
+ * @param start index of the first sample to include in the new block
+ * @param stop index one past the last sample to include in the new block
+ *
+ * @returns A pointer to the newly allocated block, or a `NULL` pointer in
+ *          case of error. In case of error, you can use `mts_last_error()`
+ *          to get the error message.
+ */
+struct mts_block_t *mts_block_slice_samples(const struct mts_block_t *block,
+                                            uintptr_t start,
+                                            uintptr_t stop);
+
 /**
  * Get the set of labels from this `block`.
  *
@@ -637,6 +902,22 @@ mts_status_t mts_block_gradients_list(const struct mts_block_t *block,
                                       const char *const **parameters,
                                       uintptr_t *parameters_count);
 
+/**
+ * Get the memory used by this `block` and all its gradients, in bytes.
+ *
+ * Labels shared between the values and gradients of the block (for example
+ * the properties) are only counted once.
+ *
+ * @param block pointer to an existing block
+ * @param usage pointer to be filled with the memory used by the block
+ *
+ * @returns The status code of this operation. If the status is not
+ *          `MTS_SUCCESS`, you can use `mts_last_error()` to get the full
+ *          error message.
+ */
+mts_status_t mts_block_memory_usage(const struct mts_block_t *block,
+                                    struct mts_memory_usage_t *usage);
+
 /**
  * Create a new `mts_tensormap_t` with the given `keys` and `blocks`.
  * `blocks_count` must be set to the number of entries in the blocks array.
@@ -710,6 +991,10 @@ mts_status_t mts_tensormap_keys(const struct mts_tensormap_t *tensor, struct mts
  * `mts_tensormap_free` or the set of keys is modified by calling one
  * of the `mts_tensormap_keys_to_XXX` function.
  *
+ * This function does not modify the tensor map, and can be called
+ * concurrently from multiple threads. Different threads can then modify
+ * different blocks at the same time.
+ *
  * @param tensor pointer to an existing tensor map
  * @param block pointer to be filled with a block
  * @param index index of the block to get
@@ -748,6 +1033,33 @@ mts_status_t mts_tensormap_blocks_matching(const struct mts_tensormap_t *tensor,
                                            uintptr_t *count,
                                            struct mts_labels_t selection);
 
+/**
+ * Find which entry of `selection` each block in this `tensor` matches.
+ *
+ * This is equivalent to calling `mts_tensormap_blocks_matching` once for each
+ * entry of `selection`, but much faster when there are many entries. The
+ * `selection` should have a subset of the names/dimensions of the keys for
+ * this tensor map, and can contain any number of entries. Since all the
+ * entries in `selection` are different, each block matches at most one of
+ * them.
+ *
+ * @param tensor pointer to an existing tensor map
+ * @param block_selection array to be filled with the index of the entry in
+ *                        `selection` matching each block, or -1 if the block
+ *                        does not match any entry
+ * @param count number of entries in `block_selection`, this must be the same
+ *              as the number of blocks in the tensor map
+ * @param selection labels describing the requested blocks
+ *
+ * @returns The status code of this operation. If the status is not
+ *          `MTS_SUCCESS`, you can use `mts_last_error()` to get the full
+ *          error message.
+ */
+mts_status_t mts_tensormap_blocks_matching_many(const struct mts_tensormap_t *tensor,
+                                                int64_t *block_selection,
+                                                uintptr_t count,
+                                                struct mts_labels_t selection);
+
 /**
  * Merge blocks with the same value for selected keys dimensions along the
  * property axis.
@@ -763,12 +1075,15 @@ mts_status_t mts_tensormap_blocks_matching(const struct mts_tensormap_t *tensor,
  * 3` will produce a block with properties `a, p = (0, 1), (0, 2), (2, 1),
  * (2, 3)`.
  *
- * If `keys_to_move` contains entries, then the property labels must be the
- * same for all the merged blocks. In that case, the merged property labels
- * will contains each of the entries of `keys_to_move` and then the current
- * property labels. For example, using `a=2, 3` in `keys_to_move`, and
- * blocks with properties `p=1, 2` will result in `a, p = (2, 1), (2, 2),
- * (3, 1), (3, 2)`.
+ * If `keys_to_move` contains entries, then the merged property labels will
+ * contains each of the entries of `keys_to_move` and then the current property
+ * labels. For example, using `a=2, 3` in `keys_to_move`, and blocks with
+ * properties `p=1, 2` will result in `a, p = (2, 1), (2, 2), (3, 1), (3, 2)`.
+ * If the merged blocks have different property labels, each entry of
+ * `keys_to_move` is followed by the properties of the block with this entry in
+ * its key. Entries without such block use the properties of the blocks with
+ * this entry in the other groups of merged blocks, which must then all be the
+ * same.
  *
  * The new sample labels will contains all of the merged blocks sample
  * labels. The order of the samples is controlled by `sort_samples`. If
@@ -795,6 +1110,11 @@ struct mts_tensormap_t *mts_tensormap_keys_to_properties(const struct mts_tensor
  * Move the given dimensions from the component labels to the property labels
  * for each block in this tensor map.
  *
+ * `dimensions` can either contain the names of a single component, or all the
+ * names of multiple components. In the latter case, all the components are
+ * moved at once, and the new properties contain the components in the order
+ * in which they appear in `dimensions`, followed by the old properties.
+ *
  * `dimensions` must be an array of `dimensions_count` NULL-terminated strings,
  * encoded as UTF-8.
  *
@@ -844,6 +1164,53 @@ struct mts_tensormap_t *mts_tensormap_keys_to_samples(const struct mts_tensormap
                                                       struct mts_labels_t keys_to_move,
                                                       bool sort_samples);
 
+/**
+ * Join multiple tensor maps along the samples axis, merging the blocks with
+ * the same key in all the tensor maps.
+ *
+ * All the tensor maps must have the same keys (potentially in a different
+ * order), and the merged blocks must have the same sample names, components
+ * and properties. The keys of the new tensor map are in the same order as the
+ * keys of the first tensor map.
+ *
+ * If `new_dimension` is not `NULL`, a new dimension with this name is added
+ * to the samples, containing the index of the tensor map each sample comes
+ * from. Otherwise, the samples of the merged blocks must all be different. In
+ * both cases, the samples of the new blocks are in the same order as in the
+ * tensor maps.
+ *
+ * The result is a new tensor map, which should be freed with `mts_tensormap_free`.
+ *
+ * @param tensors array of pointers to the tensor maps to join
+ * @param tensors_count number of tensor maps in `tensors`
+ * @param new_dimension name of the new sample dimension, or `NULL` to join
+ *                      the samples without adding a new dimension
+ *
+ * @returns A pointer to the newly allocated tensor map, or a `NULL` pointer in
+ *          case of error. In case of error, you can use `mts_last_error()`
+ *          to get the error message.
+ */
+struct mts_tensormap_t *mts_tensormap_join_samples(const struct mts_tensormap_t *const *tensors,
+                                                   uintptr_t tensors_count,
+                                                   const char *new_dimension);
+
+/**
+ * Get the memory used by this `tensor` and all its blocks, in bytes.
+ *
+ * Labels shared between multiple blocks or gradients (for example the
+ * properties of gradients and the corresponding values) are only counted
+ * once.
+ *
+ * @param tensor pointer to an existing tensor map
+ * @param usage pointer to be filled with the memory used by the tensor map
+ *
+ * @returns The status code of this operation. If the status is not
+ *          `MTS_SUCCESS`, you can use `mts_last_error()` to get the full
+ *          error message.
+ */
+mts_status_t mts_tensormap_memory_usage(const struct mts_tensormap_t *tensor,
+                                        struct mts_memory_usage_t *usage);
+
 /**
  * Load labels from the file at the given path.
  *
@@ -978,6 +1345,116 @@ mts_status_t mts_labels_save_buffer(uint8_t **buffer,
 struct mts_tensormap_t *mts_tensormap_load(const char *path,
                                            mts_create_array_callback_t create_array);
 
+/**
+ * Load a subset of the blocks of a tensor map from the file at the given path.
+ *
+ * The `selection` follows the same rules as `mts_tensormap_blocks_matching`:
+ * it should contain a single entry, using a subset of the dimensions of the
+ * keys. Only the blocks matching this selection (and their gradients) are
+ * read from the file, all other blocks are skipped. The keys of the returned
+ * tensor map only contain the matching entries, in the same order as in the
+ * file.
+ *
+ * Arrays for the values and gradient data will be created with the given
+ * `create_array` callback, and filled by this function with the corresponding
+ * data.
+ *
+ * The memory allocated by this function should be released using
+ * `mts_tensormap_free`.
+ *
+ * @param path path to the file as a NULL-terminated UTF-8 string
+ * @param selection labels with a single entry describing which blocks should
+ *                  be loaded
+ * @param create_array callback function that will be used to create data
+ *                     arrays inside each block
+ *
+ * @returns A pointer to the newly allocated tensor map, or a `NULL` pointer in
+ *          case of error. In case of error, you can use `mts_last_error()`
+ *          to get the error message.
+ */
+struct mts_tensormap_t *mts_tensormap_load_selection(const char *path,
+                                                     struct mts_labels_t selection,
+                                                     mts_create_array_callback_t create_array);
+
+/**
+ * Load a tensor map from the file at the given path, decoding the blocks in
+ * parallel.
+ *
+ * This function uses up to `n_threads` threads to decompress the values and
+ * gradients of compressed files and to parse the Labels of all blocks, or
+ * all the available cores if `n_threads` is 0. Arrays for the
+ * values and gradient data will be created with the given `create_array`
+ * callback, and filled by this function with the corresponding data. The
+ * `create_array` callback is always called from the thread calling this
+ * function, and does not need to be thread-safe.
+ *
+ * The memory allocated by this function should be released using
+ * `mts_tensormap_free`.
+ *
+ * @param path path to the file as a NULL-terminated UTF-8 string
+ * @param n_threads maximal number of threads to use, or 0 to use all the
+ *                  available cores
+ * @param create_array callback function that will be used to create data
+ *                     arrays inside each block
+ *
+ * @returns A pointer to the newly allocated tensor map, or a `NULL` pointer in
+ *          case of error. In case of error, you can use `mts_last_error()`
+ *          to get the error message.
+ */
+struct mts_tensormap_t *mts_tensormap_load_parallel(const char *path,
+                                                    uintptr_t n_threads,
+                                                    mts_create_array_callback_t create_array);
+
+/**
+ * Load a tensor map from the file at the given path, using memory mapping to
+ * avoid copying the values and gradients data.
+ *
+ * The file is mapped in memory in copy-on-write mode, and the arrays in the
+ * returned tensor map point directly inside the mapped file. These arrays can
+ * be modified, but modifications are private to the current process and never
+ * written back to the file. The file must not be modified by other processes
+ * while the tensor map (or any array coming from it) is alive.
+ *
+ * The arrays are managed by metatensor, and contain floating point data on CPU
+ * using the same data type as the file, accessible with `mts_array_t.typed_data`.
+ * Accessing the data with `mts_array_t.data` converts arrays using another data
+ * type to 64-bit floating point. Entries that can not be used directly from the
+ * mapped file (for example compressed entries) are copied to memory owned by the
+ * corresponding array.
+ *
+ * The memory allocated by this function should be released using
+ * `mts_tensormap_free`.
+ *
+ * @param path path to the file as a NULL-terminated UTF-8 string
+ *
+ * @returns A pointer to the newly allocated tensor map, or a `NULL` pointer in
+ *          case of error. In case of error, you can use `mts_last_error()`
+ *          to get the error message.
+ */
+struct mts_tensormap_t *mts_tensormap_load_mmap(const char *path);
+
+/**
+ * Load a tensor map from the shared memory segment with the given `name`,
+ * created by `mts_tensormap_save_shm`.
+ *
+ * The segment is memory-mapped in the same way as `mts_tensormap_load_mmap`,
+ * and the arrays in the returned tensor map point directly inside the shared
+ * memory, without copying the data. The segment is not removed by this
+ * function, and can be loaded multiple times. Use `mts_tensormap_remove_shm`
+ * to remove it once it is no longer needed.
+ *
+ * The memory allocated by this function should be released using
+ * `mts_tensormap_free`.
+ *
+ * @param name name of the shared memory segment as a NULL-terminated UTF-8
+ *             string
+ *
+ * @returns A pointer to the newly allocated tensor map, or a `NULL` pointer in
+ *          case of error. In case of error, you can use `mts_last_error()`
+ *          to get the error message.
+ */
+struct mts_tensormap_t *mts_tensormap_load_shm(const char *name);
+
 /**
  * Load a tensor map from the given in-memory buffer.
  *
@@ -1015,6 +1492,78 @@ struct mts_tensormap_t *mts_tensormap_load_buffer(const uint8_t *buffer,
  */
 mts_status_t mts_tensormap_save(const char *path, const struct mts_tensormap_t *tensor);
 
+/**
+ * Save a tensor map to the file at the given path, compressing the data.
+ *
+ * If the file already exists, it is overwritten. All the entries in the file
+ * are compressed using the given `compression` method (one of the
+ * `MTS_COMPRESSION_XXX` constants), in parallel over up to `n_threads`
+ * threads. Compressed files can be loaded with all the `mts_tensormap_load`
+ * functions, but the data will be copied instead of memory-mapped when using
+ * `mts_tensormap_load_mmap`.
+ *
+ * @param path path to the file as a NULL-terminated UTF-8 string
+ * @param tensor tensor map to save to the file
+ * @param compression compression method to use, one of `MTS_COMPRESSION_NONE`,
+ *                    `MTS_COMPRESSION_DEFLATE` or `MTS_COMPRESSION_ZSTD`
+ * @param level compression level, with a meaning depending on the
+ *              compression method. Use 0 for the default level.
+ * @param n_threads maximal number of threads to use, or 0 to use all the
+ *                  available cores
+ *
+ * @returns The status code of this operation. If the status is not
+ *          `MTS_SUCCESS`, you can use `mts_last_error()` to get the full
+ *          error message.
+ */
+mts_status_t mts_tensormap_save_compressed(const char *path,
+                                           const struct mts_tensormap_t *tensor,
+                                           int32_t compression,
+                                           int32_t level,
+                                           uintptr_t n_threads);
+
+/**
+ * Save a tensor map to the shared memory segment with the given `name`.
+ *
+ * If the segment already exists, it is replaced. The exact size of the
+ * serialized data is computed first, and the data is then written directly
+ * inside a new file in the shared memory, without any intermediary buffer.
+ * This file is then renamed to the final name of the segment. The tensor map
+ * can then be loaded (potentially from another process) with
+ * `mts_tensormap_load_shm`.
+ *
+ * On Linux, the segment is a file in `/dev/shm`, and on other platforms a file
+ * in the temporary directory. On unix platforms, the file is only accessible
+ * by the current user. The segment is not removed automatically, and should
+ * be removed with `mts_tensormap_remove_shm` once it is no longer needed.
+ *
+ * @param name name of the shared memory segment as a NULL-terminated UTF-8
+ *             string. This should not contain any path separator.
+ * @param tensor tensor map to save to the shared memory segment
+ *
+ * @returns The status code of this operation. If the status is not
+ *          `MTS_SUCCESS`, you can use `mts_last_error()` to get the full
+ *          error message.
+ */
+mts_status_t mts_tensormap_save_shm(const char *name, const struct mts_tensormap_t *tensor);
+
+/**
+ * Remove the shared memory segment with the given `name`, created by
+ * `mts_tensormap_save_shm`.
+ *
+ * On unix platforms, tensor maps already loaded from this segment with
+ * `mts_tensormap_load_shm` stay valid, and the memory is released when the
+ * last array using it is destroyed. Other platforms do not allow removing a
+ * segment while it is still in use.
+ *
+ * @param name name of the shared memory segment as a NULL-terminated UTF-8
+ *             string
+ *
+ * @returns The status code of this operation. If the status is not
+ *          `MTS_SUCCESS`, you can use `mts_last_error()` to get the full
+ *          error message.
+ */
+mts_status_t mts_tensormap_remove_shm(const char *name);
+
 /**
  * Save a tensor map to an in-memory buffer.
  *
@@ -1047,6 +1596,154 @@ mts_status_t mts_tensormap_save_buffer(uint8_t **buffer,
                                        mts_realloc_buffer_t realloc,
                                        const struct mts_tensormap_t *tensor);
 
+/**
+ * Create a new `mts_tensormap_writer_t`, writing a tensor map to the file at
+ * the given `path` one block at a time.
+ *
+ * Blocks are written to the file as soon as they are added with
+ * `mts_tensormap_writer_add_block`, and the keys are written at the end by
+ * `mts_tensormap_writer_finish`. This allows writing a tensor map without
+ * having all the blocks in memory at the same time. The resulting file can
+ * be loaded with `mts_tensormap_load`. If the file already exists, it is
+ * overwritten.
+ *
+ * The memory allocated by this function should be released using
+ * `mts_tensormap_writer_free`.
+ *
+ * @param path path to the file as a NULL-terminated UTF-8 string
+ * @param keys_names names of the dimensions of the keys, as an array of
+ *                   NULL-terminated UTF-8 strings
+ * @param keys_names_count number of elements in the `keys_names` array
+ *
+ * @returns A pointer to the newly allocated writer, or a `NULL` pointer in
+ *          case of error. In case of error, you can use `mts_last_error()`
+ *          to get the error message.
+ */
+struct mts_tensormap_writer_t *mts_tensormap_writer(const char *path,
+                                                    const char *const *keys_names,
+                                                    uintptr_t keys_names_count);
+
+/**
+ * Write a single `block` to the file managed by this `writer`, associated
+ * with the given `key`.
+ *
+ * All blocks must have the same samples, components and properties names,
+ * and the same set of gradients. The block is not modified, and should still
+ * be released separately with `mts_block_free`.
+ *
+ * If writing to the file fails, the file is left in an invalid state, and
+ * all later operations on this `writer` fail.
+ *
+ * @param writer writer created with `mts_tensormap_writer`
+ * @param key values of the key for this block
+ * @param key_count number of elements in the `key` array, this must match
+ *                  the number of keys names given to `mts_tensormap_writer`
+ * @param block block to write to the file
+ *
+ * @returns The status code of this operation. If the status is not
+ *          `MTS_SUCCESS`, you can use `mts_last_error()` to get the full
+ *          error message.
+ */
+mts_status_t mts_tensormap_writer_add_block(struct mts_tensormap_writer_t *writer,
+                                            const int32_t *key,
+                                            uintptr_t key_count,
+                                            const struct mts_block_t *block);
+
+/**
+ * Start writing a block associated with the given `key` in chunks of
+ * samples, using the file managed by this `writer`.
+ *
+ * `shape` is the total shape of the values of the block. The NPY header of
+ * the values is written together with the first chunk, and the chunks are
+ * then written directly to the file. The chunks added with
+ * `mts_tensormap_writer_add_samples` must contain exactly `shape[0]` samples
+ * in total before calling `mts_tensormap_writer_end_block`. Blocks written
+ * this way can not contain gradients.
+ *
+ * @param writer writer created with `mts_tensormap_writer`
+ * @param key values of the key for this block
+ * @param key_count number of elements in the `key` array, this must match
+ *                  the number of keys names given to `mts_tensormap_writer`
+ * @param shape total shape of the values of this block
+ * @param shape_count number of elements in the `shape` array
+ *
+ * @returns The status code of this operation. If the status is not
+ *          `MTS_SUCCESS`, you can use `mts_last_error()` to get the full
+ *          error message.
+ */
+mts_status_t mts_tensormap_writer_begin_block(struct mts_tensormap_writer_t *writer,
+                                              const int32_t *key,
+                                              uintptr_t key_count,
+                                              const uintptr_t *shape,
+                                              uintptr_t shape_count);
+
+/**
+ * Write a `chunk` of samples for the block started with
+ * `mts_tensormap_writer_begin_block` to the file managed by this `writer`.
+ *
+ * The chunk must contain the next samples of the block, with the same
+ * components and properties as the other chunks, and no gradients. The
+ * chunk is not modified, and should still be released separately with
+ * `mts_block_free`.
+ *
+ * @param writer writer created with `mts_tensormap_writer`
+ * @param chunk block containing the next samples to write
+ *
+ * @returns The status code of this operation. If the status is not
+ *          `MTS_SUCCESS`, you can use `mts_last_error()` to get the full
+ *          error message.
+ */
+mts_status_t mts_tensormap_writer_add_samples(struct mts_tensormap_writer_t *writer,
+                                              const struct mts_block_t *chunk);
+
+/**
+ * Finish writing the block started with `mts_tensormap_writer_begin_block`,
+ * writing the samples, components and properties of the block to the file
+ * managed by this `writer`.
+ *
+ * This fails if the chunks did not contain the number of samples declared
+ * in `mts_tensormap_writer_begin_block`.
+ *
+ * @param writer writer created with `mts_tensormap_writer`
+ *
+ * @returns The status code of this operation. If the status is not
+ *          `MTS_SUCCESS`, you can use `mts_last_error()` to get the full
+ *          error message.
+ */
+mts_status_t mts_tensormap_writer_end_block(struct mts_tensormap_writer_t *writer);
+
+/**
+ * Finish writing the tensor map managed by this `writer`, writing the keys
+ * of all the blocks added so far to the file.
+ *
+ * No blocks can be added after calling this function. The writer itself
+ * must still be released with `mts_tensormap_writer_free`.
+ *
+ * @param writer writer created with `mts_tensormap_writer`
+ *
+ * @returns The status code of this operation. If the status is not
+ *          `MTS_SUCCESS`, you can use `mts_last_error()` to get the full
+ *          error message.
+ */
+mts_status_t mts_tensormap_writer_finish(struct mts_tensormap_writer_t *writer);
+
+/**
+ * Free the memory associated with a `writer` previously created with
+ * `mts_tensormap_writer`.
+ *
+ * If `mts_tensormap_writer_finish` was not called on this writer, the file
+ * will not contain the keys, and can not be loaded.
+ *
+ * If `writer` is `NULL`, this function does nothing.
+ *
+ * @param writer pointer to an existing writer, or `NULL`
+ *
+ * @returns The status code of this operation. If the status is not
+ *          `MTS_SUCCESS`, you can use `mts_last_error()` to get the full
+ *          error message.
+ */
+mts_status_t mts_tensormap_writer_free(struct mts_tensormap_writer_t *writer);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif // __cplusplus
@@ -2,6 +2,10 @@
 #define METATENSOR_HPP
 
 #include <array>
+#include <algorithm>
+#include <mutex>
+#include <atomic>
+#include <thread>
 #include <vector>
 #include <string>
 #include <memory>
@@ -130,9 +134,9 @@ namespace details {
     /// and array `shape`
     inline std::vector<size_t> cartesian_index(const std::vector<size_t>& shape, size_t index) {
         auto result = std::vector<size_t>(shape.size(), 0);
-        for (size_t i=0; i<shape.size(); i++) {
-            result[i] = index % shape[i];
-            index = index / shape[i];
+        for (size_t i=shape.size(); i>0; i--) {
+            result[i - 1] = index % shape[i - 1];
+            index = index / shape[i - 1];
         }
         assert(index == 0);
         return result;
@@ -169,7 +173,7 @@ namespace details {
         return linear_index(shape, index.data(), index.size());
     }
 
-    Labels labels_from_cxx(const std::vector<std::string>& names, const int32_t* values, size_t count);
+    Labels labels_from_cxx(const std::vector<std::string>& names, const int32_t* values, size_t count, bool assume_unique = false);
 }
 
 /******************************************************************************/
@@ -588,6 +592,41 @@ public:
             }, array, input, samples, samples_count, property_start, property_end);
         };
 
+        array.typed_data = [](void* array, void** data, int32_t* dtype) {
+            return details::catch_exceptions([](void* array, void** data, int32_t* dtype){
+                auto* cxx_array = static_cast<DataArrayBase*>(array);
+                *data = cxx_array->typed_data(*dtype);
+                return MTS_SUCCESS;
+            }, array, data, dtype);
+        };
+
+        array.create_typed = [](
+            const void* array,
+            const uintptr_t* shape,
+            uintptr_t shape_count,
+            int32_t dtype,
+            mts_array_t* new_array
+        ) {
+            return details::catch_exceptions([](
+                const void* array,
+                const uintptr_t* shape,
+                uintptr_t shape_count,
+                int32_t dtype,
+                mts_array_t* new_array
+            ) {
+                const auto* cxx_array = static_cast<const DataArrayBase*>(array);
+                auto cxx_shape = std::vector<size_t>();
+                for (size_t i=0; i<static_cast<size_t>(shape_count); i++) {
+                    cxx_shape.push_back(static_cast<size_t>(shape[i]));
+                }
+                auto copy = cxx_array->create_typed(std::move(cxx_shape), dtype);
+                if (copy != nullptr) {
+                    *new_array = DataArrayBase::to_mts_array_t(std::move(copy));
+                }
+                return MTS_SUCCESS;
+            }, array, shape, shape_count, dtype, new_array);
+        };
+
         return array;
     }
 
@@ -646,6 +685,33 @@ public:
         uintptr_t property_start,
         uintptr_t property_end
     ) = 0;
+
+    /// Get a pointer to the underlying data storage, and set `dtype` to the
+    /// type of the data (one of the `MTS_DTYPE_XXX` constants).
+    ///
+    /// This function is allowed to fail if the data is not accessible in RAM,
+    /// or not stored as a C-contiguous array. The default implementation
+    /// calls `data()`, and is only valid for 64-bit floating point values.
+    virtual void* typed_data(int32_t& dtype) & {
+        dtype = MTS_DTYPE_F64;
+        return this->data();
+    }
+
+    void* typed_data(int32_t& dtype) && = delete;
+
+    /// Create a new array with the same options as the current one (data
+    /// location, etc.), the requested `shape` and the requested `dtype` (one
+    /// of the `MTS_DTYPE_XXX` constants).
+    ///
+    /// The new array should be filled with zeros. If this array does not
+    /// support the requested `dtype`, this function should return `nullptr`.
+    /// The default implementation only supports `MTS_DTYPE_F64`.
+    virtual std::unique_ptr<DataArrayBase> create_typed(std::vector<uintptr_t> shape, int32_t dtype) const {
+        if (dtype == MTS_DTYPE_F64) {
+            return this->create(std::move(shape));
+        }
+        return nullptr;
+    }
 };
 
 
@@ -929,6 +995,750 @@ private:
     std::vector<uintptr_t> shape_;
 };
 
+/// An implementation of `DataArrayBase` storing only the non-zero elements.
+///
+/// The data is stored in coordinate (COO) format, as two vectors containing
+/// the linear (row-major) index of each non-zero element, sorted in increasing
+/// order, and the corresponding values. This is useful for blocks where most
+/// of the values are zero, since all the operations used by metatensor
+/// (`create`, `reshape`, `swap_axes`, `move_samples_from`, ...) only
+/// manipulate the non-zero elements. In particular
+/// `TensorMap::keys_to_properties` and `TensorMap::keys_to_samples` do not
+/// need to create a dense version of the data.
+///
+/// Calling `data()` switches this array to a dense storage, returning a
+/// pointer to the full data. This pointer is only valid until the next call to
+/// any other function of this array modifying it, which will switch it back
+/// to the sparse storage, removing all zero elements.
+class SparseDataArray: public metatensor::DataArrayBase {
+public:
+    /// Create a `SparseDataArray` with the given `shape`, and all elements set
+    /// to zero
+    SparseDataArray(std::vector<uintptr_t> shape):
+        shape_(std::move(shape)) {}
+
+    ~SparseDataArray() override = default;
+
+    /// SparseDataArray can be copy-constructed
+    SparseDataArray(const SparseDataArray&) = default;
+    /// SparseDataArray can be copy-assigned
+    SparseDataArray& operator=(const SparseDataArray&) = default;
+    /// SparseDataArray can be move-constructed
+    SparseDataArray(SparseDataArray&&) noexcept = default;
+    /// SparseDataArray can be move-assigned
+    SparseDataArray& operator=(SparseDataArray&&) noexcept = default;
+
+    mts_data_origin_t origin() const override {
+        mts_data_origin_t origin = 0;
+        mts_register_data_origin("metatensor::SparseDataArray", &origin);
+        return origin;
+    }
+
+    double* data() & override {
+        if (!dense_) {
+            dense_data_ = std::vector<double>(details::product(shape_), 0.0);
+            for (size_t i=0; i<indices_.size(); i++) {
+                dense_data_[indices_[i]] = values_[i];
+            }
+            indices_ = std::vector<size_t>();
+            values_ = std::vector<double>();
+            dense_ = true;
+        }
+        return dense_data_.data();
+    }
+
+    const std::vector<uintptr_t>& shape() const & override {
+        return shape_;
+    }
+
+    void reshape(std::vector<uintptr_t> shape) override {
+        if (details::product(shape_) != details::product(shape)) {
+            throw metatensor::Error("invalid shape in reshape");
+        }
+        // the linear index of all elements stays the same for row-major data
+        shape_ = std::move(shape);
+    }
+
+    void swap_axes(uintptr_t axis_1, uintptr_t axis_2) override {
+        this->make_sparse();
+
+        auto new_shape = shape_;
+        std::swap(new_shape[axis_1], new_shape[axis_2]);
+
+        auto entries = std::vector<std::pair<size_t, double>>();
+        entries.reserve(indices_.size());
+        for (size_t i=0; i<indices_.size(); i++) {
+            auto index = details::cartesian_index(shape_, indices_[i]);
+            std::swap(index[axis_1], index[axis_2]);
+            entries.emplace_back(details::linear_index(new_shape, index), values_[i]);
+        }
+        std::sort(entries.begin(), entries.end());
+
+        shape_ = std::move(new_shape);
+        for (size_t i=0; i<entries.size(); i++) {
+            indices_[i] = entries[i].first;
+            values_[i] = entries[i].second;
+        }
+    }
+
+    std::unique_ptr<DataArrayBase> copy() const override {
+        auto copy = std::unique_ptr<SparseDataArray>(new SparseDataArray(*this));
+        copy->make_sparse();
+        return copy;
+    }
+
+    std::unique_ptr<DataArrayBase> create(std::vector<uintptr_t> shape) const override {
+        return std::unique_ptr<DataArrayBase>(new SparseDataArray(std::move(shape)));
+    }
+
+    void move_samples_from(
+        const DataArrayBase& input,
+        std::vector<mts_sample_mapping_t> samples,
+        uintptr_t property_start,
+        uintptr_t property_end
+    ) override {
+        const auto* input_array = dynamic_cast<const SparseDataArray*>(&input);
+        if (input_array == nullptr) {
+            throw metatensor::Error("SparseDataArray can only move samples from another SparseDataArray");
+        }
+        assert(input_array->shape_.size() == this->shape_.size());
+        this->make_sparse();
+
+        size_t property_count = property_end - property_start;
+        size_t property_dim = shape_.size() - 1;
+        assert(input_array->shape_[property_dim] == property_count);
+
+        // number of elements per sample, and per set of components
+        size_t input_sample_size = details::product(input_array->shape_) / input_array->shape_[0];
+        size_t output_sample_size = details::product(shape_) / shape_[0];
+        size_t output_property_count = shape_[property_dim];
+        size_t n_components = output_sample_size / output_property_count;
+
+        auto moved = std::vector<std::pair<size_t, double>>();
+        auto overwrite = false;
+        for (const auto& sample: samples) {
+            auto input_start = sample.input * input_sample_size;
+            auto output_start = sample.output * output_sample_size;
+
+            // check if there are existing elements in the output range, which
+            // then need to be removed
+            for (size_t component=0; component<n_components && !overwrite; component++) {
+                auto start = output_start + component * output_property_count;
+                auto first = std::lower_bound(indices_.begin(), indices_.end(), start + property_start);
+                overwrite = first != indices_.end() && *first < start + property_end;
+            }
+
+            auto add_element = [&](size_t element, double value) {
+                auto component = element / property_count;
+                auto property = element % property_count;
+                auto output = output_start + component * output_property_count + property_start + property;
+                moved.emplace_back(output, value);
+            };
+
+            if (input_array->dense_) {
+                // the input was switched to dense storage by a call to
+                // `data()`, use the dense data directly
+                for (size_t element=0; element<input_sample_size; element++) {
+                    auto value = input_array->dense_data_[input_start + element];
+                    if (value != 0.0) {
+                        add_element(element, value);
+                    }
+                }
+            } else {
+                // the non-zero elements of each input sample are contiguous,
+                // so we can find all of them with a binary search
+                const auto& indices = input_array->indices_;
+                auto first = std::lower_bound(indices.begin(), indices.end(), input_start);
+                auto last = std::lower_bound(first, indices.end(), input_start + input_sample_size);
+                for (auto it = first; it != last; ++it) {
+                    auto position = static_cast<size_t>(it - indices.begin());
+                    add_element(*it - input_start, input_array->values_[position]);
+                }
+            }
+        }
+
+        if (overwrite) {
+            this->remove_elements(samples, output_sample_size, property_start, property_end);
+        }
+
+        std::sort(moved.begin(), moved.end());
+        if (indices_.empty() || moved.empty() || moved.front().first > indices_.back()) {
+            // fast path: the new elements go after all the existing ones
+            indices_.reserve(indices_.size() + moved.size());
+            values_.reserve(values_.size() + moved.size());
+            for (const auto& entry: moved) {
+                indices_.push_back(entry.first);
+                values_.push_back(entry.second);
+            }
+        } else {
+            // merge the two sorted lists of elements
+            auto indices = std::vector<size_t>();
+            auto values = std::vector<double>();
+            indices.reserve(indices_.size() + moved.size());
+            values.reserve(values_.size() + moved.size());
+
+            size_t i = 0;
+            size_t j = 0;
+            while (i < indices_.size() || j < moved.size()) {
+                if (j == moved.size() || (i < indices_.size() && indices_[i] < moved[j].first)) {
+                    indices.push_back(indices_[i]);
+                    values.push_back(values_[i]);
+                    i += 1;
+                } else {
+                    indices.push_back(moved[j].first);
+                    values.push_back(moved[j].second);
+                    j += 1;
+                }
+            }
+
+            indices_ = std::move(indices);
+            values_ = std::move(values);
+        }
+    }
+
+    /// Get the value of the element at the given `index`
+    double get(const std::vector<size_t>& index) const {
+        auto linear = details::linear_index(shape_, index);
+        if (dense_) {
+            return dense_data_[linear];
+        }
+
+        auto it = std::lower_bound(indices_.begin(), indices_.end(), linear);
+        if (it == indices_.end() || *it != linear) {
+            return 0.0;
+        }
+        return values_[static_cast<size_t>(it - indices_.begin())];
+    }
+
+    /// Set the value of the element at the given `index` to `value`. Setting
+    /// an element to zero removes it from the non-zero elements.
+    ///
+    /// This needs to shift all the elements after `index`, and is only
+    /// intended to fill arrays with a small number of non-zero elements.
+    void set(const std::vector<size_t>& index, double value) {
+        this->make_sparse();
+
+        auto linear = details::linear_index(shape_, index);
+        auto it = std::lower_bound(indices_.begin(), indices_.end(), linear);
+        auto position = it - indices_.begin();
+        auto exists = it != indices_.end() && *it == linear;
+
+        if (value == 0.0) {
+            if (exists) {
+                indices_.erase(it);
+                values_.erase(values_.begin() + position);
+            }
+        } else if (exists) {
+            values_[static_cast<size_t>(position)] = value;
+        } else {
+            indices_.insert(it, linear);
+            values_.insert(values_.begin() + position, value);
+        }
+    }
+
+    /// Check if this array switched to dense storage, which happens the first
+    /// time the data is accessed through `data()`
+    bool is_dense() const {
+        return dense_;
+    }
+
+    /// Get the number of non-zero elements in this array
+    size_t nnz() const {
+        if (dense_) {
+            size_t count = 0;
+            for (auto value: dense_data_) {
+                if (value != 0.0) {
+                    count += 1;
+                }
+            }
+            return count;
+        }
+        return indices_.size();
+    }
+
+    /// Create a dense copy of the data in this array
+    SimpleDataArray to_dense() const {
+        if (dense_) {
+            return SimpleDataArray(shape_, dense_data_);
+        }
+
+        auto data = std::vector<double>(details::product(shape_), 0.0);
+        for (size_t i=0; i<indices_.size(); i++) {
+            data[indices_[i]] = values_[i];
+        }
+        return SimpleDataArray(shape_, std::move(data));
+    }
+
+    /// Extract a reference to SparseDataArray out of an `mts_array_t`.
+    ///
+    /// This function fails if the `mts_array_t` does not contain a
+    /// SparseDataArray.
+    static SparseDataArray& from_mts_array(mts_array_t& array) {
+        mts_data_origin_t origin = 0;
+        auto status = array.origin(array.ptr, &origin);
+        if (status != MTS_SUCCESS) {
+            throw Error("failed to get data origin");
+        }
+
+        std::array<char, 64> buffer = {0};
+        status = mts_get_data_origin(origin, buffer.data(), buffer.size());
+        if (status != MTS_SUCCESS || std::string(buffer.data()) != "metatensor::SparseDataArray") {
+            throw Error("this array is not a metatensor::SparseDataArray");
+        }
+
+        auto* base = static_cast<DataArrayBase*>(array.ptr);
+        return dynamic_cast<SparseDataArray&>(*base);
+    }
+
+    /// Extract a const reference to SparseDataArray out of an `mts_array_t`.
+    ///
+    /// This function fails if the `mts_array_t` does not contain a
+    /// SparseDataArray.
+    static const SparseDataArray& from_mts_array(const mts_array_t& array) {
+        mts_data_origin_t origin = 0;
+        auto status = array.origin(array.ptr, &origin);
+        if (status != MTS_SUCCESS) {
+            throw Error("failed to get data origin");
+        }
+
+        std::array<char, 64> buffer = {0};
+        status = mts_get_data_origin(origin, buffer.data(), buffer.size());
+        if (status != MTS_SUCCESS || std::string(buffer.data()) != "metatensor::SparseDataArray") {
+            throw Error("this array is not a metatensor::SparseDataArray");
+        }
+
+        const auto* base = static_cast<const DataArrayBase*>(array.ptr);
+        return dynamic_cast<const SparseDataArray&>(*base);
+    }
+
+private:
+    /// Switch back to sparse storage after a call to `data()`
+    void make_sparse() {
+        if (dense_) {
+            indices_.clear();
+            values_.clear();
+            for (size_t i=0; i<dense_data_.size(); i++) {
+                if (dense_data_[i] != 0.0) {
+                    indices_.push_back(i);
+                    values_.push_back(dense_data_[i]);
+                }
+            }
+            dense_data_ = std::vector<double>();
+            dense_ = false;
+        }
+    }
+
+    /// Remove the existing elements in the properties between
+    /// `property_start` and `property_end` of the output samples in `samples`
+    void remove_elements(
+        const std::vector<mts_sample_mapping_t>& samples,
+        size_t sample_size,
+        size_t property_start,
+        size_t property_end
+    ) {
+        auto removed_samples = std::vector<bool>(shape_[0], false);
+        for (const auto& sample: samples) {
+            removed_samples[sample.output] = true;
+        }
+
+        auto property_count = shape_.back();
+        size_t kept = 0;
+        for (size_t i=0; i<indices_.size(); i++) {
+            auto sample = indices_[i] / sample_size;
+            auto property = indices_[i] % property_count;
+            if (removed_samples[sample] && property >= property_start && property < property_end) {
+                continue;
+            }
+
+            indices_[kept] = indices_[i];
+            values_[kept] = values_[i];
+            kept += 1;
+        }
+        indices_.resize(kept);
+        values_.resize(kept);
+    }
+
+    std::vector<uintptr_t> shape_;
+    /// row-major linear index of the non-zero elements, in increasing order
+    std::vector<size_t> indices_;
+    /// values of the non-zero elements, in the same order as `indices_`
+    std::vector<double> values_;
+    /// whether the data is currently stored in `dense_data_`
+    bool dense_ = false;
+    std::vector<double> dense_data_;
+};
+
+class ArenaDataArray;
+
+/// Memory pool used to allocate the data of multiple `ArenaDataArray`.
+///
+/// Memory is allocated in large chunks, and each array uses a contiguous
+/// range of elements inside one of the chunks. A chunk is released when the
+/// last array using it is destroyed, i.e. when all the `TensorMap` containing
+/// arrays from this chunk are dropped. The arena itself can be destroyed before
+/// the arrays.
+///
+/// Arrays created by calling `create()` on an `ArenaDataArray` (for example by
+/// `TensorMap::keys_to_properties()` or `TensorMap::keys_to_samples()`) are
+/// allocated in the same arena. When loading data, `DataArrayArena::Scope` and
+/// `DataArrayArena::create_array` can be used to create all the arrays in an
+/// arena. Arrays are filled with zeros when they are created, except for the
+/// ones coming from `DataArrayArena::create_array` and `copy()`, where all the
+/// elements are overwritten.
+///
+/// Allocating memory from the arena is thread-safe.
+class DataArrayArena {
+public:
+    /// Default number of elements in each chunk (8 MiB of 64-bit floating
+    /// point values)
+    static constexpr size_t DEFAULT_CHUNK_SIZE = 1024 * 1024;
+
+    /// Create a new arena, allocating memory in chunks containing at least
+    /// `chunk_size` elements.
+    explicit DataArrayArena(size_t chunk_size = DEFAULT_CHUNK_SIZE):
+        chunk_size_(std::max(chunk_size, static_cast<size_t>(ALIGNMENT)))
+    {}
+
+    ~DataArrayArena() = default;
+
+    /// DataArrayArena can not be copy-constructed
+    DataArrayArena(const DataArrayArena&) = delete;
+    /// DataArrayArena can not be copy-assigned
+    DataArrayArena& operator=(const DataArrayArena&) = delete;
+    /// DataArrayArena can not be move-constructed
+    DataArrayArena(DataArrayArena&&) = delete;
+    /// DataArrayArena can not be move-assigned
+    DataArrayArena& operator=(DataArrayArena&&) = delete;
+
+    /// Make sure that the next `count` elements are allocated from a single
+    /// chunk, allocating a new chunk if the current one is too small. This can
+    /// be used to get a single allocation when the total size of the arrays is
+    /// known in advance. Each array uses a multiple of 8 elements, to keep the
+    /// data aligned to 64 bytes.
+    void reserve(size_t count) {
+        std::lock_guard<std::mutex> guard(mutex_);
+        if (chunk_ == nullptr || current_chunk_size_ - chunk_used_ < count) {
+            this->new_chunk(count);
+        }
+    }
+
+    /// Allocate `count` elements in this arena. The data is filled with zeros
+    /// if `zero_initialize` is `true`, and left uninitialized otherwise. This
+    /// should only be used when all the elements are overwritten afterward.
+    ///
+    /// The returned pointer shares ownership of the corresponding chunk.
+    std::shared_ptr<double> allocate(size_t count, bool zero_initialize = true) {
+        std::lock_guard<std::mutex> guard(mutex_);
+
+        // keep all allocations aligned to 64 bytes
+        auto aligned = (count + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+        if (chunk_ == nullptr || current_chunk_size_ - chunk_used_ < aligned) {
+            this->new_chunk(aligned);
+        }
+
+        auto* data = chunk_.get() + chunk_used_;
+        chunk_used_ += aligned;
+
+        if (zero_initialize) {
+            std::fill(data, data + count, 0.0);
+        }
+
+        // aliasing constructor: the pointer refers to `data`, but shares the
+        // ownership of the full chunk
+        return std::shared_ptr<double>(chunk_, data);
+    }
+
+    /// Get the total memory allocated by this arena so far, in bytes
+    size_t allocated_size() const {
+        std::lock_guard<std::mutex> guard(mutex_);
+        return allocated_ * sizeof(double);
+    }
+
+    /// Use an arena as the target of `DataArrayArena::create_array` for the
+    /// lifetime of this object on the current thread.
+    ///
+    /// ```
+    /// auto arena = std::make_shared<metatensor::DataArrayArena>(
+    ///     /*chunk_size=*/ 1 << 20
+    /// );
+    ///
+    /// metatensor::DataArrayArena::Scope scope(arena);
+    /// auto tensor = metatensor::io::load(path, metatensor::DataArrayArena::create_array);
+    /// ```
+    class Scope {
+    public:
+        /// Make `arena` the current arena for this thread
+        explicit Scope(std::shared_ptr<DataArrayArena> arena):
+            arena_(std::move(arena)),
+            previous_(DataArrayArena::current())
+        {
+            if (arena_ == nullptr) {
+                throw Error("the arena in DataArrayArena::Scope can not be null");
+            }
+            DataArrayArena::current() = &arena_;
+        }
+
+        /// Restore the previous arena for this thread
+        ~Scope() {
+            DataArrayArena::current() = previous_;
+        }
+
+        /// Scope can not be copy-constructed
+        Scope(const Scope&) = delete;
+        /// Scope can not be copy-assigned
+        Scope& operator=(const Scope&) = delete;
+        /// Scope can not be move-constructed
+        Scope(Scope&&) = delete;
+        /// Scope can not be move-assigned
+        Scope& operator=(Scope&&) = delete;
+
+    private:
+        std::shared_ptr<DataArrayArena> arena_;
+        const std::shared_ptr<DataArrayArena>* previous_;
+    };
+
+    /// Callback for data array creation in `metatensor::io::load` and
+    /// friends, creating `ArenaDataArray` in the arena of the active
+    /// `DataArrayArena::Scope` on the current thread. Loading overwrites all
+    /// the elements, so the data of these arrays is not filled with zeros.
+    static mts_status_t create_array(
+        const uintptr_t* shape_ptr,
+        uintptr_t shape_count,
+        mts_array_t* array
+    );
+
+private:
+    /// Allocate a new chunk with space for at least `count` elements. The
+    /// remaining space in the previous chunk is not used anymore.
+    void new_chunk(size_t count) {
+        current_chunk_size_ = std::max(chunk_size_, count);
+        chunk_ = std::shared_ptr<double>(
+            // no value-initialization of the elements here
+            new double[current_chunk_size_],
+            std::default_delete<double[]>()
+        );
+        chunk_used_ = 0;
+        allocated_ += current_chunk_size_;
+    }
+
+    /// Get the arena of the active `Scope` on the current thread
+    static const std::shared_ptr<DataArrayArena>*& current() {
+        static thread_local const std::shared_ptr<DataArrayArena>* CURRENT = nullptr;
+        return CURRENT;
+    }
+
+    /// Number of elements used for alignment (64 bytes)
+    static constexpr size_t ALIGNMENT = 64 / sizeof(double);
+
+    mutable std::mutex mutex_;
+    size_t chunk_size_;
+
+    std::shared_ptr<double> chunk_;
+    size_t current_chunk_size_ = 0;
+    size_t chunk_used_ = 0;
+    size_t allocated_ = 0;
+};
+
+/// An implementation of `DataArrayBase` storing the data inside a
+/// `DataArrayArena`.
+///
+/// This behaves like `SimpleDataArray`, but avoids one separate allocation
+/// (and the zero-initialization when loading data) for each array created by
+/// operations and when loading data. All arrays created with `create()` or
+/// `copy()` from an `ArenaDataArray` use the same arena.
+class ArenaDataArray: public metatensor::DataArrayBase {
+public:
+    /// Create an `ArenaDataArray` with the given `shape` inside `arena`,
+    /// filled with zeros.
+    ArenaDataArray(std::shared_ptr<DataArrayArena> arena, std::vector<uintptr_t> shape):
+        ArenaDataArray(std::move(arena), std::move(shape), /*zero_initialize=*/ true)
+    {}
+
+    ~ArenaDataArray() override = default;
+
+    /// ArenaDataArray can not be copy-constructed, use `copy()` instead
+    ArenaDataArray(const ArenaDataArray&) = delete;
+    /// ArenaDataArray can not be copy-assigned, use `copy()` instead
+    ArenaDataArray& operator=(const ArenaDataArray&) = delete;
+    /// ArenaDataArray can be move-constructed
+    ArenaDataArray(ArenaDataArray&&) noexcept = default;
+    /// ArenaDataArray can be move-assigned
+    ArenaDataArray& operator=(ArenaDataArray&&) noexcept = default;
+
+    mts_data_origin_t origin() const override {
+        mts_data_origin_t origin = 0;
+        mts_register_data_origin("metatensor::ArenaDataArray", &origin);
+        return origin;
+    }
+
+    double* data() & override {
+        return data_.get();
+    }
+
+    const std::vector<uintptr_t>& shape() const & override {
+        return shape_;
+    }
+
+    void reshape(std::vector<uintptr_t> shape) override {
+        if (details::product(shape_) != details::product(shape)) {
+            throw metatensor::Error("invalid shape in reshape");
+        }
+        shape_ = std::move(shape);
+    }
+
+    void swap_axes(uintptr_t axis_1, uintptr_t axis_2) override {
+        auto size = details::product(shape_);
+        auto old_data = std::vector<double>(data_.get(), data_.get() + size);
+
+        auto new_shape = shape_;
+        std::swap(new_shape[axis_1], new_shape[axis_2]);
+
+        for (size_t i=0; i<size; i++) {
+            auto index = details::cartesian_index(shape_, i);
+            std::swap(index[axis_1], index[axis_2]);
+
+            data_.get()[details::linear_index(new_shape, index)] = old_data[i];
+        }
+
+        shape_ = std::move(new_shape);
+    }
+
+    std::unique_ptr<DataArrayBase> copy() const override {
+        auto* copy = new ArenaDataArray(arena_, shape_, /*zero_initialize=*/ false);
+        auto size = details::product(shape_);
+        std::copy(data_.get(), data_.get() + size, copy->data_.get());
+        return std::unique_ptr<DataArrayBase>(copy);
+    }
+
+    std::unique_ptr<DataArrayBase> create(std::vector<uintptr_t> shape) const override {
+        return std::unique_ptr<DataArrayBase>(new ArenaDataArray(arena_, std::move(shape)));
+    }
+
+    void move_samples_from(
+        const DataArrayBase& input,
+        std::vector<mts_sample_mapping_t> samples,
+        uintptr_t property_start,
+        uintptr_t property_end
+    ) override {
+        const auto& input_array = dynamic_cast<const ArenaDataArray&>(input);
+        assert(input_array.shape_.size() == this->shape_.size());
+
+        size_t property_count = property_end - property_start;
+        size_t property_dim = shape_.size() - 1;
+        assert(input_array.shape_[property_dim] == property_count);
+
+        // both arrays are row-major, so each sample contains `n_components`
+        // contiguous runs of properties
+        size_t n_components = 1;
+        for (size_t i=1; i<property_dim; i++) {
+            n_components *= shape_[i];
+        }
+
+        auto n_properties = shape_[property_dim];
+        const auto* input_data = input_array.data_.get();
+        auto* output_data = data_.get();
+        for (const auto& sample: samples) {
+            for (size_t component_i=0; component_i<n_components; component_i++) {
+                const auto* input_start = input_data + (sample.input * n_components + component_i) * property_count;
+                auto* output_start = output_data + (sample.output * n_components + component_i) * n_properties + property_start;
+                std::copy(input_start, input_start + property_count, output_start);
+            }
+        }
+    }
+
+    /// Get the arena containing the data of this array
+    const std::shared_ptr<DataArrayArena>& arena() const {
+        return arena_;
+    }
+
+    /// Get a const view of the data managed by this ArenaDataArray
+    NDArray<double> view() const {
+        return NDArray<double>(data_.get(), shape_);
+    }
+
+    /// Get a mutable view of the data managed by this ArenaDataArray
+    NDArray<double> view() {
+        return NDArray<double>(data_.get(), shape_);
+    }
+
+    /// Extract a reference to ArenaDataArray out of an `mts_array_t`.
+    ///
+    /// This function fails if the `mts_array_t` does not contain an
+    /// ArenaDataArray.
+    static ArenaDataArray& from_mts_array(mts_array_t& array) {
+        ArenaDataArray::check_origin(array);
+        auto* base = static_cast<DataArrayBase*>(array.ptr);
+        return dynamic_cast<ArenaDataArray&>(*base);
+    }
+
+    /// Extract a const reference to ArenaDataArray out of an `mts_array_t`.
+    ///
+    /// This function fails if the `mts_array_t` does not contain an
+    /// ArenaDataArray.
+    static const ArenaDataArray& from_mts_array(const mts_array_t& array) {
+        ArenaDataArray::check_origin(array);
+        const auto* base = static_cast<const DataArrayBase*>(array.ptr);
+        return dynamic_cast<const ArenaDataArray&>(*base);
+    }
+
+private:
+    friend class DataArrayArena;
+
+    /// Create an `ArenaDataArray` with the given `shape` inside `arena`,
+    /// leaving the data uninitialized if `zero_initialize` is `false`.
+    ArenaDataArray(std::shared_ptr<DataArrayArena> arena, std::vector<uintptr_t> shape, bool zero_initialize):
+        arena_(std::move(arena)),
+        shape_(std::move(shape))
+    {
+        if (arena_ == nullptr) {
+            throw Error("the arena of an ArenaDataArray can not be null");
+        }
+        data_ = arena_->allocate(details::product(shape_), zero_initialize);
+    }
+
+    static void check_origin(const mts_array_t& array) {
+        mts_data_origin_t origin = 0;
+        auto status = array.origin(array.ptr, &origin);
+        if (status != MTS_SUCCESS) {
+            throw Error("failed to get data origin");
+        }
+
+        std::array<char, 64> buffer = {0};
+        status = mts_get_data_origin(origin, buffer.data(), buffer.size());
+        if (status != MTS_SUCCESS || std::string(buffer.data()) != "metatensor::ArenaDataArray") {
+            throw Error("this array is not a metatensor::ArenaDataArray");
+        }
+    }
+
+    std::shared_ptr<DataArrayArena> arena_;
+    std::vector<uintptr_t> shape_;
+    std::shared_ptr<double> data_;
+};
+
+inline mts_status_t DataArrayArena::create_array(
+    const uintptr_t* shape_ptr,
+    uintptr_t shape_count,
+    mts_array_t* array
+) {
+    return details::catch_exceptions([](const uintptr_t* shape_ptr, uintptr_t shape_count, mts_array_t* array){
+        const auto* arena = DataArrayArena::current();
+        if (arena == nullptr) {
+            throw Error(
+                "DataArrayArena::create_array can only be used while a "
+                "DataArrayArena::Scope is active on the current thread"
+            );
+        }
+
+        auto shape = std::vector<uintptr_t>(shape_ptr, shape_ptr + shape_count);
+        auto cxx_array = std::unique_ptr<DataArrayBase>(
+            new ArenaDataArray(*arena, std::move(shape), /*zero_initialize=*/ false)
+        );
+        *array = DataArrayBase::to_mts_array_t(std::move(cxx_array));
+
+        return MTS_SUCCESS;
+    }, shape_ptr, shape_count, array);
+}
+
 namespace details {
     /// Default callback for data array creating in `TensorMap::load`, which
     /// will create a `SimpleDataArray`.
@@ -970,6 +1780,31 @@ namespace io {
     /// information on the format.
     void save(const std::string& path, const TensorMap& tensor);
 
+    /// Save a `TensorMap` to the shared memory segment with the given `name`,
+    /// to be loaded by `load_shm` in another process. The data is written once
+    /// directly inside the shared memory. The segment should be removed with
+    /// `remove_shm` once it is no longer needed.
+    void save_shm(const std::string& name, const TensorMap& tensor);
+
+    /// Remove the shared memory segment with the given `name`, created by
+    /// `save_shm`. See `mts_tensormap_remove_shm` for more information.
+    void remove_shm(const std::string& name);
+
+    /// Save a `TensorMap` to the file at `path`, compressing all the arrays
+    /// with the given `compression` method (one of the `MTS_COMPRESSION_XXX`
+    /// constants) and `level` (0 for the default level of this method).
+    ///
+    /// The arrays are compressed in parallel with up to `n_threads` threads,
+    /// or all the available cores if `n_threads` is 0. The resulting file can
+    /// be read by all the `load` functions.
+    void save_compressed(
+        const std::string& path,
+        const TensorMap& tensor,
+        int32_t compression,
+        int32_t level = 0,
+        size_t n_threads = 0
+    );
+
     /// Save a `TensorMap` to an in-memory buffer.
     ///
     /// The `Buffer` template parameter can be set to any type that can be
@@ -1000,22 +1835,101 @@ namespace io {
      *
      * \verbatim embed:rst:leading-asterisk
      *
-     * ``create_array`` will be used to create new arrays when constructing the
-     * blocks and gradients, the default version will create data using
-     * :cpp:class:`SimpleDataArray`. See :c:func:`mts_create_array_callback_t`
-     * for more information.
+     * ``create_array`` will be used to create new arrays when constructing the
+     * blocks and gradients, the default version will create data using
+     * :cpp:class:`SimpleDataArray`. See :c:func:`mts_create_array_callback_t`
+     * for more information.
+     *
+     * \endverbatim
+     *
+     * `TensorMap` are serialized using numpy's `.npz` format, i.e. a ZIP file
+     * without compression (storage method is `STORED`), where each file is
+     * stored as a `.npy` array. See the C API documentation for more
+     * information on the format.
+     */
+    TensorMap load(
+        const std::string& path,
+        mts_create_array_callback_t create_array = details::default_create_array
+    );
+
+    /*!
+     * Load the blocks matching `selection` from a previously saved `TensorMap`
+     * at the given path.
+     *
+     * The `selection` follows the same rules as `TensorMap::blocks_matching`,
+     * and only the matching blocks are read from the file. The keys of the
+     * returned `TensorMap` only contain the matching entries.
+     *
+     * \verbatim embed:rst:leading-asterisk
+     *
+     * ``create_array`` will be used to create new arrays when constructing the
+     * blocks and gradients, the default version will create data using
+     * :cpp:class:`SimpleDataArray`. See :c:func:`mts_create_array_callback_t`
+     * for more information.
+     *
+     * \endverbatim
+     */
+    TensorMap load_selection(
+        const std::string& path,
+        const Labels& selection,
+        mts_create_array_callback_t create_array = details::default_create_array
+    );
+
+    /*!
+     * Load a previously saved `TensorMap` from the given path, decoding the
+     * blocks in parallel with up to `n_threads` threads (or all the available
+     * cores if `n_threads` is 0).
+     *
+     * \verbatim embed:rst:leading-asterisk
+     *
+     * ``create_array`` will be used to create new arrays when constructing the
+     * blocks and gradients, the default version will create data using
+     * :cpp:class:`SimpleDataArray`. It is always called from the thread calling
+     * this function. See :c:func:`mts_tensormap_load_parallel` for more
+     * information.
+     *
+     * \endverbatim
+     */
+    TensorMap load_parallel(
+        const std::string& path,
+        size_t n_threads,
+        mts_create_array_callback_t create_array = details::default_create_array
+    );
+
+    /*!
+     * Load a previously saved `TensorMap` from the given path, using memory
+     * mapping to avoid copying the values and gradients data.
+     *
+     * The arrays in the returned `TensorMap` are managed by metatensor and
+     * point directly inside the mapped file, keeping the data type of the file
+     * (available with `mts_array_t::typed_data`). They can be modified, but
+     * modifications are private to the current process and never written back
+     * to the file. The file must not be modified by other processes while the
+     * `TensorMap` (or any array coming from it) is alive.
+     *
+     * \verbatim embed:rst:leading-asterisk
+     *
+     * See :c:func:`mts_tensormap_load_mmap` for more information.
+     *
+     * \endverbatim
+     */
+    TensorMap load_mmap(const std::string& path);
+
+    /*!
+     * Load a `TensorMap` from the shared memory segment with the given
+     * `name`, created by `save_shm` (potentially in another process).
+     *
+     * The arrays in the returned `TensorMap` point directly inside the shared
+     * memory, in the same way as `load_mmap`. The segment is not removed,
+     * and can be loaded multiple times until it is removed by `remove_shm`.
+     *
+     * \verbatim embed:rst:leading-asterisk
+     *
+     * See :c:func:`mts_tensormap_load_shm` for more information.
      *
      * \endverbatim
-     *
-     * `TensorMap` are serialized using numpy's `.npz` format, i.e. a ZIP file
-     * without compression (storage method is `STORED`), where each file is
-     * stored as a `.npy` array. See the C API documentation for more
-     * information on the format.
      */
-    TensorMap load(
-        const std::string& path,
-        mts_create_array_callback_t create_array = details::default_create_array
-    );
+    TensorMap load_shm(const std::string& name);
 
     /*!
      * Load a previously saved `TensorMap` from the given `buffer`, containing
@@ -1129,6 +2043,10 @@ private:
 };
 
 
+/// Tag type used to create `Labels` from entries which are known to be unique,
+/// skipping the check for duplicated entries.
+struct assume_unique {};
+
 /// A set of labels used to carry metadata associated with a tensor map.
 ///
 /// This is similar to an array of named tuples, but stored as a 2D array
@@ -1163,6 +2081,20 @@ public:
     Labels(const std::vector<std::string>& names, const int32_t* values, size_t count):
         Labels(details::labels_from_cxx(names, values, count)) {}
 
+    /// Create labels with the given `names` and `values`, assuming all the
+    /// entries in `values` are unique. `values` must be an array with
+    /// `count x names.size()` elements.
+    ///
+    /// This skips the check for duplicated entries, see
+    /// `mts_labels_create_assume_unique` for more information.
+    ///
+    /// ```
+    /// auto values = std::vector<int32_t>{0, 1, 1, 4, 2, 1};
+    /// auto labels = Labels({"first", "second"}, values.data(), 3, metatensor::assume_unique{});
+    /// ```
+    Labels(const std::vector<std::string>& names, const int32_t* values, size_t count, assume_unique):
+        Labels(details::labels_from_cxx(names, values, count, /* assume_unique */ true)) {}
+
     ~Labels() {
         mts_labels_free(&labels_);
     }
@@ -1232,6 +2164,16 @@ public:
         return labels_;
     }
 
+    /// Get the memory used by these `Labels`, in bytes
+    mts_memory_usage_t memory_usage() const {
+        assert(labels_.internal_ptr_ != nullptr);
+
+        mts_memory_usage_t usage;
+        std::memset(&usage, 0, sizeof(usage));
+        details::check_status(mts_labels_memory_usage(labels_, &usage));
+        return usage;
+    }
+
     /// Get the user data pointer registered with these `Labels`.
     ///
     /// If no user data have been registered, this function will return
@@ -1249,7 +2191,9 @@ public:
     /// Register some user data pointer with these `Labels`.
     ///
     /// Any existing user data will be released (by calling the provided
-    /// `delete` function) before overwriting with the new data.
+    /// `delete` function) before overwriting with the new data. This fails for
+    /// labels obtained from a `TensorBlock`, which can be shared with other
+    /// blocks.
     void set_user_data(LabelsUserData user_data) {
         assert(labels_.internal_ptr_ != nullptr);
 
@@ -1290,6 +2234,33 @@ public:
         return result;
     }
 
+    /// Get the positions of multiple entries in this set of Labels. The
+    /// `entries` should contain `count` entries, stored as a row-major 2D
+    /// array with `count` rows and `this->size()` columns. Missing entries get
+    /// the position -1.
+    std::vector<int64_t> positions(const int32_t* entries, size_t count) const {
+        assert(labels_.internal_ptr_ != nullptr);
+
+        auto result = std::vector<int64_t>(count, -1);
+        details::check_status(mts_labels_positions(
+            labels_,
+            entries,
+            count * this->size(),
+            result.data(),
+            result.size()
+        ));
+        return result;
+    }
+
+    /// Variant of `Labels::positions` taking a 2D `NDArray` as input
+    std::vector<int64_t> positions(const NDArray<int32_t>& entries) const {
+        if (entries.shape().size() != 2 || entries.shape()[1] != this->size()) {
+            throw Error("entries must be a 2D array with " + std::to_string(this->size()) + " columns in Labels::positions");
+        }
+
+        return this->positions(entries.data(), entries.shape()[0]);
+    }
+
     /// Get the array of values for these Labels
     const NDArray<int32_t>& values() const & {
         return values_;
@@ -1597,7 +2568,7 @@ private:
     Labels(const std::vector<std::string>& names, const NDArray<int32_t>& values, InternalConstructor):
         Labels(names, values.data(), values.shape()[0]) {}
 
-    friend Labels details::labels_from_cxx(const std::vector<std::string>& names, const int32_t* values, size_t count);
+    friend Labels details::labels_from_cxx(const std::vector<std::string>& names, const int32_t* values, size_t count, bool assume_unique);
     friend Labels io::load_labels(const std::string &path);
     friend Labels io::load_labels_buffer(const uint8_t* buffer, size_t buffer_count);
     friend class TensorMap;
@@ -1616,7 +2587,8 @@ namespace details {
     inline metatensor::Labels labels_from_cxx(
         const std::vector<std::string>& names,
         const int32_t* values,
-        size_t count
+        size_t count,
+        bool assume_unique
     ) {
         mts_labels_t labels;
         std::memset(&labels, 0, sizeof(labels));
@@ -1631,7 +2603,11 @@ namespace details {
         labels.count = count;
         labels.values = values;
 
-        details::check_status(mts_labels_create(&labels));
+        if (assume_unique) {
+            details::check_status(mts_labels_create_assume_unique(&labels));
+        } else {
+            details::check_status(mts_labels_create(&labels));
+        }
 
         return metatensor::Labels(labels);
     }
@@ -1776,6 +2752,51 @@ public:
         return block;
     }
 
+    /// Create a new `TensorBlock` containing the samples in the `[start,
+    /// stop)` range of this block, and the corresponding gradients.
+    ///
+    /// The new samples are built from the current samples without checking
+    /// for duplicated entries, and the data is copied with a single contiguous
+    /// range of samples.
+    TensorBlock slice_samples(uintptr_t start, uintptr_t stop) const {
+        auto block = TensorBlock();
+        block.is_view_ = false;
+        block.block_ = mts_block_slice_samples(this->block_, start, stop);
+        details::check_pointer(block.block_);
+        return block;
+    }
+
+    /// Split this block along the samples axis, at the given `boundaries`.
+    ///
+    /// The `boundaries` must be increasing, and the resulting blocks contain
+    /// the samples in `[0, boundaries[0])`, `[boundaries[0], boundaries[1])`,
+    /// ..., `[boundaries[n - 1], samples_count)`.
+    std::vector<TensorBlock> split_samples(const std::vector<uintptr_t>& boundaries) const {
+        auto samples_count = this->values_shape()[0];
+
+        auto blocks = std::vector<TensorBlock>();
+        blocks.reserve(boundaries.size() + 1);
+
+        uintptr_t start = 0;
+        for (auto boundary: boundaries) {
+            blocks.emplace_back(this->slice_samples(start, boundary));
+            start = boundary;
+        }
+        blocks.emplace_back(this->slice_samples(start, samples_count));
+
+        return blocks;
+    }
+
+    /// Get the memory used by this block and all its gradients, in bytes.
+    /// `Labels` shared between the values and the gradients are only counted
+    /// once.
+    mts_memory_usage_t memory_usage() const {
+        mts_memory_usage_t usage;
+        std::memset(&usage, 0, sizeof(usage));
+        details::check_status(mts_block_memory_usage(block_, &usage));
+        return usage;
+    }
+
     /// Get a view in the values in this block
     NDArray<double> values() & {
         auto array = this->mts_array();
@@ -2012,6 +3033,16 @@ private:
 /// A tensor map provides functions to move some of these keys to the samples or
 /// properties labels of the blocks, moving from a sparse representation of the
 /// data to a dense one.
+///
+/// Regarding thread-safety, functions that do not modify the `TensorMap`
+/// (`keys()`, `blocks_matching()`, `block_by_id()`, ...) can be called
+/// concurrently from multiple threads. Different threads can also modify
+/// different blocks at the same time, for example with `for_each_block()`.
+/// Functions creating a new `TensorMap` from this one (`keys_to_samples()`,
+/// `keys_to_properties()`, ...) must not run concurrently with any
+/// modification of the blocks. Error messages from both metatensor and C++
+/// callbacks are stored per-thread, so errors in one thread do not affect the
+/// others.
 class TensorMap final {
 public:
     /// Create a new TensorMap with the given `keys` and `blocks`
@@ -2085,6 +3116,38 @@ public:
         return TensorMap(this->keys(), std::move(blocks));
     }
 
+    /// Create a new `TensorMap` where each block contains the samples in the
+    /// `[start, stop)` range of the corresponding block in this tensor map.
+    ///
+    /// This is mainly useful when all blocks have the same samples, see
+    /// `TensorBlock::slice_samples` for more information.
+    TensorMap slice_samples(uintptr_t start, uintptr_t stop) const {
+        auto n_blocks = this->keys().count();
+
+        auto blocks = std::vector<TensorBlock>();
+        blocks.reserve(n_blocks);
+        for (uintptr_t i=0; i<n_blocks; i++) {
+            mts_block_t* block_ptr = nullptr;
+            details::check_status(mts_tensormap_block_by_id(tensor_, &block_ptr, i));
+            details::check_pointer(block_ptr);
+            auto block = TensorBlock::unsafe_view_from_ptr(block_ptr);
+
+            blocks.push_back(block.slice_samples(start, stop));
+        }
+
+        return TensorMap(this->keys(), std::move(blocks));
+    }
+
+    /// Get the memory used by this tensor map and all its blocks, in bytes.
+    /// `Labels` shared between multiple blocks or gradients are only counted
+    /// once.
+    mts_memory_usage_t memory_usage() const {
+        mts_memory_usage_t usage;
+        std::memset(&usage, 0, sizeof(usage));
+        details::check_status(mts_tensormap_memory_usage(tensor_, &usage));
+        return usage;
+    }
+
     /// Get the set of keys labeling the blocks in this tensor map
     Labels keys() const {
         mts_labels_t keys;
@@ -2111,6 +3174,30 @@ public:
         return matching;
     }
 
+    /// Get the list of block indexes matching each entry of `selection`,
+    /// using a single call to the C API. The returned vector contains one
+    /// (possibly empty) list of block indexes for each entry in `selection`.
+    std::vector<std::vector<uintptr_t>> blocks_matching_many(const Labels& selection) const {
+        auto block_selection = std::vector<int64_t>(this->keys().count());
+
+        details::check_status(mts_tensormap_blocks_matching_many(
+            tensor_,
+            block_selection.data(),
+            block_selection.size(),
+            selection.as_mts_labels_t()
+        ));
+
+        auto matching = std::vector<std::vector<uintptr_t>>(selection.count());
+        for (uintptr_t block_i = 0; block_i < block_selection.size(); block_i++) {
+            auto entry = block_selection[block_i];
+            if (entry >= 0) {
+                matching[static_cast<size_t>(entry)].push_back(block_i);
+            }
+        }
+
+        return matching;
+    }
+
     /// Get a block inside this TensorMap by it's index/the index of the
     /// corresponding key.
     ///
@@ -2126,6 +3213,95 @@ public:
 
     TensorBlock block_by_id(uintptr_t index) && = delete;
 
+    /// Call `function(index, block)` for all the blocks in this TensorMap,
+    /// using up to `n_threads` threads.
+    ///
+    /// The `block` given to `function` is a `TensorBlock` view inside this
+    /// `TensorMap`, as returned by `block_by_id()`. Setting `n_threads` to 0
+    /// uses the value from `mts_get_max_threads()`, or all the available
+    /// cores if this is also 0. Setting it to 1 calls `function` for all the
+    /// blocks in order on the current thread.
+    ///
+    /// When running in parallel, each block is given to exactly one thread,
+    /// and `function` must be safe to call concurrently for different blocks.
+    /// If calls to `function` throw exceptions, the remaining blocks are not
+    /// processed, and the exception for the block with the lowest index is
+    /// re-thrown on the calling thread once all threads finished.
+    template <typename Function>
+    void for_each_block(Function function, size_t n_threads = 0) & {
+        auto n_blocks = this->keys().count();
+
+        if (n_threads == 0) {
+            n_threads = static_cast<size_t>(mts_get_max_threads());
+        }
+        if (n_threads == 0) {
+            n_threads = std::max(std::thread::hardware_concurrency(), 1u);
+        }
+        n_threads = std::min(n_threads, n_blocks);
+
+        if (n_threads <= 1) {
+            for (uintptr_t i=0; i<n_blocks; i++) {
+                function(i, this->block_by_id(i));
+            }
+            return;
+        }
+
+        std::atomic<uintptr_t> next(0);
+        std::atomic<bool> failed(false);
+
+        std::mutex mutex;
+        auto error = std::exception_ptr();
+        auto error_block = n_blocks;
+
+        auto worker = [&]() {
+            while (!failed.load(std::memory_order_relaxed)) {
+                auto i = next.fetch_add(1, std::memory_order_relaxed);
+                if (i >= n_blocks) {
+                    return;
+                }
+
+                try {
+                    function(i, this->block_by_id(i));
+                } catch (...) {
+                    failed.store(true, std::memory_order_relaxed);
+
+                    std::lock_guard<std::mutex> guard(mutex);
+                    if (i < error_block) {
+                        error = std::current_exception();
+                        error_block = i;
+                    }
+                }
+            }
+        };
+
+        auto threads = std::vector<std::thread>();
+        try {
+            for (size_t thread_i=1; thread_i<n_threads; thread_i++) {
+                threads.emplace_back(worker);
+            }
+        } catch (...) {
+            // failed to start a thread, stop the ones already running
+            failed.store(true);
+            for (auto& thread: threads) {
+                thread.join();
+            }
+            throw;
+        }
+        // the calling thread also participates in the work
+        worker();
+
+        for (auto& thread: threads) {
+            thread.join();
+        }
+
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    template <typename Function>
+    void for_each_block(Function function, size_t n_threads = 0) && = delete;
+
     /// Merge blocks with the same value for selected keys dimensions along the
     /// property axis.
     ///
@@ -2140,12 +3316,15 @@ public:
     /// and properties `p=1, 3` will produce a block with properties `a, p = (0,
     /// 1), (0, 2), (2, 1), (2, 3)`.
     ///
-    /// If `keys_to_move` contains entries, then the property labels must be the
-    /// same for all the merged blocks. In that case, the merged property labels
-    /// will contains each of the entries of `keys_to_move` and then the current
+    /// If `keys_to_move` contains entries, then the merged property labels will
+    /// contains each of the entries of `keys_to_move` and then the current
     /// property labels. For example, using `a=2, 3` in `keys_to_move`, and
     /// blocks with properties `p=1, 2` will result in `a, p = (2, 1), (2, 2),
-    /// (3, 1), (3, 2)`.
+    /// (3, 1), (3, 2)`. If the merged blocks have different property labels,
+    /// each entry of `keys_to_move` is followed by the properties of the block
+    /// with this entry in its key. Entries without such block use the
+    /// properties of the blocks with this entry in the other groups of merged
+    /// blocks, which must then all be the same.
     ///
     /// The new sample labels will contains all of the merged blocks sample
     /// labels. The order of the samples is controlled by `sort_samples`. If
@@ -2227,6 +3406,10 @@ public:
     /// Move the given `dimensions` from the component labels to the property
     /// labels for each block.
     ///
+    /// `dimensions` can contain the names of a single component, or all the
+    /// names of multiple components, which are then moved together. See
+    /// `mts_tensormap_components_to_properties` for more information.
+    ///
     /// @param dimensions name of the component dimensions to move to the
     ///                  properties
     TensorMap components_to_properties(const std::vector<std::string>& dimensions) const {
@@ -2256,6 +3439,53 @@ public:
         return TensorMap(ptr);
     }
 
+    /// Join multiple `tensors` along the samples axis, merging the blocks with
+    /// the same key in all tensors.
+    ///
+    /// All the tensors must have the same keys (potentially in a different
+    /// order), and the merged blocks must have the same sample names,
+    /// components and properties. The keys of the new `TensorMap` are in the
+    /// same order as the keys of the first tensor.
+    ///
+    /// @param tensors the tensors to join
+    /// @param new_dimension name of a new sample dimension, containing the
+    ///                      index of the tensor each sample comes from. If
+    ///                      this is empty, no dimension is added and the
+    ///                      samples of the merged blocks must all be different.
+    static TensorMap join_samples(
+        const std::vector<TensorMap>& tensors,
+        const std::string& new_dimension = ""
+    ) {
+        auto pointers = std::vector<const TensorMap*>();
+        pointers.reserve(tensors.size());
+        for (const auto& tensor: tensors) {
+            pointers.push_back(&tensor);
+        }
+        return TensorMap::join_samples(pointers, new_dimension);
+    }
+
+    /// Join multiple `tensors` along the samples axis, taking pointers to the
+    /// tensors instead of the tensors themselves. See the function above for
+    /// more information.
+    static TensorMap join_samples(
+        const std::vector<const TensorMap*>& tensors,
+        const std::string& new_dimension = ""
+    ) {
+        auto c_tensors = std::vector<const mts_tensormap_t*>();
+        c_tensors.reserve(tensors.size());
+        for (const auto* tensor: tensors) {
+            c_tensors.push_back(tensor->tensor_);
+        }
+
+        auto* ptr = mts_tensormap_join_samples(
+            c_tensors.data(),
+            c_tensors.size(),
+            new_dimension.empty() ? nullptr : new_dimension.c_str()
+        );
+        details::check_pointer(ptr);
+        return TensorMap(ptr);
+    }
+
     /*!
      * \verbatim embed:rst:leading-asterisk
      *
@@ -2273,6 +3503,74 @@ public:
         return metatensor::io::load(path, create_array);
     }
 
+    /*!
+     * \verbatim embed:rst:leading-asterisk
+     *
+     * Load the blocks matching ``selection`` from a previously saved
+     * ``TensorMap`` at the given path.
+     *
+     * This is identical to :cpp:func:`metatensor::io::load_selection`, and
+     * provided as a convenience API.
+     *
+     * \endverbatim
+     */
+    static TensorMap load_selection(
+        const std::string& path,
+        const Labels& selection,
+        mts_create_array_callback_t create_array = details::default_create_array
+    ) {
+        return metatensor::io::load_selection(path, selection, create_array);
+    }
+
+    /*!
+     * \verbatim embed:rst:leading-asterisk
+     *
+     * Load a previously saved ``TensorMap`` from the given path, decoding the
+     * blocks in parallel.
+     *
+     * This is identical to :cpp:func:`metatensor::io::load_parallel`, and
+     * provided as a convenience API.
+     *
+     * \endverbatim
+     */
+    static TensorMap load_parallel(
+        const std::string& path,
+        size_t n_threads,
+        mts_create_array_callback_t create_array = details::default_create_array
+    ) {
+        return metatensor::io::load_parallel(path, n_threads, create_array);
+    }
+
+    /*!
+     * \verbatim embed:rst:leading-asterisk
+     *
+     * Load a previously saved ``TensorMap`` from the given path, using memory
+     * mapping to avoid copying the data.
+     *
+     * This is identical to :cpp:func:`metatensor::io::load_mmap`, and provided
+     * as a convenience API.
+     *
+     * \endverbatim
+     */
+    static TensorMap load_mmap(const std::string& path) {
+        return metatensor::io::load_mmap(path);
+    }
+
+    /*!
+     * \verbatim embed:rst:leading-asterisk
+     *
+     * Load a ``TensorMap`` from the shared memory segment with the given
+     * ``name``.
+     *
+     * This is identical to :cpp:func:`metatensor::io::load_shm`, and provided
+     * as a convenience API.
+     *
+     * \endverbatim
+     */
+    static TensorMap load_shm(const std::string& name) {
+        return metatensor::io::load_shm(name);
+    }
+
     /*!
      * \verbatim embed:rst:leading-asterisk
      *
@@ -2323,6 +3621,35 @@ public:
         return metatensor::io::save(path, *this);
     }
 
+    /*!
+     * \verbatim embed:rst:leading-asterisk
+     *
+     * Save a ``TensorMap`` to the given path, compressing the data.
+     *
+     * This is identical to :cpp:func:`metatensor::io::save_compressed`, and
+     * provided as a convenience API.
+     *
+     * \endverbatim
+     */
+    void save_compressed(const std::string& path, int32_t compression, int32_t level = 0, size_t n_threads = 0) const {
+        return metatensor::io::save_compressed(path, *this, compression, level, n_threads);
+    }
+
+    /*!
+     * \verbatim embed:rst:leading-asterisk
+     *
+     * Save a ``TensorMap`` to the shared memory segment with the given
+     * ``name``.
+     *
+     * This is identical to :cpp:func:`metatensor::io::save_shm`, and provided
+     * as a convenience API.
+     *
+     * \endverbatim
+     */
+    void save_shm(const std::string& name) const {
+        return metatensor::io::save_shm(name, *this);
+    }
+
     /*!
      * \verbatim embed:rst:leading-asterisk
      *
@@ -2376,6 +3703,15 @@ private:
     mts_tensormap_t* tensor_;
 };
 
+/// Join multiple `tensors` along the samples axis. This is identical to
+/// `TensorMap::join_samples`, and provided as a convenience API.
+inline TensorMap join_samples(
+    const std::vector<TensorMap>& tensors,
+    const std::string& new_dimension = ""
+) {
+    return TensorMap::join_samples(tensors, new_dimension);
+}
+
 
 /******************************************************************************/
 /******************************************************************************/
@@ -2391,6 +3727,30 @@ namespace io {
         details::check_status(mts_tensormap_save(path.c_str(), tensor.as_mts_tensormap_t()));
     }
 
+    inline void save_shm(const std::string& name, const TensorMap& tensor) {
+        details::check_status(mts_tensormap_save_shm(name.c_str(), tensor.as_mts_tensormap_t()));
+    }
+
+    inline void remove_shm(const std::string& name) {
+        details::check_status(mts_tensormap_remove_shm(name.c_str()));
+    }
+
+    inline void save_compressed(
+        const std::string& path,
+        const TensorMap& tensor,
+        int32_t compression,
+        int32_t level,
+        size_t n_threads
+    ) {
+        details::check_status(mts_tensormap_save_compressed(
+            path.c_str(),
+            tensor.as_mts_tensormap_t(),
+            compression,
+            level,
+            n_threads
+        ));
+    }
+
     template <typename Buffer>
     Buffer save_buffer(const TensorMap& tensor) {
         auto buffer = metatensor::io::save_buffer<std::vector<uint8_t>>(tensor);
@@ -2468,6 +3828,46 @@ namespace io {
         return TensorMap(ptr);
     }
 
+    inline TensorMap load_selection(
+        const std::string& path,
+        const Labels& selection,
+        mts_create_array_callback_t create_array
+    ) {
+        auto* ptr = mts_tensormap_load_selection(
+            path.c_str(),
+            selection.as_mts_labels_t(),
+            create_array
+        );
+        details::check_pointer(ptr);
+        return TensorMap(ptr);
+    }
+
+    inline TensorMap load_parallel(
+        const std::string& path,
+        size_t n_threads,
+        mts_create_array_callback_t create_array
+    ) {
+        auto* ptr = mts_tensormap_load_parallel(
+            path.c_str(),
+            static_cast<uintptr_t>(n_threads),
+            create_array
+        );
+        details::check_pointer(ptr);
+        return TensorMap(ptr);
+    }
+
+    inline TensorMap load_mmap(const std::string& path) {
+        auto* ptr = mts_tensormap_load_mmap(path.c_str());
+        details::check_pointer(ptr);
+        return TensorMap(ptr);
+    }
+
+    inline TensorMap load_shm(const std::string& name) {
+        auto* ptr = mts_tensormap_load_shm(name.c_str());
+        details::check_pointer(ptr);
+        return TensorMap(ptr);
+    }
+
     inline TensorMap load_buffer(
         const uint8_t* buffer,
         size_t buffer_count,
@@ -2529,6 +3929,107 @@ namespace io {
             buffer.size()
         );
     }
+
+    /// `TensorMapWriter` writes a `TensorMap` to a file one block at a time,
+    /// without having to keep all the blocks in memory at the same time.
+    ///
+    /// Blocks are written to the file as soon as they are added with
+    /// `add_block`, and the keys are written by `finish`. The resulting file
+    /// can be loaded with `metatensor::io::load`. A single block can also be
+    /// written in chunks of samples with `begin_block`, `add_samples` and
+    /// `end_block`.
+    class TensorMapWriter final {
+    public:
+        /// Create a new writer for the file at `path`, for a `TensorMap` with
+        /// the given keys names. If the file already exists, it is
+        /// overwritten.
+        TensorMapWriter(const std::string& path, const std::vector<std::string>& keys_names) {
+            auto c_names = std::vector<const char*>();
+            for (const auto& name: keys_names) {
+                c_names.push_back(name.c_str());
+            }
+
+            writer_ = mts_tensormap_writer(path.c_str(), c_names.data(), c_names.size());
+            details::check_pointer(writer_);
+        }
+
+        ~TensorMapWriter() {
+            mts_tensormap_writer_free(writer_);
+        }
+
+        /// TensorMapWriter can NOT be copy constructed
+        TensorMapWriter(const TensorMapWriter&) = delete;
+        /// TensorMapWriter can NOT be copy assigned
+        TensorMapWriter& operator=(const TensorMapWriter&) = delete;
+
+        /// TensorMapWriter can be move constructed
+        TensorMapWriter(TensorMapWriter&& other) noexcept {
+            *this = std::move(other);
+        }
+
+        /// TensorMapWriter can be move assigned
+        TensorMapWriter& operator=(TensorMapWriter&& other) noexcept {
+            mts_tensormap_writer_free(writer_);
+
+            this->writer_ = other.writer_;
+            other.writer_ = nullptr;
+
+            return *this;
+        }
+
+        /// Write `block` to the file, associated with the given `key`. All
+        /// blocks must have the same samples, components and properties
+        /// names, and the same set of gradients. If writing to the file
+        /// fails, this writer can not be used anymore.
+        void add_block(const std::vector<int32_t>& key, const TensorBlock& block) {
+            details::check_status(mts_tensormap_writer_add_block(
+                writer_,
+                key.data(),
+                key.size(),
+                block.as_mts_block_t()
+            ));
+        }
+
+        /// Start writing a block associated with the given `key` in chunks
+        /// of samples. `shape` is the total shape of the values of this
+        /// block, and the chunks added with `add_samples()` must contain
+        /// exactly `shape[0]` samples in total before calling `end_block()`.
+        /// Blocks written this way can not contain gradients.
+        void begin_block(const std::vector<int32_t>& key, const std::vector<uintptr_t>& shape) {
+            details::check_status(mts_tensormap_writer_begin_block(
+                writer_,
+                key.data(),
+                key.size(),
+                shape.data(),
+                shape.size()
+            ));
+        }
+
+        /// Write the next samples of the block started with `begin_block()`.
+        /// `chunk` must have the same components and properties as the other
+        /// chunks, and no gradients.
+        void add_samples(const TensorBlock& chunk) {
+            details::check_status(mts_tensormap_writer_add_samples(
+                writer_,
+                chunk.as_mts_block_t()
+            ));
+        }
+
+        /// Finish writing the block started with `begin_block()`, writing
+        /// its samples, components and properties to the file.
+        void end_block() {
+            details::check_status(mts_tensormap_writer_end_block(writer_));
+        }
+
+        /// Write the keys of all the blocks added so far to the file. No
+        /// other blocks can be added after calling this function.
+        void finish() {
+            details::check_status(mts_tensormap_writer_finish(writer_));
+        }
+
+    private:
+        mts_tensormap_writer_t* writer_ = nullptr;
+    };
 }
 
 }
@@ -3,9 +3,11 @@ use std::ffi::CString;
 use std::collections::{HashMap, BTreeSet};
 
 use crate::utils::ConstCString;
-use crate::{Labels, LabelsBuilder};
-use crate::{mts_array_t, get_data_origin};
+use crate::{Labels, LabelValue};
+use crate::{mts_array_t, mts_sample_mapping_t, get_data_origin};
 use crate::Error;
+use crate::MemoryUsageTracker;
+use crate::memory::hash_table_memory_usage;
 
 /// A `Vec` which can not be modified
 #[derive(Debug, Clone, PartialEq, Eq)]
@@ -167,6 +169,45 @@ impl TensorBlock {
         })
     }
 
+    /// Add the memory used by this block and all its gradients to `tracker`
+    pub fn memory_usage(&self, tracker: &mut MemoryUsageTracker) -> Result<(), Error> {
+        tracker.add_values(&self.values)?;
+        tracker.add_labels(&self.samples);
+        for component in &*self.components {
+            tracker.add_labels(component);
+        }
+        tracker.add_labels(&self.properties);
+
+        self.gradients_memory_usage(tracker)
+    }
+
+    /// Add the memory used by the internal data structures and the gradients
+    /// of this block to `tracker`
+    fn gradients_memory_usage(&self, tracker: &mut MemoryUsageTracker) -> Result<(), Error> {
+        tracker.add_metadata(std::mem::size_of::<TensorBlock>());
+        tracker.add_metadata(hash_table_memory_usage(
+            self.gradients.capacity(),
+            std::mem::size_of::<(String, TensorBlock)>()
+        ));
+        tracker.add_metadata(self.components.len() * std::mem::size_of::<Arc<Labels>>());
+
+        for (parameter, gradient) in &self.gradients {
+            // the parameter is stored both as a `String` and a `ConstCString`
+            tracker.add_metadata(parameter.capacity() + parameter.len() + 1 + std::mem::size_of::<ConstCString>());
+
+            tracker.add_gradient_values(&gradient.values)?;
+            tracker.add_gradient_labels(&gradient.samples);
+            for component in &*gradient.components {
+                tracker.add_gradient_labels(component);
+            }
+            tracker.add_gradient_labels(&gradient.properties);
+
+            gradient.gradients_memory_usage(tracker)?;
+        }
+
+        Ok(())
+    }
+
     /// Get all gradients defined in this block
     pub fn gradients(&self) -> &HashMap<String, TensorBlock> {
         &self.gradients
@@ -278,60 +319,300 @@ impl TensorBlock {
     }
 
     /// Move components to properties for this block and all gradients in this
-    /// block
+    /// block.
+    ///
+    /// If a single component has exactly the names in `dimensions`, this
+    /// component is moved. Otherwise, `dimensions` must contain all the names
+    /// of one or more components, and all these components are moved at once,
+    /// in the order in which they appear in `dimensions`.
     pub(crate) fn components_to_properties(&mut self, dimensions: &[&str]) -> Result<(), Error> {
         if dimensions.is_empty() {
             return Ok(());
         }
 
-        let mut component_axis = None;
-        for (component_i, component) in self.components.iter().enumerate() {
-            if component.names() == dimensions {
-                component_axis = Some(component_i);
-                break;
-            }
+        let moved = find_components(&self.components, dimensions)?;
+
+        // construct the new properties with the moved components followed by
+        // the old properties, in a single pass over the cartesian product
+        let old_properties = &self.properties;
+        let mut new_property_names = Vec::new();
+        for &component_i in &moved {
+            new_property_names.extend(self.components[component_i].names());
         }
+        new_property_names.extend(old_properties.names());
 
-        let component_axis = component_axis.ok_or_else(|| Error::InvalidParameter(format!(
-            "unable to find [{}] in the components ", dimensions.join(", ")
-        )))?;
+        let moved_labels = moved.iter().map(|&i| &*self.components[i]).collect::<Vec<_>>();
+        let mut count = old_properties.count();
+        for labels in &moved_labels {
+            count *= labels.count();
+        }
 
-        let moved_component = self.components.0.remove(component_axis);
+        let mut values = Vec::with_capacity(count * new_property_names.len());
+        let mut indexes = vec![0; moved_labels.len()];
+        if count != 0 {
+            loop {
+                for old_property in old_properties.iter() {
+                    for (labels, &i) in moved_labels.iter().zip(&indexes) {
+                        values.extend_from_slice(&labels[i]);
+                    }
+                    values.extend_from_slice(old_property);
+                }
 
-        // construct the new property with old properties and the components
-        let old_properties = &self.properties;
-        let new_property_names = moved_component.names().iter()
-            .chain(old_properties.names().iter())
-            .copied()
-            .collect();
-
-        let mut new_properties_builder = LabelsBuilder::new(new_property_names)?;
-        for new_property in &*moved_component {
-            for old_property in old_properties.iter() {
-                let mut property = new_property.to_vec();
-                property.extend_from_slice(old_property);
-                new_properties_builder.add(&property)?;
+                // increment the indexes, the last component changing fastest
+                let mut done = true;
+                for (labels, index) in moved_labels.iter().zip(&mut indexes).rev() {
+                    *index += 1;
+                    if *index < labels.count() {
+                        done = false;
+                        break;
+                    }
+                    *index = 0;
+                }
+
+                if done {
+                    break;
+                }
             }
         }
-        let new_properties = new_properties_builder.finish();
 
-        let mut new_shape = self.values.shape()?.to_vec();
-        let properties_axis = new_shape.len() - 1;
-        new_shape[properties_axis] = new_properties.count();
-        new_shape.remove(component_axis + 1);
+        // all the entries are unique since both the components and the
+        // properties are unique
+        let new_properties = Labels::new_assume_unique(new_property_names, values)?;
 
-        self.values.swap_axes(component_axis + 1, properties_axis - 1)?;
+        self.move_components_to_properties(&moved, &Arc::new(new_properties))
+    }
+
+    /// Move the components at indexes `moved` to the properties of this block
+    /// and all its gradients, replacing the properties with
+    /// `new_properties`.
+    ///
+    /// The data is transformed with a single permutation of the axes (moving
+    /// all the components after the remaining ones) followed by a single
+    /// reshape. For arrays implementing `swap_axes` as a view (numpy, torch)
+    /// this means that the data is only copied once, during the reshape.
+    fn move_components_to_properties(&mut self, moved: &[usize], new_properties: &Arc<Labels>) -> Result<(), Error> {
+        let shape = self.values.shape()?.to_vec();
+        let properties_axis = shape.len() - 1;
+
+        // new axis order: samples, remaining components, moved components,
+        // properties. Components start at the axis 1.
+        let mut order = vec![0];
+        order.extend((0..self.components.len()).filter(|c| !moved.contains(c)).map(|c| c + 1));
+        order.extend(moved.iter().map(|c| c + 1));
+        order.push(properties_axis);
+
+        permute_axes(&mut self.values, &order)?;
+
+        let mut new_shape = order[..order.len() - moved.len() - 1].iter()
+            .map(|&axis| shape[axis])
+            .collect::<Vec<_>>();
+        new_shape.push(new_properties.count());
         self.values.reshape(&new_shape)?;
 
-        self.properties = Arc::new(new_properties);
+        let n_components = self.components.len();
+        let components = std::mem::take(&mut self.components.0);
+        self.components = ImmutableVec(components.into_iter()
+            .enumerate()
+            .filter(|(i, _)| !moved.contains(i))
+            .map(|(_, component)| component)
+            .collect()
+        );
+
+        // the properties are shared between the block and its gradients
+        self.properties = Arc::clone(new_properties);
 
-        // Repeat all the above for all gradient blocks
+        // gradients contain additional components before the block ones
         for gradient in self.gradients.values_mut() {
-            gradient.components_to_properties(dimensions)?;
+            let offset = gradient.components.len() - n_components;
+            let gradient_moved = moved.iter().map(|c| c + offset).collect::<Vec<_>>();
+            gradient.move_components_to_properties(&gradient_moved, new_properties)?;
         }
 
         Ok(())
     }
+
+    /// Create a new `TensorBlock` containing the samples in the `start..end`
+    /// range of this block, and the corresponding gradients.
+    ///
+    /// The new samples are built directly from the entries of the current
+    /// samples, without checking for duplicated entries. The data is copied
+    /// into new arrays with a single contiguous range of samples. Gradients
+    /// samples are renumbered to refer to the samples of the new block; if
+    /// they are sorted, the corresponding rows are found with a binary search.
+    pub fn slice_samples(&self, start: usize, end: usize) -> Result<TensorBlock, Error> {
+        if start > end || end > self.samples.count() {
+            return Err(Error::InvalidParameter(format!(
+                "invalid range of samples {}..{} for a block with {} samples",
+                start, end, self.samples.count()
+            )));
+        }
+
+        for gradient in self.gradients.values() {
+            if !gradient.gradients.is_empty() {
+                return Err(Error::InvalidParameter(
+                    "gradient of gradients are not supported yet in slice_samples".into()
+                ));
+            }
+        }
+
+        let samples = Arc::new(self.samples.slice(start..end));
+        let mapping = (start..end).map(|sample| mts_sample_mapping_t {
+            input: sample,
+            output: sample - start,
+        }).collect::<Vec<_>>();
+        let values = slice_array(&self.values, &self.values, &mapping, self.properties.count())?;
+
+        let mut new_block = TensorBlock::new(
+            values,
+            samples,
+            self.components.to_vec(),
+            Arc::clone(&self.properties),
+        ).expect("invalid sliced block");
+
+        // add the gradients in the same order as the current block
+        for parameter in &self.gradient_parameters {
+            let gradient = &self.gradients[parameter.as_str()];
+            let gradient_samples = &gradient.samples;
+            let size = gradient_samples.size();
+
+            let rows = if gradient_samples.is_sorted() {
+                // the "sample" dimension is the first one, so the gradient rows
+                // for the selected samples are contiguous
+                let values = gradient_samples.raw_values();
+                let count = gradient_samples.count();
+                let first_row = partition_point(count, |row| values[row * size].usize() < start);
+                let last_row = partition_point(count, |row| values[row * size].usize() < end);
+                (first_row..last_row).collect::<Vec<_>>()
+            } else {
+                (0..gradient_samples.count()).filter(|&row| {
+                    let sample = gradient_samples[row][0].usize();
+                    sample >= start && sample < end
+                }).collect()
+            };
+
+            let mut mapping = Vec::with_capacity(rows.len());
+            let mut new_values = Vec::with_capacity(rows.len() * size);
+            for (output, &row) in rows.iter().enumerate() {
+                let entry = &gradient_samples[row];
+                mapping.push(mts_sample_mapping_t {
+                    input: row,
+                    output: output,
+                });
+                new_values.push(LabelValue::from(entry[0].usize() - start));
+                new_values.extend_from_slice(&entry[1..]);
+            }
+
+            // shifting the "sample" dimension of selected unique entries by the
+            // same amount keeps them unique
+            let gradient_samples = Labels::new_assume_unique(gradient_samples.names(), new_values)?;
+            let gradient_values = slice_array(
+                &self.values, &gradient.values, &mapping, self.properties.count()
+            )?;
+
+            let new_gradient = TensorBlock::new(
+                gradient_values,
+                Arc::new(gradient_samples),
+                gradient.components.to_vec(),
+                Arc::clone(&new_block.properties),
+            ).expect("invalid sliced gradient");
+
+            new_block.add_gradient(parameter.as_str(), new_gradient).expect("could not add gradient");
+        }
+
+        return Ok(new_block);
+    }
+}
+
+/// Create a new array with `creator.create()`, with the same shape as `array`
+/// except for the samples, and move the data for the samples in `mapping`
+/// into it.
+fn slice_array(
+    creator: &mts_array_t,
+    array: &mts_array_t,
+    mapping: &[mts_sample_mapping_t],
+    properties_count: usize,
+) -> Result<mts_array_t, Error> {
+    let mut shape = array.shape()?.to_vec();
+    shape[0] = mapping.len();
+
+    let mut new_array = creator.create(&shape)?;
+    if !mapping.is_empty() {
+        new_array.move_samples_from(array, mapping, 0..properties_count)?;
+    }
+
+    return Ok(new_array);
+}
+
+/// Find the indexes of the components containing the names in `dimensions`,
+/// following the rules of `TensorBlock::components_to_properties`.
+fn find_components(components: &[Arc<Labels>], dimensions: &[&str]) -> Result<Vec<usize>, Error> {
+    if let Some(component_i) = components.iter().position(|c| c.names() == dimensions) {
+        return Ok(vec![component_i]);
+    }
+
+    let mut moved = Vec::new();
+    for dimension in dimensions {
+        let component_i = components.iter()
+            .position(|c| c.names().contains(dimension))
+            .ok_or_else(|| Error::InvalidParameter(format!(
+                "unable to find [{}] in the components ", dimensions.join(", ")
+            )))?;
+
+        if !moved.contains(&component_i) {
+            moved.push(component_i);
+        }
+    }
+
+    let n_names = moved.iter().map(|&i| components[i].size()).sum::<usize>();
+    let all_names = moved.iter().all(|&i| {
+        components[i].names().iter().all(|name| dimensions.contains(name))
+    });
+    if !all_names || n_names != dimensions.len() {
+        return Err(Error::InvalidParameter(format!(
+            "[{}] does not correspond to the dimensions of one or more components: \
+            all the dimensions of a component must be moved together, and only once",
+            dimensions.join(", ")
+        )));
+    }
+
+    return Ok(moved);
+}
+
+/// Permute the axes of `array`, such that the axis `i` of the permuted array is
+/// the axis `order[i]` of the initial array. This uses at most `order.len() -
+/// 1` calls to `swap_axes`.
+fn permute_axes(array: &mut mts_array_t, order: &[usize]) -> Result<(), Error> {
+    // current[i] is the initial axis currently at position i
+    let mut current = (0..order.len()).collect::<Vec<_>>();
+    for (i, axis) in order.iter().enumerate() {
+        let position = current.iter()
+            .position(|a| a == axis)
+            .expect("invalid axes order");
+
+        if position != i {
+            array.swap_axes(i, position)?;
+            current.swap(i, position);
+        }
+    }
+
+    return Ok(());
+}
+
+/// Find the first index `i` in `0..count` for which `predicate(i)` is false,
+/// assuming the predicate is true for all indexes before `i` and false for all
+/// indexes after.
+fn partition_point(count: usize, predicate: impl Fn(usize) -> bool) -> usize {
+    let mut low = 0;
+    let mut high = count;
+    while low < high {
+        let middle = low + (high - low) / 2;
+        if predicate(middle) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
 }
 
 #[cfg(test)]
@@ -521,4 +802,39 @@ mod tests {
             assert!(result.is_ok());
         }
     }
+
+    #[test]
+    fn memory_usage() {
+        let samples = example_labels("samples", 4);
+        let properties = example_labels("properties", 7);
+        let mut block = TensorBlock::new(
+            TestArray::new(vec![4, 7]),
+            samples.clone(),
+            Vec::new(),
+            properties.clone(),
+        ).unwrap();
+
+        let gradient_samples = example_labels("sample", 3);
+        let gradient = TensorBlock::new(
+            TestArray::new(vec![3, 7]),
+            gradient_samples.clone(),
+            Vec::new(),
+            properties.clone(),
+        ).unwrap();
+        block.add_gradient("gradient", gradient).unwrap();
+
+        let mut tracker = MemoryUsageTracker::new();
+        block.memory_usage(&mut tracker).unwrap();
+        let usage = tracker.finish();
+
+        // TestArray does not implement typed_data, so we assume 64-bit floats
+        assert_eq!(usage.values, 4 * 7 * 8);
+        assert_eq!(usage.gradients_values, 3 * 7 * 8);
+        // the properties are shared between the values and gradient, and
+        // only counted once
+        assert_eq!(usage.labels_values, samples.memory_usage().values + properties.memory_usage().values);
+        assert_eq!(usage.labels_positions, 0);
+        assert_eq!(usage.gradients_metadata, gradient_samples.memory_usage().values);
+        assert!(usage.metadata > 0);
+    }
 }
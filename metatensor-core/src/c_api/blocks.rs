@@ -3,6 +3,8 @@ use std::os::raw::c_char;
 use std::ffi::CStr;
 
 use crate::{TensorBlock, Error, mts_array_t};
+use crate::{mts_memory_usage_t, MemoryUsageTracker};
+use crate::labels::intern_labels;
 
 use super::labels::{mts_labels_t, rust_to_mts_labels, mts_labels_to_rust};
 
@@ -43,6 +45,10 @@ impl mts_block_t {
 /// The memory allocated by this function and the blocks should be released
 /// using `mts_block_free`, or moved into a tensor map using `mts_tensormap`.
 ///
+/// Labels without user data are interned when creating the block: if another
+/// block already uses labels with the same names and values, the new block
+/// will share them instead of keeping a separate copy.
+///
 /// @param data array handle containing the data for this block. The block takes
 ///             ownership of the array, and will release it with
 ///             `array.destroy(array.ptr)` when it no longer needs it.
@@ -66,17 +72,19 @@ pub unsafe extern fn mts_block(
     let mut result = std::ptr::null_mut();
     let unwind_wrapper = std::panic::AssertUnwindSafe(&mut result);
     let status = catch_unwind(move || {
-        let samples = mts_labels_to_rust(&samples)?;
+        // identical labels are often used for many blocks, intern them to
+        // share the memory and make comparisons cheaper
+        let samples = intern_labels(mts_labels_to_rust(&samples)?);
 
         let mut rust_components = Vec::new();
         if components_count != 0 {
             check_pointers_non_null!(components);
             for component in std::slice::from_raw_parts(components, components_count) {
-                rust_components.push(mts_labels_to_rust(component)?);
+                rust_components.push(intern_labels(mts_labels_to_rust(component)?));
             }
         }
 
-        let properties = mts_labels_to_rust(&properties)?;
+        let properties = intern_labels(mts_labels_to_rust(&properties)?);
 
         let block = TensorBlock::new(data, samples, rust_components, properties)?;
         let boxed = Box::new(mts_block_t(block));
@@ -133,6 +141,7 @@ pub unsafe extern fn mts_block_free(
 pub unsafe extern fn mts_block_copy(
     block: *const mts_block_t,
 ) -> *mut mts_block_t {
+    profile_scope!("mts_block_copy");
     let mut result = std::ptr::null_mut();
     let unwind_wrapper = std::panic::AssertUnwindSafe(&mut result);
     let status = catch_unwind(move || {
@@ -154,6 +163,54 @@ pub unsafe extern fn mts_block_copy(
     return result;
 }
 
+/// Create a new `mts_block_t` containing the samples in the `[start, stop)`
+/// range of `block`, and the corresponding gradients.
+///
+/// The new samples labels are built from the entries of the current samples
+/// without checking for duplicated entries, and the values and gradients data
+/// are moved with a single call to `mts_array_t.move_samples_from` using a
+/// contiguous range of samples. The arrays are created with the `create`
+/// function of the values array of `block`. The `"sample"` dimension of the
+/// gradients samples is shifted to refer to the samples of the new block.
+///
+/// The memory allocated by this function and the blocks should be released
+/// using `mts_block_free`, or moved into a tensor map using `mts_tensormap`.
+///
+/// @param block existing block to slice
+/// @param start index of the first sample to include in the new block
+/// @param stop index one past the last sample to include in the new block
+///
+/// @returns A pointer to the newly allocated block, or a `NULL` pointer in
+///          case of error. In case of error, you can use `mts_last_error()`
+///          to get the error message.
+#[no_mangle]
+pub unsafe extern fn mts_block_slice_samples(
+    block: *const mts_block_t,
+    start: usize,
+    stop: usize,
+) -> *mut mts_block_t {
+    profile_scope!("mts_block_slice_samples");
+    let mut result = std::ptr::null_mut();
+    let unwind_wrapper = std::panic::AssertUnwindSafe(&mut result);
+    let status = catch_unwind(move || {
+        check_pointers_non_null!(block);
+        let new_block = (*block).slice_samples(start, stop)?;
+        let boxed = Box::new(mts_block_t(new_block));
+
+        // force the closure to capture the full unwind_wrapper, not just
+        // unwind_wrapper.0
+        let _ = &unwind_wrapper;
+        *(unwind_wrapper.0) = Box::into_raw(boxed);
+        Ok(())
+    });
+
+    if !status.is_success() {
+        return std::ptr::null_mut();
+    }
+
+    return result;
+}
+
 
 /// Get the set of labels from this `block`.
 ///
@@ -360,3 +417,30 @@ pub unsafe extern fn mts_block_gradients_list(
         Ok(())
     })
 }
+
+/// Get the memory used by this `block` and all its gradients, in bytes.
+///
+/// Labels shared between the values and gradients of the block (for example
+/// the properties) are only counted once.
+///
+/// @param block pointer to an existing block
+/// @param usage pointer to be filled with the memory used by the block
+///
+/// @returns The status code of this operation. If the status is not
+///          `MTS_SUCCESS`, you can use `mts_last_error()` to get the full
+///          error message.
+#[no_mangle]
+pub unsafe extern fn mts_block_memory_usage(
+    block: *const mts_block_t,
+    usage: *mut mts_memory_usage_t,
+) -> mts_status_t {
+    catch_unwind(|| {
+        check_pointers_non_null!(block, usage);
+
+        let mut tracker = MemoryUsageTracker::new();
+        (*block).memory_usage(&mut tracker)?;
+        *usage = tracker.finish();
+
+        Ok(())
+    })
+}
@@ -30,6 +30,7 @@ pub unsafe extern fn mts_labels_load(
     path: *const c_char,
     labels: *mut mts_labels_t,
 ) -> mts_status_t {
+    profile_scope!("mts_labels_load");
     catch_unwind(move || {
         check_pointers_non_null!(path, labels);
         if (*labels).is_rust() {
@@ -80,6 +81,7 @@ pub unsafe extern fn mts_labels_load_buffer(
     buffer_count: usize,
     labels: *mut mts_labels_t,
 ) -> mts_status_t {
+    profile_scope!("mts_labels_load_buffer");
     catch_unwind(move || {
         check_pointers_non_null!(buffer, labels);
         if (*labels).is_rust() {
@@ -133,6 +135,7 @@ pub unsafe extern fn mts_labels_save(
     path: *const c_char,
     labels: mts_labels_t,
 ) -> mts_status_t {
+    profile_scope!("mts_labels_save");
     catch_unwind(move || {
         check_pointers_non_null!(path);
         if !labels.is_rust() {
@@ -187,6 +190,7 @@ pub unsafe extern fn mts_labels_save_buffer(
     realloc: mts_realloc_buffer_t,
     labels: mts_labels_t,
 ) -> mts_status_t {
+    profile_scope!("mts_labels_save_buffer");
     catch_unwind(move || {
         if !labels.is_rust() {
             return Err(Error::InvalidParameter(
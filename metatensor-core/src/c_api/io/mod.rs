@@ -2,6 +2,7 @@ use std::os::raw::c_void;
 
 mod labels;
 mod tensor;
+mod writer;
 
 /// Function pointer to grow in-memory buffers for `mts_tensormap_save_buffer`
 /// and `mts_labels_save_buffer`.
@@ -1,7 +1,7 @@
 use std::os::raw::{c_char, c_void};
 use std::ffi::CStr;
 use std::fs::File;
-use std::io::{BufReader, BufWriter};
+use std::io::{BufReader, BufWriter, Cursor};
 
 use crate::Error;
 use crate::data::mts_array_t;
@@ -10,6 +10,7 @@ use super::{ExternalBuffer, mts_realloc_buffer_t};
 
 use super::super::status::{mts_status_t, catch_unwind};
 use super::super::tensor::mts_tensormap_t;
+use super::super::labels::{mts_labels_t, mts_labels_to_rust};
 
 /// Function pointer to create a new `mts_array_t` when de-serializing tensor
 /// maps.
@@ -20,7 +21,10 @@ use super::super::tensor::mts_tensormap_t;
 ///
 /// The newly created array should contains 64-bit floating points (`double`)
 /// data, and live on CPU, since metatensor will use `mts_array_t.data` to get
-/// the data pointer and write to it.
+/// the data pointer and write to it. If the file contains data stored with
+/// another type and the array implements `mts_array_t.create_typed`, this
+/// function will be used to create arrays of the same type as the file;
+/// otherwise the data is converted to 64-bit floating points.
 #[allow(non_camel_case_types)]
 type mts_create_array_callback_t = unsafe extern fn(
     shape: *const usize,
@@ -81,6 +85,7 @@ pub unsafe extern fn mts_tensormap_load(
     path: *const c_char,
     create_array: mts_create_array_callback_t,
 ) -> *mut mts_tensormap_t {
+    profile_scope!("mts_tensormap_load");
     let mut result = std::ptr::null_mut();
     let unwind_wrapper = std::panic::AssertUnwindSafe(&mut result);
     let status = catch_unwind(move || {
@@ -120,6 +125,249 @@ pub unsafe extern fn mts_tensormap_load(
     return result;
 }
 
+/// Load a subset of the blocks of a tensor map from the file at the given path.
+///
+/// The `selection` follows the same rules as `mts_tensormap_blocks_matching`:
+/// it should contain a single entry, using a subset of the dimensions of the
+/// keys. Only the blocks matching this selection (and their gradients) are
+/// read from the file, all other blocks are skipped. The keys of the returned
+/// tensor map only contain the matching entries, in the same order as in the
+/// file.
+///
+/// Arrays for the values and gradient data will be created with the given
+/// `create_array` callback, and filled by this function with the corresponding
+/// data.
+///
+/// The memory allocated by this function should be released using
+/// `mts_tensormap_free`.
+///
+/// @param path path to the file as a NULL-terminated UTF-8 string
+/// @param selection labels with a single entry describing which blocks should
+///                  be loaded
+/// @param create_array callback function that will be used to create data
+///                     arrays inside each block
+///
+/// @returns A pointer to the newly allocated tensor map, or a `NULL` pointer in
+///          case of error. In case of error, you can use `mts_last_error()`
+///          to get the error message.
+#[no_mangle]
+pub unsafe extern fn mts_tensormap_load_selection(
+    path: *const c_char,
+    selection: mts_labels_t,
+    create_array: mts_create_array_callback_t,
+) -> *mut mts_tensormap_t {
+    profile_scope!("mts_tensormap_load_selection");
+    let mut result = std::ptr::null_mut();
+    let unwind_wrapper = std::panic::AssertUnwindSafe(&mut result);
+    let status = catch_unwind(move || {
+        check_pointers_non_null!(path);
+
+        let create_array = wrap_create_array(&create_array);
+        let selection = mts_labels_to_rust(&selection)?;
+
+        let path = CStr::from_ptr(path).to_str().expect("use UTF-8 for path");
+        let file = BufReader::new(File::open(path)?);
+        let tensor = crate::io::load_selection(file, &selection, create_array)
+            .map_err(|err| match err {
+                Error::Serialization(message) => {
+                    Error::Serialization(format!(
+                        "unable to load a TensorMap from '{}': {}", path, message
+                    ))
+                }
+                err => return err,
+            })?;
+
+        // force the closure to capture the full unwind_wrapper, not just
+        // unwind_wrapper.0
+        let _ = &unwind_wrapper;
+        *(unwind_wrapper.0) = mts_tensormap_t::into_boxed_raw(tensor);
+        Ok(())
+    });
+
+    if !status.is_success() {
+        return std::ptr::null_mut();
+    }
+
+    return result;
+}
+
+/// Load a tensor map from the file at the given path, decoding the blocks in
+/// parallel.
+///
+/// This function uses up to `n_threads` threads to decompress the values and
+/// gradients of compressed files and to parse the Labels of all blocks, or
+/// all the available cores if `n_threads` is 0. Arrays for the
+/// values and gradient data will be created with the given `create_array`
+/// callback, and filled by this function with the corresponding data. The
+/// `create_array` callback is always called from the thread calling this
+/// function, and does not need to be thread-safe.
+///
+/// The memory allocated by this function should be released using
+/// `mts_tensormap_free`.
+///
+/// @param path path to the file as a NULL-terminated UTF-8 string
+/// @param n_threads maximal number of threads to use, or 0 to use all the
+///                  available cores
+/// @param create_array callback function that will be used to create data
+///                     arrays inside each block
+///
+/// @returns A pointer to the newly allocated tensor map, or a `NULL` pointer in
+///          case of error. In case of error, you can use `mts_last_error()`
+///          to get the error message.
+#[no_mangle]
+pub unsafe extern fn mts_tensormap_load_parallel(
+    path: *const c_char,
+    n_threads: usize,
+    create_array: mts_create_array_callback_t,
+) -> *mut mts_tensormap_t {
+    profile_scope!("mts_tensormap_load_parallel");
+    let mut result = std::ptr::null_mut();
+    let unwind_wrapper = std::panic::AssertUnwindSafe(&mut result);
+    let status = catch_unwind(move || {
+        check_pointers_non_null!(path);
+
+        let create_array = wrap_create_array(&create_array);
+
+        let path = CStr::from_ptr(path).to_str().expect("use UTF-8 for path");
+        let file = File::open(path)?;
+        // SAFETY: the file is only read while loading, and the mapping is
+        // dropped at the end of this function. This allows all the threads to
+        // read from the file at the same time.
+        let mmap = memmap2::Mmap::map(&file)?;
+        let tensor = crate::io::load_parallel(Cursor::new(&mmap[..]), n_threads, create_array)
+            .map_err(|err| match err {
+                Error::Serialization(message) => {
+                    Error::Serialization(format!(
+                        "unable to load a TensorMap from '{}': {}", path, message
+                    ))
+                }
+                err => return err,
+            })?;
+
+        // force the closure to capture the full unwind_wrapper, not just
+        // unwind_wrapper.0
+        let _ = &unwind_wrapper;
+        *(unwind_wrapper.0) = mts_tensormap_t::into_boxed_raw(tensor);
+        Ok(())
+    });
+
+    if !status.is_success() {
+        return std::ptr::null_mut();
+    }
+
+    return result;
+}
+
+/// Load a tensor map from the file at the given path, using memory mapping to
+/// avoid copying the values and gradients data.
+///
+/// The file is mapped in memory in copy-on-write mode, and the arrays in the
+/// returned tensor map point directly inside the mapped file. These arrays can
+/// be modified, but modifications are private to the current process and never
+/// written back to the file. The file must not be modified by other processes
+/// while the tensor map (or any array coming from it) is alive.
+///
+/// The arrays are managed by metatensor, and contain floating point data on CPU
+/// using the same data type as the file, accessible with `mts_array_t.typed_data`.
+/// Accessing the data with `mts_array_t.data` converts arrays using another data
+/// type to 64-bit floating point. Entries that can not be used directly from the
+/// mapped file (for example compressed entries) are copied to memory owned by the
+/// corresponding array.
+///
+/// The memory allocated by this function should be released using
+/// `mts_tensormap_free`.
+///
+/// @param path path to the file as a NULL-terminated UTF-8 string
+///
+/// @returns A pointer to the newly allocated tensor map, or a `NULL` pointer in
+///          case of error. In case of error, you can use `mts_last_error()`
+///          to get the error message.
+#[no_mangle]
+pub unsafe extern fn mts_tensormap_load_mmap(
+    path: *const c_char,
+) -> *mut mts_tensormap_t {
+    profile_scope!("mts_tensormap_load_mmap");
+    let mut result = std::ptr::null_mut();
+    let unwind_wrapper = std::panic::AssertUnwindSafe(&mut result);
+    let status = catch_unwind(move || {
+        check_pointers_non_null!(path);
+
+        let path = CStr::from_ptr(path).to_str().expect("use UTF-8 for path");
+        let tensor = crate::io::load_mmap(path)
+            .map_err(|err| match err {
+                Error::Serialization(message) => {
+                    if crate::io::looks_like_labels_data(crate::io::PathOrBuffer::Path(path)) {
+                        Error::Serialization(format!(
+                            "unable to load a TensorMap from '{}', use `load_labels` to load Labels: {}", path, message
+                        ))
+                    } else {
+                        Error::Serialization(format!(
+                            "unable to load a TensorMap from '{}': {}", path, message
+                        ))
+                    }
+                }
+                err => return err,
+            })?;
+
+        // force the closure to capture the full unwind_wrapper, not just
+        // unwind_wrapper.0
+        let _ = &unwind_wrapper;
+        *(unwind_wrapper.0) = mts_tensormap_t::into_boxed_raw(tensor);
+        Ok(())
+    });
+
+    if !status.is_success() {
+        return std::ptr::null_mut();
+    }
+
+    return result;
+}
+
+/// Load a tensor map from the shared memory segment with the given `name`,
+/// created by `mts_tensormap_save_shm`.
+///
+/// The segment is memory-mapped in the same way as `mts_tensormap_load_mmap`,
+/// and the arrays in the returned tensor map point directly inside the shared
+/// memory, without copying the data. The segment is not removed by this
+/// function, and can be loaded multiple times. Use `mts_tensormap_remove_shm`
+/// to remove it once it is no longer needed.
+///
+/// The memory allocated by this function should be released using
+/// `mts_tensormap_free`.
+///
+/// @param name name of the shared memory segment as a NULL-terminated UTF-8
+///             string
+///
+/// @returns A pointer to the newly allocated tensor map, or a `NULL` pointer in
+///          case of error. In case of error, you can use `mts_last_error()`
+///          to get the error message.
+#[no_mangle]
+pub unsafe extern fn mts_tensormap_load_shm(
+    name: *const c_char,
+) -> *mut mts_tensormap_t {
+    profile_scope!("mts_tensormap_load_shm");
+    let mut result = std::ptr::null_mut();
+    let unwind_wrapper = std::panic::AssertUnwindSafe(&mut result);
+    let status = catch_unwind(move || {
+        check_pointers_non_null!(name);
+
+        let name = CStr::from_ptr(name).to_str().expect("use UTF-8 for name");
+        let tensor = crate::io::load_shm(name)?;
+
+        // force the closure to capture the full unwind_wrapper, not just
+        // unwind_wrapper.0
+        let _ = &unwind_wrapper;
+        *(unwind_wrapper.0) = mts_tensormap_t::into_boxed_raw(tensor);
+        Ok(())
+    });
+
+    if !status.is_success() {
+        return std::ptr::null_mut();
+    }
+
+    return result;
+}
+
 /// Load a tensor map from the given in-memory buffer.
 ///
 /// Arrays for the values and gradient data will be created with the given
@@ -143,6 +391,7 @@ pub unsafe extern fn mts_tensormap_load_buffer(
     buffer_count: usize,
     create_array: mts_create_array_callback_t,
 ) -> *mut mts_tensormap_t {
+    profile_scope!("mts_tensormap_load_buffer");
     let mut result = std::ptr::null_mut();
     let unwind_wrapper = std::panic::AssertUnwindSafe(&mut result);
     let status = catch_unwind(move || {
@@ -224,6 +473,7 @@ pub unsafe extern fn mts_tensormap_save(
     path: *const c_char,
     tensor: *const mts_tensormap_t,
 ) -> mts_status_t {
+    profile_scope!("mts_tensormap_save");
     catch_unwind(|| {
         check_pointers_non_null!(path, tensor);
 
@@ -236,6 +486,112 @@ pub unsafe extern fn mts_tensormap_save(
 }
 
 
+/// Save a tensor map to the file at the given path, compressing the data.
+///
+/// If the file already exists, it is overwritten. All the entries in the file
+/// are compressed using the given `compression` method (one of the
+/// `MTS_COMPRESSION_XXX` constants), in parallel over up to `n_threads`
+/// threads. Compressed files can be loaded with all the `mts_tensormap_load`
+/// functions, but the data will be copied instead of memory-mapped when using
+/// `mts_tensormap_load_mmap`.
+///
+/// @param path path to the file as a NULL-terminated UTF-8 string
+/// @param tensor tensor map to save to the file
+/// @param compression compression method to use, one of `MTS_COMPRESSION_NONE`,
+///                    `MTS_COMPRESSION_DEFLATE` or `MTS_COMPRESSION_ZSTD`
+/// @param level compression level, with a meaning depending on the
+///              compression method. Use 0 for the default level.
+/// @param n_threads maximal number of threads to use, or 0 to use all the
+///                  available cores
+///
+/// @returns The status code of this operation. If the status is not
+///          `MTS_SUCCESS`, you can use `mts_last_error()` to get the full
+///          error message.
+#[no_mangle]
+pub unsafe extern fn mts_tensormap_save_compressed(
+    path: *const c_char,
+    tensor: *const mts_tensormap_t,
+    compression: i32,
+    level: i32,
+    n_threads: usize,
+) -> mts_status_t {
+    profile_scope!("mts_tensormap_save_compressed");
+    catch_unwind(|| {
+        check_pointers_non_null!(path, tensor);
+
+        let path = CStr::from_ptr(path).to_str().expect("use UTF-8 for path");
+        let file = BufWriter::new(File::create(path)?);
+        crate::io::save_compressed(file, &*tensor, compression, level, n_threads)?;
+
+        Ok(())
+    })
+}
+
+
+/// Save a tensor map to the shared memory segment with the given `name`.
+///
+/// If the segment already exists, it is replaced. The exact size of the
+/// serialized data is computed first, and the data is then written directly
+/// inside a new file in the shared memory, without any intermediary buffer.
+/// This file is then renamed to the final name of the segment. The tensor map
+/// can then be loaded (potentially from another process) with
+/// `mts_tensormap_load_shm`.
+///
+/// On Linux, the segment is a file in `/dev/shm`, and on other platforms a file
+/// in the temporary directory. On unix platforms, the file is only accessible
+/// by the current user. The segment is not removed automatically, and should
+/// be removed with `mts_tensormap_remove_shm` once it is no longer needed.
+///
+/// @param name name of the shared memory segment as a NULL-terminated UTF-8
+///             string. This should not contain any path separator.
+/// @param tensor tensor map to save to the shared memory segment
+///
+/// @returns The status code of this operation. If the status is not
+///          `MTS_SUCCESS`, you can use `mts_last_error()` to get the full
+///          error message.
+#[no_mangle]
+pub unsafe extern fn mts_tensormap_save_shm(
+    name: *const c_char,
+    tensor: *const mts_tensormap_t,
+) -> mts_status_t {
+    profile_scope!("mts_tensormap_save_shm");
+    catch_unwind(|| {
+        check_pointers_non_null!(name, tensor);
+
+        let name = CStr::from_ptr(name).to_str().expect("use UTF-8 for name");
+        crate::io::save_shm(name, &*tensor)?;
+
+        Ok(())
+    })
+}
+
+/// Remove the shared memory segment with the given `name`, created by
+/// `mts_tensormap_save_shm`.
+///
+/// On unix platforms, tensor maps already loaded from this segment with
+/// `mts_tensormap_load_shm` stay valid, and the memory is released when the
+/// last array using it is destroyed. Other platforms do not allow removing a
+/// segment while it is still in use.
+///
+/// @param name name of the shared memory segment as a NULL-terminated UTF-8
+///             string
+///
+/// @returns The status code of this operation. If the status is not
+///          `MTS_SUCCESS`, you can use `mts_last_error()` to get the full
+///          error message.
+#[no_mangle]
+pub unsafe extern fn mts_tensormap_remove_shm(name: *const c_char) -> mts_status_t {
+    catch_unwind(|| {
+        check_pointers_non_null!(name);
+
+        let name = CStr::from_ptr(name).to_str().expect("use UTF-8 for name");
+        crate::io::remove_shm(name)?;
+
+        Ok(())
+    })
+}
+
+
 /// Save a tensor map to an in-memory buffer.
 ///
 /// On input, `*buffer` should contain the address of a starting buffer (which
@@ -269,6 +625,7 @@ pub unsafe extern fn mts_tensormap_save_buffer(
     realloc: mts_realloc_buffer_t,
     tensor: *const mts_tensormap_t,
 ) -> mts_status_t {
+    profile_scope!("mts_tensormap_save_buffer");
     catch_unwind(|| {
         check_pointers_non_null!(tensor, buffer_count, buffer);
 
@@ -0,0 +1,265 @@
+use std::os::raw::c_char;
+use std::ffi::CStr;
+use std::fs::File;
+use std::io::BufWriter;
+
+use crate::io::TensorMapWriter;
+
+use super::super::status::{mts_status_t, catch_unwind};
+use super::super::blocks::mts_block_t;
+
+/// Opaque type used to write a tensor map to a file one block at a time.
+#[allow(non_camel_case_types)]
+pub struct mts_tensormap_writer_t(TensorMapWriter<BufWriter<File>>);
+
+/// Create a new `mts_tensormap_writer_t`, writing a tensor map to the file at
+/// the given `path` one block at a time.
+///
+/// Blocks are written to the file as soon as they are added with
+/// `mts_tensormap_writer_add_block`, and the keys are written at the end by
+/// `mts_tensormap_writer_finish`. This allows writing a tensor map without
+/// having all the blocks in memory at the same time. The resulting file can
+/// be loaded with `mts_tensormap_load`. If the file already exists, it is
+/// overwritten.
+///
+/// The memory allocated by this function should be released using
+/// `mts_tensormap_writer_free`.
+///
+/// @param path path to the file as a NULL-terminated UTF-8 string
+/// @param keys_names names of the dimensions of the keys, as an array of
+///                   NULL-terminated UTF-8 strings
+/// @param keys_names_count number of elements in the `keys_names` array
+///
+/// @returns A pointer to the newly allocated writer, or a `NULL` pointer in
+///          case of error. In case of error, you can use `mts_last_error()`
+///          to get the error message.
+#[no_mangle]
+pub unsafe extern fn mts_tensormap_writer(
+    path: *const c_char,
+    keys_names: *const *const c_char,
+    keys_names_count: usize,
+) -> *mut mts_tensormap_writer_t {
+    let mut result = std::ptr::null_mut();
+    let unwind_wrapper = std::panic::AssertUnwindSafe(&mut result);
+    let status = catch_unwind(move || {
+        check_pointers_non_null!(path);
+        if keys_names_count != 0 {
+            check_pointers_non_null!(keys_names);
+        }
+
+        let mut names = Vec::new();
+        for i in 0..keys_names_count {
+            let name = CStr::from_ptr(*(keys_names.add(i)));
+            names.push(name.to_str().expect("invalid UTF8 name"));
+        }
+
+        let path = CStr::from_ptr(path).to_str().expect("use UTF-8 for path");
+        let file = BufWriter::new(File::create(path)?);
+        let writer = TensorMapWriter::new(file, names)?;
+
+        // force the closure to capture the full unwind_wrapper, not just
+        // unwind_wrapper.0
+        let _ = &unwind_wrapper;
+        *(unwind_wrapper.0) = Box::into_raw(Box::new(mts_tensormap_writer_t(writer)));
+        Ok(())
+    });
+
+    if !status.is_success() {
+        return std::ptr::null_mut();
+    }
+
+    return result;
+}
+
+/// Write a single `block` to the file managed by this `writer`, associated
+/// with the given `key`.
+///
+/// All blocks must have the same samples, components and properties names,
+/// and the same set of gradients. The block is not modified, and should still
+/// be released separately with `mts_block_free`.
+///
+/// If writing to the file fails, the file is left in an invalid state, and
+/// all later operations on this `writer` fail.
+///
+/// @param writer writer created with `mts_tensormap_writer`
+/// @param key values of the key for this block
+/// @param key_count number of elements in the `key` array, this must match
+///                  the number of keys names given to `mts_tensormap_writer`
+/// @param block block to write to the file
+///
+/// @returns The status code of this operation. If the status is not
+///          `MTS_SUCCESS`, you can use `mts_last_error()` to get the full
+///          error message.
+#[no_mangle]
+pub unsafe extern fn mts_tensormap_writer_add_block(
+    writer: *mut mts_tensormap_writer_t,
+    key: *const i32,
+    key_count: usize,
+    block: *const mts_block_t,
+) -> mts_status_t {
+    profile_scope!("mts_tensormap_writer_add_block");
+    catch_unwind(|| {
+        check_pointers_non_null!(writer, block);
+
+        let key = if key_count == 0 {
+            &[]
+        } else {
+            check_pointers_non_null!(key);
+            std::slice::from_raw_parts(key, key_count)
+        };
+
+        (*writer).0.add_block(key, &*block)?;
+
+        Ok(())
+    })
+}
+
+/// Start writing a block associated with the given `key` in chunks of
+/// samples, using the file managed by this `writer`.
+///
+/// `shape` is the total shape of the values of the block. The NPY header of
+/// the values is written together with the first chunk, and the chunks are
+/// then written directly to the file. The chunks added with
+/// `mts_tensormap_writer_add_samples` must contain exactly `shape[0]` samples
+/// in total before calling `mts_tensormap_writer_end_block`. Blocks written
+/// this way can not contain gradients.
+///
+/// @param writer writer created with `mts_tensormap_writer`
+/// @param key values of the key for this block
+/// @param key_count number of elements in the `key` array, this must match
+///                  the number of keys names given to `mts_tensormap_writer`
+/// @param shape total shape of the values of this block
+/// @param shape_count number of elements in the `shape` array
+///
+/// @returns The status code of this operation. If the status is not
+///          `MTS_SUCCESS`, you can use `mts_last_error()` to get the full
+///          error message.
+#[no_mangle]
+pub unsafe extern fn mts_tensormap_writer_begin_block(
+    writer: *mut mts_tensormap_writer_t,
+    key: *const i32,
+    key_count: usize,
+    shape: *const usize,
+    shape_count: usize,
+) -> mts_status_t {
+    profile_scope!("mts_tensormap_writer_begin_block");
+    catch_unwind(|| {
+        check_pointers_non_null!(writer);
+
+        let key = if key_count == 0 {
+            &[]
+        } else {
+            check_pointers_non_null!(key);
+            std::slice::from_raw_parts(key, key_count)
+        };
+
+        let shape = if shape_count == 0 {
+            &[]
+        } else {
+            check_pointers_non_null!(shape);
+            std::slice::from_raw_parts(shape, shape_count)
+        };
+
+        (*writer).0.begin_block(key, shape)?;
+
+        Ok(())
+    })
+}
+
+/// Write a `chunk` of samples for the block started with
+/// `mts_tensormap_writer_begin_block` to the file managed by this `writer`.
+///
+/// The chunk must contain the next samples of the block, with the same
+/// components and properties as the other chunks, and no gradients. The
+/// chunk is not modified, and should still be released separately with
+/// `mts_block_free`.
+///
+/// @param writer writer created with `mts_tensormap_writer`
+/// @param chunk block containing the next samples to write
+///
+/// @returns The status code of this operation. If the status is not
+///          `MTS_SUCCESS`, you can use `mts_last_error()` to get the full
+///          error message.
+#[no_mangle]
+pub unsafe extern fn mts_tensormap_writer_add_samples(
+    writer: *mut mts_tensormap_writer_t,
+    chunk: *const mts_block_t,
+) -> mts_status_t {
+    profile_scope!("mts_tensormap_writer_add_samples");
+    catch_unwind(|| {
+        check_pointers_non_null!(writer, chunk);
+        (*writer).0.add_samples(&*chunk)?;
+        Ok(())
+    })
+}
+
+/// Finish writing the block started with `mts_tensormap_writer_begin_block`,
+/// writing the samples, components and properties of the block to the file
+/// managed by this `writer`.
+///
+/// This fails if the chunks did not contain the number of samples declared
+/// in `mts_tensormap_writer_begin_block`.
+///
+/// @param writer writer created with `mts_tensormap_writer`
+///
+/// @returns The status code of this operation. If the status is not
+///          `MTS_SUCCESS`, you can use `mts_last_error()` to get the full
+///          error message.
+#[no_mangle]
+pub unsafe extern fn mts_tensormap_writer_end_block(
+    writer: *mut mts_tensormap_writer_t,
+) -> mts_status_t {
+    profile_scope!("mts_tensormap_writer_end_block");
+    catch_unwind(|| {
+        check_pointers_non_null!(writer);
+        (*writer).0.end_block()?;
+        Ok(())
+    })
+}
+
+/// Finish writing the tensor map managed by this `writer`, writing the keys
+/// of all the blocks added so far to the file.
+///
+/// No blocks can be added after calling this function. The writer itself
+/// must still be released with `mts_tensormap_writer_free`.
+///
+/// @param writer writer created with `mts_tensormap_writer`
+///
+/// @returns The status code of this operation. If the status is not
+///          `MTS_SUCCESS`, you can use `mts_last_error()` to get the full
+///          error message.
+#[no_mangle]
+pub unsafe extern fn mts_tensormap_writer_finish(
+    writer: *mut mts_tensormap_writer_t,
+) -> mts_status_t {
+    profile_scope!("mts_tensormap_writer_finish");
+    catch_unwind(|| {
+        check_pointers_non_null!(writer);
+        (*writer).0.finish()?;
+        Ok(())
+    })
+}
+
+/// Free the memory associated with a `writer` previously created with
+/// `mts_tensormap_writer`.
+///
+/// If `mts_tensormap_writer_finish` was not called on this writer, the file
+/// will not contain the keys, and can not be loaded.
+///
+/// If `writer` is `NULL`, this function does nothing.
+///
+/// @param writer pointer to an existing writer, or `NULL`
+///
+/// @returns The status code of this operation. If the status is not
+///          `MTS_SUCCESS`, you can use `mts_last_error()` to get the full
+///          error message.
+#[no_mangle]
+pub unsafe extern fn mts_tensormap_writer_free(writer: *mut mts_tensormap_writer_t) -> mts_status_t {
+    catch_unwind(|| {
+        if !writer.is_null() {
+            std::mem::drop(Box::from_raw(writer));
+        }
+
+        Ok(())
+    })
+}
@@ -3,6 +3,7 @@ use std::ffi::CStr;
 use std::sync::Arc;
 
 use crate::{LabelValue, Labels, LabelsBuilder, Error};
+use crate::{mts_memory_usage_t, MemoryUsageTracker};
 use super::status::{mts_status_t, catch_unwind};
 
 /// A set of labels used to carry metadata associated with a tensor map.
@@ -91,12 +92,13 @@ pub unsafe fn mts_labels_to_rust(labels: &mts_labels_t) -> Result<Arc<Labels>, E
     }
 
     // otherwise, create new labels from the data
-    return create_rust_labels(labels);
+    return create_rust_labels(labels, false);
 }
 
 /// Create a new set of rust Labels from `mts_labels_t`, copying the data into
-/// Rust managed memory.
-unsafe fn create_rust_labels(labels: &mts_labels_t) -> Result<Arc<Labels>, Error> {
+/// Rust managed memory. If `assume_unique` is true, the entries are not checked
+/// for duplicates.
+unsafe fn create_rust_labels(labels: &mts_labels_t, assume_unique: bool) -> Result<Arc<Labels>, Error> {
     assert!(!labels.is_rust());
 
     if labels.size == 0 {
@@ -128,6 +130,15 @@ unsafe fn create_rust_labels(labels: &mts_labels_t) -> Result<Arc<Labels>, Error
         names.push(name);
     }
 
+    if assume_unique {
+        let values = if labels.count == 0 {
+            Vec::new()
+        } else {
+            std::slice::from_raw_parts(labels.values.cast::<LabelValue>(), labels.count * labels.size).to_vec()
+        };
+        return Ok(Arc::new(Labels::new_assume_unique(names, values)?));
+    }
+
     let mut builder = LabelsBuilder::new(names)?;
     builder.reserve(labels.count);
 
@@ -189,6 +200,74 @@ pub unsafe extern fn mts_labels_position(
     })
 }
 
+/// Get the positions of multiple entries in the given set of `labels`. This
+/// operation is only available if the labels correspond to a set of Rust Labels
+/// (i.e. `labels.internal_ptr_` is not NULL).
+///
+/// The entries to lookup are given in `values`, as a row-major 2D array of
+/// shape `(result_count, labels.size)`. This gives the same result as calling
+/// `mts_labels_position` for each entry, in a single call.
+///
+/// @param labels set of labels with an associated Rust data structure
+/// @param values array containing the entries to lookup
+/// @param values_count size of the values array, this should be
+///                     `result_count * labels.size`
+/// @param result array of size `result_count`, that will be filled with the
+///               position of the corresponding entry in the labels, or -1 if
+///               the entry was not found
+/// @param result_count number of entries to lookup
+///
+/// @returns The status code of this operation. If the status is not
+///          `MTS_SUCCESS`, you can use `mts_last_error()` to get the full
+///          error message.
+#[no_mangle]
+#[allow(clippy::cast_possible_wrap)]
+pub unsafe extern fn mts_labels_positions(
+    labels: mts_labels_t,
+    values: *const i32,
+    values_count: usize,
+    result: *mut i64,
+    result_count: usize,
+) -> mts_status_t {
+    profile_scope!("mts_labels_positions");
+    catch_unwind(|| {
+        if !labels.is_rust() {
+            return Err(Error::InvalidParameter(
+                "these labels do not support calling mts_labels_positions, \
+                call mts_labels_create first".into()
+            ));
+        }
+
+        let labels = &(*labels.internal_ptr_.cast::<Labels>());
+        if values_count != result_count * labels.size() {
+            return Err(Error::InvalidParameter(format!(
+                "expected {} values for {} entries of size {} in mts_labels_positions, got {}",
+                result_count * labels.size(), result_count, labels.size(), values_count
+            )));
+        }
+
+        if result_count == 0 {
+            return Ok(());
+        }
+
+        check_pointers_non_null!(result);
+        let result = std::slice::from_raw_parts_mut(result, result_count);
+
+        if labels.size() == 0 {
+            result.fill(-1);
+            return Ok(());
+        }
+
+        check_pointers_non_null!(values);
+        let values = std::slice::from_raw_parts(values.cast::<LabelValue>(), values_count);
+        for (entry, position) in values.chunks_exact(labels.size()).zip(result) {
+            *position = labels.position(entry).map_or(-1, |p| p as i64);
+        }
+
+        Ok(())
+    })
+}
+
 
 /// Finish the creation of `mts_labels_t` by associating it to Rust-owned
 /// labels.
@@ -208,6 +287,7 @@ pub unsafe extern fn mts_labels_position(
 pub unsafe extern fn mts_labels_create(
     labels: *mut mts_labels_t,
 ) -> mts_status_t {
+    profile_scope!("mts_labels_create");
     catch_unwind(|| {
         check_pointers_non_null!(labels);
 
@@ -217,7 +297,45 @@ pub unsafe extern fn mts_labels_create(
             ));
         }
 
-        let rust_labels = create_rust_labels(&*labels)?;
+        let rust_labels = create_rust_labels(&*labels, false)?;
+        *labels = rust_to_mts_labels(rust_labels);
+
+        Ok(())
+    })
+}
+
+/// Finish the creation of `mts_labels_t` by associating it to Rust-owned
+/// labels, assuming all the entries in `labels.values` are unique.
+///
+/// This is the same as `mts_labels_create`, but skips the check for duplicated
+/// entries, which is useful when creating large labels with entries known to
+/// be unique. If there are duplicated entries, `mts_labels_position` can
+/// return the position of any of them, and other functions using these labels
+/// might give wrong results.
+///
+/// This function allocates memory which must be released `mts_labels_free` when
+/// you don't need it anymore.
+///
+/// @param labels new set of labels containing pointers to user-managed memory
+///        on input, and pointers to Rust-managed memory on output.
+/// @returns The status code of this operation. If the status is not
+///          `MTS_SUCCESS`, you can use `mts_last_error()` to get the full
+///          error message.
+#[no_mangle]
+pub unsafe extern fn mts_labels_create_assume_unique(
+    labels: *mut mts_labels_t,
+) -> mts_status_t {
+    profile_scope!("mts_labels_create_assume_unique");
+    catch_unwind(|| {
+        check_pointers_non_null!(labels);
+
+        if (*labels).is_rust() {
+            return Err(Error::InvalidParameter(
+                "these labels already correspond to rust labels".into()
+            ));
+        }
+
+        let rust_labels = create_rust_labels(&*labels, true)?;
         *labels = rust_to_mts_labels(rust_labels);
 
         Ok(())
@@ -233,6 +351,9 @@ pub unsafe extern fn mts_labels_create(
 /// Any existing user data will be released (by calling the provided
 /// `user_data_delete` function) before overwriting with the new data.
 ///
+/// This function fails for labels stored inside a block (e.g. labels obtained
+/// from `mts_block_labels`), since these can be shared with other blocks.
+///
 /// @param labels set of labels where we want to add user data
 /// @param user_data pointer to the data
 /// @param user_data_delete function pointer that will be used (if not NULL)
@@ -256,7 +377,7 @@ pub unsafe extern fn mts_labels_set_user_data(
         }
 
         let rust_labels = &*labels.internal_ptr_.cast::<Labels>();
-        rust_labels.set_user_data(user_data, user_data_delete);
+        rust_labels.set_user_data(user_data, user_data_delete)?;
 
         Ok(())
     })
@@ -431,6 +552,7 @@ pub unsafe extern fn mts_labels_union(
     second_mapping: *mut i64,
     second_mapping_count: usize,
 ) -> mts_status_t {
+    profile_scope!("mts_labels_union");
     let unwind_wrapper = std::panic::AssertUnwindSafe(result);
     catch_unwind(|| {
         let (first_mapping, second_mapping) = labels_set_common(
@@ -498,6 +620,7 @@ pub unsafe extern fn mts_labels_intersection(
     second_mapping: *mut i64,
     second_mapping_count: usize,
 ) -> mts_status_t {
+    profile_scope!("mts_labels_intersection");
     let unwind_wrapper = std::panic::AssertUnwindSafe(result);
     catch_unwind(|| {
         let (first_mapping, second_mapping) = labels_set_common(
@@ -528,6 +651,42 @@ pub unsafe extern fn mts_labels_intersection(
     })
 }
 
+/// Get the memory used by `labels`, in bytes. This operation is only
+/// available if the labels correspond to a set of Rust Labels (i.e.
+/// `labels.internal_ptr_` is not NULL).
+///
+/// Only the memory managed by metatensor is counted, the user data associated
+/// with the labels (see `mts_labels_set_user_data`) is not.
+///
+/// @param labels set of labels with an associated Rust data structure
+/// @param usage pointer to be filled with the memory used by the labels
+///
+/// @returns The status code of this operation. If the status is not
+///          `MTS_SUCCESS`, you can use `mts_last_error()` to get the full
+///          error message.
+#[no_mangle]
+pub unsafe extern fn mts_labels_memory_usage(
+    labels: mts_labels_t,
+    usage: *mut mts_memory_usage_t,
+) -> mts_status_t {
+    catch_unwind(|| {
+        check_pointers_non_null!(usage);
+        if !labels.is_rust() {
+            return Err(Error::InvalidParameter(
+                "these labels do not support calling mts_labels_memory_usage, \
+                call mts_labels_create first".into()
+            ));
+        }
+
+        let labels = &(*labels.internal_ptr_.cast::<Labels>());
+        let mut tracker = MemoryUsageTracker::new();
+        tracker.add_labels(labels);
+        *usage = tracker.finish();
+
+        Ok(())
+    })
+}
+
 /// Decrease the reference count of `labels`, and release the corresponding
 /// memory once the reference count reaches 0.
 ///
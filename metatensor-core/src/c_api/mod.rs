@@ -11,6 +11,9 @@ pub use self::status::{catch_unwind, mts_status_t};
 #[cfg(test)]
 pub use self::status::MTS_SUCCESS;
 
+#[macro_use]
+mod profiling;
+
 mod labels;
 mod data;
 mod blocks;
@@ -53,3 +56,24 @@ static VERSION: Lazy<CString> = Lazy::new(|| {
 pub extern fn mts_version() -> *const c_char {
     return VERSION.as_ptr();
 }
+
+/// Set the maximal number of threads metatensor can use for operations running
+/// in parallel, such as `mts_tensormap_keys_to_properties` and
+/// `mts_tensormap_keys_to_samples`.
+///
+/// Setting `n_threads` to 0 (the default) uses all the available cores, and
+/// setting it to 1 runs everything on the calling thread. Only the Labels are
+/// computed in parallel, the functions in `mts_array_t` are always called from
+/// the thread calling metatensor.
+#[no_mangle]
+pub extern fn mts_set_max_threads(n_threads: usize) {
+    crate::utils::set_max_threads(n_threads);
+}
+
+/// Get the maximal number of threads metatensor can use for operations running
+/// in parallel, as set by `mts_set_max_threads`. A value of 0 means that all
+/// the available cores are used.
+#[no_mangle]
+pub extern fn mts_get_max_threads() -> usize {
+    return crate::utils::max_threads();
+}
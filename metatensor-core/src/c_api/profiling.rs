@@ -0,0 +1,121 @@
+use std::os::raw::c_char;
+use std::sync::RwLock;
+
+/// Function pointer called when entering and leaving some of the functions in
+/// metatensor, to integrate metatensor with external profilers.
+///
+/// `name` is the name of the function (e.g.
+/// `"mts_tensormap_keys_to_properties"`). It is a static NULL-terminated
+/// string, which stays valid until the program exits. `enter` will be `true`
+/// when entering the function, and `false` when leaving it. The calls are
+/// always properly nested, and made from the thread calling metatensor.
+#[allow(non_camel_case_types)]
+pub type mts_profiling_callback_t = unsafe extern fn(name: *const c_char, enter: bool);
+
+/// Callback registered with `mts_set_profiling_callback`
+static PROFILING_CALLBACK: RwLock<Option<mts_profiling_callback_t>> = RwLock::new(None);
+
+/// Guard calling the profiling callback (if any) when created and when
+/// dropped. This should be created through the `profile_scope!` macro.
+pub struct ProfilingScope {
+    name: &'static str,
+    callback: Option<mts_profiling_callback_t>,
+}
+
+impl ProfilingScope {
+    /// Enter a profiling scope with the given `name`, which must be a NULL
+    /// terminated string.
+    pub fn new(name: &'static str) -> ProfilingScope {
+        debug_assert!(name.ends_with('\0'));
+
+        let callback = *PROFILING_CALLBACK.read().expect("poisoned lock");
+        if let Some(callback) = callback {
+            // SAFETY: `name` is NULL-terminated, and the user provided a valid
+            // function pointer
+            unsafe {
+                callback(name.as_ptr().cast(), true);
+            }
+        }
+
+        return ProfilingScope { name, callback };
+    }
+}
+
+impl Drop for ProfilingScope {
+    fn drop(&mut self) {
+        // call the same callback as the one used when entering the scope, even
+        // if a different one was registered in the mean time
+        if let Some(callback) = self.callback {
+            // SAFETY: same as above
+            unsafe {
+                callback(self.name.as_ptr().cast(), false);
+            }
+        }
+    }
+}
+
+/// Call the profiling callback with the given name now, and when the current
+/// scope ends.
+#[macro_export]
+#[doc(hidden)]
+macro_rules! profile_scope {
+    ($name: literal) => {
+        let _profiling_scope = $crate::c_api::profiling::ProfilingScope::new(concat!($name, "\0"));
+    };
+}
+
+/// Register a `callback` that will be called when entering and leaving some of
+/// the functions in metatensor, such as `mts_tensormap_keys_to_properties` or
+/// `mts_tensormap_load`. This can be used to integrate with external
+/// profilers, and attribute time to metatensor operations.
+///
+/// Only a single callback can be registered at a given time, and calling this
+/// function again replaces the previous callback. Setting `callback` to `NULL`
+/// (the default) disables profiling.
+///
+/// @param callback function to call when entering and leaving functions, or
+///        `NULL` to disable profiling
+#[no_mangle]
+pub extern fn mts_set_profiling_callback(callback: Option<mts_profiling_callback_t>) {
+    *PROFILING_CALLBACK.write().expect("poisoned lock") = callback;
+}
+
+#[cfg(test)]
+mod tests {
+    use std::cell::RefCell;
+    use std::ffi::CStr;
+
+    use super::*;
+
+    thread_local! {
+        static EVENTS: RefCell<Vec<(String, bool)>> = RefCell::new(Vec::new());
+    }
+
+    unsafe extern fn record_event(name: *const c_char, enter: bool) {
+        let name = CStr::from_ptr(name).to_str().unwrap().to_owned();
+        EVENTS.with(|events| events.borrow_mut().push((name, enter)));
+    }
+
+    #[test]
+    fn scopes() {
+        mts_set_profiling_callback(Some(record_event));
+        {
+            profile_scope!("outer");
+            {
+                profile_scope!("inner");
+            }
+        }
+        mts_set_profiling_callback(None);
+        {
+            profile_scope!("disabled");
+        }
+
+        let events = EVENTS.with(|events| events.borrow().clone());
+        assert_eq!(events, [
+            ("outer".into(), true),
+            ("inner".into(), true),
+            ("inner".into(), false),
+            ("outer".into(), false),
+        ]);
+    }
+}
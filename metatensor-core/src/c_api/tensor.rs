@@ -3,7 +3,8 @@ use std::sync::Arc;
 use std::ffi::CStr;
 use std::collections::BTreeSet;
 
-use crate::{TensorMap, TensorBlock, Error};
+use crate::{TensorMap, Error};
+use crate::{mts_memory_usage_t, MemoryUsageTracker};
 
 use super::labels::{mts_labels_t, rust_to_mts_labels, mts_labels_to_rust};
 use super::blocks::mts_block_t;
@@ -142,6 +143,7 @@ pub unsafe extern fn mts_tensormap_free(tensor: *mut mts_tensormap_t) -> mts_sta
 pub unsafe extern fn mts_tensormap_copy(
     tensor: *const mts_tensormap_t,
 ) -> *mut mts_tensormap_t {
+    profile_scope!("mts_tensormap_copy");
     let mut result = std::ptr::null_mut();
     let unwind_wrapper = std::panic::AssertUnwindSafe(&mut result);
     let status = catch_unwind(move || {
@@ -202,6 +204,10 @@ pub unsafe extern fn mts_tensormap_keys(
 /// `mts_tensormap_free` or the set of keys is modified by calling one
 /// of the `mts_tensormap_keys_to_XXX` function.
 ///
+/// This function does not modify the tensor map, and can be called
+/// concurrently from multiple threads. Different threads can then modify
+/// different blocks at the same time.
+///
 /// @param tensor pointer to an existing tensor map
 /// @param block pointer to be filled with a block
 /// @param index index of the block to get
@@ -218,15 +224,17 @@ pub unsafe extern fn mts_tensormap_block_by_id(
     catch_unwind(|| {
         check_pointers_non_null!(tensor, block);
 
-        let blocks = (*tensor).blocks_mut();
-        match blocks.get_mut(index) {
+        // do not create a `&mut TensorMap` here, since other threads can be
+        // modifying other blocks at the same time
+        let tensor = std::ptr::addr_of_mut!((*tensor).0);
+        match TensorMap::block_ptr(tensor, index) {
             Some(b) => {
-                (*block) = (b as *mut TensorBlock).cast();
+                (*block) = b.cast();
             }
             None => {
                 return Err(Error::InvalidParameter(format!(
                     "block index out of bounds: we have {} blocks but the index is {}",
-                    blocks.len(), index
+                    (*tensor).keys().count(), index
                 )));
             }
         }
@@ -262,6 +270,7 @@ pub unsafe extern fn mts_tensormap_blocks_matching(
 	count: *mut usize,
     selection: mts_labels_t,
 ) -> mts_status_t {
+    profile_scope!("mts_tensormap_blocks_matching");
     catch_unwind(|| {
         check_pointers_non_null!(tensor, count);
 
@@ -291,6 +300,66 @@ pub unsafe extern fn mts_tensormap_blocks_matching(
 }
 
 
+/// Find which entry of `selection` each block in this `tensor` matches.
+///
+/// This is equivalent to calling `mts_tensormap_blocks_matching` once for each
+/// entry of `selection`, but much faster when there are many entries. The
+/// `selection` should have a subset of the names/dimensions of the keys for
+/// this tensor map, and can contain any number of entries. Since all the
+/// entries in `selection` are different, each block matches at most one of
+/// them.
+///
+/// @param tensor pointer to an existing tensor map
+/// @param block_selection array to be filled with the index of the entry in
+///                        `selection` matching each block, or -1 if the block
+///                        does not match any entry
+/// @param count number of entries in `block_selection`, this must be the same
+///              as the number of blocks in the tensor map
+/// @param selection labels describing the requested blocks
+///
+/// @returns The status code of this operation. If the status is not
+///          `MTS_SUCCESS`, you can use `mts_last_error()` to get the full
+///          error message.
+#[no_mangle]
+#[allow(clippy::cast_possible_wrap)]
+pub unsafe extern fn mts_tensormap_blocks_matching_many(
+    tensor: *const mts_tensormap_t,
+    block_selection: *mut i64,
+    count: usize,
+    selection: mts_labels_t,
+) -> mts_status_t {
+    profile_scope!("mts_tensormap_blocks_matching_many");
+    catch_unwind(|| {
+        check_pointers_non_null!(tensor);
+
+        if count != (*tensor).keys().count() {
+            return Err(Error::InvalidParameter(format!(
+                "expected space for {} indices as input to mts_tensormap_blocks_matching_many, got space for {}",
+                (*tensor).keys().count(), count
+            )));
+        }
+
+        let selection = mts_labels_to_rust(&selection)?;
+        let matching = (*tensor).blocks_matching_many(&selection)?;
+
+        if count == 0 {
+            return Ok(());
+        }
+
+        check_pointers_non_null!(block_selection);
+        let block_selection = std::slice::from_raw_parts_mut(block_selection, count);
+        block_selection.fill(-1);
+        for (entry_i, blocks) in matching.into_iter().enumerate() {
+            for block in blocks {
+                block_selection[block] = entry_i as i64;
+            }
+        }
+
+        Ok(())
+    })
+}
+
+
 /// Merge blocks with the same value for selected keys dimensions along the
 /// property axis.
 ///
@@ -305,12 +374,15 @@ pub unsafe extern fn mts_tensormap_blocks_matching(
 /// 3` will produce a block with properties `a, p = (0, 1), (0, 2), (2, 1),
 /// (2, 3)`.
 ///
-/// If `keys_to_move` contains entries, then the property labels must be the
-/// same for all the merged blocks. In that case, the merged property labels
-/// will contains each of the entries of `keys_to_move` and then the current
-/// property labels. For example, using `a=2, 3` in `keys_to_move`, and
-/// blocks with properties `p=1, 2` will result in `a, p = (2, 1), (2, 2),
-/// (3, 1), (3, 2)`.
+/// If `keys_to_move` contains entries, then the merged property labels will
+/// contains each of the entries of `keys_to_move` and then the current property
+/// labels. For example, using `a=2, 3` in `keys_to_move`, and blocks with
+/// properties `p=1, 2` will result in `a, p = (2, 1), (2, 2), (3, 1), (3, 2)`.
+/// If the merged blocks have different property labels, each entry of
+/// `keys_to_move` is followed by the properties of the block with this entry in
+/// its key. Entries without such block use the properties of the blocks with
+/// this entry in the other groups of merged blocks, which must then all be the
+/// same.
 ///
 /// The new sample labels will contains all of the merged blocks sample
 /// labels. The order of the samples is controlled by `sort_samples`. If
@@ -334,6 +406,7 @@ pub unsafe extern fn mts_tensormap_keys_to_properties(
     keys_to_move: mts_labels_t,
     sort_samples: bool,
 ) -> *mut mts_tensormap_t {
+    profile_scope!("mts_tensormap_keys_to_properties");
     let mut result = std::ptr::null_mut();
     let unwind_wrapper = std::panic::AssertUnwindSafe(&mut result);
 
@@ -361,6 +434,11 @@ pub unsafe extern fn mts_tensormap_keys_to_properties(
 /// Move the given dimensions from the component labels to the property labels
 /// for each block in this tensor map.
 ///
+/// `dimensions` can either contain the names of a single component, or all the
+/// names of multiple components. In the latter case, all the components are
+/// moved at once, and the new properties contain the components in the order
+/// in which they appear in `dimensions`, followed by the old properties.
+///
 /// `dimensions` must be an array of `dimensions_count` NULL-terminated strings,
 /// encoded as UTF-8.
 ///
@@ -377,6 +455,7 @@ pub unsafe extern fn mts_tensormap_components_to_properties(
     dimensions: *const *const c_char,
     dimensions_count: usize,
 ) -> *mut mts_tensormap_t {
+    profile_scope!("mts_tensormap_components_to_properties");
     let mut result = std::ptr::null_mut();
     let unwind_wrapper = std::panic::AssertUnwindSafe(&mut result);
 
@@ -442,6 +521,7 @@ pub unsafe extern fn mts_tensormap_keys_to_samples(
     keys_to_move: mts_labels_t,
     sort_samples: bool,
 ) -> *mut mts_tensormap_t {
+    profile_scope!("mts_tensormap_keys_to_samples");
     let mut result = std::ptr::null_mut();
     let unwind_wrapper = std::panic::AssertUnwindSafe(&mut result);
 
@@ -464,3 +544,97 @@ pub unsafe extern fn mts_tensormap_keys_to_samples(
 
     return result;
 }
+
+/// Join multiple tensor maps along the samples axis, merging the blocks with
+/// the same key in all the tensor maps.
+///
+/// All the tensor maps must have the same keys (potentially in a different
+/// order), and the merged blocks must have the same sample names, components
+/// and properties. The keys of the new tensor map are in the same order as the
+/// keys of the first tensor map.
+///
+/// If `new_dimension` is not `NULL`, a new dimension with this name is added
+/// to the samples, containing the index of the tensor map each sample comes
+/// from. Otherwise, the samples of the merged blocks must all be different. In
+/// both cases, the samples of the new blocks are in the same order as in the
+/// tensor maps.
+///
+/// The result is a new tensor map, which should be freed with `mts_tensormap_free`.
+///
+/// @param tensors array of pointers to the tensor maps to join
+/// @param tensors_count number of tensor maps in `tensors`
+/// @param new_dimension name of the new sample dimension, or `NULL` to join
+///                      the samples without adding a new dimension
+///
+/// @returns A pointer to the newly allocated tensor map, or a `NULL` pointer in
+///          case of error. In case of error, you can use `mts_last_error()`
+///          to get the error message.
+#[no_mangle]
+pub unsafe extern fn mts_tensormap_join_samples(
+    tensors: *const *const mts_tensormap_t,
+    tensors_count: usize,
+    new_dimension: *const c_char,
+) -> *mut mts_tensormap_t {
+    profile_scope!("mts_tensormap_join_samples");
+    let mut result = std::ptr::null_mut();
+    let unwind_wrapper = std::panic::AssertUnwindSafe(&mut result);
+
+    let status = catch_unwind(move || {
+        let mut rust_tensors = Vec::new();
+        if tensors_count != 0 {
+            check_pointers_non_null!(tensors);
+            for &tensor in std::slice::from_raw_parts(tensors, tensors_count) {
+                check_pointers_non_null!(tensor);
+                rust_tensors.push(&**tensor);
+            }
+        }
+
+        let new_dimension = if new_dimension.is_null() {
+            None
+        } else {
+            Some(CStr::from_ptr(new_dimension).to_str().expect("invalid utf8"))
+        };
+
+        let joined = TensorMap::join_samples(&rust_tensors, new_dimension)?;
+
+        // force the closure to capture the full unwind_wrapper, not just
+        // unwind_wrapper.0
+        let _ = &unwind_wrapper;
+        *unwind_wrapper.0 = mts_tensormap_t::into_boxed_raw(joined);
+        Ok(())
+    });
+
+    if !status.is_success() {
+        return std::ptr::null_mut();
+    }
+
+    return result;
+}
+
+/// Get the memory used by this `tensor` and all its blocks, in bytes.
+///
+/// Labels shared between multiple blocks or gradients (for example the
+/// properties of gradients and the corresponding values) are only counted
+/// once.
+///
+/// @param tensor pointer to an existing tensor map
+/// @param usage pointer to be filled with the memory used by the tensor map
+///
+/// @returns The status code of this operation. If the status is not
+///          `MTS_SUCCESS`, you can use `mts_last_error()` to get the full
+///          error message.
+#[no_mangle]
+pub unsafe extern fn mts_tensormap_memory_usage(
+    tensor: *const mts_tensormap_t,
+    usage: *mut mts_memory_usage_t,
+) -> mts_status_t {
+    catch_unwind(|| {
+        check_pointers_non_null!(tensor, usage);
+
+        let mut tracker = MemoryUsageTracker::new();
+        (*tensor).memory_usage(&mut tracker)?;
+        *usage = tracker.finish();
+
+        Ok(())
+    })
+}
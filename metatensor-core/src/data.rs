@@ -50,6 +50,25 @@ pub fn get_data_origin(origin: mts_data_origin_t) -> String {
     }
 }
 
+/// The data is stored as 64-bit IEEE-754 floating point values
+pub const MTS_DTYPE_F64: i32 = 1;
+/// The data is stored as 32-bit IEEE-754 floating point values
+pub const MTS_DTYPE_F32: i32 = 2;
+/// The data is stored as 16-bit IEEE-754 floating point values
+pub const MTS_DTYPE_F16: i32 = 3;
+/// The data is stored as 16-bit brain floating point values (bfloat16)
+pub const MTS_DTYPE_BF16: i32 = 4;
+
+/// Get the size in bytes of a single element with the given `dtype`
+pub(crate) fn dtype_size(dtype: i32) -> Result<usize, Error> {
+    match dtype {
+        MTS_DTYPE_F64 => Ok(8),
+        MTS_DTYPE_F32 => Ok(4),
+        MTS_DTYPE_F16 | MTS_DTYPE_BF16 => Ok(2),
+        _ => Err(Error::InvalidParameter(format!("unknown data type {}", dtype))),
+    }
+}
+
 // SAFETY: this should be checked by the user/implementor of `mts_array_t`.
 unsafe impl Sync for mts_array_t {}
 unsafe impl Send for mts_array_t {}
@@ -67,6 +86,11 @@ unsafe impl Send for mts_array_t {}
 /// **WARNING**: all function implementations **MUST** be thread-safe, and can
 /// be called from multiple threads at the same time. The `mts_array_t` itself
 /// might be moved from one thread to another.
+///
+/// This struct is passed by value, so adding fields changes the ABI. The
+/// `typed_data` and `create_typed` fields were added in metatensor-core
+/// 0.2.0, and arrays defined with older versions of this header are not
+/// compatible with this version of the library.
 #[repr(C)]
 #[allow(non_camel_case_types)]
 pub struct mts_array_t {
@@ -78,7 +102,7 @@ pub struct mts_array_t {
     /// `origin`. Users of `mts_array_t` should register a single data
     /// origin with `mts_register_data_origin`, and use it for all compatible
     /// arrays.
-    origin: Option<unsafe extern fn(
+    pub(crate) origin: Option<unsafe extern fn(
         array: *const c_void,
         origin: *mut mts_data_origin_t
     ) -> mts_status_t>,
@@ -88,7 +112,7 @@ pub struct mts_array_t {
     /// This function is allowed to fail if the data is not accessible in RAM,
     /// not stored as 64-bit floating point values, or not stored as a
     /// C-contiguous array.
-    data: Option<unsafe extern fn(
+    pub(crate) data: Option<unsafe extern fn(
         array: *mut c_void,
         data: *mut *mut f64,
     ) -> mts_status_t>,
@@ -96,7 +120,7 @@ pub struct mts_array_t {
     /// Get the shape of the array managed by this `mts_array_t` in the `*shape`
     /// pointer, and the number of dimension (size of the `*shape` array) in
     /// `*shape_count`.
-    shape: Option<unsafe extern fn(
+    pub(crate) shape: Option<unsafe extern fn(
         array: *const c_void,
         shape: *mut *const usize,
         shape_count: *mut usize,
@@ -105,14 +129,14 @@ pub struct mts_array_t {
     /// Change the shape of the array managed by this `mts_array_t` to the given
     /// `shape`. `shape_count` must contain the number of elements in the
     /// `shape` array
-    reshape: Option<unsafe extern fn(
+    pub(crate) reshape: Option<unsafe extern fn(
         array: *mut c_void,
         shape: *const usize,
         shape_count: usize,
     ) -> mts_status_t>,
 
     /// Swap the axes `axis_1` and `axis_2` in this `array`.
-    swap_axes: Option<unsafe extern fn(
+    pub(crate) swap_axes: Option<unsafe extern fn(
         array: *mut c_void,
         axis_1: usize,
         axis_2: usize,
@@ -124,7 +148,7 @@ pub struct mts_array_t {
     /// in `shape_count`.
     ///
     /// The new array should be filled with zeros.
-    create: Option<unsafe extern fn(
+    pub(crate) create: Option<unsafe extern fn(
         array: *const c_void,
         shape: *const usize,
         shape_count: usize,
@@ -135,14 +159,14 @@ pub struct mts_array_t {
     ///
     /// The new array is expected to have the same data origin and parameters
     /// (data type, data location, etc.)
-    copy: Option<unsafe extern fn(
+    pub(crate) copy: Option<unsafe extern fn(
         array: *const c_void,
         new_array: *mut mts_array_t,
     ) -> mts_status_t>,
 
     /// Remove this array and free the associated memory. This function can be
     /// set to `NULL` is there is no memory management to do.
-    destroy: Option<unsafe extern fn(array: *mut c_void)>,
+    pub(crate) destroy: Option<unsafe extern fn(array: *mut c_void)>,
 
     /// Set entries in the `output` array (the current array) taking data from
     /// the `input` array. The `output` array is guaranteed to be created by
@@ -155,7 +179,7 @@ pub struct mts_array_t {
     /// This function should copy data from `input[samples[i].input, ..., :]` to
     /// `array[samples[i].output, ..., property_start:property_end]` for `i` up
     /// to `samples_count`. All indexes are 0-based.
-    move_samples_from: Option<unsafe extern fn(
+    pub(crate) move_samples_from: Option<unsafe extern fn(
         output: *mut c_void,
         input: *const c_void,
         samples: *const mts_sample_mapping_t,
@@ -163,6 +187,37 @@ pub struct mts_array_t {
         property_start: usize,
         property_end: usize,
     ) -> mts_status_t>,
+
+    /// Get a pointer to the underlying data storage in `data`, and the type
+    /// of the data (one of the `MTS_DTYPE_XXX` constants) in `dtype`.
+    ///
+    /// Contrary to `data`, this function is not limited to 64-bit floating
+    /// point values. It is allowed to fail if the data is not accessible in
+    /// RAM, or not stored as a C-contiguous array. This function can be set
+    /// to `NULL`, in which case the data is accessed through `data`.
+    pub(crate) typed_data: Option<unsafe extern fn(
+        array: *mut c_void,
+        data: *mut *mut c_void,
+        dtype: *mut i32,
+    ) -> mts_status_t>,
+
+    /// Create a new array with the same options as the current one (data
+    /// location, etc.), the requested `shape` and the requested `dtype` (one
+    /// of the `MTS_DTYPE_XXX` constants); and store it in `new_array`. The
+    /// number of elements in the `shape` array should be given in
+    /// `shape_count`.
+    ///
+    /// The new array should be filled with zeros. If the array does not
+    /// support the requested `dtype`, this function should leave `new_array`
+    /// untouched and return a successful status. This function can be set to
+    /// `NULL` if only 64-bit floating point values are supported.
+    pub(crate) create_typed: Option<unsafe extern fn(
+        array: *const c_void,
+        shape: *const usize,
+        shape_count: usize,
+        dtype: i32,
+        new_array: *mut mts_array_t,
+    ) -> mts_status_t>,
 }
 
 /// Representation of a single sample moved from an array to another one
@@ -218,6 +273,8 @@ impl mts_array_t {
             // do not copy destroy, the user should never call it
             destroy: None,
             move_samples_from: self.move_samples_from,
+            typed_data: self.typed_data,
+            create_typed: self.create_typed,
         }
     }
 
@@ -234,6 +291,8 @@ impl mts_array_t {
             copy: None,
             destroy: None,
             move_samples_from: None,
+            typed_data: None,
+            create_typed: None,
         }
     }
 
@@ -331,6 +390,86 @@ impl mts_array_t {
         return Ok(data);
     }
 
+    /// Get the underlying data for this array as raw bytes, together with
+    /// the type of the data (one of the `MTS_DTYPE_XXX` constants). This
+    /// returns `None` if the array does not implement `typed_data`.
+    pub fn typed_data(&self) -> Result<Option<(&[u8], i32)>, Error> {
+        let (data_ptr, len, dtype) = match self.typed_data_ptr()? {
+            Some(data) => data,
+            None => return Ok(None),
+        };
+
+        if len == 0 {
+            let data: &[u8] = &[];
+            return Ok(Some((data, dtype)));
+        }
+
+        let data = unsafe {
+            std::slice::from_raw_parts(data_ptr.cast::<u8>(), len)
+        };
+
+        return Ok(Some((data, dtype)));
+    }
+
+    /// Get the underlying data for this array as mutable raw bytes, together
+    /// with the type of the data (one of the `MTS_DTYPE_XXX` constants). This
+    /// returns `None` if the array does not implement `typed_data`.
+    pub fn typed_data_mut(&mut self) -> Result<Option<(&mut [u8], i32)>, Error> {
+        let (data_ptr, len, dtype) = match self.typed_data_ptr()? {
+            Some(data) => data,
+            None => return Ok(None),
+        };
+
+        if len == 0 {
+            let data: &mut [u8] = &mut [];
+            return Ok(Some((data, dtype)));
+        }
+
+        let data = unsafe {
+            std::slice::from_raw_parts_mut(data_ptr.cast::<u8>(), len)
+        };
+
+        return Ok(Some((data, dtype)));
+    }
+
+    /// Call `typed_data`, and get the data pointer, the size of the data in
+    /// bytes and the data type.
+    fn typed_data_ptr(&self) -> Result<Option<(*mut c_void, usize, i32)>, Error> {
+        let function = match self.typed_data {
+            Some(function) => function,
+            None => return Ok(None),
+        };
+
+        let shape = self.shape()?;
+        let mut len = 1;
+        for s in shape {
+            len *= s;
+        }
+
+        let mut data_ptr = std::ptr::null_mut();
+        let mut dtype = 0;
+        let status = unsafe {
+            function(
+                self.ptr,
+                &mut data_ptr,
+                &mut dtype,
+            )
+        };
+
+        if !status.is_success() {
+            return Err(Error::External {
+                status, context: "calling mts_array_t.typed_data failed".into()
+            });
+        }
+
+        let len = len * dtype_size(dtype)?;
+        if len != 0 {
+            assert!(!data_ptr.is_null());
+        }
+
+        return Ok(Some((data_ptr, len, dtype)));
+    }
+
     /// Get the shape of this array
     #[allow(clippy::cast_possible_truncation)]
     pub fn shape(&self) -> Result<&[usize], Error> {
@@ -427,6 +566,39 @@ impl mts_array_t {
         return Ok(data_storage);
     }
 
+    /// Create a new array with the same settings as this one, the given
+    /// `shape` and the given `dtype`. This returns `None` if the array does
+    /// not support creating arrays with this `dtype`.
+    pub fn create_typed(&self, shape: &[usize], dtype: i32) -> Result<Option<mts_array_t>, Error> {
+        let function = match self.create_typed {
+            Some(function) => function,
+            None => return Ok(None),
+        };
+
+        let mut data_storage = mts_array_t::null();
+        let status = unsafe {
+            function(
+                self.ptr,
+                shape.as_ptr(),
+                shape.len(),
+                dtype,
+                &mut data_storage
+            )
+        };
+
+        if !status.is_success() {
+            return Err(Error::External {
+                status, context: "calling mts_array_t.create_typed failed".into()
+            });
+        }
+
+        if data_storage.ptr.is_null() {
+            return Ok(None);
+        }
+
+        return Ok(Some(data_storage));
+    }
+
     /// Try to copy this `mts_array_t`. This can fail if the external data can
     /// not be copied for some reason
     pub fn try_clone(&self) -> Result<mts_array_t, Error> {
@@ -515,6 +687,8 @@ mod tests {
                 copy: None,
                 destroy: Some(TestArray::destroy),
                 move_samples_from: None,
+                typed_data: None,
+                create_typed: None,
             }
         }
 
@@ -0,0 +1,184 @@
+use byteorder::{LittleEndian, BigEndian, ReadBytesExt};
+
+use crate::Error;
+use crate::data::{MTS_DTYPE_F64, MTS_DTYPE_F32, MTS_DTYPE_F16, MTS_DTYPE_BF16};
+
+/// Get the NPY type descriptor used to store data with the given `dtype`
+/// (one of the `MTS_DTYPE_XXX` constants), using the native endianness.
+///
+/// bfloat16 does not exist in the NPY format, so this data is stored as
+/// 32-bit floating point values instead.
+pub(super) fn npy_descriptor(dtype: i32) -> Result<&'static str, Error> {
+    let little_endian = cfg!(target_endian = "little");
+    let descriptor = match dtype {
+        MTS_DTYPE_F64 => if little_endian { "<f8" } else { ">f8" },
+        MTS_DTYPE_F32 | MTS_DTYPE_BF16 => if little_endian { "<f4" } else { ">f4" },
+        MTS_DTYPE_F16 => if little_endian { "<f2" } else { ">f2" },
+        _ => {
+            return Err(Error::InvalidParameter(format!(
+                "unknown data type {} in array", dtype
+            )));
+        }
+    };
+
+    return Ok(descriptor);
+}
+
+/// Get the `dtype` (one of the `MTS_DTYPE_XXX` constants) and endianness
+/// (`true` for little endian) corresponding to the given NPY type descriptor.
+pub(super) fn parse_npy_descriptor(descriptor: &str) -> Option<(i32, bool)> {
+    match descriptor {
+        "<f8" => Some((MTS_DTYPE_F64, true)),
+        ">f8" => Some((MTS_DTYPE_F64, false)),
+        "<f4" => Some((MTS_DTYPE_F32, true)),
+        ">f4" => Some((MTS_DTYPE_F32, false)),
+        "<f2" => Some((MTS_DTYPE_F16, true)),
+        ">f2" => Some((MTS_DTYPE_F16, false)),
+        _ => None,
+    }
+}
+
+/// Read data of the given `dtype` and endianness from the `reader` into
+/// `output`, converting it to 64-bit floating point values.
+pub(super) fn read_as_f64<R: std::io::Read>(
+    reader: &mut R,
+    dtype: i32,
+    little_endian: bool,
+    output: &mut [f64],
+) -> Result<(), Error> {
+    match dtype {
+        MTS_DTYPE_F64 => {
+            if little_endian {
+                reader.read_f64_into::<LittleEndian>(output)?;
+            } else {
+                reader.read_f64_into::<BigEndian>(output)?;
+            }
+        }
+        MTS_DTYPE_F32 => {
+            let mut data = vec![0.0; output.len()];
+            if little_endian {
+                reader.read_f32_into::<LittleEndian>(&mut data)?;
+            } else {
+                reader.read_f32_into::<BigEndian>(&mut data)?;
+            }
+
+            for (output, value) in output.iter_mut().zip(data) {
+                *output = f64::from(value);
+            }
+        }
+        MTS_DTYPE_F16 => {
+            let mut data = vec![0; output.len()];
+            if little_endian {
+                reader.read_u16_into::<LittleEndian>(&mut data)?;
+            } else {
+                reader.read_u16_into::<BigEndian>(&mut data)?;
+            }
+
+            for (output, value) in output.iter_mut().zip(data) {
+                *output = f64::from(f16_to_f32(value));
+            }
+        }
+        _ => unreachable!("unexpected data type {}", dtype),
+    }
+
+    return Ok(());
+}
+
+/// Read raw bytes with the given `dtype` and endianness from the `reader`
+/// into `output`, converting them to the native endianness.
+pub(super) fn read_native<R: std::io::Read>(
+    reader: &mut R,
+    dtype: i32,
+    little_endian: bool,
+    output: &mut [u8],
+) -> Result<(), Error> {
+    reader.read_exact(output)?;
+
+    if little_endian != cfg!(target_endian = "little") {
+        let size = crate::data::dtype_size(dtype)?;
+        for value in output.chunks_exact_mut(size) {
+            value.reverse();
+        }
+    }
+
+    return Ok(());
+}
+
+/// Convert native-endian bfloat16 data to native-endian 32-bit floating point
+/// data.
+pub(super) fn bf16_to_f32_bytes(data: &[u8]) -> Vec<u8> {
+    let mut output = Vec::with_capacity(2 * data.len());
+    for value in data.chunks_exact(2) {
+        let bits = u16::from_ne_bytes([value[0], value[1]]);
+        output.extend_from_slice(&bf16_to_f32(bits).to_ne_bytes());
+    }
+    return output;
+}
+
+/// Convert the bits of a bfloat16 value to a 32-bit floating point value.
+/// bfloat16 is the upper half of a 32-bit float, so this is always exact.
+fn bf16_to_f32(bits: u16) -> f32 {
+    f32::from_bits(u32::from(bits) << 16)
+}
+
+/// Convert the bits of an IEEE-754 half precision value to a 32-bit floating
+/// point value. All half precision values can be represented exactly as
+/// 32-bit floats.
+fn f16_to_f32(bits: u16) -> f32 {
+    let sign = u32::from(bits & 0x8000) << 16;
+    let exponent = u32::from((bits >> 10) & 0x1f);
+    let mantissa = u32::from(bits & 0x03ff);
+
+    let bits = if exponent == 0 {
+        if mantissa == 0 {
+            // signed zero
+            sign
+        } else {
+            // sub-normal values are `mantissa * 2^-24`, and are normal
+            // values when represented as 32-bit floats
+            #[allow(clippy::cast_precision_loss)]
+            let magnitude = mantissa as f32 / 16777216.0;
+            sign | magnitude.to_bits()
+        }
+    } else if exponent == 0x1f {
+        // infinity and NaN
+        sign | 0x7f80_0000 | (mantissa << 13)
+    } else {
+        sign | ((exponent + 127 - 15) << 23) | (mantissa << 13)
+    };
+
+    return f32::from_bits(bits);
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn half_precision() {
+        assert_eq!(f16_to_f32(0x0000), 0.0);
+        assert!(f16_to_f32(0x8000).is_sign_negative());
+        assert_eq!(f16_to_f32(0x3c00), 1.0);
+        assert_eq!(f16_to_f32(0xc000), -2.0);
+        assert_eq!(f16_to_f32(0x3555), 0.333_251_95);
+        assert_eq!(f16_to_f32(0x7bff), 65504.0);
+        // smallest sub-normal value
+        assert_eq!(f16_to_f32(0x0001), 5.960_464_5e-8);
+        assert_eq!(f16_to_f32(0x7c00), f32::INFINITY);
+        assert_eq!(f16_to_f32(0xfc00), f32::NEG_INFINITY);
+        assert!(f16_to_f32(0x7e00).is_nan());
+    }
+
+    #[test]
+    fn bfloat16() {
+        assert_eq!(bf16_to_f32(0x3f80), 1.0);
+        assert_eq!(bf16_to_f32(0xc040), -3.0);
+        assert_eq!(bf16_to_f32(0x7f80), f32::INFINITY);
+
+        let data = [0x3f80_u16.to_ne_bytes(), 0x4000_u16.to_ne_bytes()].concat();
+        let converted = bf16_to_f32_bytes(&data);
+        assert_eq!(converted.len(), 8);
+        assert_eq!(f32::from_ne_bytes([converted[0], converted[1], converted[2], converted[3]]), 1.0);
+        assert_eq!(f32::from_ne_bytes([converted[4], converted[5], converted[6], converted[7]]), 2.0);
+    }
+}
@@ -1,10 +1,10 @@
 use std::io::BufReader;
 
-use byteorder::{LittleEndian, ReadBytesExt, BigEndian, WriteBytesExt, NativeEndian};
+use byteorder::{LittleEndian, ReadBytesExt, BigEndian};
 
 use super::npy_header::{Header, DataType};
 use super::{check_for_extra_bytes, PathOrBuffer};
-use crate::{Error, Labels, LabelsBuilder, LabelValue};
+use crate::{Error, Labels, LabelsBuilder};
 
 
 /// Check if the file/buffer in `data` looks like it could contain serialized
@@ -61,8 +61,9 @@ pub fn load_labels<R: std::io::Read>(mut reader: R) -> Result<Labels, Error> {
     check_for_extra_bytes(&mut reader)?;
 
     let mut builder = LabelsBuilder::new(names.iter().map(|s| &**s).collect())?;
+    builder.reserve(header.shape[0]);
     for chunk in data.chunks_exact(names.len()) {
-        builder.add(&chunk.iter().map(|&i| LabelValue::new(i)).collect::<Vec<_>>())?;
+        builder.add(chunk)?;
     }
 
     return Ok(builder.finish());
@@ -90,11 +91,13 @@ pub fn save_labels<W: std::io::Write>(writer: &mut W, labels: &Labels) -> Result
     };
     header.write(&mut *writer)?;
 
-    for entry in labels {
-        for value in entry {
-            writer.write_i32::<NativeEndian>(value.i32())?;
-        }
-    }
+    // the values are stored with the native endianness, so we can write the
+    // corresponding bytes directly
+    let values = labels.raw_values();
+    let bytes = unsafe {
+        std::slice::from_raw_parts(values.as_ptr().cast::<u8>(), std::mem::size_of_val(values))
+    };
+    writer.write_all(bytes)?;
 
     return Ok(());
 }
@@ -1,15 +1,23 @@
-use std::collections::HashSet;
-use std::io::BufReader;
+use std::cell::RefCell;
+use std::collections::HashMap;
+use std::io::{BufReader, Cursor, Read};
 use std::sync::Arc;
 
-use byteorder::{LittleEndian, BigEndian, ReadBytesExt};
-use zip::ZipArchive;
+use once_cell::unsync::OnceCell;
 
-use crate::{TensorMap, TensorBlock, Labels, Error, mts_array_t};
+use zip::{ZipArchive, CompressionMethod};
+use zip::read::ZipFile;
+
+use crate::{TensorMap, TensorBlock, Labels, LabelsBuilder, Error, mts_array_t};
+use crate::tensor::keys_matching;
+use crate::labels::intern_labels;
+use crate::utils::{parallel_map, thread_count};
+use crate::data::MTS_DTYPE_F64;
 
 use super::{check_for_extra_bytes, PathOrBuffer};
 use super::labels::load_labels;
 use super::npy_header::{Header, DataType};
+use super::dtype::{parse_npy_descriptor, read_as_f64, read_native};
 
 
 /// Check if the file/buffer in `data` looks like it could contain a serialized
@@ -63,7 +71,8 @@ pub fn looks_like_tensormap_data(mut data: PathOrBuffer) -> bool {
 /// We add other restriction on top of these formats when saving/loading data.
 /// First, `Labels` instances are saved as structured array, see the `labels`
 /// module for more information. Only 32-bit integers are supported for Labels,
-/// and only 64-bit floats are supported for data (values and gradients).
+/// and only 64-bit, 32-bit and 16-bit floats are supported for data (values and
+/// gradients). bfloat16 data is stored as 32-bit floats.
 ///
 /// Second, the path of the files in the archive also carry meaning. The keys of
 /// the `TensorMap` are stored in `/keys.npy`, and then different blocks are
@@ -88,8 +97,145 @@ pub fn load<R, F>(reader: R, create_array: F) -> Result<TensorMap, Error>
     where R: std::io::Read + std::io::Seek,
           F: Fn(Vec<usize>) -> Result<mts_array_t, Error>
 {
-    let mut archive = ZipArchive::new(reader).map_err(|e| ("<root>".into(), e))?;
+    let archive = ZipArchive::new(reader).map_err(|e| ("<root>".into(), e))?;
+    let create_array = ArrayCreator::new(create_array);
+    return load_with_reader(archive, None, 1, &|file| read_data(file, &create_array));
+}
+
+/// Load the serialized tensor map from the given reader, decoding the blocks
+/// in parallel using up to `n_threads` threads. Setting `n_threads` to 0 uses
+/// all the available cores.
+///
+/// Compressed values and gradients entries are decompressed in parallel, each
+/// entry being read from a separate clone of the archive (which is why the
+/// reader must be `Clone`, a `Cursor<&[u8]>` is the typical choice here).
+/// Entries are decompressed in windows of `n_threads` entries, in the order
+/// in which they are needed to create the arrays, and the decompressed data is
+/// released as soon as the corresponding array is created. The Labels of all
+/// blocks are also parsed in parallel, while `create_array` is always called
+/// from the thread calling this function, so it does not need to be
+/// thread-safe. The format is documented in the [`load`] function.
+pub fn load_parallel<R, F>(reader: R, n_threads: usize, create_array: F) -> Result<TensorMap, Error>
+    where R: std::io::Read + std::io::Seek + Clone + Sync,
+          F: Fn(Vec<usize>) -> Result<mts_array_t, Error>
+{
+    let archive = ZipArchive::new(reader).map_err(|e| ("<root>".into(), e))?;
 
+    // compressed values and gradients entries, in the order they are stored
+    // in the archive. For files written by metatensor, this is also the
+    // order in which `load_with_reader` reads them.
+    let mut compressed = Vec::new();
+    let mut index_archive = archive.clone();
+    for i in 0..index_archive.len() {
+        let file = index_archive.by_index_raw(i).map_err(|e| ("<root>".into(), e))?;
+        if file.name().ends_with("/values.npy") && file.compression() != CompressionMethod::Stored {
+            compressed.push(file.name().to_owned());
+        }
+    }
+    std::mem::drop(index_archive);
+
+    let decompressor = Decompressor {
+        positions: compressed.iter().enumerate().map(|(i, path)| (path.clone(), i)).collect(),
+        paths: compressed,
+        next: 0,
+        entries: HashMap::new(),
+    };
+    let decompressor = RefCell::new(decompressor);
+    let create_array = ArrayCreator::new(create_array);
+
+    return load_with_reader(archive.clone(), None, n_threads, &|file: ZipFile<'_>| {
+        let data = decompressor.borrow_mut().take(file.name(), &archive, n_threads)?;
+        match data {
+            Some(data) => read_data(Cursor::new(data), &create_array),
+            None => read_data(file, &create_array),
+        }
+    });
+}
+
+/// Decompress the compressed entries of an archive in parallel, a window of
+/// entries at a time, for `load_parallel`.
+struct Decompressor {
+    /// paths of all compressed entries, in the order they should be
+    /// decompressed
+    paths: Vec<String>,
+    /// position of each path in `paths`
+    positions: HashMap<String, usize>,
+    /// index in `paths` of the first entry that was not yet decompressed
+    next: usize,
+    /// entries which were decompressed, but not yet used
+    entries: HashMap<String, Vec<u8>>,
+}
+
+impl Decompressor {
+    /// Get the decompressed data for the entry at `path`, or `None` if this
+    /// entry is not compressed. This decompresses the next windows of entries
+    /// (using up to `n_threads` threads) until `path` is found.
+    fn take<R>(&mut self, path: &str, archive: &ZipArchive<R>, n_threads: usize) -> Result<Option<Vec<u8>>, Error>
+        where R: std::io::Read + std::io::Seek + Clone + Sync
+    {
+        let position = match self.positions.get(path) {
+            Some(&position) => position,
+            None => return Ok(None),
+        };
+
+        let window_size = thread_count(n_threads);
+        while self.next <= position {
+            let end = usize::min(self.next + window_size, self.paths.len());
+            let window = &self.paths[self.next..end];
+            let decompressed = parallel_map(window, n_threads, |path| -> Result<Vec<u8>, Error> {
+                let mut archive = archive.clone();
+                let mut file = archive.by_name(path).map_err(|e| (path.clone(), e))?;
+
+                #[allow(clippy::cast_possible_truncation)]
+                let mut data = Vec::with_capacity(file.size() as usize);
+                file.read_to_end(&mut data)?;
+                return Ok(data);
+            });
+
+            for (path, data) in window.iter().zip(decompressed) {
+                self.entries.insert(path.clone(), data?);
+            }
+            self.next = end;
+        }
+
+        return Ok(self.entries.remove(path));
+    }
+}
+
+/// Load only the blocks matching `selection` from the serialized tensor map in
+/// the given reader.
+///
+/// The selection follows the same rules as `TensorMap::blocks_matching`: it
+/// should contain a single entry, using a subset of the keys dimensions. Only
+/// the matching blocks (and their gradients) are read from the file, the other
+/// blocks are skipped entirely. The keys of the returned `TensorMap` only
+/// contain the matching entries, in the same order as in the file.
+pub fn load_selection<R, F>(reader: R, selection: &Labels, create_array: F) -> Result<TensorMap, Error>
+    where R: std::io::Read + std::io::Seek,
+          F: Fn(Vec<usize>) -> Result<mts_array_t, Error>
+{
+    let archive = ZipArchive::new(reader).map_err(|e| ("<root>".into(), e))?;
+    let create_array = ArrayCreator::new(create_array);
+    return load_with_reader(archive, Some(selection), 1, &|file| read_data(file, &create_array));
+}
+
+/// Load a `TensorMap` from the given `archive`, using `read_data` to create
+/// the arrays for values and gradients from the corresponding entry in the
+/// archive. If `selection` is given, only the blocks matching it are loaded.
+///
+/// Loading happens in three steps: first the raw bytes for all Labels are
+/// extracted from the archive, then these Labels are parsed using up to
+/// `n_threads` threads, and finally the blocks are assembled on the current
+/// thread, calling `read_data` for all values and gradients.
+pub(super) fn load_with_reader<R, D>(
+    mut archive: ZipArchive<R>,
+    selection: Option<&Labels>,
+    n_threads: usize,
+    read_data: &D,
+) -> Result<TensorMap, Error>
+    where R: std::io::Read + std::io::Seek,
+          D: Fn(ZipFile<'_>) -> Result<(mts_array_t, Vec<usize>), Error>
+{
     let path = String::from("keys.npy");
     let keys = load_labels(archive.by_name(&path).map_err(|e| (path, e))?)?;
 
@@ -102,80 +248,249 @@ pub fn load<R, F>(reader: R, create_array: F) -> Result<TensorMap, Error>
         ));
     }
 
+    let (keys, selected) = if let Some(selection) = selection {
+        let selected = keys_matching(&keys, selection)?;
+
+        let mut builder = LabelsBuilder::new(keys.names())?;
+        builder.reserve(selected.len());
+        for &block_i in &selected {
+            builder.add(&keys[block_i])?;
+        }
+
+        (builder.finish(), selected)
+    } else {
+        let count = keys.count();
+        (keys, (0..count).collect())
+    };
+
+    let index = ArchiveIndex::new(archive.file_names());
+
+    let mut raw_blocks = Vec::new();
+    for block_i in selected {
+        raw_blocks.push(read_raw_block(&mut archive, &index, format!("blocks/{}", block_i), true)?);
+    }
+
+    let mut raw_labels = Vec::new();
+    for raw_block in &raw_blocks {
+        raw_block.collect_labels(&mut raw_labels);
+    }
+
+    let labels = parallel_map(&raw_labels, n_threads, |data| load_labels(Cursor::new(*data)));
+    let mut labels = labels.into_iter();
+
     let mut blocks = Vec::new();
-    for block_i in 0..keys.count() {
-        blocks.push(read_block(
-            &mut archive,
-            &format!("blocks/{}", block_i),
-            None,
-            &create_array,
-        )?,);
+    for raw_block in &raw_blocks {
+        blocks.push(build_block(&mut archive, raw_block, &mut labels, None, read_data)?);
     }
 
     return TensorMap::new(Arc::new(keys), blocks);
 }
 
+/// Index of the content of an archive, built once from the list of files in
+/// the archive (i.e. the ZIP central directory). This avoids going over all
+/// the files in the archive for every single block.
+struct ArchiveIndex {
+    /// Gradients parameters for each block, using the path of the block
+    /// (`blocks/<i>` or `blocks/<i>/gradients/<parameter>`) as key, in the
+    /// same order as in the archive
+    gradients: HashMap<String, Vec<String>>,
+}
+
+impl ArchiveIndex {
+    fn new<'a>(file_names: impl Iterator<Item=&'a str>) -> ArchiveIndex {
+        let mut gradients = HashMap::<String, Vec<String>>::new();
+        for name in file_names {
+            if let Some((prefix, parameter)) = ArchiveIndex::gradient_parameter(name) {
+                let parameters = gradients.entry(prefix.into()).or_default();
+                if !parameters.iter().any(|p| p == parameter) {
+                    parameters.push(parameter.into());
+                }
+            }
+        }
+
+        return ArchiveIndex { gradients };
+    }
+
+    /// Extract the block prefix and gradient parameter from a path looking
+    /// like `<prefix>/gradients/<parameter>/samples.npy`
+    fn gradient_parameter(name: &str) -> Option<(&str, &str)> {
+        let gradient = name.strip_suffix("/samples.npy")?;
+        let (parent, parameter) = gradient.rsplit_once('/')?;
+        let prefix = parent.strip_suffix("/gradients")?;
+        return Some((prefix, parameter));
+    }
+
+    /// Get the list of gradient parameters for the block at `prefix`
+    fn gradients(&self, prefix: &str) -> &[String] {
+        self.gradients.get(prefix).map_or(&[], Vec::as_slice)
+    }
+}
+
+/// Serialized data for a single block or gradient, containing the raw bytes
+/// for all the Labels in this block.
+struct RawBlock {
+    /// path of this block inside the archive
+    prefix: String,
+    samples: Vec<u8>,
+    components: Vec<Vec<u8>>,
+    /// gradients share the properties with the values, so they don't store
+    /// them in the archive
+    properties: Option<Vec<u8>>,
+    gradients: Vec<(String, RawBlock)>,
+}
+
+impl RawBlock {
+    /// Add references to all the serialized Labels in this block (and its
+    /// gradients) to `output`, in the order used by `build_block`.
+    fn collect_labels<'a>(&'a self, output: &mut Vec<&'a [u8]>) {
+        output.push(&self.samples);
+        for component in &self.components {
+            output.push(component);
+        }
+        if let Some(ref properties) = self.properties {
+            output.push(properties);
+        }
+
+        for (_, gradient) in &self.gradients {
+            gradient.collect_labels(output);
+        }
+    }
+}
+
+/// Read the raw bytes (without parsing them) of a single entry in the archive
+fn read_entry<R: std::io::Read + std::io::Seek>(archive: &mut ZipArchive<R>, path: String) -> Result<Vec<u8>, Error> {
+    let mut file = archive.by_name(&path).map_err(|e| (path, e))?;
+
+    #[allow(clippy::cast_possible_truncation)]
+    let mut data = Vec::with_capacity(file.size() as usize);
+    file.read_to_end(&mut data)?;
+
+    return Ok(data);
+}
+
+fn read_raw_block<R: std::io::Read + std::io::Seek>(
+    archive: &mut ZipArchive<R>,
+    index: &ArchiveIndex,
+    prefix: String,
+    properties: bool,
+) -> Result<RawBlock, Error> {
+    // only read the NPY header for the values, to get the number of components
+    let path = format!("{}/values.npy", prefix);
+    let mut values_file = archive.by_name(&path).map_err(|e| (path, e))?;
+    let values_header = Header::from_reader(&mut values_file)?;
+    drop(values_file);
+
+    if values_header.shape.len() < 2 {
+        return Err(Error::Serialization(format!(
+            "values array at '{}/values.npy' should have at least two dimensions, got {}",
+            prefix, values_header.shape.len()
+        )));
+    }
+
+    let samples = read_entry(archive, format!("{}/samples.npy", prefix))?;
+
+    let mut components = Vec::new();
+    for i in 0..(values_header.shape.len() - 2) {
+        components.push(read_entry(archive, format!("{}/components/{}.npy", prefix, i))?);
+    }
+
+    let properties = if properties {
+        Some(read_entry(archive, format!("{}/properties.npy", prefix))?)
+    } else {
+        None
+    };
+
+    let mut gradients = Vec::new();
+    for parameter in index.gradients(&prefix) {
+        let gradient = read_raw_block(archive, index, format!("{}/gradients/{}", prefix, parameter), false)?;
+        gradients.push((parameter.clone(), gradient));
+    }
+
+    return Ok(RawBlock { prefix, samples, components, properties, gradients });
+}
+
 #[allow(clippy::needless_pass_by_value)]
-fn read_block<R, F>(
+fn build_block<R, D, L>(
     archive: &mut ZipArchive<R>,
-    prefix: &str,
+    raw: &RawBlock,
+    labels: &mut L,
     properties: Option<Arc<Labels>>,
-    create_array: &F,
+    read_data: &D,
 ) -> Result<TensorBlock, Error>
     where R: std::io::Read + std::io::Seek,
-          F: Fn(Vec<usize>) -> Result<mts_array_t, Error>
+          D: Fn(ZipFile<'_>) -> Result<(mts_array_t, Vec<usize>), Error>,
+          L: Iterator<Item=Result<Labels, Error>>,
 {
-    let path = format!("{}/values.npy", prefix);
+    let mut next_labels = || {
+        labels.next().expect("missing labels when building block").map(|labels| intern_labels(Arc::new(labels)))
+    };
+
+    let path = format!("{}/values.npy", raw.prefix);
     let data_file = archive.by_name(&path).map_err(|e| (path, e))?;
-    let (data, shape) = read_data(data_file, &create_array)?;
+    let (data, _) = read_data(data_file)?;
 
-    let path = format!("{}/samples.npy", prefix);
-    let samples_file = archive.by_name(&path).map_err(|e| (path, e))?;
-    let samples = Arc::new(load_labels(samples_file)?);
+    let samples = next_labels()?;
 
     let mut components = Vec::new();
-    for i in 0..(shape.len() - 2) {
-        let path = format!("{}/components/{}.npy", prefix, i);
-        let component_file = archive.by_name(&path).map_err(|e| (path, e))?;
-        components.push(Arc::new(load_labels(component_file)?));
+    for _ in &raw.components {
+        components.push(next_labels()?);
     }
 
     let properties = if let Some(ref properties) = properties {
         properties.clone()
     } else {
-        let path = format!("{}/properties.npy", prefix);
-        let properties_file = archive.by_name(&path).map_err(|e| (path, e))?;
-        Arc::new(load_labels(properties_file)?)
+        next_labels()?
     };
 
     let mut block = TensorBlock::new(data, samples, components, properties.clone())?;
 
-    let mut parameters = HashSet::new();
-    let gradient_prefix = format!("{}/gradients/", prefix);
-    for name in archive.file_names() {
-        if name.starts_with(&gradient_prefix) && name.ends_with("/samples.npy") {
-            let (_, parameter) = name.split_at(gradient_prefix.len());
-            let parameter = parameter.split('/').next().expect("could not find gradient parameter");
-            parameters.insert(parameter.to_string());
-        }
+    for (parameter, raw_gradient) in &raw.gradients {
+        let gradient = build_block(archive, raw_gradient, labels, Some(properties.clone()), read_data)?;
+        block.add_gradient(parameter, gradient)?;
     }
 
-    for parameter in &parameters {
-        let gradient = read_block(
-            archive,
-            &format!("{}/gradients/{}", prefix, parameter),
-            Some(properties.clone()),
-            create_array
-        )?;
+    return Ok(block);
+}
 
-        block.add_gradient(parameter, gradient)?;
+/// Create the arrays for values and gradients when loading a file, using the
+/// `create_array` callback given by the user.
+struct ArrayCreator<F> {
+    create_array: F,
+    /// Empty array created with `create_array`, used to create arrays with
+    /// another type than 64-bit floating point through `create_typed`. This is
+    /// only created once per file, when the first such entry is loaded.
+    prototype: OnceCell<mts_array_t>,
+}
+
+impl<F> ArrayCreator<F> where F: Fn(Vec<usize>) -> Result<mts_array_t, Error> {
+    fn new(create_array: F) -> ArrayCreator<F> {
+        ArrayCreator { create_array, prototype: OnceCell::new() }
     }
 
-    return Ok(block);
+    /// Create an array with the given `shape`, using the given `dtype` if
+    /// the arrays created by `create_array` support it, and 64-bit floating
+    /// point otherwise.
+    fn create(&self, shape: Vec<usize>, dtype: i32) -> Result<mts_array_t, Error> {
+        if dtype != MTS_DTYPE_F64 {
+            // we go through an empty array to avoid allocating a full-size
+            // array in 64-bit floating points, only to throw it away
+            let prototype = self.prototype.get_or_try_init(|| (self.create_array)(vec![0]))?;
+            if let Some(typed) = prototype.create_typed(&shape, dtype)? {
+                return Ok(typed);
+            }
+        }
+
+        return (self.create_array)(shape);
+    }
 }
 
-// Read a data array from the given reader, using numpy's NPY format
-fn read_data<R, F>(mut reader: R, create_array: &F) -> Result<(mts_array_t, Vec<usize>), Error>
+// Read a data array from the given reader, using numpy's NPY format.
+//
+// Data stored with another type than 64-bit floating points is loaded in an
+// array of the same type if `create_array` gives arrays implementing
+// `mts_array_t.create_typed`, and converted to 64-bit floating points
+// otherwise.
+fn read_data<R, F>(mut reader: R, create_array: &ArrayCreator<F>) -> Result<(mts_array_t, Vec<usize>), Error>
     where R: std::io::Read, F: Fn(Vec<usize>) -> Result<mts_array_t, Error>
 {
     let header = Header::from_reader(&mut reader)?;
@@ -183,25 +498,56 @@ fn read_data<R, F>(mut reader: R, create_array: &F) -> Result<(mts_array_t, Vec<
         return Err(Error::Serialization("data can not be loaded from fortran-order arrays".into()));
     }
 
+    let (dtype, little_endian) = match header.type_descriptor {
+        DataType::Scalar(ref s) => parse_npy_descriptor(s),
+        DataType::Compound(_) => None,
+    }.ok_or_else(|| Error::Serialization(format!(
+        "unknown type for data array, expected floating points, got {}",
+        header.type_descriptor
+    )))?;
+
     let shape = header.shape;
-    let mut array = create_array(shape.clone())?;
+    let mut array = create_array.create(shape.clone(), dtype)?;
 
-    match header.type_descriptor {
-        DataType::Scalar(s) if s == "<f8" => {
-            reader.read_f64_into::<LittleEndian>(array.data_mut()?)?;
-        }
-        DataType::Scalar(s) if s == ">f8" => {
-            reader.read_f64_into::<BigEndian>(array.data_mut()?)?;
-        }
-        _ => {
-            return Err(Error::Serialization(format!(
-                "unknown type for data array, expected 64-bit floating points, got {}",
-                header.type_descriptor
-            )));
-        }
+    // the bytes are read all at once, and then only swapped in-place if the
+    // endianness does not match the native one
+    let array_dtype = array.typed_data()?.map(|(_, dtype)| dtype);
+    if array_dtype == Some(dtype) {
+        let (data, _) = array.typed_data_mut()?.expect("typed_data should be set");
+        read_native(&mut reader, dtype, little_endian, data)?;
+    } else {
+        read_as_f64(&mut reader, dtype, little_endian, array.data_mut()?)?;
     }
 
     check_for_extra_bytes(&mut reader)?;
 
     return Ok((array, shape));
 }
+
+#[cfg(test)]
+mod tests {
+    use super::ArchiveIndex;
+
+    #[test]
+    fn archive_index() {
+        let files = [
+            "keys.npy",
+            "blocks/0/values.npy",
+            "blocks/0/samples.npy",
+            "blocks/0/gradients/positions/values.npy",
+            "blocks/0/gradients/positions/samples.npy",
+            "blocks/0/gradients/positions/gradients/cell/samples.npy",
+            "blocks/0/gradients/gradients/samples.npy",
+            "blocks/0/gradients/strain/samples.npy",
+            "blocks/10/gradients/positions/samples.npy",
+            "blocks/1/samples.npy",
+        ];
+
+        let index = ArchiveIndex::new(files.iter().copied());
+        assert_eq!(index.gradients("blocks/0"), ["positions", "gradients", "strain"]);
+        assert_eq!(index.gradients("blocks/0/gradients/positions"), ["cell"]);
+        assert_eq!(index.gradients("blocks/10"), ["positions"]);
+        assert!(index.gradients("blocks/1").is_empty());
+        assert!(index.gradients("blocks/2").is_empty());
+    }
+}
@@ -0,0 +1,519 @@
+use std::fs::File;
+use std::io::Read;
+use std::os::raw::c_void;
+use std::sync::Arc;
+
+use memmap2::{MmapMut, MmapOptions};
+use once_cell::sync::Lazy;
+use zip::{ZipArchive, CompressionMethod};
+use zip::read::ZipFile;
+
+use crate::c_api::{catch_unwind, mts_status_t};
+use crate::{TensorMap, Error};
+use crate::{mts_array_t, mts_data_origin_t, mts_sample_mapping_t, register_data_origin};
+use crate::data::{dtype_size, MTS_DTYPE_F64, MTS_DTYPE_F32, MTS_DTYPE_F16};
+
+use super::npy_header::{Header, DataType};
+use super::dtype::{parse_npy_descriptor, read_as_f64, read_native};
+use super::check_for_extra_bytes;
+use super::load::load_with_reader;
+
+static MMAP_ARRAY_ORIGIN: Lazy<mts_data_origin_t> = Lazy::new(|| {
+    register_data_origin("metatensor::io::MmapArray".into())
+});
+
+/// Load the serialized tensor map from the file at the given `path`, using
+/// memory mapping to avoid copying the values and gradients data.
+///
+/// The file is mapped in memory in copy-on-write mode: the arrays in the
+/// returned `TensorMap` point directly inside the mapped pages, and any
+/// modification to these arrays stays private to the current process and is
+/// never written back to the file. Metadata (``Labels``) is still copied.
+///
+/// The arrays keep the data type of the file. Data entries that can not be
+/// used directly from the mapped file (because they are compressed, use a
+/// different endianness or are not properly aligned) are copied to memory
+/// owned by the corresponding array instead.
+///
+/// The file must not be modified by other processes as long as the returned
+/// `TensorMap` (or any array coming from it) is alive.
+pub fn load_mmap(path: &str) -> Result<TensorMap, Error> {
+    let file = File::open(path)?;
+    // SAFETY: we are using copy-on-write mapping, so modification made by
+    // this process are never visible in the file. Concurrent modification of
+    // the file by other processes is documented as forbidden.
+    let mut mmap = unsafe { MmapOptions::new().map_copy(&file)? };
+    let base = mmap.as_mut_ptr();
+    let mmap = Arc::new(mmap);
+
+    let archive = ZipArchive::new(std::io::Cursor::new(&mmap[..])).map_err(|e| ("<root>".into(), e))?;
+    return load_with_reader(archive, None, 1, &|file| read_mmap_data(file, &mmap, base));
+}
+
+/// Wrapper around a reader counting the total number of bytes read
+struct CountingReader<R> {
+    reader: R,
+    count: usize,
+}
+
+impl<R: Read> Read for CountingReader<R> {
+    fn read(&mut self, buf: &mut [u8]) -> std::io::Result<usize> {
+        let count = self.reader.read(buf)?;
+        self.count += count;
+        return Ok(count);
+    }
+}
+
+// Read a data array from the given file in the memory-mapped archive. If
+// possible, the array will refer directly to the mapped data.
+fn read_mmap_data(file: ZipFile<'_>, mmap: &Arc<MmapMut>, base: *mut u8) -> Result<(mts_array_t, Vec<usize>), Error> {
+    let data_start = file.data_start();
+    let stored = file.compression() == CompressionMethod::Stored;
+
+    let mut reader = CountingReader { reader: file, count: 0 };
+    let header = Header::from_reader(&mut reader)?;
+    if header.fortran_order {
+        return Err(Error::Serialization("data can not be loaded from fortran-order arrays".into()));
+    }
+
+    let shape = header.shape;
+
+    let (dtype, little_endian) = match header.type_descriptor {
+        DataType::Scalar(ref s) => parse_npy_descriptor(s),
+        DataType::Compound(_) => None,
+    }.ok_or_else(|| Error::Serialization(format!(
+        "unknown type for data array, expected floating points, got {}",
+        header.type_descriptor
+    )))?;
+
+    let element_size = dtype_size(dtype)?;
+    let size = shape.iter().product::<usize>() * element_size;
+    let offset = usize::try_from(data_start).expect("file offset does not fit in usize") + reader.count;
+
+    let native = little_endian == cfg!(target_endian = "little");
+    let array = if stored && native && offset % element_size == 0 {
+        if offset + size > mmap.len() {
+            return Err(Error::Serialization(
+                "data array extends past the end of the file".into()
+            ));
+        }
+
+        MmapArray {
+            // SAFETY: we checked that the data is in bounds and properly
+            // aligned just above
+            storage: MmapStorage::Mapped {
+                _mmap: Arc::clone(mmap),
+                ptr: unsafe { base.add(offset) },
+            },
+            shape: shape.clone(),
+            dtype,
+        }
+    } else {
+        let mut array = MmapArray::zeros(shape.clone(), dtype);
+        read_native(&mut reader, dtype, little_endian, array.as_bytes_mut())?;
+        check_for_extra_bytes(&mut reader)?;
+        array
+    };
+
+    return Ok((array.into_mts_array(), shape));
+}
+
+/// Storage for the data of an `MmapArray`
+enum MmapStorage {
+    /// The data lives inside a memory-mapped file
+    Mapped {
+        /// Keep the mapping alive as long as this array exists
+        _mmap: Arc<MmapMut>,
+        /// Pointer to the start of the data for this array inside the mapping
+        ptr: *mut u8,
+    },
+    /// The data was copied to (or created in) memory owned by this array. We
+    /// use `u64` to get storage aligned for all supported data types.
+    Owned(Vec<u64>),
+}
+
+/// Implementation of `mts_array_t` for data loaded with `load_mmap`. This
+/// stores floating point data on CPU, in C-contiguous order, using the same
+/// data type as the file (one of the `MTS_DTYPE_XXX` constants) and gives
+/// access to it through `mts_array_t.typed_data`.
+///
+/// Accessing the data with `mts_array_t.data` converts arrays using another
+/// data type to 64-bit floating point in memory owned by the array.
+///
+/// New arrays created with `mts_array_t.create` (for example in
+/// `keys_to_samples`) or `mts_array_t.copy` use memory owned by the array, and
+/// not the memory-mapped file.
+struct MmapArray {
+    storage: MmapStorage,
+    shape: Vec<usize>,
+    dtype: i32,
+}
+
+impl MmapArray {
+    fn len(&self) -> usize {
+        self.shape.iter().product()
+    }
+
+    fn element_size(&self) -> usize {
+        dtype_size(self.dtype).expect("MmapArray should have a valid dtype")
+    }
+
+    fn as_bytes(&self) -> &[u8] {
+        let size = self.len() * self.element_size();
+        match self.storage {
+            MmapStorage::Mapped { ptr, .. } => unsafe {
+                std::slice::from_raw_parts(ptr, size)
+            },
+            MmapStorage::Owned(ref data) => unsafe {
+                std::slice::from_raw_parts(data.as_ptr().cast(), size)
+            },
+        }
+    }
+
+    fn as_bytes_mut(&mut self) -> &mut [u8] {
+        let size = self.len() * self.element_size();
+        match self.storage {
+            MmapStorage::Mapped { ptr, .. } => unsafe {
+                std::slice::from_raw_parts_mut(ptr, size)
+            },
+            MmapStorage::Owned(ref mut data) => unsafe {
+                std::slice::from_raw_parts_mut(data.as_mut_ptr().cast(), size)
+            },
+        }
+    }
+
+    /// Create a new array filled with zeros, in memory owned by the array
+    fn zeros(shape: Vec<usize>, dtype: i32) -> MmapArray {
+        let size = shape.iter().product::<usize>() * dtype_size(dtype).expect("invalid dtype");
+        let data = vec![0; (size + 7) / 8];
+        MmapArray { storage: MmapStorage::Owned(data), shape, dtype }
+    }
+
+    /// Create a new array with the given raw `data`, copied to memory owned
+    /// by the array
+    fn from_bytes(data: &[u8], shape: Vec<usize>, dtype: i32) -> MmapArray {
+        let mut array = MmapArray::zeros(shape, dtype);
+        array.as_bytes_mut().copy_from_slice(data);
+        return array;
+    }
+
+    /// Get the data of this array converted to 64-bit floating point
+    fn to_f64(&self) -> Result<Vec<f64>, Error> {
+        let mut output = vec![0.0; self.len()];
+        read_as_f64(&mut self.as_bytes(), self.dtype, cfg!(target_endian = "little"), &mut output)?;
+        return Ok(output);
+    }
+
+    /// Convert this array to 64-bit floating point data in memory owned by
+    /// the array, if it uses another data type
+    fn convert_to_f64(&mut self) -> Result<(), Error> {
+        if self.dtype != MTS_DTYPE_F64 {
+            let data = self.to_f64()?;
+            let bytes = unsafe {
+                std::slice::from_raw_parts(data.as_ptr().cast::<u8>(), 8 * data.len())
+            };
+            *self = MmapArray::from_bytes(bytes, std::mem::take(&mut self.shape), MTS_DTYPE_F64);
+        }
+        Ok(())
+    }
+
+    #[cfg(test)]
+    fn owned(data: Vec<f64>, shape: Vec<usize>) -> MmapArray {
+        let bytes = unsafe {
+            std::slice::from_raw_parts(data.as_ptr().cast::<u8>(), 8 * data.len())
+        };
+        MmapArray::from_bytes(bytes, shape, MTS_DTYPE_F64)
+    }
+
+    fn into_mts_array(self) -> mts_array_t {
+        mts_array_t {
+            ptr: Box::into_raw(Box::new(self)).cast(),
+            origin: Some(MmapArray::origin),
+            data: Some(MmapArray::data),
+            shape: Some(MmapArray::shape),
+            reshape: Some(MmapArray::reshape),
+            swap_axes: Some(MmapArray::swap_axes),
+            create: Some(MmapArray::create),
+            copy: Some(MmapArray::copy),
+            destroy: Some(MmapArray::destroy),
+            move_samples_from: Some(MmapArray::move_samples_from),
+            typed_data: Some(MmapArray::typed_data),
+            create_typed: Some(MmapArray::create_typed),
+        }
+    }
+
+    unsafe extern fn origin(_: *const c_void, origin: *mut mts_data_origin_t) -> mts_status_t {
+        catch_unwind(|| {
+            *origin = *MMAP_ARRAY_ORIGIN;
+            Ok(())
+        })
+    }
+
+    unsafe extern fn data(array: *mut c_void, data: *mut *mut f64) -> mts_status_t {
+        catch_unwind(|| {
+            let array = &mut *array.cast::<MmapArray>();
+            array.convert_to_f64()?;
+            *data = array.as_bytes_mut().as_mut_ptr().cast();
+            Ok(())
+        })
+    }
+
+    unsafe extern fn typed_data(array: *mut c_void, data: *mut *mut c_void, dtype: *mut i32) -> mts_status_t {
+        catch_unwind(|| {
+            let array = &mut *array.cast::<MmapArray>();
+            *data = array.as_bytes_mut().as_mut_ptr().cast();
+            *dtype = array.dtype;
+            Ok(())
+        })
+    }
+
+    unsafe extern fn shape(array: *const c_void, shape: *mut *const usize, shape_count: *mut usize) -> mts_status_t {
+        catch_unwind(|| {
+            let array = &*array.cast::<MmapArray>();
+            *shape = array.shape.as_ptr();
+            *shape_count = array.shape.len();
+            Ok(())
+        })
+    }
+
+    unsafe extern fn reshape(array: *mut c_void, shape: *const usize, shape_count: usize) -> mts_status_t {
+        catch_unwind(|| {
+            let array = &mut *array.cast::<MmapArray>();
+            let shape = std::slice::from_raw_parts(shape, shape_count);
+            if shape.iter().product::<usize>() != array.len() {
+                return Err(Error::InvalidParameter(format!(
+                    "invalid shape in reshape: {:?} does not contain the same \
+                    number of elements as {:?}", shape, array.shape
+                )));
+            }
+
+            array.shape = shape.to_vec();
+            Ok(())
+        })
+    }
+
+    unsafe extern fn swap_axes(array: *mut c_void, axis_1: usize, axis_2: usize) -> mts_status_t {
+        catch_unwind(|| {
+            let array = &mut *array.cast::<MmapArray>();
+            if axis_1 >= array.shape.len() || axis_2 >= array.shape.len() {
+                return Err(Error::InvalidParameter(format!(
+                    "invalid axes in swap_axes: got {} and {} for an array with {} dimensions",
+                    axis_1, axis_2, array.shape.len()
+                )));
+            }
+
+            if axis_1 == axis_2 {
+                return Ok(());
+            }
+
+            let (first, second) = if axis_1 < axis_2 { (axis_1, axis_2) } else { (axis_2, axis_1) };
+
+            // view the data as a [before, first, middle, second, after] array,
+            // and transpose it to [before, second, middle, first, after]
+            let before = array.shape[..first].iter().product::<usize>();
+            let n_first = array.shape[first];
+            let middle = array.shape[(first + 1)..second].iter().product::<usize>();
+            let n_second = array.shape[second];
+            let after = array.shape[(second + 1)..].iter().product::<usize>() * array.element_size();
+
+            let mut shape = array.shape.clone();
+            shape.swap(first, second);
+            let mut output = MmapArray::zeros(shape, array.dtype);
+
+            let input = array.as_bytes();
+            let output_data = output.as_bytes_mut();
+            for b in 0..before {
+                for i in 0..n_first {
+                    for m in 0..middle {
+                        for j in 0..n_second {
+                            let input_start = (((b * n_first + i) * middle + m) * n_second + j) * after;
+                            let output_start = (((b * n_second + j) * middle + m) * n_first + i) * after;
+                            output_data[output_start..(output_start + after)].copy_from_slice(
+                                &input[input_start..(input_start + after)]
+                            );
+                        }
+                    }
+                }
+            }
+
+            *array = output;
+
+            Ok(())
+        })
+    }
+
+    unsafe extern fn create(
+        array: *const c_void,
+        shape: *const usize,
+        shape_count: usize,
+        new_array: *mut mts_array_t,
+    ) -> mts_status_t {
+        catch_unwind(|| {
+            let array = &*array.cast::<MmapArray>();
+            let shape = std::slice::from_raw_parts(shape, shape_count).to_vec();
+            *new_array = MmapArray::zeros(shape, array.dtype).into_mts_array();
+            Ok(())
+        })
+    }
+
+    unsafe extern fn create_typed(
+        _: *const c_void,
+        shape: *const usize,
+        shape_count: usize,
+        dtype: i32,
+        new_array: *mut mts_array_t,
+    ) -> mts_status_t {
+        catch_unwind(|| {
+            // bfloat16 can not be stored in NPY files, and is not supported
+            if dtype == MTS_DTYPE_F64 || dtype == MTS_DTYPE_F32 || dtype == MTS_DTYPE_F16 {
+                let shape = std::slice::from_raw_parts(shape, shape_count).to_vec();
+                *new_array = MmapArray::zeros(shape, dtype).into_mts_array();
+            }
+            Ok(())
+        })
+    }
+
+    unsafe extern fn copy(array: *const c_void, new_array: *mut mts_array_t) -> mts_status_t {
+        catch_unwind(|| {
+            let array = &*array.cast::<MmapArray>();
+            *new_array = MmapArray::from_bytes(array.as_bytes(), array.shape.clone(), array.dtype).into_mts_array();
+            Ok(())
+        })
+    }
+
+    unsafe extern fn destroy(array: *mut c_void) {
+        let array = Box::from_raw(array.cast::<MmapArray>());
+        std::mem::drop(array);
+    }
+
+    unsafe extern fn move_samples_from(
+        output: *mut c_void,
+        input: *const c_void,
+        samples: *const mts_sample_mapping_t,
+        samples_count: usize,
+        property_start: usize,
+        property_end: usize,
+    ) -> mts_status_t {
+        catch_unwind(|| {
+            let output = &mut *output.cast::<MmapArray>();
+            let input = &*input.cast::<MmapArray>();
+            let samples = if samples_count == 0 {
+                &[]
+            } else {
+                std::slice::from_raw_parts(samples, samples_count)
+            };
+
+            let input_properties = *input.shape.last().expect("empty shape");
+            let output_properties = *output.shape.last().expect("empty shape");
+            if property_end - property_start != input_properties {
+                return Err(Error::InvalidParameter(format!(
+                    "invalid property range in move_samples_from: {}..{} for an input with {} properties",
+                    property_start, property_end, input_properties
+                )));
+            }
+
+            let n_components = input.shape[1..(input.shape.len() - 1)].iter().product::<usize>();
+
+            // arrays with different data types (for example if `data` was
+            // called on one of them) are both handled as 64-bit floats
+            let converted;
+            let input_data = if input.dtype == output.dtype {
+                input.as_bytes()
+            } else {
+                output.convert_to_f64()?;
+                converted = input.to_f64()?;
+                std::slice::from_raw_parts(converted.as_ptr().cast::<u8>(), 8 * converted.len())
+            };
+
+            let size = output.element_size();
+            let output_data = output.as_bytes_mut();
+            for sample in samples {
+                for component in 0..n_components {
+                    let input_start = (sample.input * n_components + component) * input_properties * size;
+                    let output_start = ((sample.output * n_components + component) * output_properties + property_start) * size;
+                    let count = input_properties * size;
+
+                    output_data[output_start..(output_start + count)].copy_from_slice(
+                        &input_data[input_start..(input_start + count)]
+                    );
+                }
+            }
+
+            Ok(())
+        })
+    }
+}
+
+// SAFETY: MmapArray only contains a raw pointer inside a mapping it keeps
+// alive, and never shares this pointer with other arrays
+unsafe impl Send for MmapArray {}
+unsafe impl Sync for MmapArray {}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::data::MTS_DTYPE_BF16;
+
+    #[test]
+    fn swap_axes() {
+        let data = (0..24).map(f64::from).collect();
+        let mut array = MmapArray::owned(data, vec![2, 3, 4]).into_mts_array();
+
+        array.swap_axes(0, 2).unwrap();
+        assert_eq!(array.shape().unwrap(), [4, 3, 2]);
+
+        let data = array.data().unwrap();
+        // new[k, j, i] = old[i, j, k] = 12 * i + 4 * j + k
+        assert_eq!(data[0], 0.0);
+        assert_eq!(data[1], 12.0);
+        assert_eq!(data[2], 4.0);
+        assert_eq!(data[6], 1.0);
+        assert_eq!(data[23], 23.0);
+    }
+
+    #[test]
+    fn move_samples() {
+        let data = (0..12).map(f64::from).collect();
+        let input = MmapArray::owned(data, vec![3, 2, 2]).into_mts_array();
+
+        let mut output = input.create(&[2, 2, 5]).unwrap();
+        let samples = [
+            mts_sample_mapping_t { input: 2, output: 0 },
+            mts_sample_mapping_t { input: 0, output: 1 },
+        ];
+        output.move_samples_from(&input, &samples, 3..5).unwrap();
+
+        assert_eq!(output.data().unwrap(), [
+            0.0, 0.0, 0.0, 8.0, 9.0,
+            0.0, 0.0, 0.0, 10.0, 11.0,
+            0.0, 0.0, 0.0, 0.0, 1.0,
+            0.0, 0.0, 0.0, 2.0, 3.0,
+        ]);
+    }
+
+    #[test]
+    fn native_dtype() {
+        let data = (0..6_u8).map(f32::from).flat_map(f32::to_ne_bytes).collect::<Vec<_>>();
+        let mut array = MmapArray::from_bytes(&data, vec![2, 3], MTS_DTYPE_F32).into_mts_array();
+
+        let (bytes, dtype) = array.typed_data().unwrap().unwrap();
+        assert_eq!(dtype, MTS_DTYPE_F32);
+        assert_eq!(bytes, data);
+
+        // new arrays use the same dtype
+        let created = array.create(&[4]).unwrap();
+        assert_eq!(created.typed_data().unwrap().unwrap(), (&[0; 16][..], MTS_DTYPE_F32));
+
+        let created = array.create_typed(&[4], MTS_DTYPE_F16).unwrap().unwrap();
+        assert_eq!(created.typed_data().unwrap().unwrap(), (&[0; 8][..], MTS_DTYPE_F16));
+        assert!(array.create_typed(&[4], MTS_DTYPE_BF16).unwrap().is_none());
+
+        array.swap_axes(0, 1).unwrap();
+        let (bytes, _) = array.typed_data().unwrap().unwrap();
+        assert_eq!(bytes[4..8], 3.0_f32.to_ne_bytes());
+
+        // accessing the data as f64 converts the array
+        assert_eq!(array.data().unwrap(), [0.0, 3.0, 1.0, 4.0, 2.0, 5.0]);
+        assert_eq!(array.typed_data().unwrap().unwrap().1, MTS_DTYPE_F64);
+    }
+}
@@ -1,18 +1,33 @@
 mod npy_header;
+mod dtype;
 mod labels;
 pub use self::labels::load_labels;
 pub use self::labels::looks_like_labels_data;
 
 mod load;
-pub use self::load::load;
+pub use self::load::{load, load_parallel, load_selection};
 pub use self::load::looks_like_tensormap_data;
 
+mod mmap;
+pub use self::mmap::load_mmap;
+
+mod shm;
+pub use self::shm::{save_shm, load_shm, remove_shm};
+
 mod save;
-pub use self::save::save;
+pub use self::save::{save, save_compressed};
+pub use self::save::{MTS_COMPRESSION_NONE, MTS_COMPRESSION_DEFLATE, MTS_COMPRESSION_ZSTD};
 pub use self::labels::save_labels;
 
+mod writer;
+pub use self::writer::TensorMapWriter;
+
 use crate::Error;
 
+/// Alignment (in bytes) of the start of data arrays inside the NPZ files we
+/// create. This allows using the data directly from a memory-mapped file.
+const DATA_ALIGNMENT: u16 = 64;
+
 pub trait ReadAndSeek: std::io::Read + std::io::Seek {}
 impl<T: std::io::Read + std::io::Seek> ReadAndSeek for T {}
 
@@ -21,6 +36,15 @@ pub enum PathOrBuffer<'a> {
     Buffer(&'a mut dyn ReadAndSeek),
 }
 
+/// Get the bytes corresponding to the given slice of `f64`
+fn f64_as_bytes(data: &[f64]) -> &[u8] {
+    // SAFETY: u8 has no alignment requirement, and any f64 bit pattern is a
+    // valid sequence of bytes
+    unsafe {
+        std::slice::from_raw_parts(data.as_ptr().cast::<u8>(), std::mem::size_of_val(data))
+    }
+}
+
 // returns an error if the given reader contains any more data
 fn check_for_extra_bytes<R: std::io::Read>(reader: &mut R) -> Result<(), Error> {
     let extra = reader.read_to_end(&mut Vec::new())?;
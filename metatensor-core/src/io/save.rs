@@ -1,10 +1,17 @@
-use byteorder::{WriteBytesExt, NativeEndian};
-use zip::{ZipWriter, DateTime};
+use std::borrow::Cow;
+use std::io::{Cursor, Write};
+use std::sync::Arc;
 
-use crate::{TensorMap, TensorBlock, Error, mts_array_t};
+use zip::{ZipArchive, ZipWriter, DateTime, CompressionMethod};
+
+use crate::{TensorMap, TensorBlock, Labels, Error, mts_array_t};
+use crate::data::{MTS_DTYPE_F64, MTS_DTYPE_BF16};
+use crate::utils::parallel_map;
 
 use super::npy_header::{Header, DataType};
 use super::labels::save_labels;
+use super::dtype::{npy_descriptor, bf16_to_f32_bytes};
+use super::{DATA_ALIGNMENT, f64_as_bytes};
 
 
 /// Save the given tensor to a file (or any other writer).
@@ -14,10 +21,7 @@ use super::labels::save_labels;
 pub fn save<W: std::io::Write + std::io::Seek>(writer: W, tensor: &TensorMap) -> Result<(), Error> {
     let mut archive = ZipWriter::new(writer);
 
-    let options = zip::write::FileOptions::default()
-        .compression_method(zip::CompressionMethod::Stored)
-        .large_file(true)
-        .last_modified_time(DateTime::from_date_and_time(2000, 1, 1, 0, 0, 0).expect("invalid datetime"));
+    let options = file_options();
 
     let path = String::from("keys.npy");
     archive.start_file(&path, options).map_err(|e| (path, e))?;
@@ -32,51 +36,228 @@ pub fn save<W: std::io::Write + std::io::Seek>(writer: W, tensor: &TensorMap) ->
     return Ok(());
 }
 
-fn write_block<W: std::io::Write + std::io::Seek>(
-    archive: &mut ZipWriter<W>,
+/// Store the data without compression. Uncompressed arrays can be used
+/// directly when loading files with memory mapping.
+pub const MTS_COMPRESSION_NONE: i32 = 0;
+/// Compress the data with the DEFLATE algorithm, supported by all ZIP readers
+pub const MTS_COMPRESSION_DEFLATE: i32 = 1;
+/// Compress the data with the Zstandard algorithm, which is faster than
+/// DEFLATE for the same compression ratio, but is not supported by all ZIP
+/// readers (in particular Python's `zipfile` and thus numpy)
+pub const MTS_COMPRESSION_ZSTD: i32 = 2;
+
+/// Save the given tensor to a file (or any other writer), compressing all the
+/// entries in the archive with the given `compression` method (one of the
+/// `MTS_COMPRESSION_XXX` constants) and `level`.
+///
+/// A `level` of 0 uses the default level for the compression method. The
+/// entries are compressed in parallel using up to `n_threads` threads
+/// (setting `n_threads` to 0 uses all the available cores). The compressed
+/// data is kept in memory until it is written to the `writer`.
+///
+/// The resulting file can be loaded with [`super::load`] and all the other
+/// loading functions, which decompress the entries as needed.
+pub fn save_compressed<W: std::io::Write + std::io::Seek>(
+    writer: W,
+    tensor: &TensorMap,
+    compression: i32,
+    level: i32,
+    n_threads: usize,
+) -> Result<(), Error> {
+    let method = match compression {
+        MTS_COMPRESSION_NONE => return save(writer, tensor),
+        MTS_COMPRESSION_DEFLATE => CompressionMethod::Deflated,
+        MTS_COMPRESSION_ZSTD => CompressionMethod::Zstd,
+        _ => return Err(Error::InvalidParameter(format!(
+            "unknown compression method {}", compression
+        ))),
+    };
+    let level = if level == 0 { None } else { Some(level) };
+
+    // all the entries are serialized on the current thread, since arrays
+    // might not support being used from multiple threads. The data of the
+    // arrays is borrowed and not copied.
+    let mut entries = vec![Entry::labels(String::from("keys.npy"), tensor.keys())?];
+    for (block_i, block) in tensor.blocks().iter().enumerate() {
+        collect_block_entries(&mut entries, &format!("blocks/{}", block_i), true, block)?;
+    }
+
+    let compressed = parallel_map(&entries, n_threads, |entry| entry.compress(method, level));
+
+    // each entry was compressed in its own archive, copy the compressed data
+    // to the final archive
+    let mut archive = ZipWriter::new(writer);
+    for (entry, compressed) in entries.iter().zip(compressed) {
+        let mut single = ZipArchive::new(Cursor::new(compressed?)).map_err(|e| (entry.path.clone(), e))?;
+        let file = single.by_index(0).map_err(|e| (entry.path.clone(), e))?;
+        archive.raw_copy_file(file).map_err(|e| (entry.path.clone(), e))?;
+    }
+
+    archive.finish().map_err(|e| ("<root>".into(), e))?;
+
+    return Ok(());
+}
+
+/// A single entry of the archive, serialized to the NPY format
+struct Entry<'a> {
+    path: String,
+    /// NPY header for data arrays, or the full NPY file for Labels
+    header: Vec<u8>,
+    /// data for the arrays, borrowed from the array when possible
+    data: Cow<'a, [u8]>,
+}
+
+impl<'a> Entry<'a> {
+    fn labels(path: String, labels: &Labels) -> Result<Entry<'a>, Error> {
+        let mut header = Vec::new();
+        save_labels(&mut header, labels)?;
+        return Ok(Entry { path, header, data: Cow::Borrowed(&[]) });
+    }
+
+    fn array(path: String, array: &'a mts_array_t) -> Result<Entry<'a>, Error> {
+        let (header, data) = serialize_data(array)?;
+        let mut header_bytes = Vec::new();
+        header.write(&mut header_bytes)?;
+        return Ok(Entry { path, header: header_bytes, data });
+    }
+
+    /// Compress this entry, returning a ZIP archive containing only this entry
+    fn compress(&self, method: CompressionMethod, level: Option<i32>) -> Result<Vec<u8>, Error> {
+        let options = file_options()
+            .compression_method(method)
+            .compression_level(level);
+
+        let mut archive = ZipWriter::new(Cursor::new(Vec::new()));
+        archive.start_file(&self.path, options).map_err(|e| (self.path.clone(), e))?;
+        archive.write_all(&self.header)?;
+        archive.write_all(&self.data)?;
+
+        let buffer = archive.finish().map_err(|e| (self.path.clone(), e))?;
+        return Ok(buffer.into_inner());
+    }
+}
+
+/// Add all the entries for the given `block` (and recursively its gradients)
+/// to `entries`, following the same layout as `write_block`.
+fn collect_block_entries<'a>(
+    entries: &mut Vec<Entry<'a>>,
     prefix: &str,
     values: bool,
-    block: &TensorBlock,
+    block: &'a TensorBlock,
 ) -> Result<(), Error> {
-    let options = zip::write::FileOptions::default()
+    entries.push(Entry::array(format!("{}/values.npy", prefix), &block.values)?);
+    entries.push(Entry::labels(format!("{}/samples.npy", prefix), &block.samples)?);
+
+    for (i, component) in block.components.iter().enumerate() {
+        entries.push(Entry::labels(format!("{}/components/{}.npy", prefix, i), component)?);
+    }
+
+    if values {
+        entries.push(Entry::labels(format!("{}/properties.npy", prefix), &block.properties)?);
+    }
+
+    for (parameter, gradient) in block.gradients() {
+        let prefix = format!("{}/gradients/{}", prefix, parameter);
+        collect_block_entries(entries, &prefix, false, gradient)?;
+    }
+
+    Ok(())
+}
+
+/// Options used for all the files in the archive
+pub(super) fn file_options() -> zip::write::FileOptions {
+    zip::write::FileOptions::default()
         .compression_method(zip::CompressionMethod::Stored)
         .large_file(true)
-        .last_modified_time(DateTime::from_date_and_time(2000, 1, 1, 0, 0, 0).expect("invalid datetime"));
+        .last_modified_time(DateTime::from_date_and_time(2000, 1, 1, 0, 0, 0).expect("invalid datetime"))
+}
 
+/// Write a single block (and recursively its gradients) to the archive, with
+/// all files inside `prefix`. The properties are only written if `values` is
+/// `true`, since gradients share them with the values.
+pub(super) fn write_block<W: std::io::Write + std::io::Seek>(
+    archive: &mut ZipWriter<W>,
+    prefix: &str,
+    values: bool,
+    block: &TensorBlock,
+) -> Result<(), Error> {
+    let options = file_options();
+
+    // align the start of the NPY file such that the data itself (coming after
+    // a header padded to 64 bytes) is aligned, and can be used directly when
+    // memory-mapping the file
     let path = format!("{}/values.npy", prefix);
-    archive.start_file(&path, options).map_err(|e| (path, e))?;
+    archive.start_file_aligned(&path, options, DATA_ALIGNMENT).map_err(|e| (path, e))?;
     write_data(archive, &block.values)?;
 
+    let properties = if values { Some(&*block.properties) } else { None };
+    write_block_labels(archive, prefix, &block.samples, &block.components, properties)?;
+
+    for (parameter, gradient) in block.gradients() {
+        let prefix = format!("{}/gradients/{}", prefix, parameter);
+        write_block(archive, &prefix, false, gradient)?;
+    }
+
+    Ok(())
+}
+
+/// Write the samples, components and (if given) properties of a block to the
+/// archive, with all files inside `prefix`.
+pub(super) fn write_block_labels<W: std::io::Write + std::io::Seek>(
+    archive: &mut ZipWriter<W>,
+    prefix: &str,
+    samples: &Labels,
+    components: &[Arc<Labels>],
+    properties: Option<&Labels>,
+) -> Result<(), Error> {
+    let options = file_options();
+
     let path = format!("{}/samples.npy", prefix);
     archive.start_file(&path, options).map_err(|e| (path, e))?;
-    save_labels(archive, &block.samples)?;
+    save_labels(archive, samples)?;
 
-    for (i, component) in block.components.iter().enumerate() {
+    for (i, component) in components.iter().enumerate() {
         let path = format!("{}/components/{}.npy", prefix, i);
         archive.start_file(&path, options).map_err(|e| (path, e))?;
         save_labels(archive, component)?;
     }
 
-    if values {
+    if let Some(properties) = properties {
         let path = format!("{}/properties.npy", prefix);
         archive.start_file(&path, options).map_err(|e| (path.clone(), e))?;
-        save_labels(archive, &block.properties)?;
-    }
-
-    for (parameter, gradient) in block.gradients() {
-        let prefix = format!("{}/gradients/{}", prefix, parameter);
-        write_block(archive, &prefix, false, gradient)?;
+        save_labels(archive, properties)?;
     }
 
     Ok(())
 }
 
-// Write an array to the given writer, using numpy's NPY format
+// Write an array to the given writer, using numpy's NPY format. The data is
+// stored with its own type if the array provides `mts_array_t.typed_data`,
+// and as 64-bit floating points otherwise.
 fn write_data<W: std::io::Write>(writer: &mut W, array: &mts_array_t) -> Result<(), Error> {
-    let type_descriptor = if cfg!(target_endian = "little") {
-        "<f8"
+    let (header, data) = serialize_data(array)?;
+    header.write(&mut *writer)?;
+
+    // the data is stored with the native endianness, so we can write the
+    // corresponding bytes directly
+    writer.write_all(&data)?;
+
+    return Ok(());
+}
+
+// Get the NPY header and the bytes of the data for the given array
+pub(super) fn serialize_data(array: &mts_array_t) -> Result<(Header, Cow<'_, [u8]>), Error> {
+    let (dtype, data) = match array.typed_data()? {
+        Some((data, dtype)) => (dtype, Cow::Borrowed(data)),
+        None => (MTS_DTYPE_F64, Cow::Borrowed(f64_as_bytes(array.data()?))),
+    };
+
+    let type_descriptor = npy_descriptor(dtype)?;
+    let data = if dtype == MTS_DTYPE_BF16 {
+        // NPY does not support bfloat16, store the data as f32 instead
+        Cow::Owned(bf16_to_f32_bytes(&data))
     } else {
-        ">f8"
+        data
     };
 
     let header = Header {
@@ -85,11 +266,5 @@ fn write_data<W: std::io::Write>(writer: &mut W, array: &mts_array_t) -> Result<
         shape: array.shape()?.to_vec(),
     };
 
-    header.write(&mut *writer)?;
-
-    for &value in array.data()? {
-        writer.write_f64::<NativeEndian>(value)?;
-    }
-
-    return Ok(());
+    return Ok((header, data));
 }
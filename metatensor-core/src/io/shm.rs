@@ -0,0 +1,231 @@
+use std::fs::{File, OpenOptions};
+use std::io::{Seek, SeekFrom, Write};
+use std::path::{Path, PathBuf};
+use std::sync::atomic::{AtomicUsize, Ordering};
+
+use memmap2::MmapMut;
+
+use crate::{TensorMap, Error};
+
+use super::save::save;
+use super::mmap::load_mmap;
+
+/// Get the path of the file backing the shared memory segment with the given
+/// `name`. On Linux, this is a file in `/dev/shm` (which is what `shm_open`
+/// uses), and a file in the temporary directory on other platforms.
+fn shm_path(name: &str) -> Result<PathBuf, Error> {
+    if name.is_empty() || name.contains('/') || name.contains('\\') {
+        return Err(Error::InvalidParameter(format!(
+            "invalid name for shared memory segment '{}': it must not be empty \
+            or contain path separators", name
+        )));
+    }
+
+    let shm_dir = PathBuf::from("/dev/shm");
+    let directory = if cfg!(target_os = "linux") && shm_dir.is_dir() {
+        shm_dir
+    } else {
+        std::env::temp_dir()
+    };
+
+    return Ok(directory.join(format!("metatensor-{}", name)));
+}
+
+/// Writer discarding all data, and only tracking the final size of the
+/// written file
+#[derive(Default)]
+struct SizeCounter {
+    position: u64,
+    size: u64,
+}
+
+impl Write for SizeCounter {
+    fn write(&mut self, buf: &[u8]) -> std::io::Result<usize> {
+        self.position += buf.len() as u64;
+        self.size = u64::max(self.size, self.position);
+        return Ok(buf.len());
+    }
+
+    fn flush(&mut self) -> std::io::Result<()> {
+        Ok(())
+    }
+}
+
+impl Seek for SizeCounter {
+    fn seek(&mut self, pos: SeekFrom) -> std::io::Result<u64> {
+        let new_position = match pos {
+            SeekFrom::Start(offset) => Some(offset),
+            SeekFrom::End(offset) => add_signed(self.size, offset),
+            SeekFrom::Current(offset) => add_signed(self.position, offset),
+        };
+
+        self.position = new_position.ok_or_else(|| std::io::Error::new(
+            std::io::ErrorKind::InvalidInput, "invalid seek to a negative position"
+        ))?;
+        return Ok(self.position);
+    }
+}
+
+/// Add a signed offset to `value`, returning `None` on overflow or if the
+/// result would be negative
+fn add_signed(value: u64, offset: i64) -> Option<u64> {
+    if offset >= 0 {
+        value.checked_add(offset.unsigned_abs())
+    } else {
+        value.checked_sub(offset.unsigned_abs())
+    }
+}
+
+/// Create a new file next to `path`, which can later be renamed to `path`.
+///
+/// The file is created with `O_EXCL` (and `O_NOFOLLOW` on unix), so this never
+/// opens an existing file or follows a symbolic link created by someone else
+/// in a shared directory. On unix, the file is only readable and writable by
+/// the current user.
+fn create_temporary(path: &Path) -> Result<(PathBuf, File), Error> {
+    static COUNTER: AtomicUsize = AtomicUsize::new(0);
+
+    let mut options = OpenOptions::new();
+    options.read(true).write(true).create_new(true);
+
+    #[cfg(unix)]
+    {
+        use std::os::unix::fs::OpenOptionsExt;
+        options.mode(0o600).custom_flags(libc::O_NOFOLLOW);
+    }
+
+    let nanos = std::time::SystemTime::now()
+        .duration_since(std::time::UNIX_EPOCH)
+        .map_or(0, |d| d.subsec_nanos());
+
+    let mut attempts = 0;
+    loop {
+        let mut name = path.as_os_str().to_owned();
+        name.push(format!(
+            ".{}-{}-{}.tmp",
+            std::process::id(),
+            nanos,
+            COUNTER.fetch_add(1, Ordering::Relaxed),
+        ));
+        let temporary = PathBuf::from(name);
+
+        match options.open(&temporary) {
+            Ok(file) => return Ok((temporary, file)),
+            Err(e) if e.kind() == std::io::ErrorKind::AlreadyExists && attempts < 16 => {
+                attempts += 1;
+            }
+            Err(e) => return Err(e.into()),
+        }
+    }
+}
+
+/// Save the given tensor to the shared memory segment with the given `name`,
+/// creating or replacing the segment.
+///
+/// The size of the serialized data is computed first, and the data is then
+/// written directly inside a new memory-mapped file with this exact size,
+/// without intermediary buffers. This file is then renamed to the final name
+/// of the segment. Other processes can then load the tensor with
+/// [`load_shm`], and the segment should be removed with [`remove_shm`] once it
+/// is no longer needed.
+pub fn save_shm(name: &str, tensor: &TensorMap) -> Result<(), Error> {
+    let path = shm_path(name)?;
+
+    let mut counter = SizeCounter::default();
+    save(&mut counter, tensor)?;
+    let size = counter.size;
+
+    let (temporary, file) = create_temporary(&path)?;
+    let result = (|| {
+        file.set_len(size)?;
+
+        // SAFETY: the file was just created by this process with `O_EXCL`,
+        // and is only modified through this mapping
+        let mut mmap = unsafe { MmapMut::map_mut(&file)? };
+        save(std::io::Cursor::new(&mut mmap[..]), tensor)?;
+        mmap.flush()?;
+        // some platforms do not allow renaming mapped files
+        drop(mmap);
+
+        // `rename` replaces any existing file (or symbolic link) at `path`,
+        // without following it
+        std::fs::rename(&temporary, &path)?;
+        Ok(())
+    })();
+
+    if result.is_err() {
+        let _ = std::fs::remove_file(&temporary);
+    }
+
+    return result;
+}
+
+/// Load a tensor from the shared memory segment with the given `name`,
+/// created by [`save_shm`].
+///
+/// The segment is memory-mapped with [`load_mmap`], and the values and
+/// gradients arrays point directly inside the shared memory. The segment is
+/// not removed by this function, and can be loaded multiple times (for example
+/// by multiple processes). Use [`remove_shm`] to remove it.
+pub fn load_shm(name: &str) -> Result<TensorMap, Error> {
+    let path = shm_path(name)?;
+    let path = path.to_str().expect("temporary directory path is not UTF-8");
+    return load_mmap(path);
+}
+
+/// Remove the shared memory segment with the given `name`, created by
+/// [`save_shm`].
+///
+/// On unix platforms, tensors already loaded from this segment stay valid, and
+/// the memory is released when the last array using it is destroyed. Other
+/// platforms do not allow removing a segment while it is still mapped.
+pub fn remove_shm(name: &str) -> Result<(), Error> {
+    let path = shm_path(name)?;
+    std::fs::remove_file(path)?;
+    return Ok(());
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn size_counter() {
+        let mut counter = SizeCounter::default();
+        counter.write_all(&[0; 16]).unwrap();
+        counter.seek(SeekFrom::Start(4)).unwrap();
+        counter.write_all(&[0; 4]).unwrap();
+        assert_eq!(counter.position, 8);
+        assert_eq!(counter.size, 16);
+
+        assert_eq!(counter.seek(SeekFrom::End(-2)).unwrap(), 14);
+        assert_eq!(counter.seek(SeekFrom::Current(10)).unwrap(), 24);
+        assert!(counter.seek(SeekFrom::Current(-30)).is_err());
+    }
+
+    #[test]
+    fn invalid_names() {
+        assert!(shm_path("").is_err());
+        assert!(shm_path("foo/bar").is_err());
+        assert!(shm_path("foo").unwrap().ends_with("metatensor-foo"));
+    }
+
+    #[test]
+    fn temporary_files() {
+        let path = std::env::temp_dir().join(format!("metatensor-shm-test-{}", std::process::id()));
+
+        let (first, _file) = create_temporary(&path).unwrap();
+        let (second, _file) = create_temporary(&path).unwrap();
+        assert_ne!(first, second);
+
+        #[cfg(unix)]
+        {
+            use std::os::unix::fs::PermissionsExt;
+            let mode = std::fs::metadata(&first).unwrap().permissions().mode();
+            assert_eq!(mode & 0o777, 0o600);
+        }
+
+        std::fs::remove_file(first).unwrap();
+        std::fs::remove_file(second).unwrap();
+    }
+}
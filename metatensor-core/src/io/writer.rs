@@ -0,0 +1,393 @@
+use std::collections::BTreeMap;
+use std::sync::Arc;
+
+use zip::ZipWriter;
+
+use crate::{TensorBlock, Labels, LabelsBuilder, Error};
+
+use super::npy_header::{Header, DataType};
+use super::labels::save_labels;
+use super::save::{write_block, write_block_labels, serialize_data, file_options};
+use super::DATA_ALIGNMENT;
+
+/// Names of all the Labels in a block and its gradients. This is used to
+/// check that all blocks given to a `TensorMapWriter` are compatible, without
+/// keeping the blocks themselves alive.
+#[derive(Debug, Clone, PartialEq, Eq)]
+struct BlockNames {
+    samples: Vec<String>,
+    components: Vec<Vec<String>>,
+    properties: Vec<String>,
+    gradients: BTreeMap<String, BlockNames>,
+}
+
+impl BlockNames {
+    fn new(block: &TensorBlock) -> BlockNames {
+        let to_owned = |names: Vec<&str>| names.into_iter().map(String::from).collect::<Vec<_>>();
+        BlockNames {
+            samples: to_owned(block.samples.names()),
+            components: block.components.iter().map(|c| to_owned(c.names())).collect(),
+            properties: to_owned(block.properties.names()),
+            gradients: block.gradients().iter()
+                .map(|(parameter, gradient)| (parameter.clone(), BlockNames::new(gradient)))
+                .collect(),
+        }
+    }
+}
+
+/// State of a block written in chunks of samples with
+/// [`TensorMapWriter::begin_block`]
+struct PartialBlock {
+    key: Vec<i32>,
+    /// total shape of the values, declared when starting the block
+    shape: Vec<usize>,
+    /// number of samples written so far
+    written: usize,
+    /// type of the data and labels of the first chunk, all other chunks must
+    /// match. The NPY header is written together with the first chunk.
+    first: Option<FirstChunk>,
+    /// samples of all the chunks written so far
+    samples: Option<LabelsBuilder>,
+}
+
+struct FirstChunk {
+    type_descriptor: DataType,
+    components: Vec<Arc<Labels>>,
+    properties: Arc<Labels>,
+    names: BlockNames,
+}
+
+/// `TensorMapWriter` writes a `TensorMap` to a file (or any other writer) one
+/// block at a time, without having to keep the full `TensorMap` in memory.
+///
+/// The blocks are written to the archive as soon as they are added, and the
+/// keys are written when calling [`TensorMapWriter::finish`]. The resulting
+/// file uses the same format as [`super::save`], and can be loaded with
+/// [`super::load`].
+///
+/// A single block can also be written in chunks of samples, with
+/// [`TensorMapWriter::begin_block`], [`TensorMapWriter::add_samples`] and
+/// [`TensorMapWriter::end_block`].
+///
+/// If writing to the archive fails, the archive is left in an invalid state
+/// and the writer can not be used anymore.
+pub struct TensorMapWriter<W: std::io::Write + std::io::Seek> {
+    /// `None` after `finish` has been called, or after a failed write
+    archive: Option<ZipWriter<W>>,
+    /// set if `archive` was removed after a failed write
+    failed: bool,
+    keys: LabelsBuilder,
+    /// names of the labels in the first block, all other blocks must match
+    reference: Option<BlockNames>,
+    /// block currently being written in chunks of samples
+    partial: Option<PartialBlock>,
+}
+
+impl<W: std::io::Write + std::io::Seek> TensorMapWriter<W> {
+    /// Create a new `TensorMapWriter` writing to `writer`, for a `TensorMap`
+    /// with the given keys names.
+    pub fn new(writer: W, keys_names: Vec<&str>) -> Result<TensorMapWriter<W>, Error> {
+        Ok(TensorMapWriter {
+            archive: Some(ZipWriter::new(writer)),
+            failed: false,
+            keys: LabelsBuilder::new(keys_names)?,
+            reference: None,
+            partial: None,
+        })
+    }
+
+    /// Write a single `block`, associated with the given `key`, to the
+    /// archive. The same rules as `TensorMap::new` apply to the blocks, i.e.
+    /// all blocks must have the same samples, components and properties names,
+    /// and the same set of gradients.
+    pub fn add_block(&mut self, key: &[i32], block: &TensorBlock) -> Result<(), Error> {
+        self.check_can_start_block(key)?;
+
+        let names = BlockNames::new(block);
+        self.check_names(&names)?;
+
+        let block_i = self.keys.count();
+        let archive = self.archive.as_mut().expect("archive should be available");
+        let result = write_block(archive, &format!("blocks/{}", block_i), true, block)
+            .and_then(|()| self.keys.add(key));
+        self.check_write(result)?;
+
+        self.reference.get_or_insert(names);
+
+        return Ok(());
+    }
+
+    /// Start writing a block associated with the given `key` in chunks of
+    /// samples. `shape` is the total shape of the values of this block, and
+    /// all the chunks added with [`TensorMapWriter::add_samples`] must
+    /// contain exactly `shape[0]` samples in total before calling
+    /// [`TensorMapWriter::end_block`].
+    ///
+    /// Blocks written this way can not contain gradients.
+    pub fn begin_block(&mut self, key: &[i32], shape: &[usize]) -> Result<(), Error> {
+        self.check_can_start_block(key)?;
+
+        if shape.len() < 2 {
+            return Err(Error::InvalidParameter(format!(
+                "invalid shape for a block: expected at least 2 dimensions, got {}",
+                shape.len()
+            )));
+        }
+
+        let block_i = self.keys.count();
+        let path = format!("blocks/{}/values.npy", block_i);
+        let archive = self.archive.as_mut().expect("archive should be available");
+        let result = archive.start_file_aligned(&path, file_options(), DATA_ALIGNMENT)
+            .map_err(|e| Error::from((path, e)));
+        self.check_write(result)?;
+
+        self.partial = Some(PartialBlock {
+            key: key.to_vec(),
+            shape: shape.to_vec(),
+            written: 0,
+            first: None,
+            samples: None,
+        });
+
+        return Ok(());
+    }
+
+    /// Write a `chunk` of samples for the block started with
+    /// [`TensorMapWriter::begin_block`]. The chunk must contain the next
+    /// samples of the block, with the components and properties of the
+    /// block, and no gradients.
+    pub fn add_samples(&mut self, chunk: &TensorBlock) -> Result<(), Error> {
+        self.archive()?;
+
+        if !chunk.gradients().is_empty() {
+            return Err(Error::InvalidParameter(
+                "blocks written in chunks of samples can not contain gradients".into()
+            ));
+        }
+
+        let names = BlockNames::new(chunk);
+        self.check_names(&names)?;
+
+        let partial = self.partial.as_mut().ok_or_else(|| Error::InvalidParameter(
+            "can not add samples to a TensorMapWriter before calling begin_block".into()
+        ))?;
+
+        let (header, data) = serialize_data(&chunk.values)?;
+        if header.shape[1..] != partial.shape[1..] {
+            return Err(Error::InvalidParameter(format!(
+                "invalid shape for the samples chunk: expected [N, {}], got {:?}",
+                partial.shape[1..].iter().map(ToString::to_string).collect::<Vec<_>>().join(", "),
+                header.shape
+            )));
+        }
+
+        let n_samples = header.shape[0];
+        if partial.written + n_samples > partial.shape[0] {
+            return Err(Error::InvalidParameter(format!(
+                "too many samples for this block: {} samples were declared in \
+                begin_block, but got {} samples", partial.shape[0], partial.written + n_samples
+            )));
+        }
+
+        let write_header = if let Some(ref first) = partial.first {
+            if header.type_descriptor != first.type_descriptor {
+                return Err(Error::InvalidParameter(format!(
+                    "all samples chunks must have the same data type: expected {}, got {}",
+                    first.type_descriptor, header.type_descriptor
+                )));
+            }
+
+            let same_labels = chunk.components[..] == first.components[..] && chunk.properties == first.properties;
+            if !same_labels || names != first.names {
+                return Err(Error::InvalidParameter(
+                    "all samples chunks must have the same sample names, and \
+                    the same components and properties".into()
+                ));
+            }
+
+            false
+        } else {
+            partial.samples = Some(LabelsBuilder::new(chunk.samples.names())?);
+            partial.first = Some(FirstChunk {
+                type_descriptor: header.type_descriptor.clone(),
+                components: chunk.components.to_vec(),
+                properties: Arc::clone(&chunk.properties),
+                names,
+            });
+
+            true
+        };
+
+        let header = if write_header {
+            Some(Header { shape: partial.shape.clone(), ..header })
+        } else {
+            None
+        };
+
+        let archive = self.archive.as_mut().expect("archive should be available");
+        let samples = partial.samples.as_mut().expect("samples should be set");
+        let result = write_chunk(archive, header, &data, samples, &chunk.samples);
+        partial.written += n_samples;
+
+        return self.check_write(result);
+    }
+
+    /// Finish writing the block started with [`TensorMapWriter::begin_block`],
+    /// writing the samples, components and properties of the block. This
+    /// fails if the chunks did not contain the number of samples declared in
+    /// `begin_block`.
+    pub fn end_block(&mut self) -> Result<(), Error> {
+        self.archive()?;
+        let partial = self.partial.as_ref().ok_or_else(|| Error::InvalidParameter(
+            "can not end a block in a TensorMapWriter before calling begin_block".into()
+        ))?;
+
+        if partial.first.is_none() {
+            return Err(Error::InvalidParameter(
+                "at least one samples chunk must be added with add_samples before \
+                calling end_block".into()
+            ));
+        }
+
+        if partial.written != partial.shape[0] {
+            return Err(Error::InvalidParameter(format!(
+                "missing samples for this block: {} samples were declared in \
+                begin_block, but only {} were added", partial.shape[0], partial.written
+            )));
+        }
+
+        let partial = self.partial.take().expect("partial block should be set");
+        let first = partial.first.expect("first chunk should be set");
+        let samples = partial.samples.expect("samples should be set").finish();
+
+        let block_i = self.keys.count();
+        let archive = self.archive.as_mut().expect("archive should be available");
+        let result = write_block_labels(
+            archive,
+            &format!("blocks/{}", block_i),
+            &samples,
+            &first.components,
+            Some(&first.properties),
+        ).and_then(|()| self.keys.add(&partial.key));
+        self.check_write(result)?;
+
+        self.reference.get_or_insert(first.names);
+
+        return Ok(());
+    }
+
+    /// Write the keys of all blocks added so far to the archive, and finish
+    /// writing the archive. No other blocks can be added after this.
+    pub fn finish(&mut self) -> Result<(), Error> {
+        self.archive()?;
+        if self.partial.is_some() {
+            return Err(Error::InvalidParameter(
+                "can not finish a TensorMapWriter while a block is being written \
+                in chunks, call end_block first".into()
+            ));
+        }
+
+        let mut archive = self.archive.take().expect("archive should be available");
+        let keys = std::mem::replace(
+            &mut self.keys,
+            LabelsBuilder::new(vec![]).expect("invalid empty labels builder")
+        ).finish();
+
+        let path = String::from("keys.npy");
+        let result = archive.start_file(&path, file_options())
+            .map_err(|e| Error::from((path, e)))
+            .and_then(|()| save_labels(&mut archive, &keys))
+            .and_then(|()| archive.finish().map_err(|e| Error::from((String::from("<root>"), e))));
+
+        if result.is_err() {
+            self.failed = true;
+        }
+
+        return result.map(|_| ());
+    }
+
+    /// Get the archive, or an error if `finish` was called or a previous
+    /// write failed
+    fn archive(&self) -> Result<&ZipWriter<W>, Error> {
+        self.archive.as_ref().ok_or_else(|| if self.failed {
+            Error::InvalidParameter(
+                "can not use this TensorMapWriter after a previous write failed".into()
+            )
+        } else {
+            Error::InvalidParameter(
+                "TensorMapWriter::finish has already been called".into()
+            )
+        })
+    }
+
+    /// Check that a new block associated with `key` can be started
+    fn check_can_start_block(&self, key: &[i32]) -> Result<(), Error> {
+        self.archive()?;
+
+        if self.partial.is_some() {
+            return Err(Error::InvalidParameter(
+                "can not add a new block to a TensorMapWriter while another \
+                block is being written in chunks, call end_block first".into()
+            ));
+        }
+
+        if key.len() != self.keys.size() {
+            return Err(Error::InvalidParameter(format!(
+                "invalid key size: expected {} values, got {}",
+                self.keys.size(), key.len()
+            )));
+        }
+
+        return Ok(());
+    }
+
+    /// Check that a block with the given `names` is compatible with the
+    /// blocks already written
+    fn check_names(&self, names: &BlockNames) -> Result<(), Error> {
+        if let Some(ref reference) = self.reference {
+            if names != reference {
+                return Err(Error::InvalidParameter(
+                    "all blocks must have the same sample, component and property \
+                    names, and the same set of gradients as the first block \
+                    added to this TensorMapWriter".into()
+                ));
+            }
+        }
+        return Ok(());
+    }
+
+    /// Check the `result` of writing to the archive, marking the writer as
+    /// failed if needed. The archive is left in an invalid state after a
+    /// failed write, so it is not used anymore.
+    fn check_write<T>(&mut self, result: Result<T, Error>) -> Result<T, Error> {
+        if result.is_err() {
+            self.archive = None;
+            self.partial = None;
+            self.failed = true;
+        }
+        return result;
+    }
+}
+
+/// Write the data of a chunk of samples (preceded by the NPY `header` for the
+/// first chunk) to the `archive`, and add the `chunk_samples` to `samples`.
+fn write_chunk<W: std::io::Write>(
+    archive: &mut W,
+    header: Option<Header>,
+    data: &[u8],
+    samples: &mut LabelsBuilder,
+    chunk_samples: &Labels,
+) -> Result<(), Error> {
+    if let Some(header) = header {
+        header.write(&mut *archive)?;
+    }
+
+    archive.write_all(data)?;
+
+    samples.reserve(chunk_samples.count());
+    for sample in chunk_samples {
+        samples.add(sample)?;
+    }
+
+    return Ok(());
+}
@@ -1,16 +1,22 @@
 #![allow(clippy::default_trait_access, clippy::module_name_repetitions)]
-use std::sync::RwLock;
+use std::sync::{Arc, Mutex, RwLock, Weak};
+use std::sync::atomic::{AtomicBool, Ordering as AtomicOrdering};
 use std::ffi::CString;
 use std::collections::BTreeSet;
 use std::os::raw::c_void;
+use std::hash::{Hash, Hasher};
+use std::cmp::Ordering;
 
 use hashbrown::HashMap;
 use hashbrown::hash_map::RawEntryMut;
 
+use once_cell::sync::{Lazy, OnceCell};
+
 use smallvec::SmallVec;
 
 use crate::Error;
 use crate::utils::ConstCString;
+use crate::memory::{LabelsMemoryUsage, hash_table_memory_usage};
 
 /// A single value inside a label. This is represented as a 32-bit signed
 /// integer, with a couple of helper function to get its value as usize/isize.
@@ -98,12 +104,81 @@ impl LabelValue {
 
 type DefaultHasher = std::hash::BuildHasherDefault<ahash::AHasher>;
 
+/// Hash table storing the row index of all entries in a set of labels. The
+/// entries themselves are not stored in the table, the hash is computed from
+/// the corresponding row in the values array with `hash_entry`.
+type PositionsIndex = HashMap<usize, (), DefaultHasher>;
+
+/// Compute the hash used for `entry` in `PositionsIndex`
+fn hash_entry(entry: &[LabelValue]) -> u64 {
+    let mut hasher = ahash::AHasher::default();
+    entry.hash(&mut hasher);
+    return hasher.finish();
+}
+
+/// Get the row at index `i` in the linearized 2D array `values`, containing
+/// `size` columns.
+fn entry(values: &[LabelValue], size: usize, i: usize) -> &[LabelValue] {
+    &values[(i * size)..((i + 1) * size)]
+}
+
+/// Find `value` in the linearized 2D array `values` with `size` columns, using
+/// a binary search. All the rows in `values` must be sorted in strictly
+/// increasing lexicographic order.
+///
+/// This returns `Ok(position)` if the value is found, and `Err(position)` with
+/// the position where it could be inserted otherwise.
+fn sorted_position(values: &[LabelValue], size: usize, value: &[LabelValue]) -> Result<usize, usize> {
+    let mut low = 0;
+    let mut high = values.len() / size;
+    while low < high {
+        let middle = low + (high - low) / 2;
+        match entry(values, size, middle).cmp(value) {
+            Ordering::Less => low = middle + 1,
+            Ordering::Greater => high = middle,
+            Ordering::Equal => return Ok(middle),
+        }
+    }
+    return Err(low);
+}
+
+/// Find `value` in `index`, returning its position if it exists
+fn hashed_position(index: &PositionsIndex, values: &[LabelValue], size: usize, value: &[LabelValue]) -> Option<usize> {
+    index.raw_entry()
+        .from_hash(hash_entry(value), |&i| entry(values, size, i) == value)
+        .map(|(&i, _)| i)
+}
+
+/// Build the `PositionsIndex` for all the rows in the linearized 2D array
+/// `values` with `size` columns, with space for at least `capacity` entries.
+/// All the rows must be unique.
+fn build_positions_index(values: &[LabelValue], size: usize, capacity: usize) -> PositionsIndex {
+    let count = values.len() / size;
+    // reserving is fine here since the table is still empty, growing a table
+    // with entries would hash them again with `DefaultHasher`
+    let mut index = PositionsIndex::default();
+    index.reserve(usize::max(count, capacity));
+    for i in 0..count {
+        let hash = hash_entry(entry(values, size, i));
+        // all rows are unique, so there is no need to compare them
+        match index.raw_entry_mut().from_hash(hash, |_| false) {
+            RawEntryMut::Vacant(vacant) => {
+                vacant.insert_with_hasher(hash, i, (), |&i| hash_entry(entry(values, size, i)));
+            }
+            RawEntryMut::Occupied(_) => unreachable!(),
+        }
+    }
+    return index;
+}
+
 /// Builder for `Labels`, this should be used to construct `Labels`.
 pub struct LabelsBuilder {
     // cf `Labels` for the documentation of the fields
     names: Vec<ConstCString>,
     values: Vec<LabelValue>,
-    positions: HashMap<SmallVec<[LabelValue; 4]>, usize, DefaultHasher>,
+    sorted: bool,
+    /// This is only filled when the entries are not sorted
+    positions: PositionsIndex,
 }
 
 impl LabelsBuilder {
@@ -133,6 +208,7 @@ impl LabelsBuilder {
         Ok(LabelsBuilder {
             names: names,
             values: Vec::new(),
+            sorted: true,
             positions: Default::default(),
         })
     }
@@ -140,7 +216,13 @@ impl LabelsBuilder {
     /// Reserve space for `additional` other entries in the labels.
     pub fn reserve(&mut self, additional: usize) {
         self.values.reserve(additional * self.names.len());
-        self.positions.reserve(additional);
+        if !self.sorted && self.positions.capacity() - self.positions.len() < additional {
+            // `HashMap::reserve` would re-hash the existing entries with
+            // `DefaultHasher` instead of `hash_entry`, so we re-build the
+            // whole index with the new capacity instead
+            let capacity = self.positions.len() + additional;
+            self.positions = build_positions_index(&self.values, self.size(), capacity);
+        }
     }
 
     /// Get the number of labels in a single value
@@ -164,10 +246,10 @@ impl LabelsBuilder {
     pub fn add<T>(&mut self, entry: &[T]) -> Result<(), Error>
         where T: Copy + Into<LabelValue>
     {
-        let entry = entry.iter().copied().map(Into::into).collect::<SmallVec<_>>();
-        match self.add_or_get_position(entry) {
+        let entry = entry.iter().copied().map(Into::into).collect::<SmallVec<[LabelValue; 4]>>();
+        match self.add_or_get_position(&entry) {
             Ok(_) => return Ok(()),
-            Err((existing, entry)) => {
+            Err(existing) => {
                 let values_display = entry.iter().map(|v| v.to_string()).collect::<Vec<_>>().join(", ");
                 return Err(Error::InvalidParameter(format!(
                     "can not have the same label value multiple time: [{}] is already present at position {}",
@@ -177,24 +259,50 @@ impl LabelsBuilder {
         }
     }
 
-    fn add_or_get_position(&mut self, labels_entry: SmallVec<[LabelValue; 4]>) -> Result<usize, (usize, SmallVec<[LabelValue; 4]>)> {
+    /// Add `labels_entry` to this builder and return its position, or return
+    /// the position of the existing entry as an error if it was already
+    /// added.
+    ///
+    /// As long as the entries are added in strictly increasing lexicographic
+    /// order, they are guaranteed to be unique and no hash table is needed.
+    /// The hash table is only created on the first entry added out of order.
+    fn add_or_get_position(&mut self, labels_entry: &[LabelValue]) -> Result<usize, usize> {
         assert_eq!(
             self.size(), labels_entry.len(),
             "wrong size for added label: got {}, but expected {}",
             labels_entry.len(), self.size()
         );
 
-        let new_position = self.positions.len();
+        let new_position = self.count();
+        let size = self.size();
+
+        if self.sorted {
+            if new_position == 0 || entry(&self.values, size, new_position - 1) < labels_entry {
+                self.values.extend_from_slice(labels_entry);
+                return Ok(new_position);
+            }
+
+            if let Ok(existing) = sorted_position(&self.values, size, labels_entry) {
+                return Err(existing);
+            }
+
+            // this entry is not sorted, switch to using the hash table
+            self.sorted = false;
+            let capacity = self.values.capacity() / size;
+            self.positions = build_positions_index(&self.values, size, capacity);
+        }
 
-        match self.positions.raw_entry_mut().from_key(&labels_entry) {
-            RawEntryMut::Occupied(entry) => {
-                return Err((*entry.get(), labels_entry));
+        let hash = hash_entry(labels_entry);
+        let values = &self.values;
+        match self.positions.raw_entry_mut().from_hash(hash, |&i| entry(values, size, i) == labels_entry) {
+            RawEntryMut::Occupied(occupied) => {
+                return Err(*occupied.key());
             },
-            RawEntryMut::Vacant(entry) => {
-                self.values.extend(&labels_entry);
-                entry.insert(labels_entry, new_position);
+            RawEntryMut::Vacant(vacant) => {
+                vacant.insert_with_hasher(hash, new_position, (), |&i| hash_entry(entry(values, size, i)));
             }
         }
+        self.values.extend_from_slice(labels_entry);
 
         return Ok(new_position);
     }
@@ -206,16 +314,26 @@ impl LabelsBuilder {
             return Labels {
                 names: Vec::new(),
                 values: Vec::new(),
-                positions: Default::default(),
+                sorted: true,
+                positions: OnceCell::new(),
                 user_data: RwLock::new(UserData::null()),
+                interned: AtomicBool::new(false),
             }
         }
 
+        let positions = if self.sorted {
+            OnceCell::new()
+        } else {
+            OnceCell::with_value(self.positions)
+        };
+
         return Labels {
             names: self.names,
             values: self.values,
-            positions: self.positions,
+            sorted: self.sorted,
+            positions: positions,
             user_data: RwLock::new(UserData::null()),
+            interned: AtomicBool::new(false),
         };
     }
 }
@@ -284,19 +402,27 @@ pub struct Labels {
     names: Vec<ConstCString>,
     /// Values of the labels, as a linearized 2D array in row-major order
     values: Vec<LabelValue>,
+    /// Are the entries sorted in strictly increasing lexicographic order? If
+    /// this is the case, the position of entries is found with a binary
+    /// search, and `positions` is never used.
+    sorted: bool,
     /// Store the position of all the known labels, for faster access later.
-    /// This uses `XxHash64` instead of the default hasher in std since
-    /// `XxHash64` is much faster and we don't need the cryptographic strength
-    /// hash from std.
-    positions: HashMap<SmallVec<[LabelValue; 4]>, usize, DefaultHasher>,
+    /// This is only used when the entries are not sorted, and created on first
+    /// use if needed. This uses `AHasher` instead of the default hasher in std
+    /// since `AHasher` is much faster and we don't need the cryptographic
+    /// strength hash from std.
+    positions: OnceCell<PositionsIndex>,
     /// Some data provided by the user that we should keep around (this is
     /// used to store a pointer to the on-GPU tensor in metatensor-torch).
     user_data: RwLock<UserData>,
+    /// Were these labels interned with `intern_labels`? Interned labels can
+    /// be shared between unrelated blocks, and can not have user data.
+    interned: AtomicBool,
 }
 
 impl PartialEq for Labels {
     fn eq(&self, other: &Self) -> bool {
-        self.names == other.names && self.values == other.values
+        std::ptr::eq(self, other) || (self.names == other.names && self.values == other.values)
     }
 }
 
@@ -323,6 +449,73 @@ impl std::fmt::Debug for Labels {
 }
 
 impl Labels {
+    /// Create new `Labels` with the given `names` and `values`, assuming all
+    /// the entries in `values` are unique. `values` is a linearized 2D array
+    /// in row-major order, with `names.len()` columns.
+    ///
+    /// This skips the check for duplicated entries done by `LabelsBuilder`,
+    /// only going once over the entries to check if they are sorted. The index
+    /// used to find the position of entries in unsorted labels is created on
+    /// first use. If the entries are not actually unique, `Labels::position`
+    /// can return the position of any of the duplicated entries.
+    pub fn new_assume_unique(names: Vec<&str>, values: Vec<LabelValue>) -> Result<Labels, Error> {
+        // use the builder to validate the names
+        let builder = LabelsBuilder::new(names)?;
+        let size = builder.size();
+
+        if size == 0 {
+            if !values.is_empty() {
+                return Err(Error::InvalidParameter(
+                    "can not have values in Labels without any dimension".into()
+                ));
+            }
+            return Ok(builder.finish());
+        }
+
+        if values.len() % size != 0 {
+            return Err(Error::InvalidParameter(format!(
+                "the number of values ({}) is not a multiple of the number of \
+                dimensions ({}) in Labels", values.len(), size
+            )));
+        }
+
+        let count = values.len() / size;
+        let sorted = (1..count).all(|i| entry(&values, size, i - 1) < entry(&values, size, i));
+
+        return Ok(Labels {
+            names: builder.names,
+            values: values,
+            sorted: sorted,
+            positions: OnceCell::new(),
+            user_data: RwLock::new(UserData::null()),
+            interned: AtomicBool::new(false),
+        });
+    }
+
+    /// Create new `Labels` containing the entries in `range` of these Labels,
+    /// with the same names.
+    ///
+    /// The entries of `self` are already unique, so this does not check for
+    /// duplicated entries. If `self` is sorted, the new labels are also known
+    /// to be sorted without checking the entries.
+    pub fn slice(&self, range: std::ops::Range<usize>) -> Labels {
+        assert!(range.start <= range.end && range.end <= self.count(), "invalid range in Labels::slice");
+
+        let size = self.size();
+        let values = self.values[(range.start * size)..(range.end * size)].to_vec();
+        let count = range.end - range.start;
+        let sorted = self.sorted || (1..count).all(|i| entry(&values, size, i - 1) < entry(&values, size, i));
+
+        return Labels {
+            names: self.names.clone(),
+            values: values,
+            sorted: sorted,
+            positions: OnceCell::new(),
+            user_data: RwLock::new(UserData::null()),
+            interned: AtomicBool::new(false),
+        };
+    }
+
     /// Get the number of entries/named values in a single label
     pub fn size(&self) -> usize {
         self.names.len()
@@ -353,16 +546,35 @@ impl Labels {
     ///
     /// Any existing user data will be released (by calling the provided
     /// `user_data_delete` function) before overwriting with the new data.
+    ///
+    /// This fails if these labels were interned, since they can then be
+    /// shared with other blocks and tensors.
     pub fn set_user_data(
         &self,
         user_data: *mut c_void,
         user_data_delete: Option<unsafe extern fn(*mut c_void)>,
-    ) {
+    ) -> Result<(), Error> {
         let mut guard = self.user_data.write().expect("poisoned lock");
+        if self.interned.load(AtomicOrdering::Acquire) {
+            return Err(Error::InvalidParameter(
+                "can not set user data on these labels: they are stored inside a \
+                block and might be shared with other blocks, create new labels \
+                with the same entries instead".into()
+            ));
+        }
+
         *guard = UserData {
             ptr: user_data,
             delete: user_data_delete,
         };
+
+        Ok(())
+    }
+
+    /// Get the values of all entries in these labels, as a linearized 2D array
+    /// in row-major order
+    pub fn raw_values(&self) -> &[LabelValue] {
+        &self.values
     }
 
     /// Get the total number of entries in this set of labels
@@ -379,9 +591,19 @@ impl Labels {
         self.count() == 0
     }
 
+    /// Check if the entries in this set of Labels are sorted in strictly
+    /// increasing lexicographic order
+    pub fn is_sorted(&self) -> bool {
+        self.sorted
+    }
+
     /// Check whether the given `label` is part of this set of labels
     pub fn contains(&self, label: &[LabelValue]) -> bool {
-        self.positions.contains_key(label)
+        if label.len() != self.size() {
+            return false;
+        }
+
+        self.position(label).is_some()
     }
 
     /// Get the position (i.e. row index) of the given label in the full labels
@@ -389,7 +611,39 @@ impl Labels {
     pub fn position(&self, value: &[LabelValue]) -> Option<usize> {
         assert!(value.len() == self.size(), "invalid size of index in Labels::position");
 
-        self.positions.get(value).copied()
+        if self.is_empty() {
+            return None;
+        }
+
+        if self.sorted {
+            return sorted_position(&self.values, self.size(), value).ok();
+        }
+
+        let positions = self.positions_index();
+        return hashed_position(positions, &self.values, self.size(), value);
+    }
+
+    /// Get the hash table containing the positions of all entries, creating
+    /// it if needed. This should only be used for unsorted labels.
+    fn positions_index(&self) -> &PositionsIndex {
+        debug_assert!(!self.sorted);
+        self.positions.get_or_init(|| build_positions_index(&self.values, self.size(), 0))
+    }
+
+    /// Get the memory used by these labels. The positions hash table is only
+    /// counted if it was already created.
+    pub fn memory_usage(&self) -> LabelsMemoryUsage {
+        let positions = self.positions.get().map_or(0, |positions| {
+            hash_table_memory_usage(positions.capacity(), std::mem::size_of::<usize>())
+        });
+
+        let names = self.names.iter().map(|name| name.as_c_str().to_bytes_with_nul().len()).sum::<usize>();
+
+        LabelsMemoryUsage {
+            values: self.values.capacity() * std::mem::size_of::<LabelValue>(),
+            positions: positions,
+            metadata: std::mem::size_of::<Labels>() + self.names.capacity() * std::mem::size_of::<ConstCString>() + names,
+        }
     }
 
     /// Iterate over the entries in this set of labels
@@ -412,10 +666,17 @@ impl Labels {
             ));
         }
 
+        let positions = if self.sorted {
+            PositionsIndex::default()
+        } else {
+            self.positions_index().clone()
+        };
+
         let mut builder = LabelsBuilder {
             names: self.names.clone(),
             values: self.values.clone(),
-            positions: self.positions.clone(),
+            sorted: self.sorted,
+            positions: positions,
         };
 
         if !first_mapping.is_empty() {
@@ -427,13 +688,12 @@ impl Labels {
         }
 
         for (i, entry) in other.iter().enumerate() {
-            let entry = entry.iter().copied().map(Into::into).collect::<SmallVec<_>>();
             let position = builder.add_or_get_position(entry);
 
             if !second_mapping.is_empty() {
                 let index = match position {
                     #[allow(clippy::cast_possible_wrap)]
-                    Ok(index) | Err((index, _)) => {
+                    Ok(index) | Err(index) => {
                         index as i64
                     }
                 };
@@ -530,6 +790,116 @@ impl std::ops::Index<usize> for Labels {
     }
 }
 
+/// All the interned `Labels` which might still be alive, indexed by a hash
+/// of their names and values. The table is split in multiple shards selected
+/// by the hash, each with its own lock, so that blocks can be created in
+/// parallel without all waiting on the same lock.
+static INTERNED_LABELS: Lazy<Vec<Mutex<InternedLabels>>> = Lazy::new(|| {
+    (0..INTERNED_LABELS_SHARDS).map(|_| Mutex::new(InternedLabels {
+        entries: HashMap::new(),
+        count: 0,
+        next_cleanup: INTERNED_LABELS_MIN_CLEANUP,
+    })).collect()
+});
+
+/// Number of shards in `INTERNED_LABELS`
+const INTERNED_LABELS_SHARDS: usize = 32;
+
+/// Minimal number of entries in a shard of `INTERNED_LABELS` before removing
+/// the entries corresponding to dropped `Labels`
+const INTERNED_LABELS_MIN_CLEANUP: usize = 128;
+
+struct InternedLabels {
+    entries: HashMap<u64, Vec<Weak<Labels>>>,
+    /// total number of weak references in `entries`
+    count: usize,
+    /// remove dropped `Labels` from `entries` once `count` reaches this value
+    next_cleanup: usize,
+}
+
+impl InternedLabels {
+    fn insert(&mut self, hash: u64, labels: &Arc<Labels>) {
+        if self.count >= self.next_cleanup {
+            self.entries.retain(|_, bucket| {
+                bucket.retain(|weak| weak.strong_count() != 0);
+                !bucket.is_empty()
+            });
+            self.count = self.entries.values().map(Vec::len).sum();
+            self.next_cleanup = usize::max(2 * self.count, INTERNED_LABELS_MIN_CLEANUP);
+        }
+
+        self.entries.entry(hash).or_default().push(Arc::downgrade(labels));
+        self.count += 1;
+    }
+}
+
+/// Hash the names and values of `labels`, to be used for interning
+fn interning_hash(labels: &Labels) -> u64 {
+    let mut hasher = ahash::AHasher::default();
+    for name in labels.names() {
+        name.hash(&mut hasher);
+    }
+
+    // SAFETY: LabelValue is a transparent wrapper around i32, and any i32
+    // can be interpreted as bytes
+    let bytes = unsafe {
+        std::slice::from_raw_parts(
+            labels.values.as_ptr().cast::<u8>(),
+            labels.values.len() * std::mem::size_of::<LabelValue>(),
+        )
+    };
+    hasher.write(bytes);
+
+    return hasher.finish();
+}
+
+/// Get a single shared instance of `labels`, re-using previously interned
+/// `Labels` with the same names and values if there are any still alive.
+/// Otherwise, `labels` are interned and returned as-is.
+///
+/// Interning the `Labels` stored inside blocks means that identical `Labels`
+/// (e.g. the properties of all the blocks after loading a file) share the
+/// same memory, and that comparing them is a simple pointer check.
+///
+/// `Labels` with user data are never interned, since the user data is
+/// associated with a specific instance of `Labels` (e.g. the values stored on
+/// a GPU by metatensor-torch). Once interned, `Labels` can not get user data
+/// with `Labels::set_user_data`.
+pub fn intern_labels(labels: Arc<Labels>) -> Arc<Labels> {
+    // these labels are already shared, no need to hash them again
+    if labels.interned.load(AtomicOrdering::Acquire) {
+        return labels;
+    }
+
+    // keep the lock on user data until the labels are marked as interned, to
+    // prevent `set_user_data` from running concurrently
+    let user_data = labels.user_data.read().expect("poisoned lock");
+    if !user_data.ptr.is_null() {
+        std::mem::drop(user_data);
+        return labels;
+    }
+
+    let hash = interning_hash(&labels);
+    let shard = (hash as usize) % INTERNED_LABELS_SHARDS;
+
+    let mut interned = INTERNED_LABELS[shard].lock().expect("poisoned lock");
+    if let Some(bucket) = interned.entries.get(&hash) {
+        for existing in bucket.iter().filter_map(Weak::upgrade) {
+            if *existing == *labels {
+                std::mem::drop(user_data);
+                return existing;
+            }
+        }
+    }
+
+    interned.insert(hash, &labels);
+    labels.interned.store(true, AtomicOrdering::Release);
+    std::mem::drop(interned);
+    std::mem::drop(user_data);
+
+    return labels;
+}
+
 #[cfg(test)]
 mod tests {
     use super::*;
@@ -543,6 +913,124 @@ mod tests {
         assert_eq!(e.to_string(), "invalid parameter: labels names must be unique, got 'not' multiple times");
     }
 
+    #[test]
+    fn positions() {
+        // sorted labels use a binary search
+        let mut builder = LabelsBuilder::new(vec!["aa", "bb"]).unwrap();
+        builder.add(&[0, 1]).unwrap();
+        builder.add(&[0, 3]).unwrap();
+        builder.add(&[2, -1]).unwrap();
+        builder.add(&[4, 5]).unwrap();
+        let err = builder.add(&[0, 3]).unwrap_err();
+        assert_eq!(
+            err.to_string(),
+            "invalid parameter: can not have the same label value multiple time: [0, 3] is already present at position 1"
+        );
+        let labels = builder.finish();
+
+        assert!(labels.is_sorted());
+        assert!(labels.positions.get().is_none());
+        assert_eq!(labels.position(&[LabelValue(0), LabelValue(3)]), Some(1));
+        assert_eq!(labels.position(&[LabelValue(4), LabelValue(5)]), Some(3));
+        assert_eq!(labels.position(&[LabelValue(1), LabelValue(0)]), None);
+        assert_eq!(labels.position(&[LabelValue(5), LabelValue(0)]), None);
+        assert!(labels.contains(&[LabelValue(2), LabelValue(-1)]));
+        assert!(!labels.contains(&[LabelValue(2)]));
+
+        // unsorted labels switch to a hash table
+        let mut builder = LabelsBuilder::new(vec!["aa", "bb"]).unwrap();
+        builder.add(&[0, 1]).unwrap();
+        builder.add(&[2, 3]).unwrap();
+        builder.add(&[1, 1]).unwrap();
+        let err = builder.add(&[2, 3]).unwrap_err();
+        assert_eq!(
+            err.to_string(),
+            "invalid parameter: can not have the same label value multiple time: [2, 3] is already present at position 1"
+        );
+        builder.add(&[-1, 1]).unwrap();
+        let labels = builder.finish();
+
+        assert!(!labels.is_sorted());
+        assert_eq!(labels.position(&[LabelValue(0), LabelValue(1)]), Some(0));
+        assert_eq!(labels.position(&[LabelValue(1), LabelValue(1)]), Some(2));
+        assert_eq!(labels.position(&[LabelValue(-1), LabelValue(1)]), Some(3));
+        assert_eq!(labels.position(&[LabelValue(1), LabelValue(2)]), None);
+
+        // reserving space with the hash table keeps the existing entries
+        let mut builder = LabelsBuilder::new(vec!["aa", "bb"]).unwrap();
+        builder.add(&[2, 3]).unwrap();
+        builder.add(&[0, 1]).unwrap();
+        builder.reserve(1000);
+        assert!(builder.add(&[2, 3]).is_err());
+        for i in 0..1000 {
+            builder.add(&[i, 42]).unwrap();
+        }
+        assert!(builder.add(&[0, 1]).is_err());
+        let labels = builder.finish();
+        assert_eq!(labels.position(&[LabelValue(0), LabelValue(1)]), Some(1));
+        assert_eq!(labels.position(&[LabelValue(999), LabelValue(42)]), Some(1001));
+
+        let empty = LabelsBuilder::new(vec!["aa"]).unwrap().finish();
+        assert_eq!(empty.position(&[LabelValue(0)]), None);
+    }
+
+    #[test]
+    fn assume_unique() {
+        let values = [0, 1, 0, 3, 2, -1].iter().copied().map(LabelValue::new).collect();
+        let labels = Labels::new_assume_unique(vec!["aa", "bb"], values).unwrap();
+        assert!(labels.is_sorted());
+        assert_eq!(labels.count(), 3);
+        assert_eq!(labels.position(&[LabelValue(2), LabelValue(-1)]), Some(2));
+
+        let values = [0, 1, 2, 3, 1, 1].iter().copied().map(LabelValue::new).collect();
+        let labels = Labels::new_assume_unique(vec!["aa", "bb"], values).unwrap();
+        assert!(!labels.is_sorted());
+        assert!(labels.positions.get().is_none());
+        assert_eq!(labels.position(&[LabelValue(1), LabelValue(1)]), Some(2));
+        assert_eq!(labels.position(&[LabelValue(1), LabelValue(2)]), None);
+
+        let mut builder = LabelsBuilder::new(vec!["aa", "bb"]).unwrap();
+        builder.add(&[0, 1]).unwrap();
+        builder.add(&[2, 3]).unwrap();
+        builder.add(&[1, 1]).unwrap();
+        assert_eq!(labels, builder.finish());
+
+        let values = [0, 1, 2].iter().copied().map(LabelValue::new).collect();
+        let err = Labels::new_assume_unique(vec!["aa", "bb"], values).unwrap_err();
+        assert_eq!(
+            err.to_string(),
+            "invalid parameter: the number of values (3) is not a multiple of the number of dimensions (2) in Labels"
+        );
+
+        let err = Labels::new_assume_unique(vec!["aa", "aa"], Vec::new()).unwrap_err();
+        assert_eq!(
+            err.to_string(),
+            "invalid parameter: labels names must be unique, got 'aa' multiple times"
+        );
+    }
+
+    #[test]
+    fn slice() {
+        let values = [0, 1, 2, 3, 1, 1, 1, 2].iter().copied().map(LabelValue::new).collect();
+        let labels = Labels::new_assume_unique(vec!["aa", "bb"], values).unwrap();
+        assert!(!labels.is_sorted());
+
+        let slice = labels.slice(1..3);
+        assert_eq!(slice.names(), ["aa", "bb"]);
+        assert_eq!(slice.count(), 2);
+        assert!(!slice.is_sorted());
+        assert_eq!(slice.position(&[LabelValue(1), LabelValue(1)]), Some(1));
+        assert_eq!(slice.position(&[LabelValue(0), LabelValue(1)]), None);
+
+        let slice = labels.slice(2..4);
+        assert!(slice.is_sorted());
+        assert_eq!(slice.position(&[LabelValue(1), LabelValue(2)]), Some(1));
+
+        let slice = labels.slice(2..2);
+        assert!(slice.is_empty());
+        assert_eq!(slice.size(), 2);
+    }
+
     #[test]
     fn union() {
         let mut builder = LabelsBuilder::new(vec!["aa", "bb"]).unwrap();
@@ -643,6 +1131,50 @@ mod tests {
         assert_eq!(second_mapping, &[]);
     }
 
+    #[test]
+    fn interning() {
+        let create = |values: &[[i32; 2]]| {
+            let mut builder = LabelsBuilder::new(vec!["interning_a", "interning_b"]).unwrap();
+            for entry in values {
+                builder.add(entry).unwrap();
+            }
+            Arc::new(builder.finish())
+        };
+
+        let first = intern_labels(create(&[[0, 1], [1, 2]]));
+        let second = intern_labels(create(&[[0, 1], [1, 2]]));
+        assert!(Arc::ptr_eq(&first, &second));
+
+        let other = intern_labels(create(&[[0, 1], [1, 3]]));
+        assert!(!Arc::ptr_eq(&first, &other));
+
+        // interning the same instance again returns it
+        let again = intern_labels(Arc::clone(&other));
+        assert!(Arc::ptr_eq(&again, &other));
+
+        // labels with user data are never shared
+        let with_user_data = create(&[[0, 1], [1, 2]]);
+        with_user_data.set_user_data(std::ptr::NonNull::dangling().as_ptr(), None).unwrap();
+        let interned = intern_labels(Arc::clone(&with_user_data));
+        assert!(Arc::ptr_eq(&interned, &with_user_data));
+        assert!(!Arc::ptr_eq(&interned, &first));
+
+        // and interned labels can not get user data
+        let error = first.set_user_data(std::ptr::NonNull::dangling().as_ptr(), None).unwrap_err();
+        assert_eq!(
+            error.to_string(),
+            "invalid parameter: can not set user data on these labels: they are \
+            stored inside a block and might be shared with other blocks, create \
+            new labels with the same entries instead"
+        );
+        assert!(first.user_data().is_null());
+
+        // once all the instances are dropped, new labels are interned again
+        std::mem::drop((other, again));
+        let new = intern_labels(create(&[[0, 1], [1, 3]]));
+        assert_eq!(Arc::strong_count(&new), 1);
+    }
+
     #[test]
     fn marker_traits() {
         // ensure Arc<Labels> is Send and Sync, assuming the user data is
@@ -24,6 +24,9 @@ use self::blocks::TensorBlock;
 mod tensor;
 use self::tensor::TensorMap;
 
+mod memory;
+use self::memory::{mts_memory_usage_t, MemoryUsageTracker};
+
 #[doc(hidden)]
 mod c_api;
 use c_api::mts_status_t;
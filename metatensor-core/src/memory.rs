@@ -0,0 +1,158 @@
+use std::collections::HashSet;
+
+use crate::{Labels, Error};
+use crate::data::mts_array_t;
+
+/// Memory used by some metatensor data structure, broken down by category.
+///
+/// All sizes are given in bytes. `Labels` shared between multiple blocks or
+/// gradients (for example the properties of a gradient, which are always the
+/// same as the properties of the corresponding block) are only counted once.
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+#[allow(non_camel_case_types)]
+pub struct mts_memory_usage_t {
+    /// Memory used by the values arrays of the blocks. This assumes that the
+    /// arrays contain 64-bit floating point values, since `mts_array_t` does
+    /// not give a way to query the data type without accessing the data.
+    pub values: usize,
+    /// Memory used by the values arrays of the gradients, with the same
+    /// caveat as `values` regarding the data type.
+    pub gradients_values: usize,
+    /// Memory used by the entries of `Labels`, i.e. keys, samples, components
+    /// and properties of the blocks
+    pub labels_values: usize,
+    /// Memory used by the hash maps used to find the position of entries in
+    /// `Labels`, and to find the blocks matching a selection in `TensorMap`
+    pub labels_positions: usize,
+    /// Memory used by `Labels` only used by gradients (both the entries and
+    /// the hash maps), and which are not counted in `labels_values` and
+    /// `labels_positions`
+    pub gradients_metadata: usize,
+    /// Memory used by everything else: labels names, gradient parameters
+    /// names and the fixed size part of the data structures
+    pub metadata: usize,
+}
+
+/// Memory used by a single set of `Labels`
+pub struct LabelsMemoryUsage {
+    /// Memory used by the entries
+    pub values: usize,
+    /// Memory used by the positions hash map
+    pub positions: usize,
+    /// Memory used by the names and internal data structures
+    pub metadata: usize,
+}
+
+/// Accumulate the memory usage of multiple data structures, counting shared
+/// `Labels` only once.
+pub struct MemoryUsageTracker {
+    usage: mts_memory_usage_t,
+    seen_labels: HashSet<*const Labels>,
+}
+
+impl MemoryUsageTracker {
+    /// Create a new empty `MemoryUsageTracker`
+    pub fn new() -> MemoryUsageTracker {
+        MemoryUsageTracker {
+            usage: mts_memory_usage_t::default(),
+            seen_labels: HashSet::new(),
+        }
+    }
+
+    /// Get the accumulated memory usage
+    pub fn finish(self) -> mts_memory_usage_t {
+        self.usage
+    }
+
+    /// Add the memory used by `labels`, if they were not already added.
+    pub fn add_labels(&mut self, labels: &Labels) {
+        if self.seen_labels.insert(labels as *const Labels) {
+            let labels_usage = labels.memory_usage();
+            self.usage.labels_values += labels_usage.values;
+            self.usage.labels_positions += labels_usage.positions;
+            self.usage.metadata += labels_usage.metadata;
+        }
+    }
+
+    /// Add the memory used by `labels`, used by a gradient, if they were not
+    /// already added.
+    pub fn add_gradient_labels(&mut self, labels: &Labels) {
+        if self.seen_labels.insert(labels as *const Labels) {
+            let labels_usage = labels.memory_usage();
+            self.usage.gradients_metadata += labels_usage.values + labels_usage.positions;
+            self.usage.metadata += labels_usage.metadata;
+        }
+    }
+
+    /// Add the memory used by the values of a block
+    pub fn add_values(&mut self, array: &mts_array_t) -> Result<(), Error> {
+        self.usage.values += array_memory_usage(array)?;
+        Ok(())
+    }
+
+    /// Add the memory used by the values of a gradient
+    pub fn add_gradient_values(&mut self, array: &mts_array_t) -> Result<(), Error> {
+        self.usage.gradients_values += array_memory_usage(array)?;
+        Ok(())
+    }
+
+    /// Add memory used by hash maps used to lookup data
+    pub fn add_positions(&mut self, size: usize) {
+        self.usage.labels_positions += size;
+    }
+
+    /// Add memory used by other metadata
+    pub fn add_metadata(&mut self, size: usize) {
+        self.usage.metadata += size;
+    }
+}
+
+/// Get the memory used by the data of an array
+fn array_memory_usage(array: &mts_array_t) -> Result<usize, Error> {
+    let count = array.shape()?.iter().product::<usize>();
+
+    // the data type is only available through `typed_data`, which is not
+    // free of side effects (sparse arrays switch to dense storage, and
+    // non-contiguous arrays are copied). Measuring the memory should not
+    // change it, so we always use the size of the default data type.
+    return Ok(count * std::mem::size_of::<f64>());
+}
+
+/// Number of additional control bytes at the end of hashbrown tables
+const HASH_TABLE_GROUP_WIDTH: usize = 16;
+
+/// Get the size of the heap allocation of a hash table (from either `std` or
+/// `hashbrown`) with the given `capacity`, containing entries of
+/// `entry_size` bytes.
+pub fn hash_table_memory_usage(capacity: usize, entry_size: usize) -> usize {
+    if capacity == 0 {
+        return 0;
+    }
+
+    // hashbrown uses at most 7/8 of the buckets (or all but one for small
+    // tables), and one control byte per bucket, plus a group of control bytes
+    let buckets = if capacity < 7 {
+        (capacity + 1).next_power_of_two()
+    } else {
+        (capacity / 7 * 8).next_power_of_two()
+    };
+
+    return buckets * (entry_size + 1) + HASH_TABLE_GROUP_WIDTH;
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn hash_table() {
+        assert_eq!(hash_table_memory_usage(0, 8), 0);
+
+        let map = std::collections::HashMap::<usize, ()>::with_capacity(100);
+        let capacity = map.capacity();
+        assert!(capacity >= 100);
+        // 128 buckets of 8 bytes, 128 + 16 control bytes
+        assert_eq!(hash_table_memory_usage(capacity, 8), 128 * 9 + 16);
+    }
+}
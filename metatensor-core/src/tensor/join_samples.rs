@@ -0,0 +1,194 @@
+use std::sync::Arc;
+
+use crate::labels::{Labels, LabelValue};
+use crate::utils::parallel_map;
+use crate::Error;
+
+use crate::data::mts_sample_mapping_t;
+
+use super::TensorMap;
+use super::utils::{KeyAndBlock, merge_threads, merge_samples, merge_gradient_samples};
+use super::keys_to_samples::{SamplesMerge, merge_blocks_along_samples};
+
+impl TensorMap {
+    /// Join multiple `tensors` along the samples axis, merging blocks with the
+    /// same key in all tensors.
+    ///
+    /// All the tensors must have the same keys (potentially in a different
+    /// order), and the merged blocks must have the same sample names,
+    /// components and properties. The keys of the new `TensorMap` are in the
+    /// same order as the keys of the first tensor.
+    ///
+    /// If `new_dimension` is `Some`, a new dimension with this name is added
+    /// to the samples, containing the index of the tensor each sample comes
+    /// from. Otherwise, the samples of the merged blocks must all be
+    /// different. In both cases, the samples of the new blocks are in the same
+    /// order as in the tensors.
+    pub fn join_samples(tensors: &[&TensorMap], new_dimension: Option<&str>) -> Result<TensorMap, Error> {
+        if tensors.is_empty() {
+            return Err(Error::InvalidParameter(
+                "there must be at least one tensor to join".into()
+            ));
+        }
+
+        let keys = &tensors[0].keys;
+        for (tensor_i, tensor) in tensors.iter().enumerate().skip(1) {
+            if tensor.keys.names() != keys.names() || tensor.keys.count() != keys.count() {
+                return Err(Error::InvalidParameter(format!(
+                    "can not join tensors with different keys: tensor at index {} \
+                    does not have the same keys as the first tensor", tensor_i
+                )));
+            }
+        }
+
+        // for each key, collect the corresponding block from all tensors,
+        // using the index of the tensor as the "key" of the block
+        let mut groups = Vec::with_capacity(keys.count());
+        for (key_i, key) in keys.iter().enumerate() {
+            let mut blocks = Vec::with_capacity(tensors.len());
+            for (tensor_i, tensor) in tensors.iter().enumerate() {
+                let position = if tensor_i == 0 {
+                    Some(key_i)
+                } else if Arc::ptr_eq(&tensor.keys, keys) || tensor.keys[key_i] == *key {
+                    // fast path for tensors with keys in the same order
+                    Some(key_i)
+                } else {
+                    tensor.keys.position(key)
+                };
+
+                let position = position.ok_or_else(|| Error::InvalidParameter(format!(
+                    "can not join tensors with different keys: tensor at index {} \
+                    does not have the same keys as the first tensor", tensor_i
+                )))?;
+
+                blocks.push(KeyAndBlock {
+                    key: vec![LabelValue::from(tensor_i)],
+                    block: &tensor.blocks[position],
+                });
+            }
+            groups.push(blocks);
+        }
+
+        // compute the new Labels for all blocks in parallel, and then move
+        // the data on the current thread, since the `mts_array_t` functions
+        // might not be safe to call from multiple threads.
+        let (n_threads, threads_per_group) = merge_threads(groups.len());
+        let merges = parallel_map(&groups, n_threads, |blocks_to_join| {
+            join_samples_labels(blocks_to_join, new_dimension, threads_per_group)
+        });
+
+        let mut new_blocks = Vec::with_capacity(groups.len());
+        for (blocks_to_join, merge) in groups.iter().zip(merges) {
+            new_blocks.push(merge_blocks_along_samples(blocks_to_join, merge?)?);
+        }
+
+        return TensorMap::new(Arc::clone(keys), new_blocks);
+    }
+}
+
+/// Compute the Labels of the block created by joining `blocks_to_join` along
+/// the samples axis, without touching the data. This uses up to `n_threads`
+/// threads.
+fn join_samples_labels(
+    blocks_to_join: &[KeyAndBlock],
+    new_dimension: Option<&str>,
+    n_threads: usize,
+) -> Result<SamplesMerge, Error> {
+    let first_block = blocks_to_join[0].block;
+    for gradient in first_block.gradients().values() {
+        if !gradient.gradients().is_empty() {
+            return Err(Error::InvalidParameter(
+                "gradient of gradients are not supported yet in join_samples".into()
+            ));
+        }
+    }
+
+    let sample_names = first_block.samples.names();
+    for KeyAndBlock{block, ..} in blocks_to_join {
+        if block.samples.names() != sample_names {
+            return Err(Error::InvalidParameter(
+                "can not join blocks with different sample names".into()
+            ));
+        }
+
+        if block.components != first_block.components {
+            return Err(Error::InvalidParameter(
+                "can not join blocks with different components labels".into()
+            ));
+        }
+
+        if block.properties != first_block.properties {
+            return Err(Error::InvalidParameter(
+                "can not join blocks with different property labels".into()
+            ));
+        }
+
+        if block.gradients().len() != first_block.gradients().len() ||
+           first_block.gradients().keys().any(|parameter| block.gradient(parameter).is_none()) {
+            return Err(Error::InvalidParameter(
+                "can not join blocks with different gradients".into()
+            ));
+        }
+    }
+
+    let (samples, samples_mappings) = if let Some(new_dimension) = new_dimension {
+        // the samples are unique thanks to the new dimension, so they can be
+        // directly concatenated
+        let mut new_sample_names = sample_names;
+        new_sample_names.push(new_dimension);
+        concatenate_samples(blocks_to_join, new_sample_names)?
+    } else {
+        let n_samples = blocks_to_join.iter().map(|b| b.block.samples.count()).sum::<usize>();
+        let (samples, mappings) = merge_samples(blocks_to_join, sample_names, false, n_threads);
+        if samples.count() != n_samples {
+            return Err(Error::InvalidParameter(
+                "can not join blocks containing the same samples, use a new \
+                sample dimension to distinguish between the tensors".into()
+            ));
+        }
+        (samples, mappings)
+    };
+
+    let mut gradients = Vec::new();
+    for parameter in first_block.gradients().keys() {
+        let merged = merge_gradient_samples(
+            blocks_to_join, parameter, &samples_mappings, n_threads
+        )?;
+        gradients.push((parameter.clone(), merged));
+    }
+
+    return Ok(SamplesMerge {
+        samples,
+        samples_mappings,
+        gradients,
+    });
+}
+
+/// Concatenate the samples of all `blocks`, adding the key of the blocks at
+/// the end of each sample. The resulting samples are assumed to be unique.
+fn concatenate_samples(
+    blocks: &[KeyAndBlock],
+    new_sample_names: Vec<&str>,
+) -> Result<(Arc<Labels>, Vec<Vec<mts_sample_mapping_t>>), Error> {
+    let n_samples = blocks.iter().map(|b| b.block.samples.count()).sum::<usize>();
+    let mut values = Vec::with_capacity(n_samples * new_sample_names.len());
+    let mut mappings = Vec::with_capacity(blocks.len());
+
+    let mut start = 0;
+    for KeyAndBlock{key, block} in blocks {
+        for sample in &*block.samples {
+            values.extend_from_slice(sample);
+            values.extend_from_slice(key);
+        }
+
+        let count = block.samples.count();
+        mappings.push((0..count).map(|sample_i| mts_sample_mapping_t {
+            input: sample_i,
+            output: start + sample_i,
+        }).collect());
+        start += count;
+    }
+
+    let samples = Labels::new_assume_unique(new_sample_names, values)?;
+    return Ok((Arc::new(samples), mappings));
+}
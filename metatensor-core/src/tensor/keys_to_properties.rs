@@ -1,14 +1,16 @@
+use std::ops::Range;
 use std::sync::Arc;
 
-use indexmap::IndexSet;
-
-use crate::labels::{Labels, LabelsBuilder};
+use crate::labels::{Labels, LabelValue};
+use crate::utils::parallel_map;
 use crate::{Error, TensorBlock};
 
 use crate::data::mts_sample_mapping_t;
 
 use super::TensorMap;
-use super::utils::{KeyAndBlock, remove_dimensions_from_keys, merge_samples, merge_gradient_samples};
+use super::utils::{KeyAndBlock, MergedGradientSamples, remove_dimensions_from_keys, group_blocks};
+use super::utils::{merge_threads, merge_samples, merge_gradient_samples};
+use super::utils::{shared_labels, identity_mapping};
 
 
 impl TensorMap {
@@ -26,12 +28,15 @@ impl TensorMap {
     /// 3` will produce a block with properties `a, p = (0, 1), (0, 2), (2, 1),
     /// (2, 3)`.
     ///
-    /// If `keys_to_move` contains entries, then the property labels must be the
-    /// same for all the merged blocks. In that case, the merged property labels
-    /// will contains each of the entries of `keys_to_move` and then the current
+    /// If `keys_to_move` contains entries, then the merged property labels will
+    /// contains each of the entries of `keys_to_move` and then the current
     /// property labels. For example, using `a=2, 3` in `keys_to_move`, and
     /// blocks with properties `p=1, 2` will result in `a, p = (2, 1), (2, 2),
-    /// (3, 1), (3, 2)`.
+    /// (3, 1), (3, 2)`. If the merged blocks have different property labels,
+    /// each entry of `keys_to_move` is followed by the properties of the block
+    /// with this entry in its key. Entries without such block use the
+    /// properties of the blocks with this entry in the other groups of merged
+    /// blocks, which must then all be the same.
     ///
     /// The new sample labels will contains all of the merged blocks sample
     /// labels. The order of the samples is controlled by `sort_samples`. If
@@ -54,75 +59,105 @@ impl TensorMap {
             Some(keys_to_move)
         };
 
-        let mut new_blocks = Vec::new();
-        if splitted_keys.new_keys.count() == 1 {
-            // create a single block with everything
-            let blocks_to_merge = self.keys.iter()
-                .zip(&self.blocks)
-                .map(|(key, block)| {
-                    let mut moved_key = Vec::new();
-                    for &i in &splitted_keys.dimensions_positions {
-                        moved_key.push(key[i]);
-                    }
+        let groups = group_blocks(self, &splitted_keys)?;
 
-                    KeyAndBlock {
-                        key: moved_key,
-                        block
-                    }
-                })
-                .collect::<Vec<_>>();
+        // if the blocks have different properties, find the properties
+        // associated with each entry of `keys_to_move` across all groups
+        let all_blocks = groups.iter().flatten().map(|b| &b.block.properties);
+        let moved_keys_properties = match keys_to_move {
+            Some(keys_to_move) if shared_labels(all_blocks, false).is_none() => {
+                Some(moved_keys_properties(&groups, keys_to_move))
+            }
+            _ => None,
+        };
 
-            let block = merge_blocks_along_properties(
-                &blocks_to_merge,
+        // compute the new Labels for all groups of blocks in parallel, and
+        // then move the data on the current thread, since the `mts_array_t`
+        // functions might not be safe to call from multiple threads.
+        let (n_threads, threads_per_group) = merge_threads(groups.len());
+        let merges = parallel_map(&groups, n_threads, |blocks_to_merge| {
+            merge_properties_labels(
+                blocks_to_merge,
                 keys_to_move,
+                moved_keys_properties.as_deref(),
                 &names_to_move,
                 sort_samples,
-            )?;
-            new_blocks.push(block);
-        } else {
-            for entry in &splitted_keys.new_keys {
-                let mut selection = LabelsBuilder::new(splitted_keys.new_keys.names())?;
-                selection.add(entry)?;
-
-                let matching = self.blocks_matching(&selection.finish())?;
-                let blocks_to_merge = matching.iter()
-                    .map(|&i| {
-                        let block = &self.blocks[i];
-                        let key = &self.keys[i];
-                        let mut moved_key = Vec::new();
-                        for &i in &splitted_keys.dimensions_positions {
-                            moved_key.push(key[i]);
-                        }
-
-                        KeyAndBlock {
-                            key: moved_key,
-                            block
-                        }
-                    })
-                    .collect::<Vec<_>>();
-
-                let block = merge_blocks_along_properties(
-                    &blocks_to_merge,
-                    keys_to_move,
-                    &names_to_move,
-                    sort_samples,
-                )?;
-                new_blocks.push(block);
-            }
+                threads_per_group,
+            )
+        });
+
+        let mut new_blocks = Vec::new();
+        for (blocks_to_merge, merge) in groups.iter().zip(merges) {
+            new_blocks.push(merge_blocks_along_properties(blocks_to_merge, merge?)?);
         }
 
         return TensorMap::new(Arc::new(splitted_keys.new_keys), new_blocks);
     }
 }
 
-/// Merge the given `blocks` along the property axis.
-#[allow(clippy::too_many_lines)]
-fn merge_blocks_along_properties(
+/// Properties associated with a single entry of `keys_to_move`, taken from all
+/// the blocks in the tensor with this entry in their keys.
+enum MovedKeyProperties {
+    /// There are no blocks with this entry
+    Missing,
+    /// All the blocks with this entry have the same properties
+    Consistent(Arc<Labels>),
+    /// The blocks with this entry have different properties
+    Inconsistent,
+}
+
+/// Find the properties associated with each entry of `keys_to_move` in
+/// all the groups of blocks. These are used when merging blocks with
+/// different properties, for the entries without a block in a group.
+fn moved_keys_properties(groups: &[Vec<KeyAndBlock>], keys_to_move: &Labels) -> Vec<MovedKeyProperties> {
+    let mut result = Vec::new();
+    result.resize_with(keys_to_move.count(), || MovedKeyProperties::Missing);
+
+    for KeyAndBlock{key, block} in groups.iter().flatten() {
+        if let Some(position) = keys_to_move.position(key) {
+            let entry = &mut result[position];
+            match entry {
+                MovedKeyProperties::Missing => {
+                    *entry = MovedKeyProperties::Consistent(Arc::clone(&block.properties));
+                }
+                MovedKeyProperties::Consistent(properties) => {
+                    if *properties != block.properties {
+                        *entry = MovedKeyProperties::Inconsistent;
+                    }
+                }
+                MovedKeyProperties::Inconsistent => {}
+            }
+        }
+    }
+
+    return result;
+}
+
+/// Labels of a block created by merging other blocks along the property axis,
+/// and the corresponding positions of the data from the merged blocks.
+struct PropertiesMerge {
+    samples: Arc<Labels>,
+    samples_mappings: Vec<Vec<mts_sample_mapping_t>>,
+    properties: Arc<Labels>,
+    /// for each merged block, the range of the new properties it corresponds
+    /// to, or `None` if the block should not be included in the new block
+    property_ranges: Vec<Option<Range<usize>>>,
+    /// merged gradients samples, in the same order as the gradients of the
+    /// first block
+    gradients: Vec<(String, MergedGradientSamples)>,
+}
+
+/// Compute the Labels of the block created by merging `blocks_to_merge` along
+/// the property axis, without touching the data. This uses up to `n_threads`
+/// threads.
+fn merge_properties_labels(
     blocks_to_merge: &[KeyAndBlock],
     keys_to_move: Option<&Labels>,
+    moved_keys_properties: Option<&[MovedKeyProperties]>,
     extracted_names: &[&str],
     sort_samples: bool,
-) -> Result<TensorBlock, Error> {
+    n_threads: usize,
+) -> Result<PropertiesMerge, Error> {
     assert!(!blocks_to_merge.is_empty());
 
     let first_block = blocks_to_merge[0].block;
@@ -135,7 +170,6 @@ fn merge_blocks_along_properties(
     }
 
     let first_components_label = &first_block.components;
-    let first_property_labels = &first_block.properties;
     for KeyAndBlock{block, ..} in blocks_to_merge {
         if &block.components != first_components_label {
             return Err(Error::InvalidParameter(
@@ -143,102 +177,232 @@ fn merge_blocks_along_properties(
                 different components labels, call components_to_properties first".into()
             ));
         }
-
-        if keys_to_move.is_some() && &block.properties != first_property_labels {
-            // TODO: this might be possible but also pretty slow. It would
-            // requires to lookup the position of properties one by one in the
-            // merged properties
-            return Err(Error::InvalidParameter(
-                "can not provide values for the keys to move to properties if \
-                the blocks have different property labels".into()
-            ));
-        }
     }
 
-    // collect and merge samples across the blocks
-    let (merged_samples, samples_mappings) = merge_samples(
-        blocks_to_merge,
-        first_block.samples.names(),
+    // collect and merge samples across the blocks. If all the blocks have
+    // the same samples, we can use them directly, and every block is moved to
+    // the same samples in the new block.
+    let shared_samples = shared_labels(
+        blocks_to_merge.iter().map(|b| &b.block.samples),
         sort_samples,
     );
+    let samples_are_shared = shared_samples.is_some();
+    let (merged_samples, samples_mappings) = if let Some(samples) = shared_samples {
+        let mapping = identity_mapping(samples.count());
+        (samples, vec![mapping; blocks_to_merge.len()])
+    } else {
+        merge_samples(
+            blocks_to_merge,
+            first_block.samples.names(),
+            sort_samples,
+            n_threads,
+        )
+    };
+
+    // build the new properties directly as a linearized 2D array. All the new
+    // properties are known to be unique: the moved keys are unique within a
+    // group of blocks (or within `keys_to_move`), and the properties of each
+    // block are unique.
+    let new_property_names = extracted_names.iter()
+        .chain(first_block.properties.names().iter())
+        .copied()
+        .collect::<Vec<_>>();
+    let new_properties_size = new_property_names.len();
 
-    let mut new_properties = IndexSet::new();
+    let mut new_properties = Vec::new();
+    let mut property_ranges = Vec::new();
     if let Some(keys_to_move) = keys_to_move {
-        // use the user-provided new values
-        for new_property in keys_to_move {
-            for KeyAndBlock{block, ..} in blocks_to_merge {
-                for old_property in &*block.properties {
-                    let mut property = new_property.to_vec();
-                    property.extend_from_slice(old_property);
-                    new_properties.insert(property);
+        // use the user-provided new values. The data for each block goes to
+        // the properties corresponding to its key in `keys_to_move`, which
+        // might not include all the keys.
+        let entries_ranges = if let Some(moved_keys_properties) = moved_keys_properties {
+            moved_keys_ranges(blocks_to_merge, keys_to_move, moved_keys_properties, &mut new_properties)?
+        } else {
+            // all blocks have the same properties, which are repeated for each
+            // entry in `keys_to_move`.
+            let properties = &first_block.properties;
+            let n_properties = properties.count();
+            new_properties.reserve(keys_to_move.count() * n_properties * new_properties_size);
+            for new_property in keys_to_move {
+                for old_property in &**properties {
+                    new_properties.extend_from_slice(new_property);
+                    new_properties.extend_from_slice(old_property);
                 }
             }
+
+            (0..keys_to_move.count()).map(|position| {
+                let start = position * n_properties;
+                start..(start + n_properties)
+            }).collect()
+        };
+
+        for KeyAndBlock{key, block} in blocks_to_merge {
+            if block.properties.is_empty() {
+                // no properties, ignore this block
+                property_ranges.push(None);
+                continue;
+            }
+
+            let range = keys_to_move.position(key).map(|position| entries_ranges[position].clone());
+            property_ranges.push(range);
         }
-        assert_eq!(new_properties.len(), first_property_labels.count() * keys_to_move.count());
     } else {
         // collect properties from the blocks, augmenting them with the new
-        // properties
+        // properties. The data for each block goes to the corresponding
+        // contiguous range of properties.
+        let total = blocks_to_merge.iter().map(|b| b.block.properties.count()).sum::<usize>();
+        new_properties.reserve(total * new_properties_size);
+
+        let mut start = 0;
         for KeyAndBlock{key, block} in blocks_to_merge {
             for old_property in &*block.properties {
-                let mut property = key.clone();
-                property.extend_from_slice(old_property);
-                new_properties.insert(property);
+                new_properties.extend_from_slice(key);
+                new_properties.extend_from_slice(old_property);
+            }
+
+            let size = block.properties.count();
+            if size == 0 {
+                // no properties, ignore this block
+                property_ranges.push(None);
+            } else {
+                property_ranges.push(Some(start..(start + size)));
             }
+            start += size;
         }
     }
 
-    let new_property_names = extracted_names.iter()
-        .chain(first_block.properties.names().iter())
-        .copied()
-        .collect();
-    let mut new_properties_builder = LabelsBuilder::new(new_property_names)?;
-    for property in new_properties {
-        new_properties_builder.add(&property)?;
-    }
+    let new_properties = Arc::new(Labels::new_assume_unique(new_property_names, new_properties)?);
+
+    let mut gradients = Vec::new();
+    for parameter in first_block.gradients().keys() {
+        // gradients samples can also be used directly if the samples of the
+        // blocks are shared. `merge_gradient_samples` produces sorted gradient
+        // samples, so they also need to be sorted here.
+        let shared_gradient_samples = if samples_are_shared {
+            shared_labels(
+                blocks_to_merge.iter().map(|b| &b.block.gradient(parameter).expect("missing gradient").samples),
+                true,
+            )
+        } else {
+            None
+        };
 
-    let new_components = first_block.components.to_vec();
-    let new_properties = Arc::new(new_properties_builder.finish());
-    let new_properties_count = new_properties.count();
+        let merged = if let Some(samples) = shared_gradient_samples {
+            let mapping = identity_mapping(samples.count());
+            MergedGradientSamples {
+                samples,
+                mappings: vec![mapping; blocks_to_merge.len()],
+            }
+        } else {
+            merge_gradient_samples(blocks_to_merge, parameter, &samples_mappings, n_threads)?
+        };
+        gradients.push((parameter.clone(), merged));
+    }
 
-    // create a new array and move the data around
-    let mut new_shape = first_block.values.shape()?.to_vec();
-    new_shape[0] = merged_samples.count();
-    let property_axis = new_shape.len() - 1;
-    new_shape[property_axis] = new_properties_count;
-    let mut new_data = first_block.values.create(&new_shape)?;
+    return Ok(PropertiesMerge {
+        samples: merged_samples,
+        samples_mappings,
+        properties: new_properties,
+        property_ranges,
+        gradients,
+    });
+}
 
-    // compute the property range for each block, i.e. where we want to put
-    // the corresponding data
-    let mut property_ranges = Vec::new();
+/// Build the new properties for blocks with different properties, when the
+/// user provided the `keys_to_move`. The properties of each entry in
+/// `keys_to_move` are the ones of the block with this entry in its key, or
+/// the properties found in the other groups of blocks if there is no such
+/// block in `blocks_to_merge`. If these are not known, and all the blocks in
+/// `blocks_to_merge` have the same properties, these are used instead.
+///
+/// The new properties are added to `new_properties`, and this function returns
+/// the range of new properties corresponding to each entry in `keys_to_move`.
+/// Each block is then moved to a single contiguous range of properties,
+/// without looking up its properties one by one in the merged properties.
+fn moved_keys_ranges(
+    blocks_to_merge: &[KeyAndBlock],
+    keys_to_move: &Labels,
+    moved_keys_properties: &[MovedKeyProperties],
+    new_properties: &mut Vec<LabelValue>,
+) -> Result<Vec<Range<usize>>, Error> {
+    debug_assert_eq!(keys_to_move.count(), moved_keys_properties.len());
+
+    // the keys are unique within a group of blocks, so there is at most one
+    // block for each entry in `keys_to_move`
+    let mut entries_blocks = vec![None; keys_to_move.count()];
     for KeyAndBlock{key, block} in blocks_to_merge {
-        if block.properties.is_empty() {
-            // no properties, ignore this block
-            property_ranges.push(None);
-            continue;
+        if let Some(position) = keys_to_move.position(key) {
+            entries_blocks[position] = Some(*block);
         }
+    }
 
-        let mut first = key.clone();
-        first.extend_from_slice(&block.properties[0]);
-
-        // we can lookup only the `first` new property here, since the new
-        // properties match exactly the old ones, just with an added "channel"
-        // of the moved key.
+    let group_properties = shared_labels(blocks_to_merge.iter().map(|b| &b.block.properties), false);
 
-        // start can be None is the user requested a set of values which do not
-        // include the key for the current block
-        let start = new_properties.position(&first);
-        let size = block.properties.count();
-        if let Some(start) = start {
-            property_ranges.push(Some(start..(start + size)));
+    let mut ranges = Vec::with_capacity(keys_to_move.count());
+    let mut start = 0;
+    for (position, new_property) in keys_to_move.iter().enumerate() {
+        let properties = if let Some(block) = entries_blocks[position] {
+            &block.properties
         } else {
-            property_ranges.push(None);
+            match (&moved_keys_properties[position], &group_properties) {
+                (MovedKeyProperties::Consistent(properties), _) | (_, Some(properties)) => properties,
+                (MovedKeyProperties::Missing, None) => {
+                    // there are no blocks for this entry anywhere, so it does
+                    // not have any properties
+                    ranges.push(start..start);
+                    continue;
+                }
+                (MovedKeyProperties::Inconsistent, None) => {
+                    let entry = keys_to_move.names().iter()
+                        .zip(new_property)
+                        .map(|(name, value)| format!("{}={}", name, value))
+                        .collect::<Vec<_>>()
+                        .join(", ");
+
+                    return Err(Error::InvalidParameter(format!(
+                        "can not provide values for the keys to move to properties: \
+                        the blocks with ({}) in their keys have different property \
+                        labels, and some of the merged blocks do not contain it",
+                        entry
+                    )));
+                }
+            }
+        };
+
+        for old_property in &**properties {
+            new_properties.extend_from_slice(new_property);
+            new_properties.extend_from_slice(old_property);
         }
+
+        let size = properties.count();
+        ranges.push(start..(start + size));
+        start += size;
     }
 
-    debug_assert_eq!(blocks_to_merge.len(), samples_mappings.len());
-    debug_assert_eq!(blocks_to_merge.len(), property_ranges.len());
+    return Ok(ranges);
+}
+
+/// Merge the given `blocks` along the property axis, using the Labels
+/// computed by `merge_properties_labels`.
+fn merge_blocks_along_properties(
+    blocks_to_merge: &[KeyAndBlock],
+    merge: PropertiesMerge,
+) -> Result<TensorBlock, Error> {
+    let first_block = blocks_to_merge[0].block;
+    let new_components = first_block.components.to_vec();
+    let new_properties_count = merge.properties.count();
+
+    // create a new array and move the data around
+    let mut new_shape = first_block.values.shape()?.to_vec();
+    new_shape[0] = merge.samples.count();
+    let property_axis = new_shape.len() - 1;
+    new_shape[property_axis] = new_properties_count;
+    let mut new_data = first_block.values.create(&new_shape)?;
+
+    debug_assert_eq!(blocks_to_merge.len(), merge.samples_mappings.len());
+    debug_assert_eq!(blocks_to_merge.len(), merge.property_ranges.len());
     // for each block, gather the data to be moved & send it in one go
-    for ((KeyAndBlock{block, ..}, samples_mapping), property_range) in blocks_to_merge.iter().zip(&samples_mappings).zip(&property_ranges) {
+    for ((KeyAndBlock{block, ..}, samples_mapping), property_range) in blocks_to_merge.iter().zip(&merge.samples_mappings).zip(&merge.property_ranges) {
         if let Some(property_range) = property_range {
             new_data.move_samples_from(
                 &block.values,
@@ -250,65 +414,47 @@ fn merge_blocks_along_properties(
 
     let mut new_block = TensorBlock::new(
         new_data,
-        merged_samples,
+        merge.samples,
         new_components,
-        new_properties
+        merge.properties
     ).expect("constructed an invalid block");
 
-    // now collect & merge the different gradients
-    for (parameter, first_gradient) in first_block.gradients() {
-        let new_gradient_samples = merge_gradient_samples(
-            blocks_to_merge, parameter, &samples_mappings
-        )?;
+    // now merge the different gradients
+    for (parameter, new_gradient_samples) in merge.gradients {
+        let first_gradient = first_block.gradient(&parameter).expect("missing gradient");
 
         let mut new_shape = first_gradient.values.shape()?.to_vec();
-        new_shape[0] = new_gradient_samples.count();
+        new_shape[0] = new_gradient_samples.samples.count();
         let property_axis = new_shape.len() - 1;
         new_shape[property_axis] = new_properties_count;
 
         let mut new_gradient = first_block.values.create(&new_shape)?;
         let new_components = first_gradient.components.to_vec();
 
-        for ((KeyAndBlock{block, ..}, samples_mapping), property_range) in blocks_to_merge.iter().zip(&samples_mappings).zip(&property_ranges) {
-            if property_range.is_none() {
-                continue;
-            }
-            let property_range = property_range.as_ref().unwrap();
-
-            let gradient = block.gradient(parameter).expect("missing gradient");
-            debug_assert!(*gradient.components == *new_components);
-
-            let mut samples_to_move = Vec::new();
-            for (sample_i, grad_sample) in gradient.samples.iter().enumerate() {
-                // translate from the old sample id in gradients to the new ones
-                let mut grad_sample = grad_sample.to_vec();
-                let old_sample_i = grad_sample[0].usize();
-
-                let mapping = &samples_mapping[old_sample_i];
-                debug_assert_eq!(mapping.input, old_sample_i);
-                grad_sample[0] = mapping.output.into();
-
-                let new_sample_i = new_gradient_samples.position(&grad_sample).expect("missing entry in merged samples");
-                samples_to_move.push(mts_sample_mapping_t {
-                    input: sample_i,
-                    output: new_sample_i,
-                });
+        let blocks_and_mappings = blocks_to_merge.iter()
+            .zip(&new_gradient_samples.mappings)
+            .zip(&merge.property_ranges);
+        for ((KeyAndBlock{block, ..}, samples_to_move), property_range) in blocks_and_mappings {
+            if let Some(property_range) = property_range {
+                let gradient = block.gradient(&parameter).expect("missing gradient");
+                debug_assert!(*gradient.components == *new_components);
+
+                new_gradient.move_samples_from(
+                    &gradient.values,
+                    samples_to_move,
+                    property_range.clone(),
+                )?;
             }
-            new_gradient.move_samples_from(
-                &gradient.values,
-                &samples_to_move,
-                property_range.clone(),
-            )?;
         }
 
         let new_gradient = TensorBlock::new(
             new_gradient,
-            new_gradient_samples,
+            new_gradient_samples.samples,
             new_components,
             new_block.properties.clone()
         ).expect("created invalid gradient");
 
-        new_block.add_gradient(parameter, new_gradient).expect("could not add gradient");
+        new_block.add_gradient(&parameter, new_gradient).expect("could not add gradient");
     }
 
     return Ok(new_block);
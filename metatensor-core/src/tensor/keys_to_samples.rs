@@ -1,12 +1,14 @@
 use std::sync::Arc;
 
-use crate::labels::{Labels, LabelsBuilder};
+use crate::labels::Labels;
+use crate::utils::parallel_map;
 use crate::{Error, TensorBlock};
 
 use crate::data::mts_sample_mapping_t;
 
 use super::TensorMap;
-use super::utils::{KeyAndBlock, remove_dimensions_from_keys, merge_samples, merge_gradient_samples};
+use super::utils::{KeyAndBlock, MergedGradientSamples, remove_dimensions_from_keys, group_blocks};
+use super::utils::{merge_threads, merge_samples, merge_gradient_samples};
 
 impl TensorMap {
     /// Merge blocks with the same value for selected keys dimensions along the
@@ -45,70 +47,49 @@ impl TensorMap {
         let names_to_move = keys_to_move.names();
         let splitted_keys = remove_dimensions_from_keys(&self.keys, &names_to_move)?;
 
-        let mut new_blocks = Vec::new();
-        if splitted_keys.new_keys.count() == 1 {
-            // create a single block with everything
-            let blocks_to_merge = self.keys.iter()
-                .zip(&self.blocks)
-                .map(|(key, block)| {
-                    let mut moved_key = Vec::new();
-                    for &i in &splitted_keys.dimensions_positions {
-                        moved_key.push(key[i]);
-                    }
-
-                    KeyAndBlock {
-                        key: moved_key,
-                        block
-                    }
-                })
-                .collect::<Vec<_>>();
-
-            let block = merge_blocks_along_samples(
-                &blocks_to_merge,
+        let groups = group_blocks(self, &splitted_keys)?;
+
+        // compute the new Labels for all groups of blocks in parallel, and
+        // then move the data on the current thread, since the `mts_array_t`
+        // functions might not be safe to call from multiple threads.
+        let (n_threads, threads_per_group) = merge_threads(groups.len());
+        let merges = parallel_map(&groups, n_threads, |blocks_to_merge| {
+            merge_samples_labels(
+                blocks_to_merge,
                 &names_to_move,
                 sort_samples,
-            )?;
-            new_blocks.push(block);
-        } else {
-            for entry in &splitted_keys.new_keys {
-                let mut selection = LabelsBuilder::new(splitted_keys.new_keys.names())?;
-                selection.add(entry)?;
-
-                let matching = self.blocks_matching(&selection.finish())?;
-                let blocks_to_merge = matching.iter()
-                    .map(|&i| {
-                        let block = &self.blocks[i];
-                        let key = &self.keys[i];
-                        let mut moved_key = Vec::new();
-                        for &i in &splitted_keys.dimensions_positions {
-                            moved_key.push(key[i]);
-                        }
-
-                        KeyAndBlock {
-                            key: moved_key,
-                            block
-                        }
-                    })
-                    .collect::<Vec<_>>();
-
-                new_blocks.push(merge_blocks_along_samples(
-                    &blocks_to_merge,
-                    &names_to_move,
-                    sort_samples,
-                )?);
-            }
+                threads_per_group,
+            )
+        });
+
+        let mut new_blocks = Vec::new();
+        for (blocks_to_merge, merge) in groups.iter().zip(merges) {
+            new_blocks.push(merge_blocks_along_samples(blocks_to_merge, merge?)?);
         }
 
         return TensorMap::new(Arc::new(splitted_keys.new_keys), new_blocks);
     }
 }
 
-/// Merge the given `blocks` along the sample axis.
-fn merge_blocks_along_samples(
+/// Labels of a block created by merging other blocks along the sample axis,
+/// and the corresponding positions of the data from the merged blocks.
+pub(super) struct SamplesMerge {
+    pub(super) samples: Arc<Labels>,
+    pub(super) samples_mappings: Vec<Vec<mts_sample_mapping_t>>,
+    /// merged gradients samples, in the same order as the gradients of the
+    /// first block
+    pub(super) gradients: Vec<(String, MergedGradientSamples)>,
+}
+
+/// Compute the Labels of the block created by merging `blocks_to_merge` along
+/// the sample axis, without touching the data. This uses up to `n_threads`
+/// threads.
+fn merge_samples_labels(
     blocks_to_merge: &[KeyAndBlock],
     extracted_names: &[&str],
     sort_samples: bool,
-) -> Result<TensorBlock, Error> {
+    n_threads: usize,
+) -> Result<SamplesMerge, Error> {
     assert!(!blocks_to_merge.is_empty());
 
     let first_block = blocks_to_merge[0].block;
@@ -148,19 +129,42 @@ fn merge_blocks_along_samples(
         blocks_to_merge,
         new_sample_names,
         sort_samples,
+        n_threads,
     );
 
+    let mut gradients = Vec::new();
+    for parameter in first_block.gradients().keys() {
+        let merged = merge_gradient_samples(
+            blocks_to_merge, parameter, &samples_mappings, n_threads
+        )?;
+        gradients.push((parameter.clone(), merged));
+    }
+
+    return Ok(SamplesMerge {
+        samples: merged_samples,
+        samples_mappings,
+        gradients,
+    });
+}
+
+/// Merge the given `blocks` along the sample axis, using the Labels computed
+/// by `merge_samples_labels`.
+pub(super) fn merge_blocks_along_samples(
+    blocks_to_merge: &[KeyAndBlock],
+    merge: SamplesMerge,
+) -> Result<TensorBlock, Error> {
+    let first_block = blocks_to_merge[0].block;
     let new_components = first_block.components.to_vec();
     let new_properties = Arc::clone(&first_block.properties);
 
     let mut new_shape = first_block.values.shape()?.to_vec();
-    new_shape[0] = merged_samples.count();
+    new_shape[0] = merge.samples.count();
     let mut new_data = first_block.values.create(&new_shape)?;
 
     let property_range = 0..new_properties.count();
 
-    debug_assert_eq!(blocks_to_merge.len(), samples_mappings.len());
-    for (KeyAndBlock{block, ..}, samples_mapping) in blocks_to_merge.iter().zip(&samples_mappings) {
+    debug_assert_eq!(blocks_to_merge.len(), merge.samples_mappings.len());
+    for (KeyAndBlock{block, ..}, samples_mapping) in blocks_to_merge.iter().zip(&merge.samples_mappings) {
         new_data.move_samples_from(
             &block.values,
             samples_mapping,
@@ -170,57 +174,39 @@ fn merge_blocks_along_samples(
 
     let mut new_block = TensorBlock::new(
         new_data,
-        merged_samples,
+        merge.samples,
         new_components,
         new_properties
     ).expect("invalid block");
 
-    // now collect & merge the different gradients
-    for (parameter, first_gradient) in first_block.gradients() {
-        let new_gradient_samples = merge_gradient_samples(
-            blocks_to_merge, parameter, &samples_mappings
-        )?;
+    // now merge the different gradients
+    for (parameter, new_gradient_samples) in merge.gradients {
+        let first_gradient = first_block.gradient(&parameter).expect("missing gradient");
 
         let mut new_shape = first_gradient.values.shape()?.to_vec();
-        new_shape[0] = new_gradient_samples.count();
+        new_shape[0] = new_gradient_samples.samples.count();
         let mut new_gradient = first_block.values.create(&new_shape)?;
         let new_components = first_gradient.components.to_vec();
 
-        for (KeyAndBlock{block, ..}, samples_mapping) in blocks_to_merge.iter().zip(&samples_mappings) {
-            let gradient = block.gradient(parameter).expect("missing gradient");
+        for (KeyAndBlock{block, ..}, samples_to_move) in blocks_to_merge.iter().zip(&new_gradient_samples.mappings) {
+            let gradient = block.gradient(&parameter).expect("missing gradient");
             debug_assert!(*gradient.components == *new_components);
 
-            let mut samples_to_move = Vec::new();
-            for (sample_i, grad_sample) in gradient.samples.iter().enumerate() {
-                // translate from the old sample id in gradients to the new ones
-                let mut grad_sample = grad_sample.to_vec();
-                let old_sample_i = grad_sample[0].usize();
-
-                let mapping = &samples_mapping[old_sample_i];
-                debug_assert_eq!(mapping.input, old_sample_i);
-                grad_sample[0] = mapping.output.into();
-
-                let new_sample_i = new_gradient_samples.position(&grad_sample).expect("missing entry in merged samples");
-                samples_to_move.push(mts_sample_mapping_t {
-                    input: sample_i,
-                    output: new_sample_i,
-                });
-            }
             new_gradient.move_samples_from(
                 &gradient.values,
-                &samples_to_move,
+                samples_to_move,
                 property_range.clone(),
             )?;
         }
 
         let new_gradient = TensorBlock::new(
             new_gradient,
-            new_gradient_samples,
+            new_gradient_samples.samples,
             new_components,
             new_block.properties.clone()
         ).expect("created invalid gradient");
 
-        new_block.add_gradient(parameter, new_gradient).expect("could not add gradient");
+        new_block.add_gradient(&parameter, new_gradient).expect("could not add gradient");
     }
 
     return Ok(new_block);
@@ -1,14 +1,17 @@
 use std::collections::HashMap;
-use std::sync::Arc;
+use std::sync::{Arc, RwLock};
 
 use crate::TensorBlock;
-use crate::{Labels, Error};
+use crate::{Labels, LabelValue, Error};
 use crate::get_data_origin;
+use crate::MemoryUsageTracker;
+use crate::memory::hash_table_memory_usage;
 
 mod utils;
 
 mod keys_to_samples;
 mod keys_to_properties;
+mod join_samples;
 
 
 /// A tensor map is the main user-facing struct of this library, and can store
@@ -24,9 +27,16 @@ mod keys_to_properties;
 pub struct TensorMap {
     keys: Arc<Labels>,
     blocks: Vec<TensorBlock>,
+    /// Indexes used by `blocks_matching` for selections containing a subset
+    /// of the keys dimensions, created on first use for each subset
+    selection_indexes: RwLock<HashMap<Vec<usize>, Arc<SelectionIndex>>>,
     // TODO: arbitrary tensor-level metadata? e.g. using `HashMap<String, String>`
 }
 
+/// Index of the blocks in a `TensorMap`, grouped by the values they take for
+/// a subset of the keys dimensions.
+type SelectionIndex = hashbrown::HashMap<Vec<LabelValue>, Vec<usize>, std::hash::BuildHasherDefault<ahash::AHasher>>;
+
 fn check_labels_names(
     block: &TensorBlock,
     sample_names: &[&str],
@@ -171,6 +181,7 @@ impl TensorMap {
         Ok(TensorMap {
             keys: keys,
             blocks,
+            selection_indexes: RwLock::new(HashMap::new()),
         })
     }
 
@@ -182,9 +193,11 @@ impl TensorMap {
             blocks.push(block.try_clone()?);
         }
 
+        let selection_indexes = self.selection_indexes.read().expect("poisoned lock").clone();
         return Ok(TensorMap {
             keys: Arc::clone(&self.keys),
-            blocks
+            blocks,
+            selection_indexes: RwLock::new(selection_indexes),
         });
     }
 
@@ -198,11 +211,65 @@ impl TensorMap {
         &mut self.blocks
     }
 
+    /// Get a raw pointer to the block at `index` in the `TensorMap` pointed to
+    /// by `tensor`, or `None` if the index is out of bounds.
+    ///
+    /// This does not create any reference to the whole `TensorMap` or to the
+    /// other blocks, so it can be called from multiple threads while these
+    /// threads are modifying different blocks.
+    ///
+    /// # Safety
+    ///
+    /// `tensor` must point to a valid `TensorMap`, and the list of blocks must
+    /// not be modified while this function runs.
+    pub unsafe fn block_ptr(tensor: *mut TensorMap, index: usize) -> Option<*mut TensorBlock> {
+        let blocks = std::ptr::addr_of!((*tensor).blocks);
+        if index >= (*blocks).len() {
+            return None;
+        }
+
+        // only create shared references to the header of the `Vec`, which
+        // can overlap between threads. `Vec::as_ptr` does not create a
+        // reference to the blocks themselves, and the pointer it returns
+        // comes from the `Vec` buffer and can be used for writes.
+        return Some((*blocks).as_ptr().add(index).cast_mut());
+    }
+
     /// Get the keys defined in this `TensorMap`
     pub fn keys(&self) -> &Arc<Labels> {
         &self.keys
     }
 
+    /// Add the memory used by this `TensorMap` and all its blocks to `tracker`
+    pub fn memory_usage(&self, tracker: &mut MemoryUsageTracker) -> Result<(), Error> {
+        tracker.add_metadata(std::mem::size_of::<TensorMap>());
+        tracker.add_labels(&self.keys);
+
+        let selection_indexes = self.selection_indexes.read().expect("poisoned lock");
+        tracker.add_positions(hash_table_memory_usage(
+            selection_indexes.capacity(),
+            std::mem::size_of::<(Vec<usize>, Arc<SelectionIndex>)>(),
+        ));
+        for (dimensions, index) in selection_indexes.iter() {
+            let mut size = dimensions.capacity() * std::mem::size_of::<usize>();
+            size += hash_table_memory_usage(
+                index.capacity(),
+                std::mem::size_of::<(Vec<LabelValue>, Vec<usize>)>(),
+            );
+            for (key, blocks) in index.iter() {
+                size += key.capacity() * std::mem::size_of::<LabelValue>();
+                size += blocks.capacity() * std::mem::size_of::<usize>();
+            }
+            tracker.add_positions(size);
+        }
+
+        for block in &self.blocks {
+            block.memory_usage(tracker)?;
+        }
+
+        Ok(())
+    }
+
     /// Get the index of blocks matching the given selection.
     ///
     /// The selection must contains a single entry, defining the requested key
@@ -210,7 +277,7 @@ impl TensorMap {
     /// keys, there can be multiple matching blocks.
     pub fn blocks_matching(&self, selection: &Labels) -> Result<Vec<usize>, Error> {
         if selection.size() == 0 {
-            return Ok((0..self.blocks().len()).collect());
+            return Ok((0..self.keys.count()).collect());
         }
 
         if selection.count() != 1 {
@@ -220,41 +287,66 @@ impl TensorMap {
             )));
         }
 
-        let mut dimensions = Vec::new();
-        'outer: for requested in selection.names() {
-            for (i, &name) in self.keys.names().iter().enumerate() {
-                if requested == name {
-                    dimensions.push(i);
-                    continue 'outer;
-                }
-            }
+        let mut matching = self.blocks_matching_many(selection)?;
+        return Ok(matching.pop().expect("missing selection entry"));
+    }
 
-            return Err(Error::InvalidParameter(format!(
-                "'{}' is not part of the keys for this tensor",
-                requested
-            )));
+    /// Get the index of blocks matching each one of the entries in the given
+    /// selection.
+    ///
+    /// This is equivalent to calling `blocks_matching` with each entry of
+    /// `selection` separately, but faster. The result contains one list of
+    /// blocks for each entry in the selection. Since all the entries in
+    /// `selection` are different, a given block can only match one of them.
+    pub fn blocks_matching_many(&self, selection: &Labels) -> Result<Vec<Vec<usize>>, Error> {
+        if selection.size() == 0 {
+            return Ok(vec![(0..self.keys.count()).collect(); selection.count()]);
         }
 
-        let mut matching = Vec::new();
-        let selection = selection.iter().next().expect("empty selection");
+        let dimensions = selection_dimensions(&self.keys, selection)?;
 
-        for (block_i, labels) in self.keys.iter().enumerate() {
-            let mut selected = true;
-            for (&requested_i, &value) in dimensions.iter().zip(selection) {
-                if labels[requested_i] != value {
-                    selected = false;
-                    break;
+        if dimensions.len() == self.keys.size() {
+            // the selection contains all the dimensions, we can directly use
+            // the positions of the keys
+            let mut key = vec![LabelValue::new(0); dimensions.len()];
+            let matching = selection.iter().map(|entry| {
+                for (&dimension, &value) in dimensions.iter().zip(entry) {
+                    key[dimension] = value;
                 }
-            }
+                self.keys.position(&key).into_iter().collect()
+            }).collect();
 
-            if selected {
-                matching.push(block_i);
-            }
+            return Ok(matching);
         }
 
+        let index = self.selection_index(&dimensions);
+        let matching = selection.iter()
+            .map(|entry| index.get(entry).cloned().unwrap_or_default())
+            .collect();
+
         return Ok(matching);
     }
 
+    /// Get the `SelectionIndex` for the given keys `dimensions`, creating it
+    /// if needed.
+    fn selection_index(&self, dimensions: &[usize]) -> Arc<SelectionIndex> {
+        if let Some(index) = self.selection_indexes.read().expect("poisoned lock").get(dimensions) {
+            return Arc::clone(index);
+        }
+
+        let mut index = SelectionIndex::default();
+        for (block_i, key) in self.keys.iter().enumerate() {
+            let values = dimensions.iter().map(|&d| key[d]).collect::<Vec<_>>();
+            index.entry(values).or_default().push(block_i);
+        }
+        let index = Arc::new(index);
+
+        let mut indexes = self.selection_indexes.write().expect("poisoned lock");
+        indexes.insert(dimensions.to_vec(), Arc::clone(&index));
+
+        return index;
+    }
+
     /// Move the given dimensions from the component labels to the property labels
     /// for each block in this `TensorMap`.
     pub fn components_to_properties(&self, dimensions: &[&str]) -> Result<TensorMap, Error> {
@@ -273,6 +365,65 @@ impl TensorMap {
 }
 
 
+/// Get the index of entries in `keys` matching the given selection.
+///
+/// This implements the logic of `TensorMap::blocks_matching`, and can be used
+/// before the corresponding `TensorMap` exists (e.g. when loading a subset of
+/// the blocks from a file).
+pub(crate) fn keys_matching(keys: &Labels, selection: &Labels) -> Result<Vec<usize>, Error> {
+    if selection.size() == 0 {
+        return Ok((0..keys.count()).collect());
+    }
+
+    if selection.count() != 1 {
+        return Err(Error::InvalidParameter(format!(
+            "block selection must contain exactly one entry, got {}",
+            selection.count()
+        )));
+    }
+
+    let dimensions = selection_dimensions(keys, selection)?;
+
+    let mut matching = Vec::new();
+    let selection = selection.iter().next().expect("empty selection");
+
+    for (block_i, labels) in keys.iter().enumerate() {
+        let mut selected = true;
+        for (&requested_i, &value) in dimensions.iter().zip(selection) {
+            if labels[requested_i] != value {
+                selected = false;
+                break;
+            }
+        }
+
+        if selected {
+            matching.push(block_i);
+        }
+    }
+
+    return Ok(matching);
+}
+
+/// Get the index in `keys` of all the dimensions in `selection`
+fn selection_dimensions(keys: &Labels, selection: &Labels) -> Result<Vec<usize>, Error> {
+    let mut dimensions = Vec::new();
+    'outer: for requested in selection.names() {
+        for (i, &name) in keys.names().iter().enumerate() {
+            if requested == name {
+                dimensions.push(i);
+                continue 'outer;
+            }
+        }
+
+        return Err(Error::InvalidParameter(format!(
+            "'{}' is not part of the keys for this tensor",
+            requested
+        )));
+    }
+
+    return Ok(dimensions);
+}
+
 #[cfg(test)]
 mod tests {
     use crate::LabelsBuilder;
@@ -464,5 +615,30 @@ mod tests {
             result.unwrap_err().to_string(),
             "invalid parameter: 'key_3' is not part of the keys for this tensor"
         );
+
+        // multiple selections at once
+        let mut selection = LabelsBuilder::new(vec!["key_2"]).unwrap();
+        selection.add(&[2]).unwrap();
+        selection.add(&[5]).unwrap();
+        selection.add(&[1]).unwrap();
+        let selection = selection.finish();
+        assert_eq!(
+            tensor.blocks_matching_many(&selection).unwrap(),
+            [vec![1, 3], vec![], vec![0, 2]]
+        );
+        // the second call re-uses the index
+        assert_eq!(
+            tensor.blocks_matching_many(&selection).unwrap(),
+            [vec![1, 3], vec![], vec![0, 2]]
+        );
+
+        let mut selection = LabelsBuilder::new(vec!["key_2", "key_1"]).unwrap();
+        selection.add(&[3, 4]).unwrap();
+        selection.add(&[1, 2]).unwrap();
+        selection.add(&[2, 1]).unwrap();
+        assert_eq!(
+            tensor.blocks_matching_many(&selection.finish()).unwrap(),
+            [vec![5], vec![], vec![3]]
+        );
     }
 }
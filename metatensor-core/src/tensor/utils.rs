@@ -4,8 +4,11 @@ use std::sync::Arc;
 use indexmap::IndexSet;
 
 use crate::labels::{Labels, LabelsBuilder, LabelValue};
+use crate::utils::{parallel_map, thread_count, max_threads};
 use crate::{Error, TensorBlock, mts_sample_mapping_t};
 
+use super::TensorMap;
+
 /// single block and part of the associated key, this is used for the various
 /// `keys_to_xxx` functions
 pub struct KeyAndBlock<'a> {
@@ -80,20 +83,96 @@ pub fn remove_dimensions_from_keys(keys: &Labels, dimensions: &[&str]) -> Result
     });
 }
 
+/// Group the blocks of `tensor` sharing the same remaining keys after removing
+/// the dimensions in `splitted_keys`, in the same order as
+/// `splitted_keys.new_keys`.
+pub fn group_blocks<'a>(tensor: &'a TensorMap, splitted_keys: &RemovedDimensionsKeys) -> Result<Vec<Vec<KeyAndBlock<'a>>>, Error> {
+    let key_and_block = |block_i: usize| {
+        let key = &tensor.keys[block_i];
+        let mut moved_key = Vec::new();
+        for &i in &splitted_keys.dimensions_positions {
+            moved_key.push(key[i]);
+        }
+
+        KeyAndBlock {
+            key: moved_key,
+            block: &tensor.blocks[block_i],
+        }
+    };
+
+    if splitted_keys.new_keys.count() == 1 {
+        // create a single group with everything. This also covers the case
+        // where all the dimensions are moved, and the new keys do not share
+        // any dimension with the current keys.
+        return Ok(vec![(0..tensor.keys.count()).map(key_and_block).collect()]);
+    }
+
+    let matching = tensor.blocks_matching_many(&splitted_keys.new_keys)?;
+    return Ok(matching.into_iter()
+        .map(|blocks| blocks.into_iter().map(key_and_block).collect())
+        .collect()
+    );
+}
+
+/// Split the maximal number of threads between `n_groups` groups of blocks
+/// merged in parallel, returning the number of threads to use for the
+/// groups, and the number of threads to use inside each group.
+pub fn merge_threads(n_groups: usize) -> (usize, usize) {
+    let n_threads = thread_count(max_threads());
+    let per_group = usize::max(1, n_threads / usize::max(1, n_groups));
+    return (n_threads, per_group);
+}
+
+/// Get the Labels shared by all the entries in `labels`, if they are all
+/// identical. If `sorted` is true, this also requires the Labels to be sorted.
+///
+/// This is used to skip `merge_samples` and `merge_gradient_samples` when
+/// merging blocks with the same samples, which is a very common case when
+/// moving keys to properties.
+pub fn shared_labels<'a>(mut labels: impl Iterator<Item=&'a Arc<Labels>>, sorted: bool) -> Option<Arc<Labels>> {
+    let first = labels.next()?;
+    if sorted && !first.is_sorted() {
+        return None;
+    }
+
+    for other in labels {
+        if !Arc::ptr_eq(first, other) && first != other {
+            return None;
+        }
+    }
+
+    return Some(Arc::clone(first));
+}
+
+/// Get the samples mapping used to move all `count` samples of a block to
+/// the same position in the new block.
+pub fn identity_mapping(count: usize) -> Vec<mts_sample_mapping_t> {
+    return (0..count).map(|i| mts_sample_mapping_t { input: i, output: i }).collect();
+}
+
+/// Merged samples for one of the gradients of a set of merged blocks
+pub struct MergedGradientSamples {
+    /// new gradient samples
+    pub samples: Arc<Labels>,
+    /// for each merged block, where the samples of the gradient should go in
+    /// the new gradient samples
+    pub mappings: Vec<Vec<mts_sample_mapping_t>>,
+}
+
+/// Merge the samples of the gradient with respect to `gradient_name` in all
+/// the `blocks`, using `samples_mappings` to translate the sample dimension
+/// of the gradients. This uses up to `n_threads` threads.
 pub fn merge_gradient_samples(
     blocks: &[KeyAndBlock],
     gradient_name: &str,
     samples_mappings: &[Vec<mts_sample_mapping_t>],
-) -> Result<Arc<Labels>, Error> {
-    let mut new_gradient_samples = BTreeSet::new();
-    let mut new_gradient_sample_names = None;
-    for (KeyAndBlock{block, ..}, samples_mapping) in blocks.iter().zip(samples_mappings) {
+    n_threads: usize,
+) -> Result<MergedGradientSamples, Error> {
+    let gradients = blocks.iter().zip(samples_mappings).collect::<Vec<_>>();
+    let translated = parallel_map(&gradients, n_threads, |(KeyAndBlock{block, ..}, samples_mapping)| {
         let gradient = block.gradient(gradient_name).expect("missing gradient");
 
-        if new_gradient_sample_names.is_none() {
-            new_gradient_sample_names = Some(gradient.samples.names());
-        }
-
+        let mut translated = Vec::with_capacity(gradient.samples.count());
         for grad_sample in &*gradient.samples {
             // translate from the old sample id in gradients to the new ones
             let mut grad_sample = grad_sample.to_vec();
@@ -103,72 +182,310 @@ pub fn merge_gradient_samples(
             debug_assert_eq!(mapping.input, old_sample_i);
             grad_sample[0] = mapping.output.into();
 
-            new_gradient_samples.insert(grad_sample);
+            translated.push(grad_sample);
         }
+        translated
+    });
+
+    let mut new_gradient_samples = BTreeSet::new();
+    for grad_sample in translated.iter().flatten() {
+        new_gradient_samples.insert(grad_sample);
     }
 
-    let mut new_gradient_samples_builder = LabelsBuilder::new(
-        new_gradient_sample_names.expect("missing gradient sample names")
-    )?;
+    let gradient_sample_names = blocks[0].block.gradient(gradient_name)
+        .expect("missing gradient")
+        .samples
+        .names();
 
+    let mut new_gradient_samples_builder = LabelsBuilder::new(gradient_sample_names)?;
     for sample in new_gradient_samples {
-        new_gradient_samples_builder.add(&sample)?;
+        new_gradient_samples_builder.add(sample)?;
     }
+    let new_gradient_samples = Arc::new(new_gradient_samples_builder.finish());
+
+    let mappings = parallel_map(&translated, n_threads, |translated| {
+        translated.iter().enumerate().map(|(sample_i, grad_sample)| {
+            let new_sample_i = new_gradient_samples.position(grad_sample).expect("missing entry in merged samples");
+            mts_sample_mapping_t {
+                input: sample_i,
+                output: new_sample_i,
+            }
+        }).collect()
+    });
 
-    return Ok(Arc::new(new_gradient_samples_builder.finish()));
+    return Ok(MergedGradientSamples {
+        samples: new_gradient_samples,
+        mappings,
+    });
 }
 
+/// Merge the samples of all the `blocks`, adding the key of the blocks to the
+/// samples if `new_sample_names` contains more dimensions than the existing
+/// samples. The mapping from the samples of each block to the merged samples
+/// is computed using up to `n_threads` threads.
+///
+/// All the samples are first sorted with a stable sort (a radix sort if they
+/// can be packed in 64-bit integers, see `SamplesPacking`), which groups
+/// identical samples together. The first sample of each group is the first
+/// one to appear in the blocks, which gives the order of the merged samples
+/// when `sort` is false.
 pub fn merge_samples(
     blocks: &[KeyAndBlock],
     new_sample_names: Vec<&str>,
-    sort: bool
+    sort: bool,
+    n_threads: usize,
 ) -> (Arc<Labels>, Vec<Vec<mts_sample_mapping_t>>) {
-    let add_key_to_samples = blocks[0].block.samples.size() < new_sample_names.len();
-
-    // Collect samples in an IndexSet to keep them in the same order as they
-    // were in the blocks, and then optionally sort them later below
-    let mut merged_samples = IndexSet::new();
-    for KeyAndBlock{key, block} in blocks {
-        for sample in &*block.samples {
-            let mut sample = sample.to_vec();
-            if add_key_to_samples {
-                sample.extend_from_slice(key);
+    let size = new_sample_names.len();
+    let add_key_to_samples = blocks[0].block.samples.size() < size;
+
+    // the samples of all the blocks are indexed globally, with the samples of
+    // block `i` in the `offsets[i]..offsets[i + 1]` range
+    let mut offsets = Vec::with_capacity(blocks.len() + 1);
+    offsets.push(0);
+    for KeyAndBlock{block, ..} in blocks {
+        offsets.push(offsets[offsets.len() - 1] + block.samples.count());
+    }
+    let n_samples = offsets[blocks.len()];
+
+    let (order, samples) = if let Some(packing) = SamplesPacking::new(blocks, add_key_to_samples) {
+        let packed = parallel_map(blocks, n_threads, |KeyAndBlock{key, block}| {
+            let key: &[LabelValue] = if add_key_to_samples { key } else { &[] };
+            block.samples.iter().map(|sample| packing.pack(sample, key)).collect::<Vec<_>>()
+        }).concat();
+
+        let order = radix_argsort(&packed, packing.total_bits);
+        (order, AllSamples::Packed { packed, packing })
+    } else {
+        let mut values = Vec::with_capacity(n_samples * size);
+        for KeyAndBlock{key, block} in blocks {
+            for sample in &*block.samples {
+                values.extend_from_slice(sample);
+                if add_key_to_samples {
+                    values.extend_from_slice(key);
+                }
             }
+        }
 
-            merged_samples.insert(sample);
+        let samples = AllSamples::Flat { values, size };
+        let mut order = (0..n_samples).collect::<Vec<_>>();
+        order.sort_by(|&a, &b| samples.get(a).cmp(samples.get(b)));
+        (order, samples)
+    };
+
+    // assign each sample to a group of identical samples, numbered in the
+    // sorted order, and record the first sample in each group
+    let mut groups = vec![0; n_samples];
+    let mut first_in_group = Vec::new();
+    for (i, &sample) in order.iter().enumerate() {
+        if i == 0 || !samples.equal(order[i - 1], sample) {
+            first_in_group.push(sample);
         }
+        groups[sample] = first_in_group.len() - 1;
     }
+    drop(order);
 
-    if sort {
-        merged_samples.sort_unstable();
+    if !sort {
+        // re-number the groups in the order of their first sample
+        let mut new_group = vec![0; first_in_group.len()];
+        let mut new_first_in_group = Vec::with_capacity(first_in_group.len());
+        for (sample, group) in groups.iter_mut().enumerate() {
+            if first_in_group[*group] == sample {
+                new_group[*group] = new_first_in_group.len();
+                new_first_in_group.push(sample);
+            }
+            *group = new_group[*group];
+        }
+        first_in_group = new_first_in_group;
     }
 
-    let mut merged_samples_builder = LabelsBuilder::new(new_sample_names).expect("invalid new sample names");
-    for sample in merged_samples {
-        merged_samples_builder.add(&sample).expect("got duplicated samples");
+    let mut merged_samples = Vec::with_capacity(first_in_group.len() * size);
+    for &sample in &first_in_group {
+        samples.extend_into(sample, &mut merged_samples);
     }
+    drop(samples);
 
-    let merged_samples = Arc::new(merged_samples_builder.finish());
+    let merged_samples = Labels::new_assume_unique(new_sample_names, merged_samples)
+        .expect("invalid new sample names");
 
-    let mut samples_mappings = Vec::new();
-    for KeyAndBlock{key, block} in blocks {
-        let mut mapping_for_block = Vec::new();
-        for (sample_i, sample) in block.samples.iter().enumerate() {
-            let mut sample = sample.to_vec();
-            if add_key_to_samples {
-                sample.extend_from_slice(key);
+    let ranges = offsets.windows(2).map(|w| w[0]..w[1]).collect::<Vec<_>>();
+    let samples_mappings = parallel_map(&ranges, n_threads, |range| {
+        groups[range.clone()].iter().enumerate().map(|(sample_i, &group)| {
+            mts_sample_mapping_t {
+                input: sample_i,
+                output: group,
             }
+        }).collect()
+    });
 
-            let new_sample_i = merged_samples.position(&sample).expect("missing entry in merged samples");
-            mapping_for_block.push(mts_sample_mapping_t {
-                input: sample_i,
-                output: new_sample_i,
-            });
+    return (Arc::new(merged_samples), samples_mappings);
+}
+
+/// Values of all the samples to merge in `merge_samples`
+enum AllSamples {
+    /// samples packed in 64-bit integers
+    Packed {
+        packed: Vec<u64>,
+        packing: SamplesPacking,
+    },
+    /// samples stored as a linearized 2D array
+    Flat {
+        values: Vec<LabelValue>,
+        size: usize,
+    },
+}
+
+impl AllSamples {
+    /// Get the values of the `i`-th sample, for samples stored as a 2D array
+    fn get(&self, i: usize) -> &[LabelValue] {
+        match self {
+            AllSamples::Flat { values, size } => &values[(i * size)..((i + 1) * size)],
+            AllSamples::Packed { .. } => unreachable!("can not get packed samples as a slice"),
+        }
+    }
+
+    /// Check if the samples `i` and `j` are identical
+    fn equal(&self, i: usize, j: usize) -> bool {
+        match self {
+            AllSamples::Packed { packed, .. } => packed[i] == packed[j],
+            AllSamples::Flat { .. } => self.get(i) == self.get(j),
+        }
+    }
+
+    /// Add the values of the `i`-th sample at the end of `output`
+    fn extend_into(&self, i: usize, output: &mut Vec<LabelValue>) {
+        match self {
+            AllSamples::Packed { packed, packing } => packing.unpack(packed[i], output),
+            AllSamples::Flat { .. } => output.extend_from_slice(self.get(i)),
+        }
+    }
+}
+
+/// Packing of samples in 64-bit integers. Each dimension of the samples is
+/// stored as the offset from the minimal value of this dimension, using only
+/// as many bits as required for the range of values in this dimension. The
+/// first dimension is stored in the highest bits, so the packed integers are
+/// sorted in the same order as the samples.
+struct SamplesPacking {
+    minimum: Vec<i32>,
+    bits: Vec<u32>,
+    total_bits: u32,
+}
+
+impl SamplesPacking {
+    /// Get the packing for the samples of all `blocks` (with the key of the
+    /// blocks if `add_key_to_samples` is true), or `None` if the samples do
+    /// not fit in 64 bits.
+    #[allow(clippy::cast_sign_loss)]
+    fn new(blocks: &[KeyAndBlock], add_key_to_samples: bool) -> Option<SamplesPacking> {
+        let sample_size = blocks[0].block.samples.size();
+        let size = if add_key_to_samples {
+            sample_size + blocks[0].key.len()
+        } else {
+            sample_size
+        };
+
+        let mut minimum = vec![i32::MAX; size];
+        let mut maximum = vec![i32::MIN; size];
+        let mut update = |values: &[LabelValue], start: usize| {
+            for (i, value) in values.iter().enumerate() {
+                minimum[start + i] = i32::min(minimum[start + i], value.i32());
+                maximum[start + i] = i32::max(maximum[start + i], value.i32());
+            }
+        };
+
+        for KeyAndBlock{key, block} in blocks {
+            for sample in &*block.samples {
+                update(sample, 0);
+            }
+
+            if add_key_to_samples && block.samples.count() != 0 {
+                update(key, sample_size);
+            }
+        }
+
+        let bits = minimum.iter().zip(&maximum).map(|(&min, &max)| {
+            if min >= max {
+                0
+            } else {
+                let range = (i64::from(max) - i64::from(min)) as u64;
+                u64::BITS - range.leading_zeros()
+            }
+        }).collect::<Vec<_>>();
+
+        let total_bits = bits.iter().sum();
+        if total_bits > u64::BITS {
+            return None;
+        }
+
+        return Some(SamplesPacking { minimum, bits, total_bits });
+    }
+
+    /// Pack the values of `sample` followed by the values of `key`
+    #[allow(clippy::cast_sign_loss)]
+    fn pack(&self, sample: &[LabelValue], key: &[LabelValue]) -> u64 {
+        debug_assert_eq!(sample.len() + key.len(), self.bits.len());
+        let mut packed = 0;
+        let values = sample.iter().chain(key);
+        for ((value, &minimum), &bits) in values.zip(&self.minimum).zip(&self.bits) {
+            // shifting by 64 bits is an overflow, but no single dimension can
+            // use more than 32 bits
+            packed = (packed << bits) | (i64::from(value.i32()) - i64::from(minimum)) as u64;
+        }
+        return packed;
+    }
+
+    /// Unpack the values of a sample, adding them to the end of `output`
+    #[allow(clippy::cast_possible_truncation, clippy::cast_possible_wrap)]
+    fn unpack(&self, mut packed: u64, output: &mut Vec<LabelValue>) {
+        let start = output.len();
+        output.resize(start + self.bits.len(), LabelValue::new(0));
+        let unpacked = &mut output[start..];
+        for i in (0..self.bits.len()).rev() {
+            let bits = self.bits[i];
+            let offset = packed & ((1 << bits) - 1);
+            packed = if bits == 0 { packed } else { packed >> bits };
+
+            let value = i64::from(self.minimum[i]) + offset as i64;
+            unpacked[i] = LabelValue::new(value as i32);
+        }
+    }
+}
+
+/// Get the indices that would sort the lowest `bits` of `values`, using a
+/// stable least significant digit radix sort with 8-bit digits
+fn radix_argsort(values: &[u64], bits: u32) -> Vec<usize> {
+    let mut current = values.iter().copied().zip(0..).collect::<Vec<(u64, usize)>>();
+    let mut next = vec![(0, 0); current.len()];
+
+    let mut shift = 0;
+    while shift < bits {
+        let mut counts = [0_usize; 256];
+        for &(value, _) in &current {
+            counts[((value >> shift) & 0xff) as usize] += 1;
+        }
+
+        // if all values have the same digit, this pass would not change the
+        // order, and we can skip it
+        if !counts.contains(&current.len()) {
+            let mut start = 0;
+            for count in &mut counts {
+                let size = *count;
+                *count = start;
+                start += size;
+            }
+
+            for &(value, i) in &current {
+                let digit = ((value >> shift) & 0xff) as usize;
+                next[counts[digit]] = (value, i);
+                counts[digit] += 1;
+            }
+            std::mem::swap(&mut current, &mut next);
         }
-        samples_mappings.push(mapping_for_block);
+
+        shift += 8;
     }
 
-    return (merged_samples, samples_mappings)
+    return current.into_iter().map(|(_, i)| i).collect();
 }
 
 /******************************************************************************/
@@ -191,3 +508,98 @@ mod tests_utils {
         return Arc::new(labels.finish());
     }
 }
+
+#[cfg(test)]
+mod tests {
+    use crate::data::TestArray;
+    use crate::labels::LabelValue;
+    use crate::TensorBlock;
+
+    use super::*;
+
+    #[test]
+    fn radix_sort() {
+        let values = [5, 3, 0x1_0000_0003, 5, 0, 0x300, 3];
+        assert_eq!(radix_argsort(&values, 33), [4, 1, 6, 0, 3, 5, 2]);
+        assert_eq!(radix_argsort(&[], 64), Vec::<usize>::new());
+    }
+
+    fn check_merge_samples(blocks: &[KeyAndBlock], names: Vec<&str>, sort: bool) {
+        // reference implementation, collecting samples in an `IndexSet`
+        let add_key = blocks[0].block.samples.size() < names.len();
+        let mut expected = IndexSet::new();
+        for KeyAndBlock{key, block} in blocks {
+            for sample in &*block.samples {
+                let mut sample = sample.to_vec();
+                if add_key {
+                    sample.extend_from_slice(key);
+                }
+                expected.insert(sample);
+            }
+        }
+        if sort {
+            expected.sort_unstable();
+        }
+
+        let (merged, mappings) = merge_samples(blocks, names, sort, 2);
+        assert_eq!(merged.count(), expected.len());
+        for (merged, expected) in merged.iter().zip(&expected) {
+            assert_eq!(merged, &**expected);
+        }
+
+        for (KeyAndBlock{key, block}, mapping) in blocks.iter().zip(&mappings) {
+            assert_eq!(mapping.len(), block.samples.count());
+            for (sample_i, sample) in block.samples.iter().enumerate() {
+                let mut sample = sample.to_vec();
+                if add_key {
+                    sample.extend_from_slice(key);
+                }
+                assert_eq!(mapping[sample_i].input, sample_i);
+                assert_eq!(mapping[sample_i].output, expected.get_index_of(&sample).unwrap());
+            }
+        }
+    }
+
+    fn block_with_samples<const N: usize>(samples: Vec<[i32; N]>) -> TensorBlock {
+        let names = (0..N).map(|i| format!("s_{}", i)).collect::<Vec<_>>();
+        let count = samples.len();
+        return TensorBlock::new(
+            TestArray::new(vec![count, 1]),
+            example_labels(names.iter().map(|s| &**s).collect(), samples),
+            vec![],
+            example_labels(vec!["properties"], vec![[0]]),
+        ).unwrap();
+    }
+
+    #[test]
+    fn merge() {
+        let block_1 = block_with_samples(vec![[3, -2], [0, 5], [1, 1]]);
+        let block_2 = block_with_samples(vec![[1, 1], [-4, 7], [3, -2], [0, 0]]);
+        let block_3 = block_with_samples::<2>(vec![]);
+
+        let key = |i: i32| vec![LabelValue::new(i)];
+        let blocks = [
+            KeyAndBlock { key: key(6), block: &block_1 },
+            KeyAndBlock { key: key(6), block: &block_3 },
+            KeyAndBlock { key: key(-1), block: &block_2 },
+        ];
+
+        for sort in [true, false] {
+            check_merge_samples(&blocks, vec!["s_0", "s_1"], sort);
+            check_merge_samples(&blocks, vec!["s_0", "s_1", "key"], sort);
+        }
+
+        // these samples do not fit in 64 bits
+        let block_1 = block_with_samples(vec![[i32::MIN, 0, i32::MAX], [3, 2, 1], [i32::MAX, 0, i32::MIN]]);
+        let block_2 = block_with_samples(vec![[3, 2, 1], [0, i32::MIN, 0]]);
+        let blocks = [
+            KeyAndBlock { key: key(0), block: &block_1 },
+            KeyAndBlock { key: key(1), block: &block_2 },
+        ];
+
+        for sort in [true, false] {
+            check_merge_samples(&blocks, vec!["s_0", "s_1", "s_2"], sort);
+            check_merge_samples(&blocks, vec!["s_0", "s_1", "s_2", "key"], sort);
+        }
+    }
+}
@@ -1,4 +1,5 @@
 use std::ffi::{CString, CStr};
+use std::sync::atomic::{AtomicUsize, Ordering};
 
 
 /// An analog to `std::ffi::CString` that is immutable & can be shared between
@@ -66,3 +67,95 @@ impl std::fmt::Debug for ConstCString {
         f.debug_tuple("ConstCString").field(&self.as_c_str()).finish()
     }
 }
+
+/// Maximal number of threads used by operations running in parallel on their
+/// own (e.g. `TensorMap::keys_to_properties`), where `0` means "use all the
+/// available cores".
+static MAX_THREADS: AtomicUsize = AtomicUsize::new(0);
+
+/// Set the maximal number of threads used by operations running in parallel on
+/// their own. Setting this to `0` uses all the available cores, and setting it
+/// to `1` runs everything on the calling thread.
+pub fn set_max_threads(n_threads: usize) {
+    MAX_THREADS.store(n_threads, Ordering::Relaxed);
+}
+
+/// Get the maximal number of threads set with `set_max_threads`
+pub fn max_threads() -> usize {
+    MAX_THREADS.load(Ordering::Relaxed)
+}
+
+/// Get the number of threads to use for parallel operations, where `0` means
+/// "use all the available cores".
+pub fn thread_count(n_threads: usize) -> usize {
+    if n_threads == 0 {
+        std::thread::available_parallelism().map_or(1, std::num::NonZeroUsize::get)
+    } else {
+        n_threads
+    }
+}
+
+/// Apply `function` to all the `inputs`, using up to `n_threads` threads in
+/// parallel, and return the outputs in the same order as the inputs.
+///
+/// The threads pick the next input to process as soon as they are done with
+/// the previous one, so inputs with different costs are still balanced
+/// between threads. This runs everything on the current thread if there is a
+/// single thread or a single input.
+pub fn parallel_map<T, U, F>(inputs: &[T], n_threads: usize, function: F) -> Vec<U>
+    where T: Sync, U: Send, F: Fn(&T) -> U + Sync
+{
+    let n_threads = usize::min(thread_count(n_threads), inputs.len());
+    if n_threads <= 1 {
+        return inputs.iter().map(function).collect();
+    }
+
+    let next = std::sync::atomic::AtomicUsize::new(0);
+    let mut outputs = std::iter::repeat_with(|| None).take(inputs.len()).collect::<Vec<_>>();
+
+    let next = &next;
+    let function = &function;
+    std::thread::scope(|scope| {
+        let threads = (0..n_threads).map(|_| scope.spawn(move || {
+            let mut outputs = Vec::new();
+            loop {
+                let i = next.fetch_add(1, std::sync::atomic::Ordering::Relaxed);
+                if i >= inputs.len() {
+                    break;
+                }
+                outputs.push((i, function(&inputs[i])));
+            }
+            outputs
+        })).collect::<Vec<_>>();
+
+        for thread in threads {
+            let thread_outputs = match thread.join() {
+                Ok(outputs) => outputs,
+                Err(panic) => std::panic::resume_unwind(panic),
+            };
+
+            for (i, output) in thread_outputs {
+                outputs[i] = Some(output);
+            }
+        }
+    });
+
+    return outputs.into_iter().map(|output| output.expect("missing output in parallel_map")).collect();
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn parallel_map_keeps_order() {
+        let inputs = (0..1000).collect::<Vec<usize>>();
+        for n_threads in [0, 1, 3, 16] {
+            let outputs = parallel_map(&inputs, n_threads, |&i| 2 * i);
+            assert_eq!(outputs, inputs.iter().map(|i| 2 * i).collect::<Vec<_>>());
+        }
+
+        let outputs = parallel_map(&[] as &[usize], 4, |&i| i);
+        assert!(outputs.is_empty());
+    }
+}
@@ -163,6 +163,124 @@ TEST_CASE("Blocks") {
         CHECK(buffer == std::string("metatensor::EmptyDataArray"));
     }
 
+    SECTION("slice samples") {
+        auto properties = Labels({"properties"}, {{5}, {3}});
+        auto block = TensorBlock(
+            std::unique_ptr<SimpleDataArray>(new SimpleDataArray({4, 2}, {
+                0.0, 1.0,
+                2.0, 3.0,
+                4.0, 5.0,
+                6.0, 7.0,
+            })),
+            Labels({"samples"}, {{0}, {1}, {4}, {2}}),
+            {},
+            properties
+        );
+
+        auto gradient = TensorBlock(
+            std::unique_ptr<SimpleDataArray>(new SimpleDataArray({4, 2}, {
+                10.0, 11.0,
+                12.0, 13.0,
+                14.0, 15.0,
+                16.0, 17.0,
+            })),
+            Labels({"sample", "parameter"}, {{0, 1}, {1, 0}, {1, 2}, {3, 1}}),
+            {},
+            properties
+        );
+        block.add_gradient("parameter", std::move(gradient));
+
+        auto slice = block.slice_samples(1, 3);
+        CHECK(slice.samples() == Labels({"samples"}, {{1}, {4}}));
+        CHECK(slice.properties() == properties);
+        const auto& values = SimpleDataArray::from_mts_array(slice.mts_array());
+        CHECK(values == SimpleDataArray({2, 2}, {2.0, 3.0, 4.0, 5.0}));
+
+        auto sliced_gradient = slice.gradient("parameter");
+        CHECK(sliced_gradient.samples() == Labels({"sample", "parameter"}, {{0, 0}, {0, 2}}));
+        const auto& gradient_values = SimpleDataArray::from_mts_array(sliced_gradient.mts_array());
+        CHECK(gradient_values == SimpleDataArray({2, 2}, {12.0, 13.0, 14.0, 15.0}));
+
+        auto blocks = block.split_samples({1, 1, 3});
+        REQUIRE(blocks.size() == 4);
+        CHECK(blocks[0].samples() == Labels({"samples"}, {{0}}));
+        CHECK(blocks[1].samples().count() == 0);
+        CHECK(blocks[1].gradient("parameter").samples().count() == 0);
+        CHECK(blocks[2].samples() == Labels({"samples"}, {{1}, {4}}));
+        CHECK(blocks[3].samples() == Labels({"samples"}, {{2}}));
+        CHECK(blocks[3].gradient("parameter").samples() == Labels({"sample", "parameter"}, {{0, 1}}));
+
+        CHECK_THROWS_WITH(
+            block.slice_samples(3, 5),
+            "invalid parameter: invalid range of samples 3..5 for a block with 4 samples"
+        );
+    }
+
+    SECTION("memory usage") {
+        auto properties = Labels({"properties"}, {{5}, {3}});
+        auto block = TensorBlock(
+            std::unique_ptr<SimpleDataArray>(new SimpleDataArray({3, 2})),
+            Labels({"samples"}, {{0}, {1}, {4}}),
+            {},
+            properties
+        );
+
+        auto gradient = TensorBlock(
+            std::unique_ptr<SimpleDataArray>(new SimpleDataArray({4, 2})),
+            Labels({"sample", "parameter"}, {{0, 1}, {1, 0}, {1, 2}, {2, 1}}),
+            {},
+            properties
+        );
+        block.add_gradient("parameter", std::move(gradient));
+
+        auto usage = block.memory_usage();
+        CHECK(usage.values == 3 * 2 * sizeof(double));
+        CHECK(usage.gradients_values == 4 * 2 * sizeof(double));
+
+        // the properties are shared with the gradient, and only counted once
+        auto expected = block.samples().memory_usage().labels_values + properties.memory_usage().labels_values;
+        CHECK(usage.labels_values == expected);
+        CHECK(usage.gradients_metadata == block.gradient("parameter").samples().memory_usage().labels_values);
+    }
+
+    SECTION("identical labels are shared") {
+        auto first = TensorBlock(
+            std::unique_ptr<SimpleDataArray>(new SimpleDataArray({3, 2})),
+            Labels({"samples"}, {{0}, {1}, {4}}),
+            {},
+            Labels({"properties"}, {{5}, {3}})
+        );
+
+        auto second = TensorBlock(
+            std::unique_ptr<SimpleDataArray>(new SimpleDataArray({2, 2})),
+            Labels({"samples"}, {{0}, {2}}),
+            {},
+            Labels({"properties"}, {{5}, {3}})
+        );
+
+        auto first_properties = first.properties().as_mts_labels_t();
+        auto second_properties = second.properties().as_mts_labels_t();
+        CHECK(first_properties.internal_ptr_ == second_properties.internal_ptr_);
+
+        auto first_samples = first.samples().as_mts_labels_t();
+        auto second_samples = second.samples().as_mts_labels_t();
+        CHECK(first_samples.internal_ptr_ != second_samples.internal_ptr_);
+
+        // user data on shared labels would be visible from all blocks
+        auto properties = first.properties();
+        auto user_data = metatensor::LabelsUserData(new int(3), [](void* ptr) {
+            delete static_cast<int*>(ptr);
+        });
+        CHECK_THROWS_WITH(
+            properties.set_user_data(std::move(user_data)),
+            "invalid parameter: can not set user data on these labels: they are "
+            "stored inside a block and might be shared with other blocks, create "
+            "new labels with the same entries instead"
+        );
+        auto second_properties_labels = second.properties();
+        CHECK(second_properties_labels.user_data() == nullptr);
+    }
+
     SECTION("empty labels") {
         auto block = TensorBlock(
             std::unique_ptr<SimpleDataArray>(new SimpleDataArray({3, 0})),
@@ -105,3 +105,291 @@ TEST_CASE("Data Array") {
 
     array.destroy(array.ptr);
 }
+
+TEST_CASE("Sparse Data Array") {
+    auto sparse = SparseDataArray({2, 3, 4});
+    sparse.set({0, 1, 2}, 1.0);
+    sparse.set({1, 2, 3}, 2.0);
+    sparse.set({1, 0, 0}, 3.0);
+    CHECK(sparse.nnz() == 3);
+
+    sparse.set({1, 0, 0}, 0.0);
+    CHECK(sparse.nnz() == 2);
+    CHECK(sparse.get({0, 1, 2}) == 1.0);
+    CHECK(sparse.get({1, 0, 0}) == 0.0);
+
+    SECTION("origin") {
+        auto array = DataArrayBase::to_mts_array_t(std::unique_ptr<DataArrayBase>(new SparseDataArray(sparse)));
+
+        mts_data_origin_t origin = 0;
+        auto status = array.origin(array.ptr, &origin);
+        CHECK(status == MTS_SUCCESS);
+
+        char buffer[64] = {0};
+        status = mts_get_data_origin(origin, buffer, 64);
+        CHECK(status == MTS_SUCCESS);
+        CHECK(std::string(buffer) == "metatensor::SparseDataArray");
+
+        CHECK(SparseDataArray::from_mts_array(array).nnz() == 2);
+        array.destroy(array.ptr);
+    }
+
+    SECTION("dense data") {
+        auto expected = sparse.to_dense();
+
+        auto* data = sparse.data();
+        CHECK(data[6] == 1.0);
+        CHECK(data[23] == 2.0);
+        CHECK(sparse.to_dense() == expected);
+
+        // modifications of the dense data are kept when going back to sparse
+        data[0] = 4.0;
+        sparse.reshape({6, 4});
+        sparse.swap_axes(0, 1);
+        CHECK(sparse.nnz() == 3);
+        CHECK(sparse.get({0, 0}) == 4.0);
+        CHECK(sparse.get({2, 1}) == 1.0);
+        CHECK(sparse.get({3, 5}) == 2.0);
+    }
+
+    SECTION("shape") {
+        auto dense = sparse.to_dense();
+
+        sparse.swap_axes(0, 2);
+        dense.swap_axes(0, 2);
+        CHECK(sparse.shape() == std::vector<uintptr_t>{4, 3, 2});
+        CHECK(sparse.get({2, 1, 0}) == 1.0);
+        CHECK(sparse.get({3, 2, 1}) == 2.0);
+        CHECK(sparse.nnz() == 2);
+
+        sparse.reshape({12, 2});
+        CHECK(sparse.get({7, 0}) == 1.0);
+        CHECK(sparse.get({11, 1}) == 2.0);
+        CHECK_THROWS_WITH(sparse.reshape({5, 5}), "invalid shape in reshape");
+    }
+
+    SECTION("keys_to_properties") {
+        auto create_block = [](double value, int32_t property) {
+            auto values = std::unique_ptr<SparseDataArray>(new SparseDataArray({3, 1, 2}));
+            values->set({1, 0, 1}, value);
+            return TensorBlock(
+                std::move(values),
+                Labels({"s"}, {{0}, {1}, {2}}),
+                {Labels({"c"}, {{0}})},
+                Labels({"p"}, {{property}, {property + 1}})
+            );
+        };
+
+        auto blocks = std::vector<TensorBlock>();
+        blocks.emplace_back(create_block(1.0, 0));
+        blocks.emplace_back(create_block(2.0, 2));
+        auto tensor = TensorMap(Labels({"key"}, {{0}, {1}}), std::move(blocks));
+
+        auto merged = tensor.keys_to_properties("key");
+        auto block = merged.block_by_id(0);
+        const auto& values = SparseDataArray::from_mts_array(block.mts_array());
+
+        auto expected = SimpleDataArray({3, 1, 4}, {
+            0.0, 0.0, 0.0, 0.0,
+            0.0, 1.0, 0.0, 2.0,
+            0.0, 0.0, 0.0, 0.0,
+        });
+
+        CHECK(values.shape() == std::vector<uintptr_t>{3, 1, 4});
+        CHECK(values.nnz() == 2);
+        CHECK(values.to_dense() == expected);
+
+        // memory_usage() should not access the data of the arrays, which
+        // would switch them to dense storage
+        auto usage = tensor.memory_usage();
+        CHECK(usage.values == 2 * 3 * 1 * 2 * sizeof(double));
+        for (size_t i = 0; i < tensor.keys().count(); i++) {
+            const auto& input = SparseDataArray::from_mts_array(tensor.block_by_id(i).mts_array());
+            CHECK_FALSE(input.is_dense());
+        }
+
+        // switch the arrays to dense storage, we should still be able to
+        // merge them afterward
+        for (size_t i = 0; i < tensor.keys().count(); i++) {
+            auto input_block = tensor.block_by_id(i);
+            input_block.values();
+            const auto& input = SparseDataArray::from_mts_array(input_block.mts_array());
+            CHECK(input.is_dense());
+        }
+
+        auto merged_dense = tensor.keys_to_properties("key");
+        block = merged_dense.block_by_id(0);
+        const auto& values_after_dense = SparseDataArray::from_mts_array(block.mts_array());
+        CHECK(values_after_dense.nnz() == 2);
+        CHECK(values_after_dense.to_dense() == expected);
+    }
+
+    SECTION("move_samples_from") {
+        auto input = SparseDataArray({2, 2, 2});
+        input.set({0, 0, 1}, 1.0);
+        input.set({1, 1, 0}, 2.0);
+
+        auto output = SparseDataArray({3, 2, 4});
+        output.set({2, 0, 0}, 5.0);
+        output.set({2, 1, 2}, 6.0);
+        output.set({0, 1, 3}, 7.0);
+
+        // the existing elements in the output range are overwritten
+        output.move_samples_from(input, {{0, 0}, {1, 2}}, 2, 4);
+        CHECK(output.nnz() == 3);
+        CHECK(output.get({0, 0, 3}) == 1.0);
+        CHECK(output.get({0, 1, 3}) == 0.0);
+        CHECK(output.get({2, 0, 0}) == 5.0);
+        CHECK(output.get({2, 1, 2}) == 2.0);
+
+        // the data of the input can also be stored as dense
+        input.data()[0] = 3.0;
+        output.move_samples_from(input, {{0, 1}}, 0, 2);
+        CHECK(output.nnz() == 5);
+        CHECK(output.get({1, 0, 0}) == 3.0);
+        CHECK(output.get({1, 0, 1}) == 1.0);
+        CHECK(output.to_dense() == SimpleDataArray({3, 2, 4}, {
+            0.0, 0.0, 0.0, 1.0,
+            0.0, 0.0, 0.0, 0.0,
+            3.0, 1.0, 0.0, 0.0,
+            0.0, 0.0, 0.0, 0.0,
+            5.0, 0.0, 0.0, 0.0,
+            0.0, 0.0, 2.0, 0.0,
+        }));
+    }
+}
+
+TEST_CASE("Arena Data Array") {
+    auto arena = std::make_shared<DataArrayArena>(/*chunk_size=*/ 1024);
+
+    SECTION("origin") {
+        auto array = DataArrayBase::to_mts_array_t(std::unique_ptr<DataArrayBase>(new ArenaDataArray(arena, {3, 2})));
+
+        mts_data_origin_t origin = 0;
+        auto status = array.origin(array.ptr, &origin);
+        CHECK(status == MTS_SUCCESS);
+
+        char buffer[64] = {0};
+        status = mts_get_data_origin(origin, buffer, 64);
+        CHECK(status == MTS_SUCCESS);
+        CHECK(std::string(buffer) == "metatensor::ArenaDataArray");
+
+        CHECK(ArenaDataArray::from_mts_array(array).shape() == std::vector<uintptr_t>{3, 2});
+        array.destroy(array.ptr);
+    }
+
+    SECTION("allocations") {
+        auto first = ArenaDataArray(arena, {3, 2});
+        auto second = first.create({4, 5});
+        CHECK(arena->allocated_size() == 1024 * sizeof(double));
+
+        // data is aligned to 64 bytes inside the same chunk
+        CHECK(second->data() - first.data() == 8);
+        CHECK(second->data()[19] == 0.0);
+
+        // larger arrays get their own chunk
+        auto large = ArenaDataArray(arena, {2000});
+        CHECK(arena->allocated_size() == 3024 * sizeof(double));
+
+        arena->reserve(1000);
+        CHECK(arena->allocated_size() == 4048 * sizeof(double));
+
+        // arrays keep their chunk alive after the arena is destroyed
+        first.data()[5] = 3.0;
+        arena.reset();
+        auto copy = first.copy();
+        CHECK(copy->data()[5] == 3.0);
+    }
+
+    SECTION("shape") {
+        auto array = ArenaDataArray(arena, {2, 3});
+        auto view = array.view();
+        for (size_t i=0; i<2; i++) {
+            for (size_t j=0; j<3; j++) {
+                view(i, j) = static_cast<double>(i * 3 + j);
+            }
+        }
+
+        array.swap_axes(0, 1);
+        CHECK(array.shape() == std::vector<uintptr_t>{3, 2});
+        view = array.view();
+        CHECK(view(2, 1) == 5.0);
+        CHECK(view(1, 0) == 1.0);
+
+        array.reshape({6});
+        view = array.view();
+        CHECK(view(1) == 3.0);
+        CHECK_THROWS_WITH(array.reshape({5, 5}), "invalid shape in reshape");
+    }
+
+    SECTION("keys_to_properties") {
+        auto create_block = [&](double value, std::initializer_list<std::initializer_list<int32_t>> samples) {
+            auto values = std::unique_ptr<ArenaDataArray>(new ArenaDataArray(arena, {2, 3, 1}));
+            auto view = values->view();
+            for (size_t i=0; i<2; i++) {
+                for (size_t j=0; j<3; j++) {
+                    view(i, j, 0) = value + static_cast<double>(j);
+                }
+            }
+
+            return TensorBlock(
+                std::move(values),
+                Labels({"s"}, samples),
+                {Labels({"c"}, {{0}, {1}, {2}})},
+                Labels({"p"}, {{0}})
+            );
+        };
+
+        auto blocks = std::vector<TensorBlock>();
+        blocks.emplace_back(create_block(1.0, {{0}, {1}}));
+        blocks.emplace_back(create_block(10.0, {{1}, {2}}));
+        auto tensor = TensorMap(Labels({"key"}, {{0}, {1}}), std::move(blocks));
+
+        auto merged = tensor.keys_to_properties("key");
+        auto block = merged.block_by_id(0);
+        const auto& values = ArenaDataArray::from_mts_array(block.mts_array());
+        CHECK(values.arena() == arena);
+        CHECK(values.shape() == std::vector<uintptr_t>{3, 3, 2});
+
+        auto view = values.view();
+        CHECK(view(0, 1, 0) == 2.0);
+        CHECK(view(0, 1, 1) == 0.0);
+        CHECK(view(1, 2, 0) == 3.0);
+        CHECK(view(1, 2, 1) == 12.0);
+        CHECK(view(2, 0, 0) == 0.0);
+        CHECK(view(2, 0, 1) == 10.0);
+
+        merged = tensor.keys_to_samples("key");
+        block = merged.block_by_id(0);
+        const auto& samples_values = ArenaDataArray::from_mts_array(block.mts_array());
+        CHECK(samples_values.shape() == std::vector<uintptr_t>{4, 3, 1});
+        view = samples_values.view();
+        CHECK(view(3, 2, 0) == 12.0);
+    }
+
+    SECTION("create_array") {
+        auto shape = std::vector<uintptr_t>{2, 2};
+        mts_array_t array;
+        std::memset(&array, 0, sizeof(array));
+
+        auto status = DataArrayArena::create_array(shape.data(), shape.size(), &array);
+        CHECK(status != MTS_SUCCESS);
+
+        {
+            DataArrayArena::Scope scope(arena);
+            status = DataArrayArena::create_array(shape.data(), shape.size(), &array);
+            CHECK(status == MTS_SUCCESS);
+        }
+
+        CHECK(ArenaDataArray::from_mts_array(array).arena() == arena);
+
+        // arrays created by operations on arrays from `create_array` are
+        // still filled with zeros
+        auto values = ArenaDataArray::from_mts_array(array).create({2, 3});
+        for (size_t i=0; i<6; i++) {
+            CHECK(values->data()[i] == 0.0);
+        }
+
+        array.destroy(array.ptr);
+    }
+}
@@ -23,6 +23,11 @@ TEST_CASE("Labels") {
     CHECK(labels.position({3, 4}) == 1);
     CHECK(labels.position({1, 4}) == -1);
 
+    auto entries = std::vector<int32_t>{5, 6, 1, 4, 1, 2};
+    CHECK(labels.positions(entries.data(), 3) == std::vector<int64_t>{2, -1, 0});
+    CHECK(labels.positions(NDArray<int32_t>(entries.data(), {3, 2})) == std::vector<int64_t>{2, -1, 0});
+    CHECK(labels.positions(entries.data(), 0).empty());
+
     const auto& values = labels.values();
     CHECK(values(0, 0) == 1);
     CHECK(values(0, 1) == 2);
@@ -44,6 +49,13 @@ TEST_CASE("Labels") {
 
     CHECK_THROWS_WITH(Labels({"foo"}, {{1}, {3, 4}}), "invalid size for row: expected 1 got 2");
 
+    // labels created without checking for duplicated entries
+    auto unique_values = std::vector<int32_t>{5, 6, 1, 2, 3, 4};
+    auto unique = Labels({"foo", "bar"}, unique_values.data(), 3, metatensor::assume_unique{});
+    CHECK(unique == Labels({"foo", "bar"}, {{5, 6}, {1, 2}, {3, 4}}));
+    CHECK(unique.position({1, 2}) == 1);
+    CHECK(unique.position({1, 4}) == -1);
+
     CHECK_THROWS_WITH(
         Labels({"not an ident"}, {{0}}),
         "invalid parameter: 'not an ident' is not a valid label name"
@@ -171,7 +183,8 @@ TEST_CASE("User data") {
         CHECK(data_ptr->count == 42);
         CHECK(data_ptr->values == std::vector<double>{1.0, 2.0, 3.0, 42.1, 12356});
 
-        // check that we can register user data after the construction of the block
+        // labels inside a block can be shared with other blocks, so we can
+        // not register user data on them after the construction of the block
         data = new UserData{"properties", 0, {}};
         user_data = metatensor::LabelsUserData(data, [](void* ptr){
             DELETE_CALL_MARKER += 10000000;
@@ -179,14 +192,17 @@ TEST_CASE("User data") {
         });
 
         auto properties = block.properties();
-        properties.set_user_data(std::move(user_data));
+        CHECK_THROWS_WITH(
+            properties.set_user_data(std::move(user_data)),
+            "invalid parameter: can not set user data on these labels: they are "
+            "stored inside a block and might be shared with other blocks, create "
+            "new labels with the same entries instead"
+        );
 
+        // the user data was released when the call failed
+        CHECK(DELETE_CALL_MARKER == 10000000);
         properties = block.properties();
-        data_ptr = static_cast<UserData*>(properties.user_data());
-        REQUIRE(data_ptr != nullptr);
-        CHECK(data_ptr->name == "properties");
-        CHECK(data_ptr->count == 0);
-        CHECK(data_ptr->values.empty());
+        CHECK(properties.user_data() == nullptr);
     }
 
     // Check that the `user_data_delete` function was called the
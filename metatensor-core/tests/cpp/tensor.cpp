@@ -1,5 +1,6 @@
 #include <fstream>
 #include <sstream>
+#include <cstdio>
 #include <cstdlib>
 
 #include <catch.hpp>
@@ -38,6 +39,14 @@ TEST_CASE("TensorMap") {
         CHECK(matching.size() == 2);
         CHECK(matching[0] == 0);
         CHECK(matching[1] == 1);
+
+        // multiple selections at once
+        selection = Labels({"key_2"}, {{0}, {3}, {5}});
+        auto all_matching = tensor.blocks_matching_many(selection);
+        REQUIRE(all_matching.size() == 3);
+        CHECK(all_matching[0] == std::vector<uintptr_t>{0, 1});
+        CHECK(all_matching[1] == std::vector<uintptr_t>{3});
+        CHECK(all_matching[2].empty());
     }
 
     SECTION("keys_to_samples") {
@@ -101,6 +110,33 @@ TEST_CASE("TensorMap") {
         }));
     }
 
+    SECTION("join_samples") {
+        auto tensors = std::vector<TensorMap>();
+        tensors.emplace_back(test_tensor_map());
+        tensors.emplace_back(test_tensor_map());
+
+        auto tensor = metatensor::join_samples(tensors, "tensor");
+        CHECK(tensor.keys() == tensors[0].keys());
+
+        auto block = tensor.block_by_id(0);
+        CHECK(block.samples() == Labels({"samples", "tensor"}, {
+            {0, 0}, {2, 0}, {4, 0}, {0, 1}, {2, 1}, {4, 1}
+        }));
+        const auto& values = SimpleDataArray::from_mts_array(block.mts_array());
+        CHECK(values == SimpleDataArray({6, 1, 1}, 1.0));
+
+        auto gradient = block.gradient("parameter");
+        CHECK(gradient.samples() == Labels({"sample", "parameter"}, {
+            {0, -2}, {2, 3}, {3, -2}, {5, 3}
+        }));
+
+        CHECK_THROWS_WITH(
+            TensorMap::join_samples(tensors),
+            "invalid parameter: can not join blocks containing the same samples, "
+            "use a new sample dimension to distinguish between the tensors"
+        );
+    }
+
     SECTION("keys_to_properties") {
         auto tensor = test_tensor_map().keys_to_properties("key_1");
 
@@ -157,6 +193,173 @@ TEST_CASE("TensorMap") {
         CHECK(values_3 == SimpleDataArray({4, 3, 1}, 4.0));
     }
 
+    SECTION("keys_to_properties with a single thread") {
+        auto parallel = test_tensor_map().keys_to_properties("key_1");
+
+        CHECK(mts_get_max_threads() == 0);
+        mts_set_max_threads(1);
+        auto serial = test_tensor_map().keys_to_properties("key_1");
+        mts_set_max_threads(0);
+
+        REQUIRE(serial.keys() == parallel.keys());
+        for (uintptr_t i = 0; i < serial.keys().count(); i++) {
+            auto serial_block = serial.block_by_id(i);
+            auto parallel_block = parallel.block_by_id(i);
+
+            CHECK(serial_block.samples() == parallel_block.samples());
+            CHECK(serial_block.properties() == parallel_block.properties());
+            CHECK(
+                SimpleDataArray::from_mts_array(serial_block.mts_array()) ==
+                SimpleDataArray::from_mts_array(parallel_block.mts_array())
+            );
+
+            auto serial_gradient = serial_block.gradient("parameter");
+            auto parallel_gradient = parallel_block.gradient("parameter");
+            CHECK(serial_gradient.samples() == parallel_gradient.samples());
+            CHECK(
+                SimpleDataArray::from_mts_array(serial_gradient.mts_array()) ==
+                SimpleDataArray::from_mts_array(parallel_gradient.mts_array())
+            );
+        }
+    }
+
+    SECTION("keys_to_properties with shared samples") {
+        auto samples = Labels({"samples"}, {{3}, {0}, {1}});
+        auto blocks = std::vector<TensorBlock>();
+        for (int i = 0; i < 2; i++) {
+            auto block = TensorBlock(
+                std::unique_ptr<SimpleDataArray>(new SimpleDataArray({3, 2}, static_cast<double>(i + 1))),
+                samples,
+                {},
+                Labels({"properties"}, {{0}, {1}})
+            );
+            auto gradient = TensorBlock(
+                std::unique_ptr<SimpleDataArray>(new SimpleDataArray({2, 2}, static_cast<double>(i + 11))),
+                Labels({"sample", "parameter"}, {{0, 1}, {2, 1}}),
+                {},
+                Labels({"properties"}, {{0}, {1}})
+            );
+            block.add_gradient("parameter", std::move(gradient));
+            blocks.emplace_back(std::move(block));
+        }
+        auto tensor = TensorMap(Labels({"key"}, {{0}, {1}}), std::move(blocks));
+
+        auto merged = tensor.keys_to_properties("key", /*sort_samples*/ false);
+        auto block = merged.block_by_id(0);
+        CHECK(block.samples() == samples);
+        CHECK(block.properties() == Labels({"key", "properties"}, {{0, 0}, {0, 1}, {1, 0}, {1, 1}}));
+
+        auto expected = SimpleDataArray({3, 4}, {
+            1.0, 1.0, 2.0, 2.0,
+            1.0, 1.0, 2.0, 2.0,
+            1.0, 1.0, 2.0, 2.0,
+        });
+        CHECK(SimpleDataArray::from_mts_array(block.mts_array()) == expected);
+
+        auto gradient = block.gradient("parameter");
+        CHECK(gradient.samples() == Labels({"sample", "parameter"}, {{0, 1}, {2, 1}}));
+        expected = SimpleDataArray({2, 4}, {
+            11.0, 11.0, 12.0, 12.0,
+            11.0, 11.0, 12.0, 12.0,
+        });
+        CHECK(SimpleDataArray::from_mts_array(gradient.mts_array()) == expected);
+
+        // user-provided values for the moved keys
+        merged = tensor.keys_to_properties(Labels({"key"}, {{1}, {5}, {0}}), /*sort_samples*/ false);
+        block = merged.block_by_id(0);
+        CHECK(block.properties() == Labels({"key", "properties"}, {
+            {1, 0}, {1, 1}, {5, 0}, {5, 1}, {0, 0}, {0, 1}
+        }));
+
+        expected = SimpleDataArray({3, 6}, {
+            2.0, 2.0, 0.0, 0.0, 1.0, 1.0,
+            2.0, 2.0, 0.0, 0.0, 1.0, 1.0,
+            2.0, 2.0, 0.0, 0.0, 1.0, 1.0,
+        });
+        CHECK(SimpleDataArray::from_mts_array(block.mts_array()) == expected);
+
+        // sorting the samples uses the general code path
+        merged = tensor.keys_to_properties("key", /*sort_samples*/ true);
+        block = merged.block_by_id(0);
+        CHECK(block.samples() == Labels({"samples"}, {{0}, {1}, {3}}));
+        gradient = block.gradient("parameter");
+        CHECK(gradient.samples() == Labels({"sample", "parameter"}, {{1, 1}, {2, 1}}));
+    }
+
+    SECTION("keys_to_properties with different properties") {
+        auto keys_to_move = Labels({"key_1"}, {{0}, {1}, {2}});
+        auto tensor = test_tensor_map().keys_to_properties(keys_to_move);
+        CHECK(tensor.keys() == Labels({"key_2"}, {{0}, {2}, {3}}));
+
+        // each entry in keys_to_move uses the properties of the corresponding
+        // blocks, and all the new blocks have the same properties
+        auto expected_properties = Labels({"key_1", "properties"}, {
+            {0, 0}, {1, 3}, {1, 4}, {1, 5}, {2, 0}
+        });
+
+        auto block = tensor.block_by_id(0);
+        CHECK(block.samples() == Labels({"samples"}, {{0}, {1}, {2}, {3}, {4}}));
+        CHECK(block.properties() == expected_properties);
+
+        auto expected = SimpleDataArray({5, 1, 5}, {
+            1.0, 2.0, 2.0, 2.0, 0.0,
+            0.0, 2.0, 2.0, 2.0, 0.0,
+            1.0, 0.0, 0.0, 0.0, 0.0,
+            0.0, 2.0, 2.0, 2.0, 0.0,
+            1.0, 0.0, 0.0, 0.0, 0.0,
+        });
+        CHECK(SimpleDataArray::from_mts_array(block.mts_array()) == expected);
+
+        auto gradient = block.gradient("parameter");
+        CHECK(gradient.properties() == expected_properties);
+        expected = SimpleDataArray({4, 1, 5}, {
+            11.0, 12.0, 12.0, 12.0, 0.0,
+            0.0, 12.0, 12.0, 12.0, 0.0,
+            0.0, 12.0, 12.0, 12.0, 0.0,
+            11.0, 0.0, 0.0, 0.0, 0.0,
+        });
+        CHECK(SimpleDataArray::from_mts_array(gradient.mts_array()) == expected);
+
+        block = tensor.block_by_id(1);
+        CHECK(block.properties() == expected_properties);
+        auto values = block.values();
+        CHECK(values.shape() == std::vector<size_t>{4, 3, 5});
+        CHECK(values(0, 0, 0) == 0.0);
+        CHECK(values(0, 0, 3) == 0.0);
+        CHECK(values(0, 0, 4) == 3.0);
+
+        // the properties of the blocks for key_1=3 are different, and there is
+        // no such block in the last group, where the blocks do not share their
+        // properties either
+        auto keys = Labels({"key_1", "key_2"}, {{0, 0}, {3, 0}, {3, 1}, {0, 1}, {0, 2}, {4, 2}});
+        auto blocks = std::vector<TensorBlock>();
+        for (int i = 0; i < 6; i++) {
+            auto properties = (i == 1 || i == 5) ? Labels({"properties"}, {{0}, {1}}) : Labels({"properties"}, {{0}});
+            blocks.emplace_back(TensorBlock(
+                std::unique_ptr<SimpleDataArray>(new SimpleDataArray({1, properties.count()})),
+                Labels({"samples"}, {{0}}),
+                {},
+                properties
+            ));
+        }
+        tensor = TensorMap(keys, std::move(blocks));
+
+        CHECK_THROWS_WITH(
+            tensor.keys_to_properties(Labels({"key_1"}, {{0}, {3}})),
+            "invalid parameter: can not provide values for the keys to move to "
+            "properties: the blocks with (key_1=3) in their keys have different "
+            "property labels, and some of the merged blocks do not contain it"
+        );
+
+        // this works if the entry is consistent across blocks
+        tensor = tensor.keys_to_properties(Labels({"key_1"}, {{0}, {4}}));
+        auto properties = Labels({"key_1", "properties"}, {{0, 0}, {4, 0}, {4, 1}});
+        CHECK(tensor.keys() == Labels({"key_2"}, {{0}, {1}, {2}}));
+        CHECK(tensor.block_by_id(0).properties() == properties);
+        CHECK(tensor.block_by_id(1).properties() == properties);
+        CHECK(tensor.block_by_id(2).properties() == properties);
+    }
+
     SECTION("component_to_properties") {
         auto tensor = test_tensor_map().components_to_properties("component");
 
@@ -170,6 +373,91 @@ TEST_CASE("TensorMap") {
         CHECK(block.properties() == Labels({"component", "properties"}, {{0, 0}}));
     }
 
+    SECTION("components_to_properties with multiple components") {
+        auto values = std::vector<double>(2 * 2 * 3 * 2 * 2);
+        for (size_t i=0; i<values.size(); i++) {
+            values[i] = static_cast<double>(i);
+        }
+
+        auto a = Labels({"a"}, {{0}, {1}});
+        auto b = Labels({"b"}, {{0}, {1}, {2}});
+        auto c = Labels({"c"}, {{0}, {1}});
+        auto properties = Labels({"properties"}, {{0}, {1}});
+
+        auto block = TensorBlock(
+            std::unique_ptr<SimpleDataArray>(new SimpleDataArray({2, 2, 3, 2, 2}, values)),
+            Labels({"samples"}, {{0}, {1}}),
+            {a, b, c},
+            properties
+        );
+
+        auto gradient_values = std::vector<double>(1 * 2 * 2 * 3 * 2 * 2);
+        for (size_t i=0; i<gradient_values.size(); i++) {
+            gradient_values[i] = -static_cast<double>(i);
+        }
+        block.add_gradient("parameter", TensorBlock(
+            std::unique_ptr<SimpleDataArray>(new SimpleDataArray({1, 2, 2, 3, 2, 2}, gradient_values)),
+            Labels({"sample", "parameter"}, {{1, 0}}),
+            {Labels({"g"}, {{0}, {1}}), a, b, c},
+            properties
+        ));
+
+        auto blocks = std::vector<TensorBlock>();
+        blocks.emplace_back(std::move(block));
+        auto tensor = TensorMap(Labels({"key"}, {{0}}), std::move(blocks));
+
+        auto moved = tensor.components_to_properties(std::vector<std::string>{"c", "a"});
+        block = moved.block_by_id(0);
+
+        auto components = block.components();
+        REQUIRE(components.size() == 1);
+        CHECK(components[0] == b);
+
+        auto new_properties = block.properties();
+        CHECK(new_properties.names().size() == 3);
+        CHECK(new_properties == Labels({"c", "a", "properties"}, {
+            {0, 0, 0}, {0, 0, 1}, {0, 1, 0}, {0, 1, 1},
+            {1, 0, 0}, {1, 0, 1}, {1, 1, 0}, {1, 1, 1},
+        }));
+
+        auto new_values = block.values();
+        CHECK(new_values.shape() == std::vector<size_t>{2, 3, 8});
+
+        auto gradient = block.gradient("parameter");
+        CHECK(gradient.components().size() == 2);
+        CHECK(gradient.properties() == new_properties);
+
+        auto new_gradient = gradient.values();
+        CHECK(new_gradient.shape() == std::vector<size_t>{1, 2, 3, 8});
+
+        for (size_t s=0; s<2; s++) {
+            for (size_t ib=0; ib<3; ib++) {
+                for (size_t ic=0; ic<2; ic++) {
+                    for (size_t ia=0; ia<2; ia++) {
+                        for (size_t p=0; p<2; p++) {
+                            auto property = (ic * 2 + ia) * 2 + p;
+                            auto initial = (((s * 2 + ia) * 3 + ib) * 2 + ic) * 2 + p;
+                            CHECK(new_values(s, ib, property) == static_cast<double>(initial));
+
+                            if (s == 0) {
+                                for (size_t g=0; g<2; g++) {
+                                    auto initial_gradient = ((((g * 2 + ia) * 3 + ib) * 2 + ic) * 2 + p);
+                                    CHECK(new_gradient(0, g, ib, property) == -static_cast<double>(initial_gradient));
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        // all the dimensions of a component must be given
+        CHECK_THROWS_WITH(
+            tensor.components_to_properties(std::vector<std::string>{"a", "d"}),
+            Catch::Matchers::StartsWith("invalid parameter: unable to find [a, d] in the components")
+        );
+    }
+
     SECTION("clone") {
         auto blocks = std::vector<TensorBlock>();
         blocks.push_back(TensorBlock(
@@ -213,6 +501,52 @@ TEST_CASE("TensorMap") {
         auto block = clone.block_by_id(0);
         CHECK_THROWS_WITH(block.values(), "error in C++ callback: can not call `data` for an EmptyDataArray");
     }
+
+    SECTION("for_each_block") {
+        auto tensor = test_tensor_map();
+
+        for (size_t n_threads: {0, 1, 3}) {
+            tensor.for_each_block([](uintptr_t i, TensorBlock block) {
+                auto values = block.values();
+                for (size_t j=0; j<details::product(values.shape()); j++) {
+                    values.data()[j] = static_cast<double>(i);
+                }
+            }, n_threads);
+
+            for (uintptr_t i=0; i<tensor.keys().count(); i++) {
+                auto block = tensor.block_by_id(i);
+                auto values = block.values();
+                for (size_t j=0; j<details::product(values.shape()); j++) {
+                    CHECK(values.data()[j] == static_cast<double>(i));
+                }
+            }
+        }
+
+        // errors are propagated to the calling thread
+        auto callback = [](uintptr_t i, TensorBlock) {
+            if (i >= 2) {
+                throw std::runtime_error("error in block " + std::to_string(i));
+            }
+        };
+        CHECK_THROWS_WITH(tensor.for_each_block(callback, 1), "error in block 2");
+        CHECK_THROWS_WITH(tensor.for_each_block(callback, 4), "error in block 2");
+    }
+
+    SECTION("memory usage") {
+        auto tensor = test_tensor_map();
+
+        auto usage = tensor.memory_usage();
+        CHECK(usage.values == (3 + 9 + 12 + 12) * sizeof(double));
+        CHECK(usage.gradients_values == (2 + 9 + 3 + 6) * sizeof(double));
+        CHECK(usage.labels_values > 0);
+        CHECK(usage.gradients_metadata > 0);
+        CHECK(usage.metadata > 0);
+
+        // the index used for selections with a subset of the keys dimensions
+        // is included in the positions
+        tensor.blocks_matching(Labels({"key_1"}, {{2}}));
+        CHECK(tensor.memory_usage().labels_positions > usage.labels_positions);
+    }
 }
 
 
@@ -227,6 +561,307 @@ TEST_CASE("TensorMap serialization") {
         check_loaded_tensor(tensor);
     }
 
+    SECTION("loading file with memory mapping") {
+        auto tensor = TensorMap::load_mmap(TEST_DATA_NPZ_PATH);
+        check_loaded_tensor(tensor);
+
+        tensor = metatensor::io::load_mmap(TEST_DATA_NPZ_PATH);
+        check_loaded_tensor(tensor);
+
+        // files saved by metatensor have properly aligned data, which is used
+        // directly from the mapped file
+        auto path = std::string("test-load-mmap.npz");
+        metatensor::io::save(path, tensor);
+        {
+            auto mapped = metatensor::io::load_mmap(path);
+            check_loaded_tensor(mapped);
+
+            // modifying the data does not change the file
+            auto block = mapped.block_by_id(0);
+            auto values = block.values();
+            auto initial = values(0, 0, 0);
+            values(0, 0, 0) = initial + 42.0;
+
+            auto reloaded = metatensor::io::load(path);
+            auto reloaded_block = reloaded.block_by_id(0);
+            auto reloaded_values = reloaded_block.values();
+            CHECK(reloaded_values(0, 0, 0) == initial);
+
+            // data can be moved around with keys_to_samples
+            auto moved = mapped.keys_to_samples("center_type");
+            CHECK(moved.keys().names().size() == 3);
+        }
+        std::remove(path.c_str());
+    }
+
+    SECTION("exchange through shared memory") {
+        auto full = TensorMap::load(TEST_DATA_NPZ_PATH);
+        auto name = std::string("test-shm-") + std::to_string(std::rand());
+
+        full.save_shm(name);
+        {
+            auto tensor = metatensor::io::load_shm(name);
+            check_loaded_tensor(tensor);
+
+            auto block = tensor.block_by_id(0);
+            auto values = block.values();
+            auto expected = full.block_by_id(0);
+            auto expected_values = expected.values();
+            CHECK(values == expected_values);
+
+            // the segment can be loaded multiple times
+            auto again = TensorMap::load_shm(name);
+            check_loaded_tensor(again);
+
+#ifndef _WIN32
+            // tensors loaded from the segment stay valid after removing it
+            metatensor::io::remove_shm(name);
+            CHECK(block.values() == expected_values);
+#endif
+        }
+
+#ifdef _WIN32
+        // the segment can only be removed once it is no longer mapped
+        metatensor::io::remove_shm(name);
+#endif
+
+        CHECK_THROWS(TensorMap::load_shm(name));
+        CHECK_THROWS(metatensor::io::remove_shm(name));
+
+        CHECK_THROWS_WITH(
+            metatensor::io::save_shm("invalid/name", full),
+            Catch::Matchers::StartsWith("invalid parameter: invalid name for shared memory segment")
+        );
+    }
+
+    SECTION("loading a subset of the blocks") {
+        auto selection = Labels({"o3_lambda"}, {{1}});
+        auto tensor = metatensor::io::load_selection(TEST_DATA_NPZ_PATH, selection);
+        auto full = TensorMap::load(TEST_DATA_NPZ_PATH);
+
+        auto matching = full.blocks_matching(selection);
+        REQUIRE(tensor.keys().count() == matching.size());
+
+        for (size_t i=0; i<matching.size(); i++) {
+            auto block = tensor.block_by_id(i);
+            auto expected = full.block_by_id(matching[i]);
+            CHECK(block.values_shape() == expected.values_shape());
+            CHECK(block.samples() == expected.samples());
+            CHECK(block.gradients_list() == expected.gradients_list());
+        }
+
+        tensor = TensorMap::load_selection(TEST_DATA_NPZ_PATH, Labels({"o3_lambda"}, {{-1}}));
+        CHECK(tensor.keys().count() == 0);
+
+        CHECK_THROWS_WITH(
+            metatensor::io::load_selection(TEST_DATA_NPZ_PATH, Labels({"foo"}, {{1}})),
+            "invalid parameter: 'foo' is not part of the keys for this tensor"
+        );
+    }
+
+    SECTION("loading file in parallel") {
+        auto full = TensorMap::load(TEST_DATA_NPZ_PATH);
+
+        for (size_t n_threads: {0, 1, 4}) {
+            auto tensor = metatensor::io::load_parallel(TEST_DATA_NPZ_PATH, n_threads);
+            CHECK(tensor.keys() == full.keys());
+
+            for (size_t i=0; i<full.keys().count(); i++) {
+                auto block = tensor.block_by_id(i);
+                auto expected = full.block_by_id(i);
+                CHECK(block.samples() == expected.samples());
+                CHECK(block.properties() == expected.properties());
+                CHECK(block.gradients_list() == expected.gradients_list());
+
+                auto values = block.values();
+                auto expected_values = expected.values();
+                CHECK(values == expected_values);
+
+                for (const auto& parameter: expected.gradients_list()) {
+                    auto gradient = block.gradient(parameter);
+                    CHECK(gradient.samples() == expected.gradient(parameter).samples());
+                }
+            }
+        }
+    }
+
+    SECTION("saving compressed file") {
+        auto full = TensorMap::load(TEST_DATA_NPZ_PATH);
+        auto path = std::string("test-save-compressed.npz");
+
+        auto file_size = [](const std::string& path) {
+            auto file = std::ifstream(path, std::ios::binary | std::ios::ate);
+            return static_cast<long long>(file.tellg());
+        };
+
+        auto uncompressed_size = 0ll;
+        for (auto compression: {MTS_COMPRESSION_NONE, MTS_COMPRESSION_DEFLATE, MTS_COMPRESSION_ZSTD}) {
+            metatensor::io::save_compressed(path, full, compression, 0, 2);
+
+            if (compression == MTS_COMPRESSION_NONE) {
+                uncompressed_size = file_size(path);
+            } else {
+                CHECK(file_size(path) < uncompressed_size);
+            }
+
+            auto tensor = TensorMap::load(path);
+            check_loaded_tensor(tensor);
+            REQUIRE(tensor.keys() == full.keys());
+
+            // compressed data is copied when using memory mapping
+            auto mapped = TensorMap::load_mmap(path);
+            check_loaded_tensor(mapped);
+
+            // and decompressed in parallel with load_parallel
+            auto parallel = TensorMap::load_parallel(path, 4);
+            check_loaded_tensor(parallel);
+
+            for (size_t i=0; i<full.keys().count(); i++) {
+                auto expected = full.block_by_id(i);
+                auto expected_values = expected.values();
+
+                auto block = tensor.block_by_id(i);
+                auto values = block.values();
+                CHECK(values == expected_values);
+
+                auto mapped_block = mapped.block_by_id(i);
+                auto mapped_values = mapped_block.values();
+                CHECK(mapped_values == expected_values);
+
+                auto parallel_block = parallel.block_by_id(i);
+                auto parallel_values = parallel_block.values();
+                CHECK(parallel_values == expected_values);
+
+                for (const auto& parameter: expected.gradients_list()) {
+                    auto gradient = parallel_block.gradient(parameter);
+                    auto expected_gradient = expected.gradient(parameter);
+                    CHECK(gradient.values() == expected_gradient.values());
+                }
+            }
+        }
+
+        full.save_compressed(path, MTS_COMPRESSION_ZSTD, 19);
+        auto tensor = TensorMap::load(path);
+        check_loaded_tensor(tensor);
+
+        CHECK_THROWS_WITH(
+            full.save_compressed(path, 42),
+            "invalid parameter: unknown compression method 42"
+        );
+
+        std::remove(path.c_str());
+    }
+
+    SECTION("writing blocks one at a time") {
+        auto full = TensorMap::load(TEST_DATA_NPZ_PATH);
+        auto keys = full.keys();
+
+        auto names = std::vector<std::string>();
+        for (const auto* name: keys.names()) {
+            names.emplace_back(name);
+        }
+
+        auto path = std::string("test-writer.npz");
+        auto writer = metatensor::io::TensorMapWriter(path, names);
+        const auto& values = keys.values();
+        for (size_t i=0; i<keys.count(); i++) {
+            auto key = std::vector<int32_t>();
+            for (size_t j=0; j<keys.size(); j++) {
+                key.push_back(values(i, j));
+            }
+            writer.add_block(key, full.block_by_id(i));
+        }
+
+        // blocks with different metadata are rejected
+        auto block = TensorBlock(
+            std::unique_ptr<SimpleDataArray>(new SimpleDataArray({1, 1})),
+            Labels({"other"}, {{0}}),
+            {},
+            Labels({"properties"}, {{0}})
+        );
+        CHECK_THROWS_WITH(
+            writer.add_block(std::vector<int32_t>(keys.size(), -1), block),
+            Catch::Matchers::StartsWith("invalid parameter: all blocks must have the same")
+        );
+
+        writer.finish();
+        CHECK_THROWS_WITH(writer.finish(), "invalid parameter: TensorMapWriter::finish has already been called");
+
+        auto tensor = TensorMap::load(path);
+        check_loaded_tensor(tensor);
+        CHECK(tensor.keys() == keys);
+
+        std::remove(path.c_str());
+    }
+
+    SECTION("writing blocks in chunks of samples") {
+        auto chunk = [](std::vector<std::initializer_list<int32_t>> samples, double value) {
+            auto array = std::unique_ptr<SimpleDataArray>(
+                new SimpleDataArray({samples.size(), 3, 2}, value)
+            );
+            return TensorBlock(
+                std::move(array),
+                Labels({"system", "atom"}, samples),
+                {Labels({"o3_mu"}, {{-1}, {0}, {1}})},
+                Labels({"n"}, {{0}, {1}})
+            );
+        };
+
+        auto path = std::string("test-writer-chunks.npz");
+        auto writer = metatensor::io::TensorMapWriter(path, {"key"});
+
+        writer.begin_block({0}, {3, 3, 2});
+        CHECK_THROWS_WITH(
+            writer.add_block({1}, chunk({{0, 0}}, 1.0)),
+            Catch::Matchers::StartsWith("invalid parameter: can not add a new block to a TensorMapWriter while another block")
+        );
+
+        writer.add_samples(chunk({{0, 0}, {0, 1}}, 1.0));
+        CHECK_THROWS_WITH(
+            writer.add_samples(chunk({{1, 0}, {1, 1}}, 2.0)),
+            "invalid parameter: too many samples for this block: 3 samples were "
+            "declared in begin_block, but got 4 samples"
+        );
+        CHECK_THROWS_WITH(
+            writer.end_block(),
+            "invalid parameter: missing samples for this block: 3 samples were "
+            "declared in begin_block, but only 2 were added"
+        );
+
+        writer.add_samples(chunk({{1, 0}}, 2.0));
+        writer.end_block();
+
+        writer.add_block({1}, chunk({{0, 0}}, 3.0));
+        writer.finish();
+
+        auto tensor = TensorMap::load(path);
+        CHECK(tensor.keys() == Labels({"key"}, {{0}, {1}}));
+
+        auto block = tensor.block_by_id(0);
+        CHECK(block.samples() == Labels({"system", "atom"}, {{0, 0}, {0, 1}, {1, 0}}));
+        CHECK(block.components()[0] == Labels({"o3_mu"}, {{-1}, {0}, {1}}));
+        CHECK(block.properties() == Labels({"n"}, {{0}, {1}}));
+
+        auto values = block.values();
+        CHECK(values.shape() == std::vector<uintptr_t>{3, 3, 2});
+        CHECK(values(1, 2, 1) == 1.0);
+        CHECK(values(2, 0, 0) == 2.0);
+
+        // the writer can not be used after a failed write
+        writer = metatensor::io::TensorMapWriter(path, {"key"});
+        writer.add_block({0}, chunk({{0, 0}}, 1.0));
+        CHECK_THROWS_WITH(
+            writer.add_block({0}, chunk({{0, 0}}, 1.0)),
+            Catch::Matchers::StartsWith("invalid parameter: can not have the same label value multiple time")
+        );
+        CHECK_THROWS_WITH(
+            writer.finish(),
+            "invalid parameter: can not use this TensorMapWriter after a previous write failed"
+        );
+
+        std::remove(path.c_str());
+    }
+
     SECTION("loading file with custom array creation") {
         CHECK(CUSTOM_CREATE_ARRAY_CALL_COUNT == 0);
         auto tensor = TensorMap::load(TEST_DATA_NPZ_PATH, custom_create_array);
@@ -238,6 +873,25 @@ TEST_CASE("TensorMap serialization") {
         CHECK(CUSTOM_CREATE_ARRAY_CALL_COUNT == 27 * 2);
     }
 
+    SECTION("loading file in an arena") {
+        auto arena = std::make_shared<metatensor::DataArrayArena>(
+            /*chunk_size=*/ 1 << 20
+        );
+
+        auto tensor = TensorMap(nullptr);
+        {
+            metatensor::DataArrayArena::Scope scope(arena);
+            tensor = TensorMap::load(TEST_DATA_NPZ_PATH, metatensor::DataArrayArena::create_array);
+        }
+        check_loaded_tensor(tensor);
+
+        // all the arrays fit in a single chunk
+        CHECK(arena->allocated_size() == (1 << 20) * sizeof(double));
+
+        auto block = tensor.block_by_id(0);
+        CHECK(metatensor::ArenaDataArray::from_mts_array(block.mts_array()).arena() == arena);
+    }
+
     SECTION("Load/Save with buffers") {
         // read the whole file into a buffer
         std::ifstream file(TEST_DATA_NPZ_PATH, std::ios::binary);
@@ -0,0 +1,202 @@
+#include <cmath>
+#include <cstdio>
+
+#include "benchmarks.hpp"
+
+using namespace metatensor_torch;
+using namespace metatensor_benchmarks;
+
+/// Data for a fake neighbors list, with `n_neighbors` neighbors for each of
+/// the `n_atoms` atoms, randomly placed in a cubic box
+struct NeighborsData {
+    torch::Tensor positions;
+    torch::Tensor cell;
+    torch::Tensor types;
+    torch::Tensor distances;
+    TorchLabels samples;
+    std::vector<TorchLabels> components;
+    TorchLabels properties;
+};
+
+static NeighborsData create_neighbors(int64_t n_atoms, int64_t n_neighbors, torch::Device device) {
+    auto data = NeighborsData();
+    data.positions = 10 * torch::rand({n_atoms, 3}, torch::kFloat64);
+    data.cell = 10 * torch::eye(3, torch::kFloat64);
+    data.types = torch::ones({n_atoms}, torch::kInt32);
+
+    // each atom is paired with the `n_neighbors` next atoms, so all the
+    // pairs are different as long as `n_neighbors < n_atoms`
+    auto first = torch::arange(n_atoms, torch::kInt32).repeat_interleave(n_neighbors);
+    auto offsets = torch::arange(1, n_neighbors + 1, torch::kInt32).repeat({n_atoms});
+    auto second = torch::remainder(first + offsets, n_atoms).to(torch::kInt32);
+    auto n_pairs = first.size(0);
+
+    auto samples = torch::stack({
+        first,
+        second,
+        torch::zeros({n_pairs}, torch::kInt32),
+        torch::zeros({n_pairs}, torch::kInt32),
+        torch::zeros({n_pairs}, torch::kInt32),
+    }, 1);
+    // same as the neighbors lists computed by metatensor-torch, the samples
+    // are not copied back to the CPU
+    data.samples = torch::make_intrusive<LabelsHolder>(
+        std::vector<std::string>{"first_atom", "second_atom", "cell_shift_a", "cell_shift_b", "cell_shift_c"},
+        samples.to(device),
+        /*assume_unique*/ true
+    );
+    data.components = {LabelsHolder::create({"xyz"}, {{0}, {1}, {2}})->to(device)};
+    data.properties = LabelsHolder::create({"distance"}, {{0}})->to(device);
+
+    data.distances = (
+        data.positions.index_select(0, second.to(torch::kInt64))
+        - data.positions.index_select(0, first.to(torch::kInt64))
+    ).reshape({n_pairs, 3, 1}).to(device);
+
+    data.positions = data.positions.to(device);
+    data.cell = data.cell.to(device);
+    data.types = data.types.to(device);
+
+    return data;
+}
+
+/// Synchronize with the device to make sure all the work was done before
+/// stopping the timer
+static void synchronize(torch::Device device) {
+    if (device.is_cuda()) {
+        torch::cuda::synchronize();
+    }
+}
+
+static std::vector<torch::Device> benchmark_devices() {
+    auto devices = std::vector<torch::Device>{torch::Device("cpu")};
+    if (torch::cuda::is_available()) {
+        devices.emplace_back("cuda");
+    }
+    return devices;
+}
+
+static void neighbors_autograd_benchmarks(Runner& runner) {
+    for (auto device: benchmark_devices()) {
+        for (int64_t n_atoms: {100, 1000, 10000}) {
+            auto data = create_neighbors(n_atoms, 50, device);
+            auto suffix = "/" + device.str() + "/" + std::to_string(n_atoms);
+
+            auto positions = data.positions.clone().requires_grad_(true);
+            auto cell = data.cell.clone().requires_grad_(true);
+            auto system = torch::make_intrusive<SystemHolder>(data.types, positions, cell);
+
+            auto create_neighbors_block = [&]() {
+                return torch::make_intrusive<TensorBlockHolder>(
+                    data.distances.clone(),
+                    data.samples,
+                    data.components,
+                    data.properties
+                );
+            };
+
+            runner.run("NeighborsAutograd::forward" + suffix, [&]() {
+                auto neighbors = create_neighbors_block();
+                register_autograd_neighbors(system, neighbors, /*check_consistency=*/false);
+                synchronize(device);
+                do_not_optimize(neighbors);
+            });
+
+            runner.run("NeighborsAutograd::forward/check_consistency" + suffix, [&]() {
+                auto neighbors = create_neighbors_block();
+                register_autograd_neighbors(system, neighbors, /*check_consistency=*/true);
+                synchronize(device);
+                do_not_optimize(neighbors);
+            });
+
+            runner.run("NeighborsAutograd::backward" + suffix, [&]() {
+                auto neighbors = create_neighbors_block();
+                register_autograd_neighbors(system, neighbors, /*check_consistency=*/false);
+                neighbors->values().sum().backward();
+                synchronize(device);
+
+                positions.mutable_grad().reset();
+                cell.mutable_grad().reset();
+            });
+        }
+    }
+}
+
+static void compute_neighbors_benchmarks(Runner& runner) {
+    for (auto device: benchmark_devices()) {
+        for (int64_t n_atoms: {100, 1000, 10000}) {
+            // keep the density constant at 0.1 atoms/A^3 when changing the
+            // number of atoms
+            auto box = std::cbrt(static_cast<double>(n_atoms) / 0.1);
+            auto options = torch::TensorOptions().dtype(torch::kFloat64).device(device);
+            auto positions = box * torch::rand({n_atoms, 3}, options);
+            auto cell = box * torch::eye(3, options);
+            auto types = torch::ones({n_atoms}, torch::TensorOptions().dtype(torch::kInt32).device(device));
+
+            auto suffix = "/" + device.str() + "/" + std::to_string(n_atoms);
+            auto neighbors_options = torch::make_intrusive<NeighborsListOptionsHolder>(5.0, /*full_list=*/false);
+
+            runner.run("System::compute_neighbors_lists" + suffix, [&]() {
+                auto system = torch::make_intrusive<SystemHolder>(types, positions, cell);
+                SystemHolder::compute_neighbors_lists(system, {neighbors_options});
+                synchronize(device);
+                do_not_optimize(system);
+            });
+
+            // re-using the pairs from the previous step with a Verlet skin,
+            // when the atoms did not move enough to require a new search
+            auto skin_options = torch::make_intrusive<NeighborsListOptionsHolder>(5.0, /*full_list=*/false);
+            skin_options->set_skin(1.0);
+
+            auto previous = torch::make_intrusive<SystemHolder>(types, positions, cell);
+            SystemHolder::compute_neighbors_lists(previous, {skin_options});
+            auto system = torch::make_intrusive<SystemHolder>(types, positions + 0.01, cell);
+
+            runner.run("System::compute_neighbors_lists/skin" + suffix, [&]() {
+                SystemHolder::compute_neighbors_lists(system, {skin_options}, "", previous);
+                synchronize(device);
+                do_not_optimize(system);
+            });
+        }
+    }
+}
+
+static void model_loading_benchmarks(Runner& runner) {
+    auto module = torch::jit::Module("BenchmarkModel");
+    module.define(R"(
+        def forward(self, x: Tensor) -> Tensor:
+            return x
+    )");
+
+    // the same metadata records as the ones written by the Python export code
+    auto extra_files = torch::jit::ExtraFilesMap{
+        {"metatensor-version", metatensor_torch::version()},
+        {"torch-version", TORCH_VERSION},
+        {"extensions", "[]"},
+        {"extensions-deps", "[]"},
+    };
+
+    auto path = std::string("metatensor-benchmark-model.pt");
+    module.save(path, extra_files);
+
+    runner.run("load_atomistic_model", [&]() {
+        auto loaded = load_atomistic_model(path);
+        do_not_optimize(loaded);
+    });
+
+    // separate calls, each opening and reading the file again
+    runner.run("load_model_extensions+check_atomistic_model+torch::jit::load", [&]() {
+        load_model_extensions(path, torch::nullopt);
+        check_atomistic_model(path);
+        auto loaded = torch::jit::load(path);
+        do_not_optimize(loaded);
+    });
+
+    std::remove(path.c_str());
+}
+
+void metatensor_benchmarks::atomistic_benchmarks(Runner& runner) {
+    neighbors_autograd_benchmarks(runner);
+    compute_neighbors_benchmarks(runner);
+    model_loading_benchmarks(runner);
+}
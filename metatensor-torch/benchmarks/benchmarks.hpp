@@ -0,0 +1,15 @@
+#ifndef METATENSOR_TORCH_BENCHMARKS_HPP
+#define METATENSOR_TORCH_BENCHMARKS_HPP
+
+#include <torch/torch.h>
+
+#include <metatensor/torch.hpp>
+
+#include "benchmark.hpp"
+
+namespace metatensor_benchmarks {
+    void tensor_benchmarks(Runner& runner);
+    void atomistic_benchmarks(Runner& runner);
+}
+
+#endif
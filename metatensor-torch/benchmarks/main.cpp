@@ -0,0 +1,26 @@
+#include <exception>
+
+#include "benchmarks.hpp"
+
+using namespace metatensor_benchmarks;
+
+int main(int argc, char** argv) {
+    try {
+        auto runner = Runner("metatensor-torch", argc, argv);
+        runner.add_context("metatensor-torch", metatensor_torch::version());
+        runner.add_context("torch",
+            std::to_string(TORCH_VERSION_MAJOR) + "." +
+            std::to_string(TORCH_VERSION_MINOR) + "." +
+            std::to_string(TORCH_VERSION_PATCH)
+        );
+        runner.add_context("cuda", torch::cuda::is_available() ? "available" : "unavailable");
+
+        tensor_benchmarks(runner);
+        atomistic_benchmarks(runner);
+
+        return runner.finish();
+    } catch (const std::exception& e) {
+        std::cerr << "error: " << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,115 @@
+#include "benchmarks.hpp"
+
+using namespace metatensor_torch;
+using namespace metatensor_benchmarks;
+
+/// Create a `TensorMap` with `n_blocks` blocks, each containing `n_samples`
+/// samples, one "xyz" component and `n_properties` properties, and a gradient
+/// with respect to "positions".
+static TorchTensorMap create_tensor(int32_t n_blocks, int64_t n_samples, int64_t n_properties) {
+    auto samples = torch::stack({
+        torch::zeros({n_samples}, torch::kInt32),
+        torch::arange(n_samples, torch::kInt32),
+    }, 1);
+    auto samples_labels = torch::make_intrusive<LabelsHolder>(
+        std::vector<std::string>{"system", "atom"}, samples
+    );
+    auto components = std::vector<TorchLabels>{
+        LabelsHolder::create({"xyz"}, {{0}, {1}, {2}})
+    };
+    auto properties = torch::make_intrusive<LabelsHolder>(
+        "n", torch::arange(n_properties, torch::kInt32).reshape({n_properties, 1})
+    );
+
+    auto gradient_samples = torch::make_intrusive<LabelsHolder>(
+        std::vector<std::string>{"sample", "system", "atom"},
+        torch::cat({torch::arange(n_samples, torch::kInt32).reshape({n_samples, 1}), samples}, 1)
+    );
+    auto gradient_components = std::vector<TorchLabels>{components[0], components[0]};
+
+    auto keys = std::vector<int32_t>();
+    auto blocks = std::vector<TorchTensorBlock>();
+    for (int32_t i=0; i<n_blocks; i++) {
+        auto block = torch::make_intrusive<TensorBlockHolder>(
+            torch::rand({n_samples, 3, n_properties}, torch::kFloat64),
+            samples_labels,
+            components,
+            properties
+        );
+
+        block->add_gradient("positions", torch::make_intrusive<TensorBlockHolder>(
+            torch::rand({n_samples, 3, 3, n_properties}, torch::kFloat64),
+            gradient_samples,
+            gradient_components,
+            properties
+        ));
+
+        blocks.emplace_back(std::move(block));
+        keys.push_back(i);
+    }
+
+    auto keys_labels = torch::make_intrusive<LabelsHolder>(
+        "key", torch::tensor(keys, torch::kInt32).reshape({n_blocks, 1})
+    );
+    return torch::make_intrusive<TensorMapHolder>(keys_labels, std::move(blocks));
+}
+
+void metatensor_benchmarks::tensor_benchmarks(Runner& runner) {
+    auto tensor = create_tensor(50, 200, 16);
+
+    // 3 values per sample and property in the blocks, and 9 in the gradients
+    size_t bytes = 50 * 200 * 16 * (3 + 9) * sizeof(double);
+
+    // these are called inside TorchScript models every time they iterate over
+    // the blocks of a TensorMap
+    runner.run("TensorMap::block_by_id", [&]() {
+        for (int64_t i=0; i<50; i++) {
+            auto block = TensorMapHolder::block_by_id(tensor, i);
+            do_not_optimize(block);
+        }
+    });
+
+    runner.run("TensorMap::blocks", [&]() {
+        auto blocks = TensorMapHolder::blocks(tensor);
+        do_not_optimize(blocks);
+    });
+
+    runner.run("TensorMap::items", [&]() {
+        auto items = TensorMapHolder::items(tensor);
+        do_not_optimize(items);
+    });
+
+    runner.run("TensorMap::blocks+samples", [&]() {
+        for (const auto& block: TensorMapHolder::blocks(tensor)) {
+            auto samples = block->samples();
+            do_not_optimize(samples);
+        }
+    });
+
+    runner.run("TensorMap::to/dtype", [&]() {
+        auto converted = tensor->to(torch::kFloat32);
+        do_not_optimize(converted);
+    }, bytes);
+
+    if (torch::cuda::is_available()) {
+        auto device = torch::Device("cuda");
+        auto on_device = tensor->to(torch::nullopt, device);
+
+        runner.run("TensorMap::to/cpu->cuda", [&]() {
+            auto moved = tensor->to(torch::nullopt, device);
+            torch::cuda::synchronize();
+            do_not_optimize(moved);
+        }, bytes);
+
+        runner.run("TensorMap::to/cpu->cuda/non_blocking", [&]() {
+            auto moved = tensor->to(torch::nullopt, device, /*non_blocking=*/true);
+            torch::cuda::synchronize();
+            do_not_optimize(moved);
+        }, bytes);
+
+        runner.run("TensorMap::to/cuda->cpu", [&]() {
+            auto moved = on_device->to(torch::nullopt, torch::Device("cpu"));
+            do_not_optimize(moved);
+        }, bytes);
+    }
+}
@@ -67,11 +67,17 @@ public:
         uintptr_t property_end
     ) override;
 
+    void* typed_data(int32_t& dtype) & override;
+
+    std::unique_ptr<metatensor::DataArrayBase> create_typed(std::vector<uintptr_t> shape, int32_t dtype) const override;
+
 private:
     // cache the array shape as a vector of unsigned integers (as expected by
     // metatensor) instead of signed integer (as stored in torch::Tensor::sizes)
     std::vector<uintptr_t> shape_;
     void update_shape();
+    // make `tensor_` contiguous, copying the data if needed
+    void make_contiguous();
 
     // the actual data
     torch::Tensor tensor_;
@@ -9,6 +9,7 @@
 #include <metatensor.hpp>
 
 #include "metatensor/torch/labels.hpp"
+#include "metatensor/torch/tensor.hpp"
 #include "metatensor/torch/exports.h"
 
 namespace metatensor_torch {
@@ -303,14 +304,27 @@ METATENSOR_TORCH_EXPORT void load_model_extensions(
 
 /// Check and then load the metatensor atomistic model at the given `path`.
 ///
-/// This function calls `check_atomistic_model(path)` and
-/// `load_model_extensions(path, extension_directory)` before attempting to load
-/// the model.
+/// This function does the same as `load_model_extensions(path,
+/// extension_directory)` and `check_atomistic_model(path)` before loading the
+/// model, while only opening and reading the file once.
 METATENSOR_TORCH_EXPORT torch::jit::Module load_atomistic_model(
     std::string path,
     c10::optional<std::string> extensions_directory = c10::nullopt
 );
 
+/// Split the `outputs` of a model evaluated on `n_systems` systems at once
+/// into one dictionary of outputs per system.
+///
+/// All the blocks in `outputs` must have a "system" sample dimension, and
+/// their samples must be sorted by system index (which is the case when the
+/// model produces its samples system by system). The values of the new blocks
+/// are views inside the values of the original blocks, and the "system"
+/// dimension of their samples keeps the index of the system in the batch.
+METATENSOR_TORCH_EXPORT std::vector<torch::Dict<std::string, TorchTensorMap>> split_outputs_per_system(
+    torch::Dict<std::string, TorchTensorMap> outputs,
+    int64_t n_systems
+);
+
 /// Get the multiplicative conversion factor to use to convert from unit `from`
 /// to unit `to`. Both should be units for the given physical `quantity`.
 METATENSOR_TORCH_EXPORT double unit_conversion_factor(
@@ -3,6 +3,7 @@
 
 #include <vector>
 #include <string>
+#include <memory>
 
 #include <torch/script.h>
 
@@ -56,6 +57,20 @@ public:
         return full_list_;
     }
 
+    /// Verlet skin for this neighbors list, in the units of the model. When
+    /// this is larger than zero, `SystemHolder::compute_neighbors_lists` can
+    /// re-use the pairs computed for a previous system as long as no atom
+    /// moved more than half of the skin.
+    double skin() const {
+        return skin_;
+    }
+
+    /// Set the Verlet skin to a new value, which must be positive or zero.
+    void set_skin(double skin);
+
+    /// Verlet skin for this neighbors list, in the units of the engine
+    double engine_skin(const std::string& engine_length_unit) const;
+
     /// Get the list of strings describing who requested this neighbors list
     std::vector<std::string> requestors() const {
         return requestors_;
@@ -79,11 +94,13 @@ private:
     double cutoff_;
     std::string length_unit_;
     bool full_list_;
+    // skin in the model units
+    double skin_ = 0.0;
     std::vector<std::string> requestors_;
 };
 
-/// Check `NeighborsListOptions` for equality. The `requestors` list is ignored
-/// when checking for equality
+/// Check `NeighborsListOptions` for equality. The `requestors` list and the
+/// `skin` are ignored when checking for equality
 inline bool operator==(const NeighborsListOptions& lhs, const NeighborsListOptions& rhs) {
     return lhs->cutoff() == rhs->cutoff() && lhs->full_list() == rhs->full_list();
 }
@@ -172,6 +189,16 @@ public:
     /// Set positions for all particles in the system
     void set_positions(torch::Tensor positions);
 
+    /// Update the positions of all particles in the system in-place, copying
+    /// the data from `positions` into the existing tensor.
+    ///
+    /// This is intended for engines re-using the same `System` for every step
+    /// of a simulation. When `positions` has the same shape, dtype and device
+    /// as the existing positions, and neither of them requires gradients, no
+    /// validation or allocation is done; otherwise this behaves like
+    /// `set_positions`.
+    void update_positions(torch::Tensor positions);
+
     /// Unit cell/bounding box of the system.
     torch::Tensor cell() const {
         return cell_;
@@ -180,6 +207,10 @@ public:
     /// Set cell for the system
     void set_cell(torch::Tensor cell);
 
+    /// Update the cell of the system in-place, copying the data from `cell`
+    /// into the existing tensor. See `update_positions` for more information.
+    void update_cell(torch::Tensor cell);
+
     /// Get the device used by all the data in this `System`
     torch::Device device() const {
         return this->types_.device();
@@ -229,6 +260,57 @@ public:
     /// cell_shift_a * cell_a + cell_shift_b * cell_b + cell_shift_c * cell_c`.
     void add_neighbors_list(NeighborsListOptions options, TorchTensorBlock neighbors);
 
+    /// Replace the distance vectors of an existing neighbors list
+    /// corresponding to `options` with `values`, without re-validating the
+    /// metadata of the neighbors list.
+    ///
+    /// If `samples` is not given, the pairs are assumed to be the same as in
+    /// the existing neighbors list, and the existing samples are re-used.
+    /// Otherwise, `samples` should contain the new set of pairs, using the
+    /// same names as in `add_neighbors_list`. In both cases, the components
+    /// and properties `Labels` of the existing neighbors list are re-used.
+    ///
+    /// `values` should have a shape of `(len(samples), 3, 1)` and use the same
+    /// dtype and device as this system. As for `add_neighbors_list`, the
+    /// values should be registered with `register_autograd_neighbors()` if
+    /// the system positions or cell require gradients.
+    void update_neighbors_list(
+        NeighborsListOptions options,
+        torch::Tensor values,
+        torch::optional<TorchLabels> samples = torch::nullopt
+    );
+
+    /// Compute the neighbors lists corresponding to all the given `options`
+    /// with a built-in cell list, and add them to the `self` system.
+    ///
+    /// The positions and cell of the system should be expressed in
+    /// `length_unit`, which is used to convert the cutoff of each
+    /// `NeighborsListOptions` (see `NeighborsListOptionsHolder::engine_cutoff`).
+    /// A single list is computed with the largest cutoff, and all the other
+    /// lists are extracted from it. The neighbors are computed on the same
+    /// device as the system, and registered with
+    /// `register_autograd_neighbors()`.
+    ///
+    /// Systems with a cell of only zeros are treated as non-periodic, all
+    /// others systems are periodic in all three directions.
+    ///
+    /// If `previous` is given and the lists were computed for it with this
+    /// function, the pairs are re-used instead of searching for all neighbors
+    /// again, as long as the cell did not change and no atom moved more than
+    /// half of the Verlet skin (see `NeighborsListOptionsHolder::skin`) since
+    /// the pairs were last computed. Only the distance vectors are then
+    /// re-computed.
+    ///
+    /// Neighbors lists already present in `self` are updated with
+    /// `update_neighbors_list` instead of being added again, allowing the same
+    /// system to be re-used for all the steps of a simulation.
+    static void compute_neighbors_lists(
+        System self,
+        std::vector<NeighborsListOptions> options,
+        std::string length_unit = "",
+        torch::optional<System> previous = torch::nullopt
+    );
+
     /// Retrieve a previously stored neighbors list with the given options, or
     /// throw an error if no such neighbors list exists.
     TorchTensorBlock get_neighbors_list(NeighborsListOptions options) const;
@@ -274,6 +356,11 @@ private:
 
     std::map<NeighborsListOptions, TorchTensorBlock, nl_options_compare> neighbors_;
     std::unordered_map<std::string, TorchTensorBlock> data_;
+
+    /// Candidate pairs for the neighbors lists created by
+    /// `compute_neighbors_lists`, used to re-use them for the next system
+    struct NeighborsCandidates;
+    std::shared_ptr<NeighborsCandidates> neighbors_candidates_;
 };
 
 }
@@ -2,6 +2,9 @@
 #define METATENSOR_TORCH_BLOCK_HPP
 
 #include <vector>
+#include <mutex>
+#include <memory>
+#include <unordered_map>
 
 #include <torch/script.h>
 
@@ -23,7 +26,13 @@ using TorchTensorBlock = torch::intrusive_ptr<TensorBlockHolder>;
 /// of instances of `TensorBlockHolder`.
 class METATENSOR_TORCH_EXPORT TensorBlockHolder: public torch::CustomClassHolder {
 public:
-    /// Create a new TensorBlockHolder with the given data and metadata
+    /// Create a new TensorBlockHolder with the given data and metadata.
+    ///
+    /// The shape of `data` is checked against the Labels right away, but the
+    /// corresponding `metatensor::TensorBlock` is only created when needed
+    /// (see `as_metatensor`). Lazy Labels (for example created with
+    /// `assume_unique` on GPU) then stay on their device, without copying
+    /// their values to the CPU.
     TensorBlockHolder(
         torch::Tensor data,
         TorchLabels samples,
@@ -43,6 +52,28 @@ public:
     /// contained inside
     TorchTensorBlock copy() const;
 
+    /// Create a new block containing the samples in the `[start, stop)` range
+    /// of this block, and the corresponding gradients.
+    ///
+    /// The values of the new block (and the samples values) are views inside
+    /// the values of this block, sharing the same memory. The new samples are
+    /// not checked for duplicated entries, since they are a subset of unique
+    /// entries. Gradients are also views if the gradient rows corresponding
+    /// to the selected samples are contiguous, and copies otherwise.
+    TorchTensorBlock slice_samples(int64_t start, int64_t stop) const;
+
+    /// Split this block along the samples axis at the given `boundaries`,
+    /// using `slice_samples` for each `[boundaries[i - 1], boundaries[i])`
+    /// range. The first range starts at 0 and the last one ends with the last
+    /// sample of this block.
+    std::vector<TorchTensorBlock> split_samples(const std::vector<int64_t>& boundaries) const;
+
+    /// Get the memory used by this block and all its gradients, in bytes,
+    /// broken down by category (see `mts_memory_usage_t` for the list of
+    /// categories). The size of the values and gradients is the size of the
+    /// corresponding tensors, on whatever device they are stored.
+    torch::Dict<std::string, int64_t> memory_usage() const;
+
     /// Get a view in the values in this block
     torch::Tensor values() const;
 
@@ -64,10 +95,10 @@ public:
     /// The entries in these labels describe intermediate dimensions of the
     /// `values()` array.
     std::vector<TorchLabels> components() const {
-        auto shape = this->block_.values_shape();
+        auto n_dims = static_cast<uintptr_t>(this->values().dim());
 
         auto result = std::vector<TorchLabels>();
-        for (size_t i=1; i<shape.size() - 1; i++) {
+        for (uintptr_t i=1; i<n_dims - 1; i++) {
             result.emplace_back(this->labels(i));
         }
 
@@ -80,8 +111,8 @@ public:
     /// `values()` array. The properties are guaranteed to be the same for
     /// values and gradients in the same block.
     TorchLabels properties() const {
-        auto shape = this->block_.values_shape();
-        return this->labels(shape.size() - 1);
+        auto n_dims = static_cast<uintptr_t>(this->values().dim());
+        return this->labels(n_dims - 1);
     }
 
     /// Add a set of gradients with respect to `parameters` in this block.
@@ -101,9 +132,7 @@ public:
     void add_gradient(const std::string& parameter, TorchTensorBlock gradient);
 
     /// Get a list of all gradients defined in this block.
-    std::vector<std::string> gradients_list() const {
-        return block_.gradients_list();
-    }
+    std::vector<std::string> gradients_list() const;
 
     /// Check if a given gradient is defined in this TensorBlock
     bool has_gradient(const std::string& parameter) const;
@@ -125,9 +154,20 @@ public:
     }
 
     /// Move all arrays in this block to the given `dtype` and `device`.
+    ///
+    /// If `non_blocking` is `true`, the copies are asynchronous with respect
+    /// to the host when possible, i.e. when copying from pinned CPU memory to
+    /// a GPU, or from a GPU to the CPU. All copies are then queued on the
+    /// current stream, and the caller is responsible for synchronizing with
+    /// this stream before reading data copied to the CPU. The Labels are
+    /// always ready to use after this function returns.
+    ///
+    /// Labels shared between the values and gradients of this block (such as
+    /// the properties) are only moved once.
     TorchTensorBlock to(
         torch::optional<torch::Dtype> dtype = torch::nullopt,
-        torch::optional<torch::Device> device = torch::nullopt
+        torch::optional<torch::Device> device = torch::nullopt,
+        bool non_blocking = false
     ) const;
 
     /// Wrapper of the `to` function to enable using it with positional
@@ -143,15 +183,21 @@ public:
         torch::IValue positional_2,
         torch::optional<torch::Dtype> dtype,
         torch::optional<torch::Device> device,
-        torch::optional<std::string> arrays
+        torch::optional<std::string> arrays,
+        bool non_blocking
     ) const;
 
     /// Implementation of __repr__/__str__ for Python
     std::string repr() const;
 
-    /// Get the underlying metatensor TensorBlock
+    /// Get the underlying metatensor TensorBlock.
+    ///
+    /// Blocks created from torch data only create the corresponding
+    /// `metatensor::TensorBlock` on the first call to this function (or to a
+    /// function requiring it, such as `add_gradient`), which also creates the
+    /// `metatensor::Labels` of lazy Labels.
     const metatensor::TensorBlock& as_metatensor() const {
-        return block_;
+        return this->block();
     }
 
 private:
@@ -160,8 +206,31 @@ private:
     TensorBlockHolder(metatensor::TensorBlock block, std::string parameter, torch::IValue parent);
     friend class torch::intrusive_ptr<TensorBlockHolder>;
 
-    /// Underlying metatensor TensorBlock
-    metatensor::TensorBlock block_;
+    /// Labels already moved to a new device by `to_impl`, indexed by the
+    /// pointer to the corresponding Rust labels (`mts_labels_t::internal_ptr_`)
+    using MovedLabels = std::unordered_map<const void*, TorchLabels>;
+
+    /// Implementation of `to`, re-using Labels in `moved_labels` if they were
+    /// already moved to the new device, and adding newly moved Labels to it.
+    TorchTensorBlock to_impl(
+        torch::optional<torch::Dtype> dtype,
+        torch::optional<torch::Device> device,
+        bool non_blocking,
+        MovedLabels& moved_labels
+    ) const;
+    friend class TensorMapHolder;
+
+    /// Get the underlying metatensor TensorBlock, creating it from `values_`
+    /// and `labels_` if needed
+    metatensor::TensorBlock& block() const;
+
+    /// Underlying metatensor TensorBlock. This is `nullptr` for blocks created
+    /// from torch data until the first call to `block()`.
+    mutable std::unique_ptr<metatensor::TensorBlock> block_;
+    /// Values of blocks created from torch data, until `block_` is created
+    mutable torch::Tensor values_;
+    /// Lock protecting the lazy initialization of `block_`
+    std::shared_ptr<std::mutex> block_mutex_ = std::make_shared<std::mutex>();
 
     /// Parent for this block, either `None`, another `TensorBlock` (if this
     /// block contains gradients), or a `TensorMap`.
@@ -170,6 +239,13 @@ private:
     /// If this TensorBlock contains gradients, these are gradients w.r.t. this
     /// parameter
     std::string parameter_;
+
+    /// Labels for each axis of the values. For blocks created from torch data,
+    /// these are the Labels given to the constructor. Otherwise, they are
+    /// created on the first call to `labels()` for each axis and then re-used
+    mutable std::vector<TorchLabels> labels_;
+    /// Lock protecting the initialization of `labels_`
+    std::shared_ptr<std::mutex> labels_mutex_ = std::make_shared<std::mutex>();
 };
 
 }
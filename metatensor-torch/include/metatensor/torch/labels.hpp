@@ -3,6 +3,8 @@
 
 #include <string>
 #include <vector>
+#include <mutex>
+#include <memory>
 
 #include <torch/script.h>
 
@@ -43,7 +45,16 @@ public:
     ///
     /// The names should be either a single string or a list/tuple of strings;
     /// and the values should be a 2D tensor of integers.
-    LabelsHolder(torch::IValue names, torch::Tensor values);
+    ///
+    /// If `assume_unique` is `true`, the entries in `values` are not checked
+    /// for uniqueness when creating the Labels. The values then stay on their
+    /// device, and the corresponding `metatensor::Labels` (with a copy of the
+    /// values on CPU) are only created when an operation requires them
+    /// (`position`, `as_metatensor`, saving a `TensorBlock`, *etc.*). The
+    /// entries are checked at this point, and `as_metatensor` throws if they
+    /// contain duplicates. This removes a synchronization between the host and
+    /// the device from the creation of Labels on GPU.
+    LabelsHolder(torch::IValue names, torch::Tensor values, bool assume_unique = false);
 
     /// Convenience constructor for building `LabelsHolder` in C++, similar to
     /// `metatensor::Labels`.
@@ -104,8 +115,12 @@ public:
     /// Move the values for these Labels to the given `device`
     TorchLabels to(torch::IValue device) const;
 
-    /// Move the values for these Labels to the given `device`
-    TorchLabels to(torch::Device device) const;
+    /// Move the values for these Labels to the given `device`. If
+    /// `non_blocking` is `true`, the copy of the values is asynchronous with
+    /// respect to the host when possible (see `torch::Tensor::to`). Copies to
+    /// the CPU are always synchronous, since the values are then used to
+    /// create the metatensor-core labels.
+    TorchLabels to(torch::Device device, bool non_blocking = false) const;
 
     /// Get the values associated with a single dimension (i.e. a single column
     /// of `values()`) in these labels.
@@ -135,6 +150,18 @@ public:
     ///    - a tuple of integers;
     torch::optional<int64_t> position(torch::IValue entry) const;
 
+    /// Get the positions of multiple `entries` in this set of Labels, in a
+    /// single call. `entries` should be a 2-D tensor of integers, with one row
+    /// for each entry. The result is a 1-D tensor of `int64_t` (on the same
+    /// device as `entries`) containing the position of each entry, or -1 for
+    /// the entries which are not part of these Labels.
+    torch::Tensor positions(torch::Tensor entries) const;
+
+    /// Get the memory used by these Labels, in bytes, broken down by category
+    /// (see `mts_memory_usage_t` for the list of categories). This includes
+    /// the copy of the values stored in a tensor, if any.
+    torch::Dict<std::string, int64_t> memory_usage() const;
+
     /// Print the names and values of these Labels to a string, including at
     /// most `max_entries` entries (set this to -1 to print all entries), and
     /// indenting all lines after the first with `indent` spaces.
@@ -151,7 +178,7 @@ public:
 
     /// Is this a view inside existing Labels or an owned Labels?
     bool is_view() const {
-        return !labels_.has_value();
+        return is_view_;
     }
 
     /// Transform a view of Labels into owned Labels, which can be further given
@@ -160,7 +187,7 @@ public:
 
     // A view is created by the `view` function (also `__getitem__` in Python),
     // and does not have a corresponding `metatensor::Labels` (`labels_` is
-    // `nullopt`)
+    // `nullopt` and `is_view_` is `true`)
     TorchLabels to_owned() const;
 
     /// Get the union of `this` and `other`
@@ -205,7 +232,26 @@ private:
     /// Create a view for an existing `LabelsHolder`
     LabelsHolder(std::vector<std::string> names, torch::Tensor values, CreateView);
 
+    /// marker type to differentiate the private constructor below from the main
+    /// one
+    struct CreateLazy {};
+
+    /// Create owned Labels from `values`, which must contain unique entries,
+    /// without creating the corresponding `metatensor::Labels` yet. These are
+    /// created on the first call to `as_metatensor`. This allows keeping the
+    /// result of operations done on the labels device there, without copying
+    /// the values back to the CPU.
+    LabelsHolder(std::vector<std::string> names, torch::Tensor values, CreateLazy);
+
+    /// Create new owned Labels from `names` and `values`, where `values` are
+    /// obtained from the values of `this` without making them non-unique
+    /// (e.g. by adding or permuting columns). If `this` is not a view, the new
+    /// Labels are lazy.
+    TorchLabels derived(std::vector<std::string> names, torch::Tensor values) const;
+
     friend class torch::intrusive_ptr<LabelsHolder>;
+    // `TensorBlockHolder::slice_samples` creates lazy Labels from views
+    friend class TensorBlockHolder;
 
     /// names of the Labels, stored here for easier retrieval from Python
     std::vector<std::string> names_;
@@ -214,8 +260,22 @@ private:
     torch::Tensor values_;
 
     /// Underlying metatensor labels, this is undefined when the Labels is
-    /// actually a view (with selected columns) into another Labels
-    torch::optional<metatensor::Labels> labels_;
+    /// actually a view (with selected columns) into another Labels, and until
+    /// the first call to `as_metatensor` for lazy Labels (created with
+    /// `CreateLazy` or `assume_unique`).
+    mutable torch::optional<metatensor::Labels> labels_;
+
+    /// Lock protecting the lazy initialization of `labels_`
+    std::shared_ptr<std::mutex> labels_mutex_ = std::make_shared<std::mutex>();
+
+    /// Should `as_metatensor` check that the entries are unique when creating
+    /// `labels_`? This is the case for lazy Labels created with
+    /// `assume_unique` (and Labels derived from them), where the entries come
+    /// from the user and were never checked.
+    bool check_unique_ = false;
+
+    /// Is this a view inside another Labels?
+    bool is_view_ = false;
 };
 
 /// Check two `LabelsHolder` for equality
@@ -15,16 +15,28 @@ METATENSOR_TORCH_EXPORT std::string version();
 
 namespace details {
     /// Function to be used as `mts_create_array_callback_t` to load data in
-    /// torch Tensor.
+    /// torch Tensor. The new tensors are not initialized, since loading
+    /// overwrites all of their elements.
     METATENSOR_TORCH_EXPORT mts_status_t create_torch_array(
         const uintptr_t* shape_ptr,
         uintptr_t shape_count,
         mts_array_t* array
     );
+
+    /// Function to be used as `mts_profiling_callback_t`, forwarding the
+    /// profiling events from metatensor-core to the torch profiler. This is
+    /// registered when loading the metatensor-torch library.
+    METATENSOR_TORCH_EXPORT void core_profiling_callback(const char* name, bool enter);
 }
 
-/// Load a previously saved `TensorMap` from the given path.
-METATENSOR_TORCH_EXPORT TorchTensorMap load(const std::string& path);
+/// Load a previously saved `TensorMap` from the given path, converting the
+/// data to the given `dtype` and `device`. See `TensorMapHolder::load` for
+/// more information.
+METATENSOR_TORCH_EXPORT TorchTensorMap load(
+    const std::string& path,
+    torch::optional<torch::Dtype> dtype = torch::nullopt,
+    torch::optional<torch::Device> device = torch::nullopt
+);
 
 /// Load previously saved `Labels` from the given path.
 METATENSOR_TORCH_EXPORT TorchLabels load_labels(const std::string& path);
@@ -51,6 +63,41 @@ METATENSOR_TORCH_EXPORT torch::Tensor save_buffer(TorchTensorMap tensor);
 /// `torch::Tensor` of bytes)
 METATENSOR_TORCH_EXPORT torch::Tensor save_buffer(TorchLabels labels);
 
+class TensorMapWriterHolder;
+/// TorchScript will always manipulate `TensorMapWriterHolder` through a `torch::intrusive_ptr`
+using TorchTensorMapWriter = torch::intrusive_ptr<TensorMapWriterHolder>;
+
+/// Wrapper around `metatensor::io::TensorMapWriter` for integration with
+/// TorchScript, writing a `TensorMap` to a file one block at a time.
+class METATENSOR_TORCH_EXPORT TensorMapWriterHolder: public torch::CustomClassHolder {
+public:
+    /// Create a new writer for the file at `path`, for a `TensorMap` with the
+    /// given keys names.
+    TensorMapWriterHolder(const std::string& path, const std::vector<std::string>& keys_names);
+
+    /// Write `block` to the file, associated with the given `key`. The block
+    /// data must be on CPU.
+    void add_block(const std::vector<int64_t>& key, const TorchTensorBlock& block);
+
+    /// Start writing a block associated with the given `key` in chunks of
+    /// samples, where `shape` is the total shape of the values of the block.
+    void begin_block(const std::vector<int64_t>& key, const std::vector<int64_t>& shape);
+
+    /// Write the next samples of the block started with `begin_block`. The
+    /// chunk data must be on CPU, and the chunk can not contain gradients.
+    void add_samples(const TorchTensorBlock& chunk);
+
+    /// Finish writing the block started with `begin_block`
+    void end_block();
+
+    /// Write the keys of all blocks added so far to the file. No other blocks
+    /// can be added after calling this function.
+    void finish();
+
+private:
+    metatensor::io::TensorMapWriter writer_;
+};
+
 }
 
 #endif
@@ -2,6 +2,8 @@
 #define METATENSOR_TORCH_TENSOR_HPP
 
 #include <vector>
+#include <mutex>
+#include <memory>
 
 #include <torch/script.h>
 
@@ -115,6 +117,35 @@ public:
     /// strings.
     TorchTensorMap components_to_properties(torch::IValue dimensions) const;
 
+    /// Join multiple `tensors` along the samples axis, merging the blocks with
+    /// the same key in all tensors.
+    ///
+    /// See `metatensor::TensorMap::join_samples` for more information on this
+    /// function. If `new_dimension` is set, a new sample dimension with this
+    /// name is added, containing the index of the tensor each sample comes
+    /// from.
+    static TorchTensorMap join_samples(
+        const std::vector<TorchTensorMap>& tensors,
+        torch::optional<std::string> new_dimension
+    );
+
+    /// Create a new `TensorMap` where each block contains the samples in the
+    /// `[start, stop)` range of the corresponding block in this tensor map.
+    ///
+    /// See `TensorBlockHolder::slice_samples` for more information on this
+    /// function. This is mainly useful when all blocks have the same samples.
+    TorchTensorMap slice_samples(int64_t start, int64_t stop) const;
+
+    /// Split all the blocks of this `TensorMap` along the samples axis at the
+    /// given `boundaries`. See `TensorBlockHolder::split_samples` for more
+    /// information on this function.
+    std::vector<TorchTensorMap> split_samples(const std::vector<int64_t>& boundaries) const;
+
+    /// Get the memory used by this `TensorMap` and all its blocks, in bytes,
+    /// broken down by category. See `TensorBlockHolder::memory_usage` for more
+    /// information.
+    torch::Dict<std::string, int64_t> memory_usage() const;
+
     /// Get the names of the samples dimensions for all blocks in this
     /// `TensorMap`
     std::vector<std::string> sample_names();
@@ -141,11 +172,34 @@ public:
     torch::Dtype scalar_type() const;
 
     /// Move this `TensorMap` to the given `dtype` and `device`.
+    ///
+    /// If `non_blocking` is `true`, the copies of all the blocks are queued on
+    /// the current stream without waiting for each one of them to finish, see
+    /// `TensorBlockHolder::to` for more information. Labels shared between
+    /// blocks are only moved once.
     TorchTensorMap to(
         torch::optional<torch::Dtype> dtype = torch::nullopt,
-        torch::optional<torch::Device> device = torch::nullopt
+        torch::optional<torch::Device> device = torch::nullopt,
+        bool non_blocking = false
     ) const;
 
+    /// Get a copy of this `TensorMap`, where the values of all blocks and all
+    /// their gradients are views inside a single contiguous 1-dimensional
+    /// buffer, available with `packed_buffer()`. The blocks are stored one
+    /// after the other in the buffer, each block followed by its gradients.
+    ///
+    /// Calling `to()` on a packed `TensorMap` moves the whole buffer with a
+    /// single copy, and returns another packed `TensorMap`. The buffer can
+    /// also be used to apply operations on all the values at once, such as
+    /// distributed all-reduce.
+    TorchTensorMap pack() const;
+
+    /// Get the buffer containing the values of all blocks if this `TensorMap`
+    /// was created by `pack()` (or `to()` on a packed `TensorMap`), and
+    /// `None` otherwise. Modifying this buffer in-place modifies the values
+    /// of all blocks.
+    torch::optional<torch::Tensor> packed_buffer() const;
+
     /// Wrapper of the `to` function to enable using it with positional
     /// parameters from Python; for example `to(dtype)`, `to(device)`,
     /// `to(dtype, device=device)`, `to(dtype, device)`, `to(device, dtype)`,
@@ -159,16 +213,48 @@ public:
         torch::IValue positional_2,
         torch::optional<torch::Dtype> dtype,
         torch::optional<torch::Device> device,
-        torch::optional<std::string> arrays
+        torch::optional<std::string> arrays,
+        bool non_blocking
     ) const;
 
     /// Get the underlying metatensor TensorMap
     const metatensor::TensorMap& as_metatensor() const {
-        return tensor_;
+        return data_->tensor;
     }
 
-    /// Load a serialized TensorMap from the given path
-    static TorchTensorMap load(const std::string& path);
+    /// Load a serialized TensorMap from the given path.
+    ///
+    /// If `dtype` or `device` are given, the values and gradients are
+    /// created directly with this dtype and on this device. For CUDA devices,
+    /// the data of each array goes through a pinned staging buffer, and is
+    /// copied asynchronously to the device while the next arrays are read
+    /// from the file.
+    static TorchTensorMap load(
+        const std::string& path,
+        torch::optional<torch::Dtype> dtype = torch::nullopt,
+        torch::optional<torch::Device> device = torch::nullopt
+    );
+
+    /// Load only the blocks matching `selection` from a serialized TensorMap at
+    /// the given path. See `metatensor::io::load_selection` for more
+    /// information.
+    static TorchTensorMap load_selection(const std::string& path, TorchLabels selection);
+
+    /// Load a serialized TensorMap from the given path, using memory mapping to
+    /// avoid copying the data. The values and gradients of the returned
+    /// TensorMap are CPU `torch::Tensor` pointing directly inside the mapped
+    /// file, see `metatensor::io::load_mmap` for more information.
+    static TorchTensorMap load_mmap(const std::string& path);
+
+    /// Load a TensorMap from the shared memory segment with the given `name`,
+    /// created by `save_shm` in this or another process. The values and
+    /// gradients are CPU `torch::Tensor` pointing directly inside the shared
+    /// memory, see `metatensor::io::load_shm` for more information.
+    static TorchTensorMap load_shm(const std::string& name);
+
+    /// Remove the shared memory segment with the given `name`, created by
+    /// `save_shm`, see `metatensor::io::remove_shm` for more information.
+    static void remove_shm(const std::string& name);
 
     /// Load a serialized TensorMap from an in-memory buffer (represented as a
     /// `torch::Tensor` of bytes)
@@ -177,16 +263,45 @@ public:
     /// Serialize and save a TensorMap to the given path
     void save(const std::string& path) const;
 
+    /// Serialize and save a TensorMap to the shared memory segment with the
+    /// given `name`, see `metatensor::io::save_shm` for more information.
+    void save_shm(const std::string& name) const;
+
     /// Serialize and save a TensorMap to an in-memory buffer (represented as a
     /// `torch::Tensor` of bytes)
     torch::Tensor save_buffer() const;
 
 private:
+    /// Owner of the underlying metatensor TensorMap. This is a separate object
+    /// to allow the blocks cached in `blocks_` to keep the TensorMap alive
+    /// without keeping this `TensorMapHolder` alive, which would create a
+    /// reference cycle.
+    struct TensorMapData: public torch::CustomClassHolder {
+        explicit TensorMapData(metatensor::TensorMap tensor_): tensor(std::move(tensor_)) {}
+        metatensor::TensorMap tensor;
+    };
+
     /// Underlying metatensor TensorMap
-    metatensor::TensorMap tensor_;
+    torch::intrusive_ptr<TensorMapData> data_;
+
+    /// Keys of this TensorMap, created on the first call to `keys()`
+    mutable TorchLabels keys_;
+    /// Blocks of this TensorMap, created on the first call to `block_by_id()`
+    /// for each block and then re-used, so that the same `TorchTensorBlock`
+    /// (and the corresponding Labels) is returned every time. The blocks
+    /// inside a TensorMap can not be modified, so this never needs to be
+    /// invalidated.
+    mutable std::vector<TorchTensorBlock> blocks_;
+    /// Lock protecting the initialization of `keys_` and `blocks_`
+    std::shared_ptr<std::mutex> cache_mutex_ = std::make_shared<std::mutex>();
+
+    /// Buffer containing the values of all blocks for `TensorMap` created by
+    /// `pack()`, undefined otherwise
+    torch::Tensor packed_;
 
     /// Wrap an existing `metatensor::TensorMap` into a `TensorMapHolder`
-    explicit TensorMapHolder(metatensor::TensorMap tensor): tensor_(std::move(tensor)) {}
+    explicit TensorMapHolder(metatensor::TensorMap tensor):
+        data_(torch::make_intrusive<TensorMapData>(std::move(tensor))) {}
 };
 
 
@@ -68,13 +68,68 @@ double* TorchDataArray::data() & {
         );
     }
 
-    if (!this->tensor_.is_contiguous()) {
-        C10_THROW_ERROR(ValueError, "can not access the data of a non contiguous torch::Tensor");
-    }
+    // `swap_axes` does not copy the data, so the tensor might not be
+    // contiguous here
+    this->make_contiguous();
 
     return static_cast<double*>(this->tensor_.data_ptr());
 }
 
+void* TorchDataArray::typed_data(int32_t& dtype) & {
+    if (!this->tensor_.device().is_cpu()) {
+        C10_THROW_ERROR(ValueError, "can not access the data of a torch::Tensor not on CPU");
+    }
+
+    auto scalar_type = this->tensor_.scalar_type();
+    if (scalar_type == torch::kF64) {
+        dtype = MTS_DTYPE_F64;
+    } else if (scalar_type == torch::kF32) {
+        dtype = MTS_DTYPE_F32;
+    } else if (scalar_type == torch::kF16) {
+        dtype = MTS_DTYPE_F16;
+    } else if (scalar_type == torch::kBFloat16) {
+        dtype = MTS_DTYPE_BF16;
+    } else {
+        C10_THROW_ERROR(ValueError,
+            "can not access the data of this torch::Tensor: expected a floating "
+            "point dtype, got " + std::string(this->tensor_.dtype().name())
+        );
+    }
+
+    this->make_contiguous();
+
+    return this->tensor_.data_ptr();
+}
+
+std::unique_ptr<metatensor::DataArrayBase> TorchDataArray::create_typed(std::vector<uintptr_t> shape, int32_t dtype) const {
+    auto scalar_type = torch::kF64;
+    if (dtype == MTS_DTYPE_F64) {
+        scalar_type = torch::kF64;
+    } else if (dtype == MTS_DTYPE_F32) {
+        scalar_type = torch::kF32;
+    } else if (dtype == MTS_DTYPE_F16) {
+        scalar_type = torch::kF16;
+    } else if (dtype == MTS_DTYPE_BF16) {
+        scalar_type = torch::kBFloat16;
+    } else {
+        return nullptr;
+    }
+
+    auto sizes = std::vector<int64_t>();
+    for (auto size: shape) {
+        sizes.push_back(static_cast<int64_t>(size));
+    }
+
+    return std::unique_ptr<DataArrayBase>(new TorchDataArray(
+        torch::zeros(
+            sizes,
+            torch::TensorOptions()
+                .dtype(scalar_type)
+                .device(this->tensor().device())
+        )
+    ));
+}
+
 const std::vector<uintptr_t>& TorchDataArray::shape() const & {
     return shape_;
 }
@@ -91,14 +146,23 @@ void TorchDataArray::reshape(std::vector<uintptr_t> shape) {
 }
 
 void TorchDataArray::swap_axes(uintptr_t axis_1, uintptr_t axis_2) {
+    // this only creates a view, the data is copied when needed by `reshape`
+    // or when accessing the data, so that multiple calls to `swap_axes` (e.g.
+    // in `components_to_properties`) copy the data at most once.
     this->tensor_ = this->tensor().swapaxes(
         static_cast<int64_t>(axis_1),
         static_cast<int64_t>(axis_2)
-    ).contiguous();
+    );
 
     this->update_shape();
 }
 
+void TorchDataArray::make_contiguous() {
+    if (!this->tensor_.is_contiguous()) {
+        this->tensor_ = this->tensor_.contiguous();
+    }
+}
+
 void TorchDataArray::move_samples_from(
     const metatensor::DataArrayBase& raw_input,
     std::vector<mts_sample_mapping_t> samples,
@@ -107,18 +171,6 @@ void TorchDataArray::move_samples_from(
 ) {
     const auto& input = dynamic_cast<const TorchDataArray&>(raw_input);
     auto input_tensor = input.tensor();
-
-    auto options = torch::TensorOptions().device(input_tensor.device()).dtype(torch::kInt64);
-    auto input_samples = torch::zeros({static_cast<int64_t>(samples.size())}, options);
-    auto output_samples = torch::zeros({static_cast<int64_t>(samples.size())}, options);
-
-    for (int64_t i=0; i<samples.size(); i++) {
-        input_samples[i] = static_cast<int64_t>(samples[i].input);
-        output_samples[i] = static_cast<int64_t>(samples[i].output);
-    }
-
-    using torch::indexing::Slice;
-    using torch::indexing::Ellipsis;
     auto output_tensor = this->tensor();
 
     assert(input_tensor.dtype() == output_tensor.dtype());
@@ -130,11 +182,59 @@ void TorchDataArray::move_samples_from(
         return;
     }
 
-    // output[output_samples, ..., properties] = input[input_samples, ..., :]
-    output_tensor.index_put_(
-        {output_samples, Ellipsis, Slice(property_start, property_end)},
-        input_tensor.index({input_samples, Ellipsis, Slice()})
+    if (samples.empty()) {
+        return;
+    }
+
+    auto n_properties = static_cast<int64_t>(property_end - property_start);
+    auto last_dim = output_tensor.dim() - 1;
+    auto output_view = output_tensor;
+    if (n_properties != output_tensor.size(last_dim)) {
+        output_view = output_tensor.narrow(last_dim, static_cast<int64_t>(property_start), n_properties);
+    }
+
+    // When the samples are moved as a contiguous range (for example when
+    // merging blocks sharing the same samples in `keys_to_properties`), we
+    // can copy the data directly without building indexes.
+    auto contiguous = true;
+    for (size_t i=1; i<samples.size(); i++) {
+        if (samples[i].input != samples[0].input + i || samples[i].output != samples[0].output + i) {
+            contiguous = false;
+            break;
+        }
+    }
+
+    auto n_samples = static_cast<int64_t>(samples.size());
+    if (contiguous) {
+        output_view.narrow(0, static_cast<int64_t>(samples[0].output), n_samples).copy_(
+            input_tensor.narrow(0, static_cast<int64_t>(samples[0].input), n_samples)
+        );
+        return;
+    }
+
+    // Build both the input and output indexes in a single host buffer, and
+    // send it to the device with a single copy. Filling torch tensors one
+    // element at a time would dispatch (and on GPU, launch a kernel) for every
+    // single sample.
+    auto indexes = std::vector<int64_t>(2 * samples.size());
+    for (size_t i=0; i<samples.size(); i++) {
+        indexes[i] = static_cast<int64_t>(samples[i].input);
+        indexes[samples.size() + i] = static_cast<int64_t>(samples[i].output);
+    }
+
+    auto cpu_indexes = torch::from_blob(
+        indexes.data(),
+        {2, n_samples},
+        torch::TensorOptions().dtype(torch::kInt64).device(torch::kCPU)
     );
+    // `indexes` is kept alive until the end of this function, so it is fine
+    // for `device_indexes` to alias it when the data is already on CPU
+    auto device_indexes = cpu_indexes.to(input_tensor.device());
+    auto input_samples = device_indexes[0];
+    auto output_samples = device_indexes[1];
+
+    // output[output_samples, ..., properties] = input[input_samples, ..., :]
+    output_view.index_copy_(0, output_samples, input_tensor.index_select(0, input_samples));
 }
 
 void TorchDataArray::update_shape() {
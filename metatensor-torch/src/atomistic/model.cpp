@@ -2,11 +2,15 @@
 #include <cctype>
 
 #include <array>
+#include <mutex>
 #include <sstream>
 #include <algorithm>
 #include <filesystem>
 
 #include <torch/torch.h>
+#include <ATen/record_function.h>
+#include <caffe2/serialize/file_adapter.h>
+#include <caffe2/serialize/inline_container.h>
 #include <nlohmann/json.hpp>
 
 #include <metatensor.hpp>
@@ -739,21 +743,63 @@ static std::string record_to_string(std::tuple<at::DataPtr, size_t> data) {
 }
 
 
-/// Check if a library is already loaded. To handle multiple platforms, this
-/// does fuzzy matching on the file name; assuming that the name of the library
-/// is the same across platforms.
-static bool library_already_loaded(
-    const std::vector<std::string>& loaded_libraries,
-    const std::string& name
-) {
-    for (const auto& library: loaded_libraries) {
-        auto filename = std::filesystem::path(library).filename().string();
-        if (filename.find(name) != std::string::npos) {
+/// Cache of the libraries known to be loaded in the current process. Since
+/// libraries are never unloaded, a library found once is considered loaded
+/// forever, and we only need to go through the list of all loaded libraries
+/// (which can be slow with many libraries) when looking for a new name.
+class LoadedLibrariesCache {
+public:
+    /// Check if a library is already loaded. To handle multiple platforms,
+    /// this does fuzzy matching on the file name; assuming that the name of
+    /// the library is the same across platforms.
+    bool contains(const std::string& name) {
+        auto guard = std::lock_guard<std::mutex>(mutex_);
+        if (known_.find(name) != known_.end()) {
             return true;
         }
+
+        if (outdated_) {
+            filenames_.clear();
+            for (const auto& library: metatensor_torch::details::get_loaded_libraries()) {
+                filenames_.emplace_back(std::filesystem::path(library).filename().string());
+            }
+            outdated_ = false;
+        }
+
+        for (const auto& filename: filenames_) {
+            if (filename.find(name) != std::string::npos) {
+                known_.insert(name);
+                return true;
+            }
+        }
+        return false;
     }
-    return false;
-}
+
+    /// Record that the library with the given `name` was loaded
+    void insert(const std::string& name) {
+        auto guard = std::lock_guard<std::mutex>(mutex_);
+        known_.insert(name);
+        // loading a library can also load its dependencies
+        outdated_ = true;
+    }
+
+    /// Mark the list of loaded libraries as outdated, since other libraries
+    /// might have been loaded since the last time we looked.
+    void invalidate() {
+        auto guard = std::lock_guard<std::mutex>(mutex_);
+        outdated_ = true;
+    }
+
+private:
+    std::mutex mutex_;
+    /// names of the libraries we know are loaded
+    std::unordered_set<std::string> known_;
+    /// file names of all the loaded libraries, the last time we looked
+    std::vector<std::string> filenames_;
+    bool outdated_ = true;
+};
+
+static LoadedLibrariesCache LOADED_LIBRARIES;
 
 
 /// Load a shared library (either TorchScript extension or dependency of
@@ -773,7 +819,9 @@ static void load_library(
 
     auto loaded = details::load_library(library.name, candidates);
 
-    if (!loaded) {
+    if (loaded) {
+        LOADED_LIBRARIES.insert(library.name);
+    } else {
         std::ostringstream oss;
         oss << "failed to load ";
         if (is_dependency) {
@@ -796,41 +844,55 @@ static void load_library(
     }
 }
 
-void metatensor_torch::load_model_extensions(
-    std::string path,
-    c10::optional<std::string> extensions_directory
-) {
-    auto reader = caffe2::serialize::PyTorchStreamReader(path);
+/// Metadata stored by `MetatensorAtomisticModel.export()` in the model archive
+struct ModelRecords {
+    Version metatensor_version;
+    Version torch_version;
+    std::vector<Library> extensions;
+    std::vector<Library> dependencies;
+};
 
+/// Read all the metadata records from an exported model, throwing an error
+/// if the file does not contain a metatensor atomistic model
+static ModelRecords read_model_records(
+    caffe2::serialize::PyTorchStreamReader& reader,
+    const std::string& path
+) {
     if (!reader.hasRecord("extra/metatensor-version")) {
         C10_THROW_ERROR(ValueError,
             "file at '" + path + "' does not contain a metatensor atomistic model"
         );
     }
 
+    return ModelRecords {
+        Version(record_to_string(reader.getRecord("extra/metatensor-version"))),
+        Version(record_to_string(reader.getRecord("extra/torch-version"))),
+        nlohmann::json::parse(record_to_string(reader.getRecord("extra/extensions"))),
+        nlohmann::json::parse(record_to_string(reader.getRecord("extra/extensions-deps"))),
+    };
+}
+
+static void load_extensions_from_records(
+    const ModelRecords& records,
+    const c10::optional<std::string>& extensions_directory
+) {
     auto debug = getenv("METATENSOR_DEBUG_EXTENSIONS_LOADING") != nullptr;
-    auto loaded_libraries = metatensor_torch::details::get_loaded_libraries();
+    LOADED_LIBRARIES.invalidate();
 
-    std::vector<Library> dependencies = nlohmann::json::parse(record_to_string(
-        reader.getRecord("extra/extensions-deps")
-    ));
-    for (const auto& dep: dependencies) {
-        if (!library_already_loaded(loaded_libraries, dep.name)) {
+    for (const auto& dep: records.dependencies) {
+        if (!LOADED_LIBRARIES.contains(dep.name)) {
             load_library(dep, extensions_directory, /*is_dependency=*/true);
         } else if (debug) {
             std::cerr << dep.name << " dependency was already loaded" << std::endl;
         }
     }
 
-    std::vector<Library> extensions = nlohmann::json::parse(record_to_string(
-        reader.getRecord("extra/extensions")
-    ));
-    for (const auto& ext: extensions) {
+    for (const auto& ext: records.extensions) {
         if (ext.name == "metatensor_torch") {
             continue;
         }
 
-        if (!library_already_loaded(loaded_libraries, ext.name)) {
+        if (!LOADED_LIBRARIES.contains(ext.name)) {
             load_library(ext, extensions_directory, /*is_dependency=*/false);
         } else if (debug) {
             std::cerr << ext.name << " extension was already loaded" << std::endl;
@@ -838,36 +900,21 @@ void metatensor_torch::load_model_extensions(
     }
 }
 
-void metatensor_torch::check_atomistic_model(std::string path) {
-    auto reader = caffe2::serialize::PyTorchStreamReader(path);
-
-    if (!reader.hasRecord("extra/metatensor-version")) {
-        C10_THROW_ERROR(ValueError,
-            "file at '" + path + "' does not contain a metatensor atomistic model"
-        );
-    }
-
-    auto recorded_mts_version = Version(record_to_string(
-        reader.getRecord("extra/metatensor-version")
-    ));
+static void check_model_records(const ModelRecords& records, const std::string& path) {
     auto current_mts_version = Version(metatensor_torch::version());
-
-    if (!current_mts_version.is_compatible(recorded_mts_version)) {
+    if (!current_mts_version.is_compatible(records.metatensor_version)) {
         TORCH_WARN(
             "Current metatensor version (", current_mts_version.string, ") ",
-            "is not compatible with the version (", recorded_mts_version.string,
+            "is not compatible with the version (", records.metatensor_version.string,
             ") used to export the model at '", path, "'; proceed at your own risk."
         );
     }
 
-    auto recorded_torch_version = Version(record_to_string(
-        reader.getRecord("extra/torch-version")
-    ));
     auto current_torch_version = Version(TORCH_VERSION);
-    if (!current_torch_version.is_compatible(recorded_torch_version, true)) {
+    if (!current_torch_version.is_compatible(records.torch_version, true)) {
         TORCH_WARN(
             "Current torch version (", current_torch_version.string, ") ",
-            "is not compatible with the version (", recorded_torch_version.string,
+            "is not compatible with the version (", records.torch_version.string,
             ") used to export the model at '", path, "'; proceed at your own risk."
         );
     }
@@ -876,14 +923,9 @@ void metatensor_torch::check_atomistic_model(std::string path) {
     // loaded now. Since the model can be exported from a different machine, or
     // the extensions might change how they organize code, we only try to do
     // fuzzy matching on the file name, and warn if we can not find a match.
-    std::vector<Library> extensions = nlohmann::json::parse(record_to_string(
-        reader.getRecord("extra/extensions")
-    ));
-
-    auto loaded_libraries = metatensor_torch::details::get_loaded_libraries();
-
-    for (const auto& extension: extensions) {
-        if (!library_already_loaded(loaded_libraries, extension.name)) {
+    LOADED_LIBRARIES.invalidate();
+    for (const auto& extension: records.extensions) {
+        if (!LOADED_LIBRARIES.contains(extension.name)) {
             TORCH_WARN(
                 "The model at '", path, "' was exported with extension '",
                 extension.name, "' loaded (from '", extension.path, "'), ",
@@ -893,13 +935,36 @@ void metatensor_torch::check_atomistic_model(std::string path) {
     }
 }
 
+void metatensor_torch::load_model_extensions(
+    std::string path,
+    c10::optional<std::string> extensions_directory
+) {
+    auto reader = caffe2::serialize::PyTorchStreamReader(path);
+    auto records = read_model_records(reader, path);
+    load_extensions_from_records(records, extensions_directory);
+}
+
+void metatensor_torch::check_atomistic_model(std::string path) {
+    auto reader = caffe2::serialize::PyTorchStreamReader(path);
+    auto records = read_model_records(reader, path);
+    check_model_records(records, path);
+}
+
 torch::jit::Module metatensor_torch::load_atomistic_model(
     std::string path,
     c10::optional<std::string> extensions_directory
 ) {
-    load_model_extensions(path, extensions_directory);
-    check_atomistic_model(path);
-    return torch::jit::load(path);
+    // open the file once, and use it both to read the metadata records and to
+    // load the TorchScript module
+    auto file = std::make_shared<caffe2::serialize::FileAdapter>(path);
+
+    auto reader = caffe2::serialize::PyTorchStreamReader(file);
+    auto records = read_model_records(reader, path);
+
+    load_extensions_from_records(records, extensions_directory);
+    check_model_records(records, path);
+
+    return torch::jit::load(file);
 }
 
 /******************************************************************************/
@@ -1077,3 +1142,99 @@ double metatensor_torch::unit_conversion_factor(
         return 1.0;
     }
 }
+
+/******************************************************************************/
+
+/// Get the boundaries between the samples of successive systems in `block`,
+/// using the "system" sample dimension
+static std::vector<int64_t> system_boundaries(
+    const TorchTensorBlock& block,
+    int64_t n_systems,
+    const std::string& name
+) {
+    auto samples = block->samples();
+    auto names = samples->names();
+    auto system_dimension = std::find(names.begin(), names.end(), "system");
+    if (system_dimension == names.end()) {
+        C10_THROW_ERROR(ValueError,
+            "invalid samples in '" + name + "' output: expected a 'system' "
+            "dimension to split the outputs per system"
+        );
+    }
+
+    auto all = torch::indexing::Slice();
+    auto column = samples->values().index({all, system_dimension - names.begin()});
+    auto n_samples = column.size(0);
+
+    if (n_samples > 1) {
+        auto sorted = (column.narrow(0, 1, n_samples - 1) >= column.narrow(0, 0, n_samples - 1)).all();
+        if (!sorted.item<bool>()) {
+            C10_THROW_ERROR(ValueError,
+                "invalid samples in '" + name + "' output: the samples must be "
+                "sorted by 'system' to split the outputs per system"
+            );
+        }
+    }
+
+    // find the first sample of each system, with a single transfer to the
+    // CPU for all boundaries
+    auto systems = torch::arange(0, n_systems + 1, column.options());
+    auto boundaries = torch::searchsorted(column.contiguous(), systems).to(torch::kCPU);
+    auto boundaries_ptr = boundaries.data_ptr<int64_t>();
+
+    if (boundaries_ptr[0] != 0) {
+        C10_THROW_ERROR(ValueError,
+            "invalid samples in '" + name + "' output: found a negative 'system' index"
+        );
+    }
+
+    if (boundaries_ptr[n_systems] != n_samples) {
+        C10_THROW_ERROR(ValueError,
+            "invalid samples in '" + name + "' output: found a 'system' index "
+            "larger than the number of systems (" + std::to_string(n_systems) + ")"
+        );
+    }
+
+    return std::vector<int64_t>(boundaries_ptr + 1, boundaries_ptr + n_systems);
+}
+
+std::vector<torch::Dict<std::string, TorchTensorMap>> metatensor_torch::split_outputs_per_system(
+    torch::Dict<std::string, TorchTensorMap> outputs,
+    int64_t n_systems
+) {
+    RECORD_FUNCTION("metatensor::split_outputs_per_system", std::vector<c10::IValue>());
+
+    if (n_systems < 0) {
+        C10_THROW_ERROR(ValueError,
+            "`n_systems` must be zero or positive, got " + std::to_string(n_systems)
+        );
+    }
+
+    auto result = std::vector<torch::Dict<std::string, TorchTensorMap>>(n_systems);
+    if (n_systems == 0) {
+        // there is nothing to split, and `system_boundaries` can not find
+        // boundaries without any system
+        return result;
+    }
+
+    for (const auto& it: outputs) {
+        const auto& name = it.key();
+        const auto& tensor = it.value();
+
+        auto blocks = std::vector<std::vector<TorchTensorBlock>>(n_systems);
+        for (const auto& block: TensorMapHolder::blocks(tensor)) {
+            auto boundaries = system_boundaries(block, n_systems, name);
+            auto splitted = block->split_samples(boundaries);
+            for (size_t system = 0; system < splitted.size(); system++) {
+                blocks[system].push_back(std::move(splitted[system]));
+            }
+        }
+
+        auto keys = tensor->keys();
+        for (int64_t system = 0; system < n_systems; system++) {
+            result[system].insert(name, torch::make_intrusive<TensorMapHolder>(keys, blocks[system]));
+        }
+    }
+
+    return result;
+}
@@ -0,0 +1,408 @@
+#include <cmath>
+
+#include <array>
+#include <limits>
+#include <tuple>
+#include <vector>
+#include <algorithm>
+
+#include <torch/torch.h>
+#include <ATen/record_function.h>
+
+#include "metatensor/torch/atomistic/system.hpp"
+
+using namespace metatensor_torch;
+
+static const auto NEIGHBORS_SAMPLES_NAMES = std::vector<std::string>{
+    "first_atom", "second_atom", "cell_shift_a", "cell_shift_b", "cell_shift_c"
+};
+
+/// Get a mask selecting the pairs which should be part of a half neighbors
+/// list from a full neighbors list `samples`. For each pair `i -> j` with cell
+/// shift `S` in the full list, the pair `j -> i` with cell shift `-S` is also
+/// present. We keep the first one if `i < j`, or if `i == j` and the first
+/// non-zero component of `S` is positive.
+static torch::Tensor half_list_mask(const torch::Tensor& samples) {
+    auto first = samples.select(1, 0);
+    auto second = samples.select(1, 1);
+    auto a = samples.select(1, 2);
+    auto b = samples.select(1, 3);
+    auto c = samples.select(1, 4);
+
+    auto positive_shift = (a > 0) | ((a == 0) & ((b > 0) | ((b == 0) & (c > 0))));
+    return (first < second) | ((first == second) & positive_shift);
+}
+
+/// Find all pairs of atoms within the given `cutoff` using a cell list, and
+/// return their samples (`first_atom`, `second_atom` and cell shifts as 32-bit
+/// integers) and distance vectors (as 64-bit floating point numbers).
+///
+/// This is implemented with batched tensor operations, and runs on the same
+/// device as `positions`. The cost is linear with the number of atoms for a
+/// given density.
+static std::tuple<torch::Tensor, torch::Tensor> cell_list_pairs(
+    torch::Tensor positions,
+    torch::Tensor cell,
+    double cutoff,
+    bool full_list
+) {
+    RECORD_FUNCTION("metatensor::cell_list_pairs", std::vector<c10::IValue>());
+
+    auto device = positions.device();
+    auto options_i64 = torch::TensorOptions().dtype(torch::kInt64).device(device);
+    auto n_atoms = positions.size(0);
+
+    positions = positions.detach().to(torch::kF64);
+    auto cell_cpu = cell.detach().to(torch::kCPU).to(torch::kF64).contiguous();
+    cell = cell_cpu.to(device);
+
+    if (n_atoms == 0) {
+        return std::make_tuple(
+            torch::zeros({0, 5}, options_i64.dtype(torch::kInt32)),
+            torch::zeros({0, 3}, positions.options())
+        );
+    }
+
+    auto cell_data = cell_cpu.accessor<double, 2>();
+    auto periodic = false;
+    for (int64_t i=0; i<3; i++) {
+        for (int64_t j=0; j<3; j++) {
+            if (cell_data[i][j] != 0.0) {
+                periodic = true;
+            }
+        }
+    }
+
+    // `scaled` contains the position of each atom inside the bounding box, in
+    // [0, 1) along each box vector; and `images` the number of box vectors we
+    // need to remove from the actual position to get inside the box.
+    auto scaled = torch::Tensor();
+    auto images = torch::Tensor();
+    // distance between opposite faces of the bounding box
+    auto widths = std::array<double, 3>{};
+    if (periodic) {
+        auto fractional = positions.matmul(torch::inverse(cell_cpu).to(device));
+        auto floor = torch::floor(fractional);
+        scaled = fractional - floor;
+        images = floor.to(torch::kInt64);
+
+        auto row = [&](int64_t i) {
+            return std::array<double, 3>{cell_data[i][0], cell_data[i][1], cell_data[i][2]};
+        };
+
+        auto volume = std::abs(
+            cell_data[0][0] * (cell_data[1][1] * cell_data[2][2] - cell_data[1][2] * cell_data[2][1]) -
+            cell_data[0][1] * (cell_data[1][0] * cell_data[2][2] - cell_data[1][2] * cell_data[2][0]) +
+            cell_data[0][2] * (cell_data[1][0] * cell_data[2][1] - cell_data[1][1] * cell_data[2][0])
+        );
+
+        for (int64_t k=0; k<3; k++) {
+            auto u = row((k + 1) % 3);
+            auto v = row((k + 2) % 3);
+            auto cross = std::array<double, 3>{
+                u[1] * v[2] - u[2] * v[1],
+                u[2] * v[0] - u[0] * v[2],
+                u[0] * v[1] - u[1] * v[0],
+            };
+            widths[k] = volume / std::sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]);
+        }
+    } else {
+        auto min = std::get<0>(positions.min(0));
+        auto extent = std::get<0>(positions.max(0)) - min;
+
+        // Using `cutoff` as the minimal extent avoids dividing by zero for
+        // planar or linear systems, and puts all atoms in a single bin along
+        // directions smaller than the cutoff.
+        scaled = (positions - min) / torch::clamp_min(extent, cutoff);
+        images = torch::zeros({n_atoms, 3}, options_i64);
+
+        auto extent_cpu = extent.to(torch::kCPU);
+        for (int64_t k=0; k<3; k++) {
+            widths[k] = extent_cpu[k].item<double>();
+        }
+    }
+
+    // use bins at least as large as the cutoff, so we only need to look at the
+    // direct neighboring bins (except for periodic cells smaller than the
+    // cutoff), and limit the total number of bins to the number of atoms.
+    auto n_bins = std::array<int64_t, 3>{};
+    for (size_t k=0; k<3; k++) {
+        n_bins[k] = std::max<int64_t>(1, static_cast<int64_t>(std::floor(widths[k] / cutoff)));
+    }
+
+    auto max_bins = static_cast<double>(n_atoms);
+    auto total_bins = static_cast<double>(n_bins[0]) * static_cast<double>(n_bins[1]) * static_cast<double>(n_bins[2]);
+    if (total_bins > max_bins) {
+        auto factor = std::cbrt(total_bins / max_bins);
+        for (size_t k=0; k<3; k++) {
+            n_bins[k] = std::max<int64_t>(1, static_cast<int64_t>(std::floor(static_cast<double>(n_bins[k]) / factor)));
+        }
+    }
+
+    // number of bins to search in each direction
+    auto search = std::array<int64_t, 3>{};
+    for (size_t k=0; k<3; k++) {
+        if (periodic) {
+            search[k] = static_cast<int64_t>(std::ceil(cutoff * static_cast<double>(n_bins[k]) / widths[k]));
+        } else {
+            search[k] = n_bins[k] > 1 ? 1 : 0;
+        }
+    }
+
+    auto offsets_data = std::vector<int64_t>();
+    for (int64_t a=-search[0]; a<=search[0]; a++) {
+        for (int64_t b=-search[1]; b<=search[1]; b++) {
+            for (int64_t c=-search[2]; c<=search[2]; c++) {
+                offsets_data.push_back(a);
+                offsets_data.push_back(b);
+                offsets_data.push_back(c);
+            }
+        }
+    }
+    auto n_offsets = static_cast<int64_t>(offsets_data.size() / 3);
+    auto offsets = torch::tensor(offsets_data, options_i64).reshape({n_offsets, 3});
+
+    // assign all atoms to a bin, and sort them by bin
+    auto n_bins_tensor = torch::tensor(std::vector<int64_t>{n_bins[0], n_bins[1], n_bins[2]}, options_i64);
+    auto bin_coords = torch::floor(scaled * n_bins_tensor.to(torch::kF64)).to(torch::kInt64);
+    bin_coords = torch::minimum(torch::clamp_min(bin_coords, 0), n_bins_tensor - 1);
+
+    auto linear_bin = [&](const torch::Tensor& coords) {
+        return (coords.select(-1, 0) * n_bins[1] + coords.select(-1, 1)) * n_bins[2] + coords.select(-1, 2);
+    };
+
+    auto bin_id = linear_bin(bin_coords);
+    auto atoms_by_bin = std::get<1>(torch::sort(bin_id, /*stable*/ true, /*dim*/ 0));
+    auto bin_counts = torch::bincount(bin_id, /*weights*/ {}, n_bins[0] * n_bins[1] * n_bins[2]);
+    auto bin_start = torch::cumsum(bin_counts, 0) - bin_counts;
+
+    // find the neighboring bins of each atom, with shape [n_atoms, n_offsets, 3]
+    auto neighbor_coords = bin_coords.unsqueeze(1) + offsets.unsqueeze(0);
+    auto bins_shifts = torch::Tensor();
+    auto valid = torch::Tensor();
+    if (periodic) {
+        bins_shifts = torch::div(neighbor_coords, n_bins_tensor, /*rounding_mode*/ "floor");
+        neighbor_coords = neighbor_coords - bins_shifts * n_bins_tensor;
+    } else {
+        valid = ((neighbor_coords >= 0) & (neighbor_coords < n_bins_tensor)).all(-1).reshape({-1});
+        neighbor_coords = torch::minimum(torch::clamp_min(neighbor_coords, 0), n_bins_tensor - 1);
+        bins_shifts = torch::zeros_like(neighbor_coords);
+    }
+    auto neighbor_bins = linear_bin(neighbor_coords).reshape({-1});
+
+    // each (atom, neighboring bin) group contains all the atoms in this bin
+    auto counts = bin_counts.index_select(0, neighbor_bins);
+    if (!periodic) {
+        counts = torch::where(valid, counts, torch::zeros_like(counts));
+    }
+    auto n_candidates = counts.sum().item<int64_t>();
+
+    auto group = torch::repeat_interleave(counts, n_candidates);
+    auto group_start = torch::cumsum(counts, 0) - counts;
+    auto within_group = torch::arange(n_candidates, options_i64) - group_start.index_select(0, group);
+
+    auto first = torch::div(group, n_offsets, /*rounding_mode*/ "floor");
+    auto second = atoms_by_bin.index_select(
+        0, bin_start.index_select(0, neighbor_bins.index_select(0, group)) + within_group
+    );
+
+    auto cell_shifts = bins_shifts.reshape({-1, 3}).index_select(0, group)
+                     + images.index_select(0, first)
+                     - images.index_select(0, second);
+
+    auto distances = positions.index_select(0, second)
+                   - positions.index_select(0, first)
+                   + cell_shifts.to(torch::kF64).matmul(cell);
+
+    auto samples = torch::cat({first.unsqueeze(1), second.unsqueeze(1), cell_shifts}, 1);
+
+    auto self_pair = (first == second) & (cell_shifts == 0).all(1);
+    auto mask = ((distances * distances).sum(1) <= cutoff * cutoff) & torch::logical_not(self_pair);
+    if (!full_list) {
+        mask = mask & half_list_mask(samples);
+    }
+
+    samples = samples.index({mask});
+    distances = distances.index({mask});
+
+    // sort the pairs by first and then second atom to get a deterministic
+    // output, regardless of the bins
+    auto key = samples.select(1, 0) * n_atoms + samples.select(1, 1);
+    auto order = std::get<1>(torch::sort(key, /*stable*/ true, /*dim*/ 0));
+
+    return std::make_tuple(
+        samples.index_select(0, order).to(torch::kInt32),
+        distances.index_select(0, order)
+    );
+}
+
+
+struct SystemHolder::NeighborsCandidates {
+    /// positions and cell of the system when the pairs were computed
+    torch::Tensor positions;
+    torch::Tensor cell;
+    /// all pairs within `range` of each other, using the same samples as the
+    /// neighbors lists
+    torch::Tensor samples;
+    /// cutoff radius used to compute the pairs, including the skin
+    double range;
+    /// is `samples` a full or half list of pairs
+    bool full_list;
+};
+
+void SystemHolder::compute_neighbors_lists(
+    System self,
+    std::vector<NeighborsListOptions> options,
+    std::string length_unit,
+    torch::optional<System> previous
+) {
+    RECORD_FUNCTION("metatensor::System::compute_neighbors_lists", std::vector<c10::IValue>());
+
+    if (options.empty()) {
+        return;
+    }
+
+    auto max_cutoff = 0.0;
+    auto max_range = 0.0;
+    auto any_full_list = false;
+    for (const auto& list_options: options) {
+        auto cutoff = list_options->engine_cutoff(length_unit);
+        if (!(cutoff > 0.0) || !std::isfinite(cutoff)) {
+            C10_THROW_ERROR(ValueError,
+                "invalid cutoff for neighbors list: expected a positive number, got "
+                + std::to_string(cutoff)
+            );
+        }
+
+        max_cutoff = std::max(max_cutoff, cutoff);
+        max_range = std::max(max_range, cutoff + list_options->engine_skin(length_unit));
+        any_full_list = any_full_list || list_options->full_list();
+    }
+
+    auto positions = self->positions().detach();
+    auto cell = self->cell().detach();
+
+    // try to re-use the pairs computed for the previous system
+    auto candidates = std::shared_ptr<NeighborsCandidates>();
+    if (previous.has_value() && previous.value()->neighbors_candidates_ != nullptr) {
+        candidates = previous.value()->neighbors_candidates_;
+
+        auto same_system = candidates->positions.sizes() == positions.sizes()
+            && candidates->positions.device() == positions.device()
+            && candidates->positions.scalar_type() == positions.scalar_type()
+            && torch::equal(candidates->cell, cell)
+            && (candidates->full_list || !any_full_list);
+
+        if (same_system) {
+            // a pair within the cutoff `c` can only be missing from the
+            // candidates if one of the atoms moved more than half of `range - c`
+            auto max_displacement = std::numeric_limits<double>::infinity();
+            for (const auto& list_options: options) {
+                auto cutoff = list_options->engine_cutoff(length_unit);
+                max_displacement = std::min(max_displacement, (candidates->range - cutoff) / 2.0);
+            }
+
+            if (max_displacement < 0.0) {
+                candidates = nullptr;
+            } else if (positions.size(0) != 0) {
+                auto displacement2 = (positions - candidates->positions).square().sum(1).max();
+                if (displacement2.item<double>() > max_displacement * max_displacement) {
+                    candidates = nullptr;
+                }
+            }
+        } else {
+            candidates = nullptr;
+        }
+    }
+
+    auto samples = torch::Tensor();
+    auto distances = torch::Tensor();
+    if (candidates == nullptr) {
+        // compute a single list with the largest cutoff (and skin), and
+        // extract all the other lists from it
+        std::tie(samples, distances) = cell_list_pairs(
+            positions,
+            cell,
+            max_range,
+            any_full_list
+        );
+
+        candidates = std::make_shared<NeighborsCandidates>(NeighborsCandidates{
+            positions.clone(),
+            cell.clone(),
+            samples,
+            max_range,
+            any_full_list,
+        });
+    } else {
+        // only update the distance vectors
+        samples = candidates->samples;
+
+        auto all = torch::indexing::Slice();
+        auto first_atom = samples.index({all, 0}).to(torch::kInt64);
+        auto second_atom = samples.index({all, 1}).to(torch::kInt64);
+        auto cell_shifts = samples.index({all, torch::indexing::Slice(2, 5)}).to(torch::kF64);
+
+        auto positions_f64 = positions.to(torch::kF64);
+        distances = positions_f64.index_select(0, second_atom)
+                  - positions_f64.index_select(0, first_atom)
+                  + cell_shifts.matmul(cell.to(torch::kF64));
+    }
+    self->neighbors_candidates_ = candidates;
+
+    auto distances2 = (distances * distances).sum(1);
+    auto half_mask = torch::Tensor();
+    if (candidates->full_list) {
+        half_mask = half_list_mask(samples);
+    }
+
+    auto device = self->device();
+    auto components = std::vector<TorchLabels>{
+        LabelsHolder::create({"xyz"}, {{0}, {1}, {2}})->to(device)
+    };
+    auto properties = LabelsHolder::create({"distance"}, {{0}})->to(device);
+
+    for (const auto& list_options: options) {
+        auto cutoff = list_options->engine_cutoff(length_unit);
+
+        auto mask = distances2 <= cutoff * cutoff;
+        if (candidates->full_list && !list_options->full_list()) {
+            mask = mask & half_mask;
+        }
+
+        auto values = distances.index({mask}).to(self->scalar_type()).reshape({-1, 3, 1});
+        // the pairs produced by the cell list are unique, so the samples can
+        // be created without checking for duplicated entries
+        auto samples_values = samples.index({mask});
+
+        auto existing = self->neighbors_.find(list_options);
+        if (existing != self->neighbors_.end()) {
+            // this system is re-used across steps: update the existing list,
+            // keeping the samples if the set of pairs did not change
+            auto neighbors_samples = torch::optional<TorchLabels>();
+            auto existing_samples = existing->second->samples();
+            if (existing_samples->values().sizes() != samples_values.sizes() ||
+                !torch::equal(existing_samples->values(), samples_values)) {
+                neighbors_samples = torch::make_intrusive<LabelsHolder>(
+                    torch::IValue(NEIGHBORS_SAMPLES_NAMES), samples_values, /*assume_unique*/ true
+                );
+            }
+
+            self->update_neighbors_list(list_options, values, neighbors_samples);
+            auto neighbors = self->get_neighbors_list(list_options);
+            register_autograd_neighbors(self, neighbors, /*check_consistency*/ false);
+        } else {
+            auto neighbors = torch::make_intrusive<TensorBlockHolder>(
+                values,
+                torch::make_intrusive<LabelsHolder>(
+                    torch::IValue(NEIGHBORS_SAMPLES_NAMES), samples_values, /*assume_unique*/ true
+                ),
+                components,
+                properties
+            );
+
+            register_autograd_neighbors(self, neighbors, /*check_consistency*/ false);
+            self->add_neighbors_list(list_options, neighbors);
+        }
+    }
+}
@@ -1,3 +1,4 @@
+#include <cmath>
 #include <cctype>
 #include <cstring>
 
@@ -5,6 +6,7 @@
 #include <algorithm>
 
 #include <torch/torch.h>
+#include <ATen/record_function.h>
 #include <nlohmann/json.hpp>
 
 #include <metatensor.hpp>
@@ -52,6 +54,20 @@ double NeighborsListOptionsHolder::engine_cutoff(const std::string& engine_lengt
     return cutoff_ * unit_conversion_factor("length", length_unit_, engine_length_unit);
 }
 
+void NeighborsListOptionsHolder::set_skin(double skin) {
+    if (!(skin >= 0.0) || !std::isfinite(skin)) {
+        C10_THROW_ERROR(ValueError,
+            "the skin of a neighbors list must be a positive number or zero, got "
+            + std::to_string(skin)
+        );
+    }
+    this->skin_ = skin;
+}
+
+double NeighborsListOptionsHolder::engine_skin(const std::string& engine_length_unit) const {
+    return skin_ * unit_conversion_factor("length", length_unit_, engine_length_unit);
+}
+
 std::string NeighborsListOptionsHolder::repr() const {
     auto ss = std::ostringstream();
 
@@ -61,6 +77,9 @@ std::string NeighborsListOptionsHolder::repr() const {
         ss << " " << length_unit_;
     }
     ss << "\n    full_list: " << (full_list_ ? "True" : "False") << "\n";
+    if (skin_ != 0.0) {
+        ss << "    skin: " << std::to_string(skin_) << "\n";
+    }
 
     if (!requestors_.empty()) {
         ss << "    requested by:\n";
@@ -91,6 +110,10 @@ std::string NeighborsListOptionsHolder::to_json() const {
     result["full_list"] = this->full_list_;
     result["length_unit"] = this->length_unit_;
 
+    int64_t int_skin = 0;
+    std::memcpy(&int_skin, &this->skin_, sizeof(double));
+    result["skin"] = int_skin;
+
     return result.dump(/*indent*/4, /*indent_char*/' ', /*ensure_ascii*/ true);
 }
 
@@ -130,6 +153,16 @@ NeighborsListOptions NeighborsListOptionsHolder::from_json(const std::string& js
         options->set_length_unit(data["length_unit"]);
     }
 
+    if (data.contains("skin")) {
+        if (!data["skin"].is_number_integer()) {
+            throw std::runtime_error("'skin' in JSON for NeighborsListOptions must be a number");
+        }
+        auto int_skin = data["skin"].get<int64_t>();
+        double skin = 0;
+        std::memcpy(&skin, &int_skin, sizeof(double));
+        options->set_skin(skin);
+    }
+
     return options;
 }
 
@@ -142,53 +175,61 @@ torch::Tensor NeighborsAutograd::forward(
     TorchTensorBlock neighbors,
     bool check_consistency
 ) {
+    RECORD_FUNCTION("metatensor::NeighborsAutograd::forward", std::vector<c10::IValue>());
+
     auto distances = neighbors->values();
 
     if (check_consistency) {
         auto epsilon = 1e-6;
         if (distances.scalar_type() != torch::kFloat64) {
-            auto epsilon = 1e-4;
+            epsilon = 1e-4;
         }
 
         auto samples = neighbors->samples()->values();
-        for (int64_t sample_i=0; sample_i<samples.size(0); sample_i++) {
-            auto atom_i = samples[sample_i][0];
-            auto atom_j = samples[sample_i][1];
-            auto cell_shift = samples.index({sample_i, torch::indexing::Slice(2, 5)}).to(positions.scalar_type());
-
-            auto actual_distance = distances[sample_i].reshape({3});
-            auto expected_distance = positions[atom_j] - positions[atom_i] + cell_shift.matmul(cell);
-
-            auto diff_norm = (actual_distance - expected_distance).norm().to(torch::kCPU).to(torch::kF64);
-            if (diff_norm.item<double>() > epsilon) {
-                std::ostringstream oss;
-
-                oss << "one neighbor pair does not match its metadata: ";
-                oss << "the pair between atom " << atom_i.item<int32_t>();
-                oss << " and atom " << atom_j.item<int32_t>() << " for the ";
-
-                auto cell_shift_i32 = samples.index({sample_i, torch::indexing::Slice(2, 5)});
-                oss << "[" << cell_shift_i32[0].item<int32_t>() << ", ";
-                oss << cell_shift_i32[1].item<int32_t>() << ", ";
-                oss << cell_shift_i32[2].item<int32_t>() << "] cell shift ";
-
-                auto expected_f64 = expected_distance.to(torch::kCPU).to(torch::kF64);
-                oss << "should have a distance vector of ";
-                oss << "[" << expected_f64[0].item<double>() << ", ";
-                oss << expected_f64[1].item<double>() << ", ";
-                oss << expected_f64[2].item<double>() << "] ";
-
-
-                auto actual_f64 = actual_distance.to(torch::kCPU).to(torch::kF64);
-                oss << "but has a distance vector of ";
-                oss << "[" << actual_f64[0].item<double>() << ", ";
-                oss << actual_f64[1].item<double>() << ", ";
-                oss << actual_f64[2].item<double>() << "] ";
-
-                oss << "norm difference is " << diff_norm.item<double>();
-
-                C10_THROW_ERROR(ValueError, oss.str());
-            }
+        auto all = torch::indexing::Slice();
+        auto first_atom = samples.index({all, 0}).to(torch::kInt64);
+        auto second_atom = samples.index({all, 1}).to(torch::kInt64);
+        auto cell_shifts = samples.index({all, torch::indexing::Slice(2, 5)}).to(positions.scalar_type());
+
+        // compute all the expected distances at once, and only go back to
+        // the CPU to check if any of them does not match
+        auto expected_distances = positions.index_select(0, second_atom)
+                                - positions.index_select(0, first_atom)
+                                + cell_shifts.matmul(cell);
+
+        auto diff_norm = (distances.reshape({-1, 3}) - expected_distances).norm(2, /*dim*/ {1});
+        auto mismatch = diff_norm > epsilon;
+        if (mismatch.any().item<bool>()) {
+            // report the first pair which does not match
+            auto sample_i = torch::nonzero(mismatch)[0][0].item<int64_t>();
+
+            auto sample = samples[sample_i].to(torch::kCPU);
+            auto expected_f64 = expected_distances[sample_i].to(torch::kCPU).to(torch::kF64);
+            auto actual_f64 = distances[sample_i].reshape({3}).to(torch::kCPU).to(torch::kF64);
+
+            std::ostringstream oss;
+
+            oss << "one neighbor pair does not match its metadata: ";
+            oss << "the pair between atom " << sample[0].item<int32_t>();
+            oss << " and atom " << sample[1].item<int32_t>() << " for the ";
+
+            oss << "[" << sample[2].item<int32_t>() << ", ";
+            oss << sample[3].item<int32_t>() << ", ";
+            oss << sample[4].item<int32_t>() << "] cell shift ";
+
+            oss << "should have a distance vector of ";
+            oss << "[" << expected_f64[0].item<double>() << ", ";
+            oss << expected_f64[1].item<double>() << ", ";
+            oss << expected_f64[2].item<double>() << "] ";
+
+            oss << "but has a distance vector of ";
+            oss << "[" << actual_f64[0].item<double>() << ", ";
+            oss << actual_f64[1].item<double>() << ", ";
+            oss << actual_f64[2].item<double>() << "] ";
+
+            oss << "norm difference is " << diff_norm[sample_i].to(torch::kCPU).to(torch::kF64).item<double>();
+
+            C10_THROW_ERROR(ValueError, oss.str());
         }
     }
 
@@ -203,6 +244,8 @@ std::vector<torch::Tensor> NeighborsAutograd::backward(
     torch::autograd::AutogradContext* ctx,
     std::vector<torch::Tensor> outputs_grad
 ) {
+    RECORD_FUNCTION("metatensor::NeighborsAutograd::backward", std::vector<c10::IValue>());
+
     auto distances_grad = outputs_grad[0];
 
     auto saved_variables = ctx->get_saved_variables();
@@ -212,33 +255,23 @@ std::vector<torch::Tensor> NeighborsAutograd::backward(
     auto samples = neighbors->samples()->values();
     auto distances = neighbors->values();
 
+    auto all = torch::indexing::Slice();
+    auto grad = distances_grad.reshape({-1, 3});
+
     auto positions_grad = torch::Tensor();
     if (positions.requires_grad()) {
-        positions_grad = torch::zeros_like(positions);
-
-        for (int64_t sample_i = 0; sample_i < samples.size(0); sample_i++) {
-            auto atom_i = samples[sample_i][0].item<int32_t>();
-            auto atom_j = samples[sample_i][1].item<int32_t>();
+        auto first_atom = samples.index({all, 0}).to(torch::kInt64);
+        auto second_atom = samples.index({all, 1}).to(torch::kInt64);
 
-            auto all = torch::indexing::Slice();
-            auto grad = distances_grad.index({sample_i, all, 0});
-            positions_grad.index({atom_i, all}) -= grad;
-            positions_grad.index({atom_j, all}) += grad;
-        }
+        positions_grad = torch::zeros_like(positions);
+        positions_grad.index_add_(0, first_atom, -grad);
+        positions_grad.index_add_(0, second_atom, grad);
     }
 
     auto cell_grad = torch::Tensor();
     if (cell.requires_grad()) {
-        cell_grad = torch::zeros_like(cell);
-
-        for (int64_t sample_i = 0; sample_i < samples.size(0); sample_i++) {
-            auto cell_shift = samples.index({
-                torch::indexing::Slice(sample_i, sample_i + 1),
-                torch::indexing::Slice(2, 5)
-            }).to(cell.scalar_type());
-
-            cell_grad += cell_shift.t().matmul(distances_grad[sample_i].t());
-        }
+        auto cell_shifts = samples.index({all, torch::indexing::Slice(2, 5)}).to(cell.scalar_type());
+        cell_grad = cell_shifts.t().matmul(grad);
     }
 
     return {positions_grad, cell_grad, torch::Tensor(), torch::Tensor()};
@@ -249,6 +282,8 @@ void metatensor_torch::register_autograd_neighbors(
     TorchTensorBlock neighbors,
     bool check_consistency
 ) {
+    RECORD_FUNCTION("metatensor::register_autograd_neighbors", std::vector<c10::IValue>());
+
     auto distances = neighbors->values();
     if (distances.requires_grad()) {
         C10_THROW_ERROR(ValueError,
@@ -495,10 +530,58 @@ void SystemHolder::set_cell(torch::Tensor cell) {
     this->cell_ = std::move(cell);
 }
 
+/// Check if `new_data` can be copied in-place inside `existing` without any
+/// conversion/re-allocation, and without changing how gradients flow through
+/// the system.
+///
+/// The copy happens outside of autograd, so it is only done when neither
+/// tensor requires gradients: otherwise the gradients would be accumulated in
+/// `existing` instead of `new_data` (if `new_data` is a leaf), or would not
+/// propagate to the graph `new_data` is part of.
+static bool can_copy_in_place(const torch::Tensor& existing, const torch::Tensor& new_data) {
+    return existing.defined()
+        && existing.sizes() == new_data.sizes()
+        && existing.scalar_type() == new_data.scalar_type()
+        && existing.device() == new_data.device()
+        && existing.requires_grad() == new_data.requires_grad()
+        && !new_data.requires_grad()
+        && !new_data.grad_fn();
+}
+
+void SystemHolder::update_positions(torch::Tensor positions) {
+    RECORD_FUNCTION("metatensor::System::update_positions", std::vector<c10::IValue>());
+
+    if (!can_copy_in_place(positions_, positions)) {
+        this->set_positions(std::move(positions));
+        return;
+    }
+
+    if (!positions_.is_same(positions)) {
+        auto guard = torch::NoGradGuard();
+        positions_.copy_(positions);
+    }
+}
+
+void SystemHolder::update_cell(torch::Tensor cell) {
+    RECORD_FUNCTION("metatensor::System::update_cell", std::vector<c10::IValue>());
+
+    if (!can_copy_in_place(cell_, cell)) {
+        this->set_cell(std::move(cell));
+        return;
+    }
+
+    if (!cell_.is_same(cell)) {
+        auto guard = torch::NoGradGuard();
+        cell_.copy_(cell);
+    }
+}
+
 System SystemHolder::to(
     torch::optional<torch::Dtype> dtype,
     torch::optional<torch::Device> device
 ) const {
+    RECORD_FUNCTION("metatensor::System::to", std::vector<c10::IValue>());
+
     auto system = torch::make_intrusive<SystemHolder>(
         this->types().to(
             /*dtype*/ torch::nullopt,
@@ -560,6 +643,8 @@ System SystemHolder::to_positional(
 
 
 void SystemHolder::add_neighbors_list(NeighborsListOptions options, TorchTensorBlock neighbors) {
+    RECORD_FUNCTION("metatensor::System::add_neighbors_list", std::vector<c10::IValue>());
+
     // check the structure of the NL
     auto samples_names = neighbors->samples()->names();
     if (samples_names.size() != 5 ||
@@ -630,6 +715,66 @@ void SystemHolder::add_neighbors_list(NeighborsListOptions options, TorchTensorB
     neighbors_.emplace(std::move(options), std::move(neighbors));
 }
 
+void SystemHolder::update_neighbors_list(
+    NeighborsListOptions options,
+    torch::Tensor values,
+    torch::optional<TorchLabels> samples
+) {
+    RECORD_FUNCTION("metatensor::System::update_neighbors_list", std::vector<c10::IValue>());
+
+    auto it = neighbors_.find(options);
+    if (it == neighbors_.end()) {
+        C10_THROW_ERROR(ValueError,
+            "No neighbors list for " + options->str() + " was found, "
+            "use `add_neighbors_list` to add it to this system first"
+        );
+    }
+    auto existing = it->second;
+
+    auto new_samples = existing->samples();
+    if (samples.has_value() && samples.value().get() != new_samples.get()) {
+        new_samples = std::move(samples.value());
+        if (new_samples->names() != existing->samples()->names()) {
+            C10_THROW_ERROR(ValueError,
+                "invalid samples for `neighbors`: the samples names must be "
+                "'first_atom', 'second_atom', 'cell_shift_a', 'cell_shift_b', 'cell_shift_c'"
+            );
+        }
+    }
+
+    if (values.device() != this->device()) {
+        C10_THROW_ERROR(ValueError,
+            "`values` device (" + values.device().str() + ") does not match "
+            "this system's device (" + this->device().str() +")"
+        );
+    }
+
+    if (values.scalar_type() != this->scalar_type()) {
+        C10_THROW_ERROR(ValueError,
+            "`values` dtype (" + scalar_type_name(values.scalar_type()) +
+            ") does not match this system's dtype (" + scalar_type_name(this->scalar_type()) +")"
+        );
+    }
+
+    if (values.sizes().size() != 3 || values.size(0) != new_samples->count() ||
+        values.size(1) != 3 || values.size(2) != 1) {
+        C10_THROW_ERROR(ValueError,
+            "`values` must be a (len(samples) x 3 x 1) tensor, got a tensor with shape " +
+            c10::str(values.sizes()) + " for " + std::to_string(new_samples->count()) +
+            " samples"
+        );
+    }
+
+    // the components and properties never change, and the samples were
+    // validated when the neighbors list was first added
+    it->second = torch::make_intrusive<TensorBlockHolder>(
+        std::move(values),
+        std::move(new_samples),
+        existing->components(),
+        existing->properties()
+    );
+}
+
 TorchTensorBlock SystemHolder::get_neighbors_list(NeighborsListOptions options) const {
     auto it = neighbors_.find(options);
     if (it == neighbors_.end()) {
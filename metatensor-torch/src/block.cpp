@@ -1,6 +1,8 @@
 #include <memory>
 #include <string>
 
+#include <ATen/record_function.h>
+
 #include <metatensor.hpp>
 
 #include "metatensor/torch/array.hpp"
@@ -25,25 +27,91 @@ TensorBlockHolder::TensorBlockHolder(
     std::vector<TorchLabels> components,
     TorchLabels properties
 ):
-    TensorBlockHolder(
-        metatensor::TensorBlock(
-            std::make_unique<TorchDataArray>(std::move(data)),
-            samples->as_metatensor(),
-            components_from_torch(components),
-            properties->as_metatensor()
-        ),
-        /* parameter */ "",
-        /* parent */ torch::IValue()
-    )
+    values_(std::move(data))
 {
-    auto values_device = this->values().device();
-    if (values_device != this->samples()->values().device()) {
+    // the same checks as in metatensor-core, done here since the
+    // metatensor::TensorBlock is only created when needed
+    auto shape = values_.sizes();
+    if (shape.size() != components.size() + 2) {
+        C10_THROW_ERROR(ValueError,
+            "cannot create TensorBlock: the array has " + std::to_string(shape.size()) +
+            " dimensions, but we have " + std::to_string(components.size() + 2) +
+            " separate labels"
+        );
+    }
+
+    if (shape[0] != samples->count()) {
+        C10_THROW_ERROR(ValueError,
+            "cannot create TensorBlock: the array shape along axis 0 is " +
+            std::to_string(shape[0]) + " but we have " +
+            std::to_string(samples->count()) + " sample labels"
+        );
+    }
+
+    for (size_t i=0; i<components.size(); i++) {
+        const auto& component = components[i];
+        if (component->size() != 1) {
+            C10_THROW_ERROR(ValueError,
+                "cannot create TensorBlock: component labels must have a single "
+                "dimension, got " + std::to_string(component->size()) +
+                " for component " + std::to_string(i)
+            );
+        }
+
+        if (component->count() == 0) {
+            C10_THROW_ERROR(ValueError,
+                "cannot create TensorBlock: component '" + component->names()[0] +
+                "' must contain at least one entry, got 0"
+            );
+        }
+
+        for (size_t j=0; j<i; j++) {
+            if (components[j]->names() == component->names()) {
+                C10_THROW_ERROR(ValueError,
+                    "cannot create TensorBlock: some of the component names "
+                    "appear more than once in component labels"
+                );
+            }
+        }
+
+        auto axis = static_cast<size_t>(i + 1);
+        if (shape[axis] != component->count()) {
+            C10_THROW_ERROR(ValueError,
+                "cannot create TensorBlock: the array shape along axis " +
+                std::to_string(axis) + " is " + std::to_string(shape[axis]) +
+                " but we have " + std::to_string(component->count()) +
+                " entries for the corresponding component"
+            );
+        }
+    }
+
+    if (shape[shape.size() - 1] != properties->count()) {
+        C10_THROW_ERROR(ValueError,
+            "cannot create TensorBlock: the array shape along axis " +
+            std::to_string(shape.size() - 1) + " is " +
+            std::to_string(shape[shape.size() - 1]) + " but we have " +
+            std::to_string(properties->count()) + " properties labels"
+        );
+    }
+
+    auto is_view = samples->is_view() || properties->is_view();
+    for (const auto& component: components) {
+        is_view = is_view || component->is_view();
+    }
+    if (is_view) {
+        C10_THROW_ERROR(ValueError,
+            "cannot create TensorBlock: can not use Labels view, call to_owned first"
+        );
+    }
+
+    auto values_device = values_.device();
+    if (values_device != samples->values().device()) {
         C10_THROW_ERROR(ValueError,
             "cannot create TensorBlock: values and samples must be on the same device, "
-            "got " + values_device.str() + " and " + this->samples()->values().device().str()
+            "got " + values_device.str() + " and " + samples->values().device().str()
         );
     }
-    for (const auto& component : this->components()) {
+    for (const auto& component : components) {
         if (values_device != component->values().device()) {
             C10_THROW_ERROR(ValueError,
                 "cannot create TensorBlock: values and components must be on the same device, "
@@ -51,12 +119,19 @@ TensorBlockHolder::TensorBlockHolder(
             );
         }
     }
-    if (values_device != this->properties()->values().device()) {
+    if (values_device != properties->values().device()) {
         C10_THROW_ERROR(ValueError,
                 "cannot create TensorBlock: values and properties must be on the same device, "
-                "got " + values_device.str() + " and " + this->properties()->values().device().str()
+                "got " + values_device.str() + " and " + properties->values().device().str()
         );
     }
+
+    labels_.reserve(components.size() + 2);
+    labels_.emplace_back(std::move(samples));
+    for (auto& component: components) {
+        labels_.emplace_back(std::move(component));
+    }
+    labels_.emplace_back(std::move(properties));
 }
 
 
@@ -65,44 +140,248 @@ TensorBlockHolder::TensorBlockHolder(metatensor::TensorBlock block, torch::IValu
 {}
 
 TensorBlockHolder::TensorBlockHolder(metatensor::TensorBlock block, std::string parameter, torch::IValue parent):
-    block_(std::move(block)),
-    parameter_(std::move(parameter)),
-    parent_(std::move(parent))
+    block_(std::make_unique<metatensor::TensorBlock>(std::move(block))),
+    parent_(std::move(parent)),
+    parameter_(std::move(parameter))
 {}
 
+metatensor::TensorBlock& TensorBlockHolder::block() const {
+    auto guard = std::lock_guard<std::mutex>(*block_mutex_);
+    if (!block_) {
+        // this block was created from torch data, and never used with
+        // metatensor-core until now. `labels_` is fully initialized and never
+        // modified for such blocks.
+        auto components = std::vector<TorchLabels>(labels_.begin() + 1, labels_.end() - 1);
+        block_ = std::make_unique<metatensor::TensorBlock>(
+            std::make_unique<TorchDataArray>(values_),
+            labels_.front()->as_metatensor(),
+            components_from_torch(components),
+            labels_.back()->as_metatensor()
+        );
+        values_ = torch::Tensor();
+    }
+    return *block_;
+}
+
 TorchTensorBlock TensorBlockHolder::copy() const {
-    return torch::make_intrusive<TensorBlockHolder>(this->block_.clone(), torch::IValue());
+    RECORD_FUNCTION("metatensor::TensorBlock::copy", std::vector<c10::IValue>());
+
+    auto values = torch::Tensor();
+    {
+        auto guard = std::lock_guard<std::mutex>(*block_mutex_);
+        if (!block_) {
+            values = values_;
+        }
+    }
+
+    if (values.defined()) {
+        // this block was never passed to metatensor-core, and does not
+        // contain gradients
+        return torch::make_intrusive<TensorBlockHolder>(
+            values.clone(), this->samples(), this->components(), this->properties()
+        );
+    }
+
+    return torch::make_intrusive<TensorBlockHolder>(this->block().clone(), torch::IValue());
+}
+
+TorchTensorBlock TensorBlockHolder::slice_samples(int64_t start, int64_t stop) const {
+    RECORD_FUNCTION("metatensor::TensorBlock::slice_samples", std::vector<c10::IValue>());
+
+    auto values = this->values();
+    auto samples_count = values.size(0);
+    if (start < 0 || start > stop || stop > samples_count) {
+        C10_THROW_ERROR(IndexError,
+            "invalid range of samples [" + std::to_string(start) + ", " +
+            std::to_string(stop) + ") for a block with " +
+            std::to_string(samples_count) + " samples"
+        );
+    }
+
+    // the entries of a contiguous range of unique samples are unique, so we
+    // can create lazy Labels directly from a view of the values
+    auto samples = this->samples();
+    auto new_samples = torch::make_intrusive<LabelsHolder>(
+        samples->names(),
+        samples->values().narrow(0, start, stop - start),
+        LabelsHolder::CreateLazy{}
+    );
+    new_samples->check_unique_ = samples->check_unique_;
+
+    auto properties = this->properties();
+    auto block = torch::make_intrusive<TensorBlockHolder>(
+        values.narrow(0, start, stop - start),
+        new_samples,
+        this->components(),
+        properties
+    );
+
+    for (const auto& parameter: this->gradients_list()) {
+        auto gradient = TensorBlockHolder(this->block().gradient(parameter), torch::IValue());
+        if (!gradient.gradients_list().empty()) {
+            C10_THROW_ERROR(ValueError,
+                "gradient of gradients are not supported yet in slice_samples"
+            );
+        }
+
+        auto gradient_samples = gradient.samples();
+        auto gradient_samples_values = gradient_samples->values();
+        auto sample = gradient_samples_values.select(1, 0);
+        auto rows = torch::logical_and(sample >= start, sample < stop).nonzero().reshape({-1});
+        auto rows_count = rows.size(0);
+
+        // the selected rows are in increasing order, so they are contiguous
+        // if the last one is `rows_count - 1` after the first one. This is
+        // always the case when the gradient samples are sorted.
+        auto first_row = rows_count == 0 ? 0 : rows[0].item<int64_t>();
+        auto contiguous = rows_count == 0 || rows[rows_count - 1].item<int64_t>() - first_row == rows_count - 1;
+
+        auto gradient_values = torch::Tensor();
+        auto new_gradient_samples_values = torch::Tensor();
+        if (contiguous) {
+            gradient_values = gradient.values().narrow(0, first_row, rows_count);
+            new_gradient_samples_values = gradient_samples_values.narrow(0, first_row, rows_count).clone();
+        } else {
+            gradient_values = gradient.values().index_select(0, rows);
+            new_gradient_samples_values = gradient_samples_values.index_select(0, rows);
+        }
+
+        // refer to the samples of the new block. Shifting the "sample"
+        // dimension of unique entries by the same amount keeps them unique.
+        new_gradient_samples_values.select(1, 0).sub_(start);
+        auto new_gradient_samples = torch::make_intrusive<LabelsHolder>(
+            gradient_samples->names(),
+            std::move(new_gradient_samples_values),
+            LabelsHolder::CreateLazy{}
+        );
+
+        auto new_gradient = torch::make_intrusive<TensorBlockHolder>(
+            std::move(gradient_values),
+            new_gradient_samples,
+            gradient.components(),
+            properties
+        );
+        block->add_gradient(parameter, new_gradient);
+    }
+
+    return block;
+}
+
+std::vector<TorchTensorBlock> TensorBlockHolder::split_samples(const std::vector<int64_t>& boundaries) const {
+    RECORD_FUNCTION("metatensor::TensorBlock::split_samples", std::vector<c10::IValue>());
+
+    auto blocks = std::vector<TorchTensorBlock>();
+    blocks.reserve(boundaries.size() + 1);
+
+    int64_t start = 0;
+    for (auto boundary: boundaries) {
+        blocks.push_back(this->slice_samples(start, boundary));
+        start = boundary;
+    }
+    blocks.push_back(this->slice_samples(start, this->values().size(0)));
+
+    return blocks;
+}
+
+/// Get the total size of the values of all the gradients of `block`,
+/// including gradients of gradients
+static int64_t gradients_nbytes(const metatensor::TensorBlock& block) {
+    int64_t nbytes = 0;
+    for (const auto& parameter: block.gradients_list()) {
+        auto gradient = block.gradient(parameter);
+        nbytes += gradients_nbytes(gradient);
+        nbytes += TensorBlockHolder(std::move(gradient), torch::IValue()).values().nbytes();
+    }
+    return nbytes;
+}
+
+torch::Dict<std::string, int64_t> TensorBlockHolder::memory_usage() const {
+    auto usage = this->block().memory_usage();
+
+    // metatensor-core can only get the data type of tensors on CPU, so we use
+    // the size of the tensors directly
+    usage.values = static_cast<uintptr_t>(this->values().nbytes());
+    usage.gradients_values = static_cast<uintptr_t>(gradients_nbytes(this->block()));
+
+    return memory_usage_to_dict(usage);
 }
 
 TorchTensorBlock TensorBlockHolder::to(
     torch::optional<torch::Dtype> dtype,
-    torch::optional<torch::Device> device
+    torch::optional<torch::Device> device,
+    bool non_blocking
+) const {
+    RECORD_FUNCTION("metatensor::TensorBlock::to", std::vector<c10::IValue>());
+
+    auto moved_labels = MovedLabels();
+    return this->to_impl(dtype, device, non_blocking, moved_labels);
+}
+
+TorchTensorBlock TensorBlockHolder::to_impl(
+    torch::optional<torch::Dtype> dtype,
+    torch::optional<torch::Device> device,
+    bool non_blocking,
+    MovedLabels& moved_labels
 ) const {
     auto values = this->values().to(
         dtype,
         /*layout*/ torch::nullopt,
         device,
         /*pin_memory*/ torch::nullopt,
-        /*non_blocking*/ false,
+        non_blocking,
         /*copy*/ false,
         /*memory_format*/ torch::MemoryFormat::Preserve
     );
+    auto new_device = values.device();
+
+    // Labels are shared between blocks and their gradients (the properties
+    // are always the same, and samples/components are often the same). Only
+    // move each Rust labels once, and re-use the result for all other users.
+    auto labels_to = [&](uintptr_t axis) {
+        auto labels = this->labels(axis);
+        // Labels which were never passed to metatensor-core are identified
+        // by the corresponding `LabelsHolder`
+        const void* key = labels.get();
+        {
+            auto guard = std::lock_guard<std::mutex>(*labels->labels_mutex_);
+            if (labels->labels_.has_value()) {
+                key = labels->labels_->as_mts_labels_t().internal_ptr_;
+            }
+        }
+
+        auto it = moved_labels.find(key);
+        if (it != moved_labels.end()) {
+            return it->second;
+        }
+
+        auto moved = labels->to(new_device, non_blocking);
+        moved_labels.emplace(key, moved);
+        return moved;
+    };
 
-    auto samples = this->samples()->to(device);
-    auto components = std::vector<torch::intrusive_ptr<LabelsHolder>>();
-    for (const auto& component : this->components()) {
-        components.push_back(component->to(device));
+    auto n_dims = static_cast<uintptr_t>(values.dim());
+    auto samples = labels_to(0);
+    auto components = std::vector<TorchLabels>();
+    for (uintptr_t i=1; i<n_dims - 1; i++) {
+        components.push_back(labels_to(i));
     }
-    auto properties = this->properties()->to(device);
+    auto properties = labels_to(n_dims - 1);
 
     auto block = torch::make_intrusive<TensorBlockHolder>(values, samples, components, properties);
     for (const auto& parameter : this->gradients_list()) {
         auto gradient = TensorBlockHolder(
-            this->block_.gradient(parameter),
+            this->block().gradient(parameter),
             torch::IValue()
         );
 
-        block->add_gradient(parameter, gradient.to(dtype, device));
+        // gradients always have the same properties as the values, so we can
+        // re-use the moved properties even if the gradient properties are a
+        // different Rust object.
+        auto gradient_shape = gradient.block().values_shape();
+        auto gradient_properties = gradient.block().labels(gradient_shape.size() - 1);
+        moved_labels.emplace(gradient_properties.as_mts_labels_t().internal_ptr_, properties);
+
+        block->add_gradient(parameter, gradient.to_impl(dtype, device, non_blocking, moved_labels));
     }
     return block;
 }
@@ -112,7 +391,8 @@ TorchTensorBlock TensorBlockHolder::to_positional(
     torch::IValue positional_2,
     torch::optional<torch::Dtype> dtype,
     torch::optional<torch::Device> device,
-    torch::optional<std::string> arrays
+    torch::optional<std::string> arrays,
+    bool non_blocking
 ) const {
     if (arrays.value_or("torch") != "torch") {
         C10_THROW_ERROR(ValueError,
@@ -128,14 +408,20 @@ TorchTensorBlock TensorBlockHolder::to_positional(
         "`TensorBlock.to`"
     );
 
-    return this->to(parsed_dtype, parsed_device);
+    return this->to(parsed_dtype, parsed_device, non_blocking);
 }
 
 torch::Tensor TensorBlockHolder::values() const {
-    // const_cast is fine here, because the returned torch::Tensor does not
-    // allow modifications to the underlying mts_array (only to the values
-    // inside the tensor).
-    auto array = const_cast<metatensor::TensorBlock&>(block_).mts_array();
+    {
+        auto guard = std::lock_guard<std::mutex>(*block_mutex_);
+        if (!block_) {
+            return values_;
+        }
+    }
+
+    // the returned torch::Tensor does not allow modifications to the
+    // underlying mts_array (only to the values inside the tensor).
+    auto array = this->block().mts_array();
 
     mts_data_origin_t origin = 0;
     metatensor::details::check_status(array.origin(array.ptr, &origin));
@@ -157,7 +443,21 @@ torch::Tensor TensorBlockHolder::values() const {
 }
 
 TorchLabels TensorBlockHolder::labels(uintptr_t axis) const {
-    return torch::make_intrusive<LabelsHolder>(block_.labels(axis));
+    auto guard = std::lock_guard<std::mutex>(*labels_mutex_);
+    if (labels_.empty()) {
+        labels_.resize(this->block().values_shape().size());
+    }
+
+    if (axis >= labels_.size()) {
+        // let metatensor throw the corresponding error
+        return torch::make_intrusive<LabelsHolder>(this->block().labels(axis));
+    }
+
+    auto& labels = labels_[axis];
+    if (!labels) {
+        labels = torch::make_intrusive<LabelsHolder>(this->block().labels(axis));
+    }
+    return labels;
 }
 
 
@@ -187,11 +487,22 @@ void TensorBlockHolder::add_gradient(const std::string& parameter, TorchTensorBl
         );
     }
 
-    block_.add_gradient(parameter, std::move(gradient_block));
+    this->block().add_gradient(parameter, std::move(gradient_block));
+}
+
+std::vector<std::string> TensorBlockHolder::gradients_list() const {
+    {
+        auto guard = std::lock_guard<std::mutex>(*block_mutex_);
+        if (!block_) {
+            // gradients can only be added through metatensor-core
+            return {};
+        }
+    }
+    return this->block().gradients_list();
 }
 
 bool TensorBlockHolder::has_gradient(const std::string& parameter) const {
-    auto list = this->block_.gradients_list();
+    auto list = this->gradients_list();
     auto it = std::find(std::begin(list), std::end(list), parameter);
     return it != std::end(list);
 }
@@ -205,7 +516,7 @@ TorchTensorBlock TensorBlockHolder::gradient(TorchTensorBlock self, const std::s
         gradient_parameter = parameter;
     }
 
-    return torch::make_intrusive<TensorBlockHolder>(self->block_.gradient(parameter), gradient_parameter, self);
+    return torch::make_intrusive<TensorBlockHolder>(self->block().gradient(parameter), gradient_parameter, self);
 }
 
 std::vector<std::tuple<std::string, TorchTensorBlock>> TensorBlockHolder::gradients(TorchTensorBlock self) {
@@ -216,11 +527,11 @@ std::vector<std::tuple<std::string, TorchTensorBlock>> TensorBlockHolder::gradie
     return result;
 }
 
-static void print_labels(std::ostringstream& output, const metatensor::Labels& labels, const char* labels_kind) {
-    output << "    " << labels_kind << " (" << labels.count() << "): ";
+static void print_labels(std::ostringstream& output, const TorchLabels& labels, const char* labels_kind) {
+    output << "    " << labels_kind << " (" << labels->count() << "): ";
     output << "[";
     auto first = true;
-    for (const auto& name: labels.names()) {
+    for (const auto& name: labels->names()) {
         if (!first) {
             output << ", ";
         }
@@ -239,16 +550,16 @@ std::string TensorBlockHolder::repr() const {
         output << "Gradient TensorBlock ('" << parameter_ << "')\n";
     }
 
-    print_labels(output, block_.samples(), "samples");
+    print_labels(output, this->samples(), "samples");
 
-    auto components = block_.components();
+    auto components = this->components();
     output << "    components (";
     auto first = true;
     for (const auto& component: components) {
         if (!first) {
             output << ", ";
         }
-        output << component.count();
+        output << component->count();
         first = false;
     }
 
@@ -258,15 +569,15 @@ std::string TensorBlockHolder::repr() const {
         if (!first) {
             output << ", ";
         }
-        assert(component.size() == 1);
-        output << '\'' << component.names()[0] << '\'';
+        assert(component->size() == 1);
+        output << '\'' << component->names()[0] << '\'';
         first = false;
     }
     output << "]\n";
 
-    print_labels(output, block_.properties(), "properties");
+    print_labels(output, this->properties(), "properties");
 
-    auto gradients = block_.gradients_list();
+    auto gradients = this->gradients_list();
     output << "    gradients: ";
     if (gradients.empty()) {
         output << "None\n";
@@ -2,6 +2,9 @@
 #define METATENSOR_TORCH_UTILS_HPP
 
 #include <torch/types.h>
+#include <ATen/core/Dict.h>
+
+#include <metatensor.h>
 
 namespace metatensor_torch {
 namespace {
@@ -39,6 +42,30 @@ inline std::string scalar_type_name(torch::ScalarType scalar_type) {
     }
 }
 
+/// Convert `usage` to a dictionary from category name to size in bytes,
+/// including the sum of all categories as `"total"`
+inline torch::Dict<std::string, int64_t> memory_usage_to_dict(const mts_memory_usage_t& usage) {
+    auto categories = std::vector<std::pair<std::string, uintptr_t>>{
+        {"values", usage.values},
+        {"gradients_values", usage.gradients_values},
+        {"labels_values", usage.labels_values},
+        {"labels_positions", usage.labels_positions},
+        {"gradients_metadata", usage.gradients_metadata},
+        {"metadata", usage.metadata},
+    };
+
+    auto result = torch::Dict<std::string, int64_t>();
+    int64_t total = 0;
+    for (const auto& category: categories) {
+        auto size = static_cast<int64_t>(category.second);
+        result.insert(category.first, size);
+        total += size;
+    }
+    result.insert("total", total);
+
+    return result;
+}
+
 /// Parse the arguments to the `to` function
 inline std::tuple<torch::optional<torch::Dtype>, torch::optional<torch::Device>>
 to_arguments_parse(
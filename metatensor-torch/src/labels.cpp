@@ -1,6 +1,7 @@
 #include <cassert>
 
 #include <torch/torch.h>
+#include <ATen/record_function.h>
 
 #include <metatensor.hpp>
 
@@ -113,7 +114,7 @@ LabelsHolder::LabelsHolder(
     labels_->set_user_data(std::move(user_data));
 }
 
-LabelsHolder::LabelsHolder(torch::IValue names, torch::Tensor values):
+LabelsHolder::LabelsHolder(torch::IValue names, torch::Tensor values, bool assume_unique):
     names_(details::normalize_names(names, "names")),
     values_(normalize_int32_tensor(values, 2, "Labels values")),
     labels_(torch::nullopt)
@@ -124,6 +125,15 @@ LabelsHolder::LabelsHolder(torch::IValue names, torch::Tensor values):
         );
     }
 
+    if (assume_unique && !names_.empty()) {
+        // check the names right away by creating empty Labels, which does not
+        // require access to the values. The full metatensor::Labels will be
+        // created in `as_metatensor` if they are ever needed.
+        auto _ = metatensor::Labels(names_);
+        check_unique_ = true;
+        return;
+    }
+
     labels_ = metatensor::Labels(
         names_,
         values_.to(torch::kCPU).contiguous().data_ptr<int32_t>(),
@@ -150,9 +160,35 @@ TorchLabels LabelsHolder::create(
 LabelsHolder::LabelsHolder(std::vector<std::string> names, torch::Tensor values, CreateView):
     names_(std::move(names)),
     values_(std::move(values)),
-    labels_(torch::nullopt)
+    labels_(torch::nullopt),
+    is_view_(true)
 {}
 
+LabelsHolder::LabelsHolder(std::vector<std::string> names, torch::Tensor values, CreateLazy):
+    names_(std::move(names)),
+    values_(std::move(values)),
+    labels_(torch::nullopt)
+{
+    assert(values_.sizes().size() == 2);
+    assert(values_.size(1) == names_.size());
+    assert(values_.scalar_type() == torch::kInt32);
+}
+
+TorchLabels LabelsHolder::derived(std::vector<std::string> names, torch::Tensor values) const {
+    if (is_view_) {
+        // the values of a view might contain duplicated entries
+        return torch::make_intrusive<LabelsHolder>(std::move(names), std::move(values));
+    } else {
+        // the entries are still unique, but the new names and the type of
+        // the new values must be checked
+        auto _ = metatensor::Labels(names);
+        values = normalize_int32_tensor(std::move(values), 2, "Labels values");
+        auto result = torch::make_intrusive<LabelsHolder>(std::move(names), std::move(values), CreateLazy{});
+        result->check_unique_ = check_unique_;
+        return result;
+    }
+}
+
 TorchLabels LabelsHolder::view(const TorchLabels& labels, std::vector<std::string> names) {
     if (names.empty()) {
         C10_THROW_ERROR(ValueError,
@@ -255,17 +291,45 @@ torch::Tensor LabelsHolder::column(std::string dimension) {
 }
 
 const metatensor::Labels& LabelsHolder::as_metatensor() const {
-    if (!labels_.has_value()) {
+    if (is_view_) {
         C10_THROW_ERROR(ValueError,
             "can not call this function on Labels view, call to_owned first"
         );
     }
 
+    auto guard = std::lock_guard<std::mutex>(*labels_mutex_);
+    if (!labels_.has_value()) {
+        // this is a lazy Labels, create the metatensor::Labels now. Entries
+        // coming from the user (`assume_unique`) are checked, the others are
+        // known to be unique.
+        auto cpu_values = values_.to(torch::kCPU).contiguous();
+        if (check_unique_) {
+            labels_ = metatensor::Labels(
+                names_,
+                cpu_values.data_ptr<int32_t>(),
+                static_cast<size_t>(values_.size(0))
+            );
+        } else {
+            labels_ = metatensor::Labels(
+                names_,
+                cpu_values.data_ptr<int32_t>(),
+                static_cast<size_t>(values_.size(0)),
+                metatensor::assume_unique{}
+            );
+        }
+
+        auto user_data = metatensor::LabelsUserData(
+            new torch::Tensor(values_),
+            [](void* tensor) { delete static_cast<torch::Tensor*>(tensor); }
+        );
+        labels_->set_user_data(std::move(user_data));
+    }
+
     return labels_.value();
 }
 
 TorchLabels LabelsHolder::to_owned() const {
-    if (labels_.has_value()) {
+    if (!is_view_) {
         return torch::make_intrusive<LabelsHolder>(*this);
     } else {
         return torch::make_intrusive<LabelsHolder>(this->names_, values_);
@@ -304,7 +368,7 @@ TorchLabels LabelsHolder::insert(int64_t index, std::string name, torch::Tensor
 
     auto new_values = torch::hstack({first, values.reshape({values.size(0), 1}), second});
 
-    return torch::make_intrusive<LabelsHolder>(std::move(new_names), std::move(new_values));
+    return this->derived(std::move(new_names), std::move(new_values));
 }
 
 
@@ -337,7 +401,7 @@ TorchLabels LabelsHolder::permute(std::vector<int64_t> dimensions_indexes) const
 
     auto new_values = this->values().index({torch::indexing::Slice(), torch::tensor(dimensions_indexes)});
 
-    return torch::make_intrusive<LabelsHolder>(std::move(new_names), std::move(new_values));
+    return this->derived(std::move(new_names), std::move(new_values));
 }
 
 
@@ -377,7 +441,7 @@ TorchLabels LabelsHolder::rename(std::string old_name, std::string new_name) con
     auto column_index = it - std::begin(new_names);
 
     new_names[column_index] = std::move(new_name);
-    return torch::make_intrusive<LabelsHolder>(std::move(new_names), this->values());
+    return this->derived(std::move(new_names), this->values());
 }
 
 TorchLabels LabelsHolder::to(torch::IValue device_ivalue) const {
@@ -396,12 +460,32 @@ TorchLabels LabelsHolder::to(torch::IValue device_ivalue) const {
     return this->to(device);
 }
 
-TorchLabels LabelsHolder::to(torch::Device device) const {
+TorchLabels LabelsHolder::to(torch::Device device, bool non_blocking) const {
+    RECORD_FUNCTION("metatensor::Labels::to", std::vector<c10::IValue>());
+
     if (device == values_.device()) {
         // return the same object
         return torch::make_intrusive<LabelsHolder>(*this);
     } else {
-        auto new_values = values_.to(device);
+        auto move_values = [&]() {
+            return values_.to(
+                torch::TensorOptions().device(device),
+                /*non_blocking*/ non_blocking && !device.is_cpu()
+            );
+        };
+
+        if (!is_view_) {
+            auto guard = std::lock_guard<std::mutex>(*labels_mutex_);
+            if (!labels_.has_value()) {
+                // the metatensor::Labels were never created for these lazy
+                // Labels, no need to create them now
+                auto result = torch::make_intrusive<LabelsHolder>(names_, move_values(), CreateLazy{});
+                result->check_unique_ = check_unique_;
+                return result;
+            }
+        }
+
+        auto new_values = move_values();
 
         // re-create new mts_labels_t and from them new metatensor::Labels with
         // the same names & values, but no user data. The user data will be
@@ -426,6 +510,8 @@ TorchLabels LabelsHolder::to(torch::Device device) const {
 }
 
 torch::optional<int64_t> LabelsHolder::position(torch::IValue entry) const {
+    RECORD_FUNCTION("metatensor::Labels::position", std::vector<c10::IValue>());
+
     const auto& labels = this->as_metatensor();
 
     int64_t position = -1;
@@ -489,37 +575,202 @@ torch::optional<int64_t> LabelsHolder::position(torch::IValue entry) const {
     }
 }
 
-TorchLabels LabelsHolder::set_union(const TorchLabels& other) const {
-    if (!labels_.has_value() || !other->labels_.has_value()) {
+torch::Tensor LabelsHolder::positions(torch::Tensor entries) const {
+    RECORD_FUNCTION("metatensor::Labels::positions", std::vector<c10::IValue>());
+
+    const auto& labels = this->as_metatensor();
+
+    entries = normalize_int32_tensor(std::move(entries), 2, "entries passed to Labels::positions");
+    if (entries.size(1) != static_cast<int64_t>(labels.size())) {
         C10_THROW_ERROR(ValueError,
-            "can not call this function on Labels view, call to_owned first"
+            "entries passed to Labels::positions must have " + std::to_string(labels.size()) +
+            " columns, got " + std::to_string(entries.size(1))
         );
     }
 
-    auto device = this->values_.device();
-    if (device != other->values_.device()) {
-        C10_THROW_ERROR(ValueError,
-            "device mismatch in union: got '" + device.str() +
-            "' and '" + other->values_.device().str() + "'"
+    auto device = entries.device();
+    entries = entries.to(torch::kCPU).contiguous();
+
+    auto count = entries.size(0);
+    auto options = torch::TensorOptions().dtype(torch::kInt64).device(torch::kCPU);
+    auto result = torch::empty({count}, options);
+
+    metatensor::details::check_status(mts_labels_positions(
+        labels.as_mts_labels_t(),
+        entries.data_ptr<int32_t>(),
+        static_cast<uintptr_t>(entries.numel()),
+        result.data_ptr<int64_t>(),
+        static_cast<uintptr_t>(count)
+    ));
+
+    return result.to(device);
+}
+
+torch::Dict<std::string, int64_t> LabelsHolder::memory_usage() const {
+    auto usage = mts_memory_usage_t();
+
+    const void* metatensor_values = nullptr;
+    {
+        auto guard = std::lock_guard<std::mutex>(*labels_mutex_);
+        if (labels_.has_value()) {
+            usage = labels_->memory_usage();
+            metatensor_values = labels_->as_mts_labels_t().values;
+        }
+    }
+
+    // the values tensor is a separate allocation, unless it was created
+    // from the memory of the metatensor Labels
+    if (values_.data_ptr() != metatensor_values) {
+        usage.labels_values += static_cast<uintptr_t>(values_.nbytes());
+    }
+
+    return memory_usage_to_dict(usage);
+}
+
+/// Compute the union of two sets of Labels values with torch operations,
+/// keeping all the data on the values device. Both `first` and `second` must
+/// contain unique entries. This returns the values of the union and the
+/// mappings from positions in the inputs to positions in the union, in the same
+/// order as `metatensor::Labels::set_union`.
+static std::tuple<torch::Tensor, torch::Tensor, torch::Tensor> union_on_device(
+    const torch::Tensor& first,
+    const torch::Tensor& second
+) {
+    auto options = torch::TensorOptions().dtype(torch::kInt64).device(first.device());
+    auto n_first = first.size(0);
+    auto n_second = second.size(0);
+
+    auto first_mapping = torch::arange(n_first, options);
+    if (n_first == 0 || n_second == 0) {
+        auto second_mapping = torch::arange(n_first, n_first + n_second, options);
+        return std::make_tuple(torch::cat({first, second}), first_mapping, second_mapping);
+    }
+
+    // `inverse` contains the index of the unique entry corresponding to each
+    // row in `all`. Since both inputs contain unique entries, each index
+    // appears at most once in each of the inputs.
+    auto all = torch::cat({first, second});
+    auto unique = torch::unique_dim(all, 0, /*sorted=*/false, /*return_inverse=*/true);
+    auto n_unique = std::get<0>(unique).size(0);
+    const auto& inverse = std::get<1>(unique);
+    auto first_inverse = inverse.slice(0, 0, n_first);
+    auto second_inverse = inverse.slice(0, n_first);
+
+    // position of each unique entry in `first`, or -1
+    auto position_in_first = torch::full({n_unique}, -1, options);
+    position_in_first.index_put_({first_inverse}, first_mapping);
+
+    auto existing = position_in_first.index({second_inverse});
+    auto is_new = existing < 0;
+
+    // new entries are added after all the entries in `first`, in order
+    auto new_positions = torch::cumsum(is_new, 0, torch::kInt64) + (n_first - 1);
+    auto second_mapping = torch::where(is_new, new_positions, existing);
+
+    auto values = torch::cat({first, second.index({is_new})});
+    return std::make_tuple(values, first_mapping, second_mapping);
+}
+
+/// Compute the intersection of two sets of Labels values with torch
+/// operations, keeping all the data on the values device. Both `first` and
+/// `second` must contain unique entries. This returns the values of the
+/// intersection and the mappings from positions in the inputs to positions in
+/// the intersection (or -1 for entries not in the intersection), in the same
+/// order as `metatensor::Labels::set_intersection`.
+static std::tuple<torch::Tensor, torch::Tensor, torch::Tensor> intersection_on_device(
+    const torch::Tensor& first,
+    const torch::Tensor& second
+) {
+    auto options = torch::TensorOptions().dtype(torch::kInt64).device(first.device());
+
+    // the entries are ordered as in the smallest of the inputs
+    auto swap = second.size(0) < first.size(0);
+    const auto& small = swap ? second : first;
+    const auto& large = swap ? first : second;
+    auto n_small = small.size(0);
+
+    torch::Tensor values;
+    torch::Tensor small_mapping;
+    torch::Tensor large_mapping;
+    if (n_small == 0) {
+        values = small;
+        small_mapping = torch::full({n_small}, -1, options);
+        large_mapping = torch::full({large.size(0)}, -1, options);
+    } else {
+        // see `union_on_device` for the meaning of `inverse`
+        auto all = torch::cat({small, large});
+        auto unique = torch::unique_dim(all, 0, /*sorted=*/false, /*return_inverse=*/true);
+        auto n_unique = std::get<0>(unique).size(0);
+        const auto& inverse = std::get<1>(unique);
+        auto small_inverse = inverse.slice(0, 0, n_small);
+        auto large_inverse = inverse.slice(0, n_small);
+
+        auto in_large = torch::zeros({n_unique}, options.dtype(torch::kBool));
+        in_large.index_put_({large_inverse}, true);
+        auto is_common = in_large.index({small_inverse});
+
+        small_mapping = torch::where(
+            is_common,
+            torch::cumsum(is_common, 0, torch::kInt64) - 1,
+            torch::full_like(small_inverse, -1)
         );
+
+        auto position = torch::full({n_unique}, -1, options);
+        position.index_put_({small_inverse}, small_mapping);
+        large_mapping = position.index({large_inverse});
+
+        values = small.index({is_common});
     }
 
-    auto result = LabelsHolder(labels_->set_union(other->labels_.value()));
-    return result.to(device);
+    if (swap) {
+        return std::make_tuple(values, large_mapping, small_mapping);
+    } else {
+        return std::make_tuple(values, small_mapping, large_mapping);
+    }
 }
 
-std::tuple<TorchLabels, torch::Tensor, torch::Tensor> LabelsHolder::union_and_mapping(const TorchLabels& other) const {
-    if (!labels_.has_value() || !other->labels_.has_value()) {
+/// Check that `first` and `second` can be used in a set operation (`union`
+/// or `intersection`) and return their device
+static torch::Device check_set_operation(const LabelsHolder& first, const LabelsHolder& second, const std::string& operation) {
+    if (first.is_view() || second.is_view()) {
         C10_THROW_ERROR(ValueError,
             "can not call this function on Labels view, call to_owned first"
         );
     }
 
-    auto device = this->values_.device();
-    if (device != other->values_.device()) {
+    auto device = first.device();
+    if (device != second.device()) {
         C10_THROW_ERROR(ValueError,
-            "device mismatch in union: got '" + device.str() +
-            "' and '" + other->values_.device().str() + "'"
+            "device mismatch in " + operation + ": got '" + device.str() +
+            "' and '" + second.device().str() + "'"
+        );
+    }
+
+    if (!device.is_cpu() && first.names() != second.names()) {
+        // this error is created by metatensor-core for CPU labels
+        throw metatensor::Error(
+            "invalid parameter: can not take the " + operation + " of these Labels, they have different names"
+        );
+    }
+
+    return device;
+}
+
+TorchLabels LabelsHolder::set_union(const TorchLabels& other) const {
+    return std::get<0>(this->union_and_mapping(other));
+}
+
+std::tuple<TorchLabels, torch::Tensor, torch::Tensor> LabelsHolder::union_and_mapping(const TorchLabels& other) const {
+    RECORD_FUNCTION("metatensor::Labels::union", std::vector<c10::IValue>());
+
+    auto device = check_set_operation(*this, *other, "union");
+
+    if (!device.is_cpu()) {
+        auto result = union_on_device(values_, other->values_);
+        return std::make_tuple<TorchLabels, torch::Tensor, torch::Tensor>(
+            torch::make_intrusive<LabelsHolder>(names_, std::move(std::get<0>(result)), CreateLazy{}),
+            std::move(std::get<1>(result)),
+            std::move(std::get<2>(result))
         );
     }
 
@@ -527,8 +778,8 @@ std::tuple<TorchLabels, torch::Tensor, torch::Tensor> LabelsHolder::union_and_ma
     auto first_mapping = torch::zeros({this->count()}, options);
     auto second_mapping = torch::zeros({other->count()}, options);
 
-    auto result = LabelsHolder(labels_->set_union(
-        other->labels_.value(),
+    auto result = LabelsHolder(this->as_metatensor().set_union(
+        other->as_metatensor(),
         first_mapping.data_ptr<int64_t>(),
         first_mapping.size(0),
         second_mapping.data_ptr<int64_t>(),
@@ -536,43 +787,27 @@ std::tuple<TorchLabels, torch::Tensor, torch::Tensor> LabelsHolder::union_and_ma
     ));
 
     return std::make_tuple<TorchLabels, torch::Tensor, torch::Tensor>(
-        result.to(device),
-        first_mapping.to(device),
-        second_mapping.to(device)
+        torch::make_intrusive<LabelsHolder>(std::move(result)),
+        std::move(first_mapping),
+        std::move(second_mapping)
     );
 }
 
 TorchLabels LabelsHolder::set_intersection(const TorchLabels& other) const {
-    if (!labels_.has_value() || !other->labels_.has_value()) {
-        C10_THROW_ERROR(ValueError,
-            "can not call this function on Labels view, call to_owned first"
-        );
-    }
-
-    auto device = this->values_.device();
-    if (device != other->values_.device()) {
-        C10_THROW_ERROR(ValueError,
-            "device mismatch in intersection: got '" + device.str() +
-            "' and '" + other->values_.device().str() + "'"
-        );
-    }
-
-    auto result = LabelsHolder(labels_->set_intersection(other->labels_.value()));
-    return result.to(device);
+    return std::get<0>(this->intersection_and_mapping(other));
 }
 
 std::tuple<TorchLabels, torch::Tensor, torch::Tensor> LabelsHolder::intersection_and_mapping(const TorchLabels& other) const {
-    if (!labels_.has_value() || !other->labels_.has_value()) {
-        C10_THROW_ERROR(ValueError,
-            "can not call this function on Labels view, call to_owned first"
-        );
-    }
+    RECORD_FUNCTION("metatensor::Labels::intersection", std::vector<c10::IValue>());
 
-    auto device = this->values_.device();
-    if (device != other->values_.device()) {
-        C10_THROW_ERROR(ValueError,
-            "device mismatch in intersection: got '" + device.str() +
-            "' and '" + other->values_.device().str() + "'"
+    auto device = check_set_operation(*this, *other, "intersection");
+
+    if (!device.is_cpu()) {
+        auto result = intersection_on_device(values_, other->values_);
+        return std::make_tuple<TorchLabels, torch::Tensor, torch::Tensor>(
+            torch::make_intrusive<LabelsHolder>(names_, std::move(std::get<0>(result)), CreateLazy{}),
+            std::move(std::get<1>(result)),
+            std::move(std::get<2>(result))
         );
     }
 
@@ -580,8 +815,8 @@ std::tuple<TorchLabels, torch::Tensor, torch::Tensor> LabelsHolder::intersection
     auto first_mapping = torch::zeros({this->count()}, options);
     auto second_mapping = torch::zeros({other->count()}, options);
 
-    auto result = LabelsHolder(labels_->set_intersection(
-        other->labels_.value(),
+    auto result = LabelsHolder(this->as_metatensor().set_intersection(
+        other->as_metatensor(),
         first_mapping.data_ptr<int64_t>(),
         first_mapping.size(0),
         second_mapping.data_ptr<int64_t>(),
@@ -589,9 +824,9 @@ std::tuple<TorchLabels, torch::Tensor, torch::Tensor> LabelsHolder::intersection
     ));
 
     return std::make_tuple<TorchLabels, torch::Tensor, torch::Tensor>(
-        result.to(device),
-        first_mapping.to(device),
-        second_mapping.to(device)
+        torch::make_intrusive<LabelsHolder>(std::move(result)),
+        std::move(first_mapping),
+        std::move(second_mapping)
     );
 }
 
@@ -741,7 +976,7 @@ std::string LabelsHolder::print(int64_t max_entries, int64_t indent) const {
 
 std::string LabelsHolder::str() const {
     auto output = std::ostringstream();
-    if (labels_.has_value()) {
+    if (!is_view_) {
         output << "Labels(\n   ";
     } else {
         output << "LabelsView(\n   ";
@@ -753,7 +988,7 @@ std::string LabelsHolder::str() const {
 
 std::string LabelsHolder::repr() const {
     auto output = std::ostringstream();
-    if (labels_.has_value()) {
+    if (!is_view_) {
         output << "Labels(\n   ";
     } else {
         output << "LabelsView(\n   ";
@@ -765,6 +1000,8 @@ std::string LabelsHolder::repr() const {
 
 
 TorchLabels LabelsHolder::load(const std::string& path) {
+    RECORD_FUNCTION("metatensor::Labels::load", std::vector<c10::IValue>());
+
     return torch::make_intrusive<LabelsHolder>(
         LabelsHolder(metatensor::io::load_labels(path))
     );
@@ -772,6 +1009,8 @@ TorchLabels LabelsHolder::load(const std::string& path) {
 
 
 TorchLabels LabelsHolder::load_buffer(torch::Tensor buffer) {
+    RECORD_FUNCTION("metatensor::Labels::load_buffer", std::vector<c10::IValue>());
+
     if (buffer.scalar_type() != torch::kUInt8) {
         C10_THROW_ERROR(ValueError,
             "`buffer` must be a tensor of uint8, not " +
@@ -795,10 +1034,14 @@ TorchLabels LabelsHolder::load_buffer(torch::Tensor buffer) {
 
 
 void LabelsHolder::save(const std::string& path) const {
+    RECORD_FUNCTION("metatensor::Labels::save", std::vector<c10::IValue>());
+
     return metatensor::io::save(path, this->as_metatensor());
 }
 
 torch::Tensor LabelsHolder::save_buffer() const {
+    RECORD_FUNCTION("metatensor::Labels::save_buffer", std::vector<c10::IValue>());
+
     auto buffer = metatensor::io::save_buffer(this->as_metatensor());
     // move the buffer to the heap so it can escape this function
     // `torch::from_blob` does not take ownership of the data,
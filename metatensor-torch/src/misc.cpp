@@ -1,4 +1,9 @@
+#include <limits>
+#include <memory>
+#include <vector>
+
 #include <torch/torch.h>
+#include <ATen/record_function.h>
 
 #include <metatensor.hpp>
 #include <torch/types.h>
@@ -27,8 +32,10 @@ mts_status_t metatensor_torch::details::create_torch_array(
             sizes.push_back(static_cast<int64_t>(shape_ptr[i]));
         }
 
+        // all the elements are overwritten when loading, so there is no need
+        // to fill the tensor with zeros first
         auto options = torch::TensorOptions().device(torch::kCPU).dtype(torch::kF64);
-        auto tensor = torch::zeros(sizes, options);
+        auto tensor = torch::empty(sizes, options);
 
         auto cxx_array = std::unique_ptr<metatensor::DataArrayBase>(new TorchDataArray(tensor));
         *array = metatensor::DataArrayBase::to_mts_array_t(std::move(cxx_array));
@@ -37,9 +44,38 @@ mts_status_t metatensor_torch::details::create_torch_array(
     }, shape_ptr, shape_count, array);
 }
 
+/// Profiling scopes opened by `core_profiling_callback` on this thread, which
+/// are `nullptr` if no profiler was active when entering the scope.
+static thread_local std::vector<std::unique_ptr<at::RecordFunction>> CORE_PROFILING_SCOPES;
+
+void metatensor_torch::details::core_profiling_callback(const char* name, bool enter) {
+    // exceptions can not cross the C API boundary, and a failure to record a
+    // profiling event should not stop the code
+    try {
+        if (enter) {
+            auto scope = std::unique_ptr<at::RecordFunction>();
+            if (at::hasCallbacks()) {
+                scope = std::make_unique<at::RecordFunction>(at::RecordScope::FUNCTION);
+                if (scope->isActive()) {
+                    // `name` is a static string, so it is fine to keep a
+                    // pointer to it until the end of the scope
+                    scope->before(name);
+                }
+            }
+            CORE_PROFILING_SCOPES.push_back(std::move(scope));
+        } else if (!CORE_PROFILING_SCOPES.empty()) {
+            // destroying the `RecordFunction` ends the corresponding scope
+            CORE_PROFILING_SCOPES.pop_back();
+        }
+    } catch (...) {}
+}
 
-TorchTensorMap metatensor_torch::load(const std::string& path) {
-    return TensorMapHolder::load(path);
+TorchTensorMap metatensor_torch::load(
+    const std::string& path,
+    torch::optional<torch::Dtype> dtype,
+    torch::optional<torch::Device> device
+) {
+    return TensorMapHolder::load(path, dtype, device);
 }
 
 TorchTensorMap metatensor_torch::load_buffer(torch::Tensor buffer) {
@@ -71,3 +107,61 @@ void metatensor_torch::save(const std::string& path, TorchLabels labels) {
 torch::Tensor metatensor_torch::save_buffer(TorchLabels labels) {
     return labels->save_buffer();
 }
+
+
+TensorMapWriterHolder::TensorMapWriterHolder(
+    const std::string& path,
+    const std::vector<std::string>& keys_names
+): writer_(path, keys_names) {}
+
+/// Convert the values of a key to 32-bit integers, checking for overflow
+static std::vector<int32_t> key_to_int32(const std::vector<int64_t>& key) {
+    auto converted = std::vector<int32_t>();
+    converted.reserve(key.size());
+    for (auto value: key) {
+        if (value < std::numeric_limits<int32_t>::min() || value > std::numeric_limits<int32_t>::max()) {
+            C10_THROW_ERROR(ValueError,
+                "key value " + std::to_string(value) + " does not fit in a 32-bit integer"
+            );
+        }
+        converted.push_back(static_cast<int32_t>(value));
+    }
+    return converted;
+}
+
+void TensorMapWriterHolder::add_block(
+    const std::vector<int64_t>& key,
+    const TorchTensorBlock& block
+) {
+    writer_.add_block(key_to_int32(key), block->as_metatensor());
+}
+
+void TensorMapWriterHolder::begin_block(
+    const std::vector<int64_t>& key,
+    const std::vector<int64_t>& shape
+) {
+    auto converted = std::vector<uintptr_t>();
+    converted.reserve(shape.size());
+    for (auto size: shape) {
+        if (size < 0) {
+            C10_THROW_ERROR(ValueError,
+                "invalid negative size " + std::to_string(size) + " in shape"
+            );
+        }
+        converted.push_back(static_cast<uintptr_t>(size));
+    }
+
+    writer_.begin_block(key_to_int32(key), converted);
+}
+
+void TensorMapWriterHolder::add_samples(const TorchTensorBlock& chunk) {
+    writer_.add_samples(chunk->as_metatensor());
+}
+
+void TensorMapWriterHolder::end_block() {
+    writer_.end_block();
+}
+
+void TensorMapWriterHolder::finish() {
+    writer_.finish();
+}
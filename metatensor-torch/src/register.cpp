@@ -74,6 +74,10 @@ static torch::Tensor save_ivalue_buffer(torch::IValue data) {
 }
 
 TORCH_LIBRARY(metatensor, m) {
+    // send the profiling events from metatensor-core functions to the torch
+    // profiler
+    mts_set_profiling_callback(details::core_profiling_callback);
+
     // There is no way to access the docstrings from Python, so we don't bother
     // setting them to something useful here.
     //
@@ -106,8 +110,8 @@ TORCH_LIBRARY(metatensor, m) {
 
     m.class_<LabelsHolder>("Labels")
         .def(
-            torch::init<torch::IValue, torch::Tensor>(), DOCSTRING,
-            {torch::arg("names"), torch::arg("values")}
+            torch::init<torch::IValue, torch::Tensor, bool>(), DOCSTRING,
+            {torch::arg("names"), torch::arg("values"), torch::arg("assume_unique") = false}
         )
         .def("__str__", &LabelsHolder::str)
         .def("__repr__", &LabelsHolder::repr)
@@ -154,6 +158,10 @@ TORCH_LIBRARY(metatensor, m) {
         .def("position", &LabelsHolder::position, DOCSTRING,
             {torch::arg("entry")}
         )
+        .def("positions", &LabelsHolder::positions, DOCSTRING,
+            {torch::arg("entries")}
+        )
+        .def("memory_usage", &LabelsHolder::memory_usage)
         .def("print", &LabelsHolder::print, DOCSTRING,
             {torch::arg("max_entries"), torch::arg("indent") = 0}
         )
@@ -179,6 +187,13 @@ TORCH_LIBRARY(metatensor, m) {
         .def("__repr__", &TensorBlockHolder::repr)
         .def("__str__", &TensorBlockHolder::repr)
         .def("copy", &TensorBlockHolder::copy)
+        .def("slice_samples", &TensorBlockHolder::slice_samples, DOCSTRING,
+            {torch::arg("start"), torch::arg("stop")}
+        )
+        .def("split_samples", &TensorBlockHolder::split_samples, DOCSTRING,
+            {torch::arg("boundaries")}
+        )
+        .def("memory_usage", &TensorBlockHolder::memory_usage)
         .def_property("values", &TensorBlockHolder::values)
         .def_property("samples", &TensorBlockHolder::samples)
         .def_property("components", &TensorBlockHolder::components)
@@ -201,7 +216,8 @@ TORCH_LIBRARY(metatensor, m) {
             torch::arg("_1") = torch::IValue(),
             torch::arg("dtype") = torch::nullopt,
             torch::arg("device") = torch::nullopt,
-            torch::arg("arrays") = torch::nullopt
+            torch::arg("arrays") = torch::nullopt,
+            torch::arg("non_blocking") = false
         })
         ;
 
@@ -218,8 +234,13 @@ TORCH_LIBRARY(metatensor, m) {
         )
         .def("copy", &TensorMapHolder::copy)
         .def("save", &TensorMapHolder::save, DOCSTRING, {torch::arg("file")})
+        .def("save_shm", &TensorMapHolder::save_shm, DOCSTRING, {torch::arg("name")})
         .def("save_buffer", &TensorMapHolder::save_buffer)
-        .def_static("load", &TensorMapHolder::load)
+        .def_static("load", [](const std::string& path){ return TensorMapHolder::load(path); })
+        .def_static("load_mmap", &TensorMapHolder::load_mmap)
+        .def_static("load_shm", &TensorMapHolder::load_shm)
+        .def_static("remove_shm", &TensorMapHolder::remove_shm)
+        .def_static("load_selection", &TensorMapHolder::load_selection)
         .def_static("load_buffer", &TensorMapHolder::load_buffer)
         .def("items", &TensorMapHolder::items)
         .def_property("keys", &TensorMapHolder::keys)
@@ -247,6 +268,14 @@ TORCH_LIBRARY(metatensor, m) {
         .def("components_to_properties", &TensorMapHolder::components_to_properties, DOCSTRING,
             {torch::arg("dimensions")}
         )
+        .def_static("join_samples", &TensorMapHolder::join_samples)
+        .def("slice_samples", &TensorMapHolder::slice_samples, DOCSTRING,
+            {torch::arg("start"), torch::arg("stop")}
+        )
+        .def("split_samples", &TensorMapHolder::split_samples, DOCSTRING,
+            {torch::arg("boundaries")}
+        )
+        .def("memory_usage", &TensorMapHolder::memory_usage)
         .def_property("sample_names", &TensorMapHolder::sample_names)
         .def_property("component_names", &TensorMapHolder::component_names)
         .def_property("property_names", &TensorMapHolder::property_names)
@@ -257,11 +286,14 @@ TORCH_LIBRARY(metatensor, m) {
             torch::arg("_1") = torch::IValue(),
             torch::arg("dtype") = torch::nullopt,
             torch::arg("device") = torch::nullopt,
-            torch::arg("arrays") = torch::nullopt
+            torch::arg("arrays") = torch::nullopt,
+            torch::arg("non_blocking") = false
         })
         .def("print", &TensorMapHolder::print, DOCSTRING,
             {torch::arg("max_keys")}
         )
+        .def("pack", &TensorMapHolder::pack)
+        .def_property("packed_buffer", &TensorMapHolder::packed_buffer)
         .def_pickle(
             // __getstate__
             [](const TorchTensorMap& self){ return self->save_buffer(); },
@@ -275,7 +307,7 @@ TORCH_LIBRARY(metatensor, m) {
     m.def("dtype_name(ScalarType dtype) -> str", scalar_type_name);
 
     m.def(
-        "load(str path) -> __torch__.torch.classes.metatensor.TensorMap",
+        "load(str path, ScalarType? dtype = None, Device? device = None) -> __torch__.torch.classes.metatensor.TensorMap",
         metatensor_torch::load
     );
     m.def(
@@ -295,6 +327,24 @@ TORCH_LIBRARY(metatensor, m) {
     m.def("save(str path, Any data) -> ()", save_ivalue);
     m.def("save_buffer(Any data) -> Tensor", save_ivalue_buffer);
 
+    m.class_<TensorMapWriterHolder>("TensorMapWriter")
+        .def(
+            torch::init<std::string, std::vector<std::string>>(), DOCSTRING,
+            {torch::arg("path"), torch::arg("keys_names")}
+        )
+        .def("add_block", &TensorMapWriterHolder::add_block, DOCSTRING,
+            {torch::arg("key"), torch::arg("block")}
+        )
+        .def("begin_block", &TensorMapWriterHolder::begin_block, DOCSTRING,
+            {torch::arg("key"), torch::arg("shape")}
+        )
+        .def("add_samples", &TensorMapWriterHolder::add_samples, DOCSTRING,
+            {torch::arg("chunk")}
+        )
+        .def("end_block", &TensorMapWriterHolder::end_block)
+        .def("finish", &TensorMapWriterHolder::finish)
+        ;
+
     // ====================================================================== //
     //               code specific to atomistic simulations                   //
     // ====================================================================== //
@@ -309,6 +359,10 @@ TORCH_LIBRARY(metatensor, m) {
             DOCSTRING, {torch::arg("engine_length_unit")}
         )
         .def_property("full_list", &NeighborsListOptionsHolder::full_list)
+        .def_property("skin", &NeighborsListOptionsHolder::skin, &NeighborsListOptionsHolder::set_skin)
+        .def("engine_skin", &NeighborsListOptionsHolder::engine_skin,
+            DOCSTRING, {torch::arg("engine_length_unit")}
+        )
         .def("requestors", &NeighborsListOptionsHolder::requestors)
         .def("add_requestor", &NeighborsListOptionsHolder::add_requestor, DOCSTRING,
             {torch::arg("requestor")}
@@ -335,6 +389,12 @@ TORCH_LIBRARY(metatensor, m) {
         .def_property("types", &SystemHolder::types, &SystemHolder::set_types)
         .def_property("positions", &SystemHolder::positions, &SystemHolder::set_positions)
         .def_property("cell", &SystemHolder::cell, &SystemHolder::set_cell)
+        .def("update_positions", &SystemHolder::update_positions, DOCSTRING,
+            {torch::arg("positions")}
+        )
+        .def("update_cell", &SystemHolder::update_cell, DOCSTRING,
+            {torch::arg("cell")}
+        )
         .def("__len__", &SystemHolder::size)
         .def("__str__", &SystemHolder::str)
         .def("__repr__", &SystemHolder::str)
@@ -349,6 +409,12 @@ TORCH_LIBRARY(metatensor, m) {
         .def("add_neighbors_list", &SystemHolder::add_neighbors_list, DOCSTRING,
             {torch::arg("options"), torch::arg("neighbors")}
         )
+        .def("update_neighbors_list", &SystemHolder::update_neighbors_list, DOCSTRING,
+            {torch::arg("options"), torch::arg("values"), torch::arg("samples") = torch::nullopt}
+        )
+        .def("compute_neighbors_lists", &SystemHolder::compute_neighbors_lists, DOCSTRING,
+            {torch::arg("options"), torch::arg("length_unit") = "", torch::arg("previous") = torch::nullopt}
+        )
         .def("get_neighbors_list", &SystemHolder::get_neighbors_list, DOCSTRING,
             {torch::arg("options")}
         )
@@ -494,4 +560,11 @@ TORCH_LIBRARY(metatensor, m) {
         ") -> ()",
         register_autograd_neighbors
     );
+    m.def(
+        "split_outputs_per_system("
+            "Dict(str, __torch__.torch.classes.metatensor.TensorMap) outputs, "
+            "int n_systems"
+        ") -> Dict(str, __torch__.torch.classes.metatensor.TensorMap)[]",
+        split_outputs_per_system
+    );
 }
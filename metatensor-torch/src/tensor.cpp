@@ -1,5 +1,8 @@
 #include <metatensor.hpp>
 #include <string>
+#include <functional>
+
+#include <ATen/record_function.h>
 
 #include "metatensor/torch/tensor.hpp"
 #include "metatensor/torch/array.hpp"
@@ -53,7 +56,7 @@ static std::vector<metatensor::TensorBlock> blocks_from_torch(const std::vector<
 
 
 TensorMapHolder::TensorMapHolder(TorchLabels keys, const std::vector<TorchTensorBlock>& blocks):
-    tensor_(keys->as_metatensor(), blocks_from_torch(blocks))
+    TensorMapHolder(metatensor::TensorMap(keys->as_metatensor(), blocks_from_torch(blocks)))
 {
     if (blocks.empty()) {
         // nothing to check
@@ -81,15 +84,23 @@ TensorMapHolder::TensorMapHolder(TorchLabels keys, const std::vector<TorchTensor
 }
 
 TorchTensorMap TensorMapHolder::copy() const {
-    return torch::make_intrusive<TensorMapHolder>(TensorMapHolder(this->tensor_.clone()));
+    RECORD_FUNCTION("metatensor::TensorMap::copy", std::vector<c10::IValue>());
+
+    return torch::make_intrusive<TensorMapHolder>(TensorMapHolder(this->data_->tensor.clone()));
 }
 
 TorchLabels TensorMapHolder::keys() const {
-    return torch::make_intrusive<LabelsHolder>(this->tensor_.keys());
+    auto guard = std::lock_guard<std::mutex>(*cache_mutex_);
+    if (!keys_) {
+        keys_ = torch::make_intrusive<LabelsHolder>(data_->tensor.keys());
+    }
+    return keys_;
 }
 
 std::vector<int64_t> TensorMapHolder::blocks_matching(const TorchLabels& selection) const {
-    auto results = tensor_.blocks_matching(selection->as_metatensor());
+    RECORD_FUNCTION("metatensor::TensorMap::blocks_matching", std::vector<c10::IValue>());
+
+    auto results = data_->tensor.blocks_matching(selection->as_metatensor());
 
     auto results_int64 = std::vector<int64_t>();
     results_int64.reserve(results.size());
@@ -101,16 +112,32 @@ std::vector<int64_t> TensorMapHolder::blocks_matching(const TorchLabels& selecti
 }
 
 TorchTensorBlock TensorMapHolder::block_by_id(TorchTensorMap self, int64_t index) {
-    if (index >= self->keys()->count()) {
+    RECORD_FUNCTION("metatensor::TensorMap::block_by_id", std::vector<c10::IValue>());
+
+    auto count = self->keys()->count();
+    if (index < 0 || index >= count) {
         // this needs to be an IndexError to enable iteration over a TensorMap
         C10_THROW_ERROR(IndexError,
-            "block index out of bounds: we have " + std::to_string(self->keys()->count())
+            "block index out of bounds: we have " + std::to_string(count)
             + " blocks but the index is " + std::to_string(index)
         );
     }
-    return torch::make_intrusive<TensorBlockHolder>(
-        self->tensor_.block_by_id(index), self
-    );
+
+    auto guard = std::lock_guard<std::mutex>(*self->cache_mutex_);
+    if (self->blocks_.empty()) {
+        self->blocks_.resize(static_cast<size_t>(count));
+    }
+
+    auto& block = self->blocks_[static_cast<size_t>(index)];
+    if (!block) {
+        // the block keeps the TensorMap data alive, but not `self`, since
+        // `self` keeps a reference to the block
+        block = torch::make_intrusive<TensorBlockHolder>(
+            self->data_->tensor.block_by_id(index),
+            torch::IValue::make_capsule(self->data_)
+        );
+    }
+    return block;
 }
 
 
@@ -142,7 +169,7 @@ TorchTensorBlock TensorMapHolder::block(TorchTensorMap self, TorchLabelsEntry to
         torch_selection->names(), cpu_values.data_ptr<int32_t>(), 1
     );
 
-    auto matching = self->tensor_.blocks_matching(selection);
+    auto matching = self->data_->tensor.blocks_matching(selection);
     if (matching.empty()) {
         C10_THROW_ERROR(ValueError,
             "could not find blocks matching the selection " + torch_selection->print()
@@ -158,6 +185,8 @@ TorchTensorBlock TensorMapHolder::block(TorchTensorMap self, TorchLabelsEntry to
 }
 
 TorchTensorBlock TensorMapHolder::block_torch(TorchTensorMap self, torch::IValue index) {
+    RECORD_FUNCTION("metatensor::TensorMap::block", std::vector<c10::IValue>());
+
     if (index.isInt()) {
         return TensorMapHolder::block_by_id(self, index.toInt());
     } else if (index.isNone()) {
@@ -218,7 +247,7 @@ std::vector<TorchTensorBlock> TensorMapHolder::blocks_by_id(TorchTensorMap self,
 
 std::vector<TorchTensorBlock> TensorMapHolder::blocks(TorchTensorMap self) {
     auto result = std::vector<TorchTensorBlock>();
-    for (size_t i=0; i<self->tensor_.keys().count(); i++) {
+    for (size_t i=0; i<self->data_->tensor.keys().count(); i++) {
         result.push_back(TensorMapHolder::block_by_id(self, static_cast<int64_t>(i)));
     }
     return result;
@@ -256,7 +285,7 @@ std::vector<TorchTensorBlock> TensorMapHolder::blocks(TorchTensorMap self, Torch
     );
 
     auto matching = std::vector<int64_t>();
-    for (auto m: self->tensor_.blocks_matching(selection)) {
+    for (auto m: self->data_->tensor.blocks_matching(selection)) {
         matching.push_back(static_cast<int64_t>(m));
     }
 
@@ -265,6 +294,8 @@ std::vector<TorchTensorBlock> TensorMapHolder::blocks(TorchTensorMap self, Torch
 
 
 std::vector<TorchTensorBlock> TensorMapHolder::blocks_torch(TorchTensorMap self,torch::IValue index) {
+    RECORD_FUNCTION("metatensor::TensorMap::blocks", std::vector<c10::IValue>());
+
     if (index.isNone()) {
         return TensorMapHolder::blocks(self);
     } else if (index.isInt()) {
@@ -344,15 +375,17 @@ static std::vector<std::string> extract_list_str(const torch::IValue& keys_to_mo
 }
 
 TorchTensorMap TensorMapHolder::keys_to_properties(torch::IValue keys_to_move, bool sort_samples) const {
+    RECORD_FUNCTION("metatensor::TensorMap::keys_to_properties", std::vector<c10::IValue>());
+
     auto device = this->keys()->values().device();
     if (keys_to_move.isString() || keys_to_move.isList() || keys_to_move.isTuple()) {
         auto selection = extract_list_str(keys_to_move, "TensorMap::keys_to_properties first argument");
-        auto tensor = tensor_.keys_to_properties(selection, sort_samples);
+        auto tensor = data_->tensor.keys_to_properties(selection, sort_samples);
         auto result = torch::make_intrusive<TensorMapHolder>(TensorMapHolder(std::move(tensor)));
         return result->to(torch::nullopt, device);
     } else if (keys_to_move.isCustomClass()) {
         auto selection = keys_to_move.toCustomClass<LabelsHolder>();
-        auto tensor = tensor_.keys_to_properties(selection->as_metatensor(), sort_samples);
+        auto tensor = data_->tensor.keys_to_properties(selection->as_metatensor(), sort_samples);
         auto result = torch::make_intrusive<TensorMapHolder>(TensorMapHolder(std::move(tensor)));
         return result->to(torch::nullopt, device);
     } else {
@@ -363,15 +396,17 @@ TorchTensorMap TensorMapHolder::keys_to_properties(torch::IValue keys_to_move, b
 }
 
 TorchTensorMap TensorMapHolder::keys_to_samples(torch::IValue keys_to_move, bool sort_samples) const {
+    RECORD_FUNCTION("metatensor::TensorMap::keys_to_samples", std::vector<c10::IValue>());
+
     auto device = this->keys()->values().device();
     if (keys_to_move.isString() || keys_to_move.isList() || keys_to_move.isTuple()) {
         auto selection = extract_list_str(keys_to_move, "TensorMap::keys_to_samples first argument");
-        auto tensor = tensor_.keys_to_samples(selection, sort_samples);
+        auto tensor = data_->tensor.keys_to_samples(selection, sort_samples);
         auto result = torch::make_intrusive<TensorMapHolder>(TensorMapHolder(std::move(tensor)));
         return result->to(torch::nullopt, device);
     } else if (keys_to_move.isCustomClass()) {
         auto selection = keys_to_move.toCustomClass<LabelsHolder>();
-        auto tensor = tensor_.keys_to_samples(selection->as_metatensor(), sort_samples);
+        auto tensor = data_->tensor.keys_to_samples(selection->as_metatensor(), sort_samples);
         auto result = torch::make_intrusive<TensorMapHolder>(TensorMapHolder(std::move(tensor)));
         return result->to(torch::nullopt, device);
     } else {
@@ -381,10 +416,102 @@ TorchTensorMap TensorMapHolder::keys_to_samples(torch::IValue keys_to_move, bool
     }
 }
 
+TorchTensorMap TensorMapHolder::join_samples(
+    const std::vector<TorchTensorMap>& tensors,
+    torch::optional<std::string> new_dimension
+) {
+    RECORD_FUNCTION("metatensor::TensorMap::join_samples", std::vector<c10::IValue>());
+
+    if (tensors.empty()) {
+        C10_THROW_ERROR(ValueError,
+            "`tensors` must contain at least one TensorMap in `join_samples`"
+        );
+    }
+
+    auto device = tensors[0]->device();
+    auto scalar_type = tensors[0]->scalar_type();
+    auto pointers = std::vector<const metatensor::TensorMap*>();
+    pointers.reserve(tensors.size());
+    for (const auto& tensor: tensors) {
+        if (tensor->device() != device) {
+            C10_THROW_ERROR(ValueError,
+                "all tensors must be on the same device in `join_samples`, "
+                "got " + tensor->device().str() + " and " + device.str()
+            );
+        }
+
+        if (tensor->keys()->count() != 0 && tensor->scalar_type() != scalar_type) {
+            C10_THROW_ERROR(ValueError,
+                "all tensors must have the same dtype in `join_samples`, "
+                "got " + scalar_type_name(tensor->scalar_type()) +
+                " and " + scalar_type_name(scalar_type)
+            );
+        }
+
+        pointers.push_back(&tensor->as_metatensor());
+    }
+
+    auto tensor = metatensor::TensorMap::join_samples(pointers, new_dimension.value_or(""));
+    auto result = torch::make_intrusive<TensorMapHolder>(TensorMapHolder(std::move(tensor)));
+    return result->to(torch::nullopt, device);
+}
+
+TorchTensorMap TensorMapHolder::slice_samples(int64_t start, int64_t stop) const {
+    RECORD_FUNCTION("metatensor::TensorMap::slice_samples", std::vector<c10::IValue>());
+
+    auto blocks = std::vector<TorchTensorBlock>();
+    for (size_t i=0; i<data_->tensor.keys().count(); i++) {
+        auto block = TensorBlockHolder(data_->tensor.block_by_id(i), torch::IValue());
+        blocks.push_back(block.slice_samples(start, stop));
+    }
+
+    return torch::make_intrusive<TensorMapHolder>(this->keys(), blocks);
+}
+
+std::vector<TorchTensorMap> TensorMapHolder::split_samples(const std::vector<int64_t>& boundaries) const {
+    RECORD_FUNCTION("metatensor::TensorMap::split_samples", std::vector<c10::IValue>());
+
+    auto keys = this->keys();
+    auto blocks = std::vector<std::vector<TorchTensorBlock>>(boundaries.size() + 1);
+    for (size_t i=0; i<data_->tensor.keys().count(); i++) {
+        auto block = TensorBlockHolder(data_->tensor.block_by_id(i), torch::IValue());
+        auto splitted = block.split_samples(boundaries);
+        for (size_t j=0; j<splitted.size(); j++) {
+            blocks[j].push_back(std::move(splitted[j]));
+        }
+    }
+
+    auto result = std::vector<TorchTensorMap>();
+    result.reserve(blocks.size());
+    for (const auto& split_blocks: blocks) {
+        result.push_back(torch::make_intrusive<TensorMapHolder>(keys, split_blocks));
+    }
+
+    return result;
+}
+
+torch::Dict<std::string, int64_t> TensorMapHolder::memory_usage() const {
+    auto usage = data_->tensor.memory_usage();
+
+    // use the size of the tensors for the values, see
+    // `TensorBlockHolder::memory_usage`
+    usage.values = 0;
+    usage.gradients_values = 0;
+    for (size_t i=0; i<data_->tensor.keys().count(); i++) {
+        auto block_usage = TensorBlockHolder(data_->tensor.block_by_id(i), torch::IValue()).memory_usage();
+        usage.values += static_cast<uintptr_t>(block_usage.at("values"));
+        usage.gradients_values += static_cast<uintptr_t>(block_usage.at("gradients_values"));
+    }
+
+    return memory_usage_to_dict(usage);
+}
+
 TorchTensorMap TensorMapHolder::components_to_properties(torch::IValue dimensions) const {
+    RECORD_FUNCTION("metatensor::TensorMap::components_to_properties", std::vector<c10::IValue>());
+
     auto device = this->keys()->values().device();
     auto selection = extract_list_str(dimensions, "TensorMap::components_to_properties argument");
-    auto tensor = this->tensor_.components_to_properties(selection);
+    auto tensor = this->data_->tensor.components_to_properties(selection);
     auto result = torch::make_intrusive<TensorMapHolder>(TensorMapHolder(std::move(tensor)));
     return result->to(torch::nullopt, device);
 }
@@ -401,18 +528,18 @@ static std::vector<std::string> labels_names(const metatensor::TensorBlock& bloc
 }
 
 std::vector<std::string> TensorMapHolder::sample_names() {
-    if (tensor_.keys().count() == 0) {
+    if (data_->tensor.keys().count() == 0) {
         return {};
     }
 
-    return labels_names(this->tensor_.block_by_id(0), 0);
+    return labels_names(this->data_->tensor.block_by_id(0), 0);
 }
 
 std::vector<std::string> TensorMapHolder::component_names() {
     auto result = std::vector<std::string>();
 
-    if (tensor_.keys().count() != 0) {
-        auto block = this->tensor_.block_by_id(0);
+    if (data_->tensor.keys().count() != 0) {
+        auto block = this->data_->tensor.block_by_id(0);
         auto n_dimensions = block.values_shape().size();
 
         for (size_t dimension=1; dimension<n_dimensions-1; dimension++) {
@@ -427,11 +554,11 @@ std::vector<std::string> TensorMapHolder::component_names() {
 }
 
 std::vector<std::string> TensorMapHolder::property_names() {
-    if (tensor_.keys().count() == 0) {
+    if (data_->tensor.keys().count() == 0) {
         return {};
     }
 
-    auto block = this->tensor_.block_by_id(0);
+    auto block = this->data_->tensor.block_by_id(0);
     auto n_dimensions = block.values_shape().size();
 
     return labels_names(block, n_dimensions - 1);
@@ -460,24 +587,180 @@ torch::Dtype TensorMapHolder::scalar_type() const {
     }
 
     // const_cast is fine here since we will just extract and return a scalar
-    auto block = const_cast<metatensor::TensorMap&>(this->tensor_).block_by_id(0);
+    auto block = const_cast<metatensor::TensorMap&>(this->data_->tensor).block_by_id(0);
     auto first_block = torch::make_intrusive<TensorBlockHolder>(std::move(block), torch::IValue());
     return first_block->scalar_type();
 }
 
+/// Get the total number of elements in the values of `block` and all its
+/// gradients
+static int64_t packed_numel(const TorchTensorBlock& block) {
+    auto numel = block->values().numel();
+    for (const auto& [_, gradient]: TensorBlockHolder::gradients(block)) {
+        numel += packed_numel(gradient);
+    }
+    return numel;
+}
+
+/// Create a new block with the metadata of `block` (transformed by
+/// `labels_to`), where the values of the block and of all its gradients are
+/// views inside the 1-dimensional `buffer`, starting at `offset`. `offset` is
+/// updated to point after the last value used by this block. If
+/// `copy_values` is `true`, the values of `block` are copied to the buffer.
+static TorchTensorBlock block_in_buffer(
+    const TorchTensorBlock& block,
+    const torch::Tensor& buffer,
+    int64_t& offset,
+    bool copy_values,
+    const std::function<TorchLabels(const TorchLabels&)>& labels_to
+) {
+    auto values = block->values();
+    auto view = buffer.narrow(0, offset, values.numel()).view(values.sizes());
+    offset += values.numel();
+
+    if (copy_values) {
+        view.copy_(values);
+    }
+
+    auto components = std::vector<TorchLabels>();
+    for (const auto& component: block->components()) {
+        components.emplace_back(labels_to(component));
+    }
+
+    auto result = torch::make_intrusive<TensorBlockHolder>(
+        std::move(view),
+        labels_to(block->samples()),
+        std::move(components),
+        labels_to(block->properties())
+    );
+
+    for (const auto& [parameter, gradient]: TensorBlockHolder::gradients(block)) {
+        result->add_gradient(
+            parameter,
+            block_in_buffer(gradient, buffer, offset, copy_values, labels_to)
+        );
+    }
+
+    return result;
+}
+
+TorchTensorMap TensorMapHolder::pack() const {
+    RECORD_FUNCTION("metatensor::TensorMap::pack", std::vector<c10::IValue>());
+
+    auto keys = this->keys();
+
+    auto blocks = std::vector<TorchTensorBlock>();
+    blocks.reserve(static_cast<size_t>(keys->count()));
+    int64_t numel = 0;
+    for (int64_t block_i=0; block_i<keys->count(); block_i++) {
+        auto block = torch::make_intrusive<TensorBlockHolder>(
+            this->data_->tensor.block_by_id(block_i), torch::IValue()
+        );
+        numel += packed_numel(block);
+        blocks.emplace_back(std::move(block));
+    }
+
+    auto options = torch::TensorOptions().dtype(this->scalar_type()).device(this->device());
+    auto buffer = torch::empty({numel}, options);
+
+    int64_t offset = 0;
+    auto new_blocks = std::vector<TorchTensorBlock>();
+    new_blocks.reserve(blocks.size());
+    for (const auto& block: blocks) {
+        new_blocks.emplace_back(block_in_buffer(
+            block, buffer, offset, /*copy_values=*/true,
+            [](const TorchLabels& labels) { return labels; }
+        ));
+    }
+
+    auto result = torch::make_intrusive<TensorMapHolder>(keys, new_blocks);
+    result->packed_ = std::move(buffer);
+    return result;
+}
+
+torch::optional<torch::Tensor> TensorMapHolder::packed_buffer() const {
+    if (packed_.defined()) {
+        return packed_;
+    } else {
+        return torch::nullopt;
+    }
+}
+
 TorchTensorMap TensorMapHolder::to(
     torch::optional<torch::Dtype> dtype,
-    torch::optional<torch::Device> device
+    torch::optional<torch::Device> device,
+    bool non_blocking
 ) const {
+    RECORD_FUNCTION("metatensor::TensorMap::to", std::vector<c10::IValue>());
+    // shared between all blocks, so each distinct Labels is only moved once
+    auto moved_labels = TensorBlockHolder::MovedLabels();
+
+    auto keys = this->keys();
+
+    if (packed_.defined()) {
+        // move all the values at once, and then create new views in the moved
+        // buffer, in the same order as in `pack()`
+        auto buffer = packed_.to(
+            dtype,
+            /*layout*/ torch::nullopt,
+            device,
+            /*pin_memory*/ torch::nullopt,
+            non_blocking,
+            /*copy*/ false,
+            /*memory_format*/ torch::MemoryFormat::Preserve
+        );
+
+        auto labels_to = [&](const TorchLabels& labels) {
+            if (!device.has_value()) {
+                return labels;
+            }
+
+            const auto* key = labels->as_metatensor().as_mts_labels_t().internal_ptr_;
+            auto it = moved_labels.find(key);
+            if (it != moved_labels.end()) {
+                return it->second;
+            }
+
+            auto moved = labels->to(device.value(), non_blocking);
+            moved_labels.emplace(key, moved);
+            return moved;
+        };
+
+        int64_t offset = 0;
+        auto new_blocks = std::vector<TorchTensorBlock>();
+        new_blocks.reserve(static_cast<size_t>(keys->count()));
+        for (int64_t block_i=0; block_i<keys->count(); block_i++) {
+            auto block = torch::make_intrusive<TensorBlockHolder>(
+                this->data_->tensor.block_by_id(block_i), torch::IValue()
+            );
+            new_blocks.emplace_back(block_in_buffer(
+                block, buffer, offset, /*copy_values=*/false, labels_to
+            ));
+        }
+
+        if (device.has_value()) {
+            keys = keys->to(device.value(), non_blocking);
+        }
+
+        auto result = torch::make_intrusive<TensorMapHolder>(keys, new_blocks);
+        result->packed_ = std::move(buffer);
+        return result;
+    }
+
     auto new_blocks = std::vector<TorchTensorBlock>();
-    for (int64_t block_i=0; block_i<this->keys()->count(); block_i++) {
+    new_blocks.reserve(static_cast<size_t>(keys->count()));
+    for (int64_t block_i=0; block_i<keys->count(); block_i++) {
         // const_cast is fine here since we will return a new copy of the data
         // with the different dtype/device
-        auto block = const_cast<metatensor::TensorMap&>(this->tensor_).block_by_id(block_i);
-        auto torch_block = torch::make_intrusive<TensorBlockHolder>(std::move(block), torch::IValue());
-        new_blocks.emplace_back(torch_block->to(dtype, device));
+        auto block = const_cast<metatensor::TensorMap&>(this->data_->tensor).block_by_id(block_i);
+        auto torch_block = TensorBlockHolder(std::move(block), torch::IValue());
+        new_blocks.emplace_back(torch_block.to_impl(dtype, device, non_blocking, moved_labels));
+    }
+
+    if (device.has_value()) {
+        keys = keys->to(device.value(), non_blocking);
     }
-    return torch::make_intrusive<TensorMapHolder>(this->keys()->to(device), new_blocks);
+    return torch::make_intrusive<TensorMapHolder>(keys, new_blocks);
 }
 
 
@@ -486,7 +769,8 @@ TorchTensorMap TensorMapHolder::to_positional(
     torch::IValue positional_2,
     torch::optional<torch::Dtype> dtype,
     torch::optional<torch::Device> device,
-    torch::optional<std::string> arrays
+    torch::optional<std::string> arrays,
+    bool non_blocking
 ) const {
     if (arrays.value_or("torch") != "torch") {
         C10_THROW_ERROR(ValueError,
@@ -502,7 +786,7 @@ TorchTensorMap TensorMapHolder::to_positional(
         "`TensorMap.to`"
     );
 
-    return this->to(parsed_dtype, parsed_device);
+    return this->to(parsed_dtype, parsed_device, non_blocking);
 }
 
 
@@ -515,13 +799,194 @@ std::string TensorMapHolder::print(int64_t max_keys) const {
 }
 
 
-TorchTensorMap TensorMapHolder::load(const std::string& path) {
+TorchTensorMap TensorMapHolder::load_selection(const std::string& path, TorchLabels selection) {
+    RECORD_FUNCTION("metatensor::TensorMap::load_selection", std::vector<c10::IValue>());
+
+    return torch::make_intrusive<TensorMapHolder>(
+        TensorMapHolder(metatensor::io::load_selection(
+            path,
+            selection->as_metatensor(),
+            details::create_torch_array
+        ))
+    );
+}
+
+/// Create a `TorchTensorBlock` using the data in a block coming from
+/// `metatensor::io::load_mmap`. The data is not copied, and the resulting
+/// tensors keep `tensor` alive and use the same dtype as the file.
+static TorchTensorBlock block_from_mmap(
+    const std::shared_ptr<metatensor::TensorMap>& tensor,
+    metatensor::TensorBlock block
+) {
+    auto array = block.mts_array();
+    void* data = nullptr;
+    int32_t dtype = 0;
+    metatensor::details::check_status(array.typed_data(array.ptr, &data, &dtype));
+
+    auto scalar_type = torch::kF64;
+    if (dtype == MTS_DTYPE_F64) {
+        scalar_type = torch::kF64;
+    } else if (dtype == MTS_DTYPE_F32) {
+        scalar_type = torch::kF32;
+    } else if (dtype == MTS_DTYPE_F16) {
+        scalar_type = torch::kF16;
+    } else {
+        C10_THROW_ERROR(ValueError,
+            "unexpected dtype in memory-mapped data: " + std::to_string(dtype)
+        );
+    }
+
+    auto sizes = std::vector<int64_t>();
+    for (auto size: block.values_shape()) {
+        sizes.push_back(static_cast<int64_t>(size));
+    }
+
+    auto values = torch::from_blob(
+        data,
+        sizes,
+        // keep the memory-mapped TensorMap alive as long as this tensor
+        [tensor](void*) {},
+        torch::TensorOptions().dtype(scalar_type).device(torch::kCPU)
+    );
+
+    auto components = std::vector<TorchLabels>();
+    for (auto component: block.components()) {
+        components.emplace_back(torch::make_intrusive<LabelsHolder>(std::move(component)));
+    }
+
+    auto result = torch::make_intrusive<TensorBlockHolder>(
+        std::move(values),
+        torch::make_intrusive<LabelsHolder>(block.samples()),
+        std::move(components),
+        torch::make_intrusive<LabelsHolder>(block.properties())
+    );
+
+    for (const auto& parameter: block.gradients_list()) {
+        result->add_gradient(parameter, block_from_mmap(tensor, block.gradient(parameter)));
+    }
+
+    return result;
+}
+
+/// Create a `TorchTensorMap` sharing the data of a `TensorMap` coming from
+/// `metatensor::io::load_mmap` or `metatensor::io::load_shm`.
+static TorchTensorMap tensor_from_mmap(std::shared_ptr<metatensor::TensorMap> tensor) {
+    auto blocks = std::vector<TorchTensorBlock>();
+    for (size_t i=0; i<tensor->keys().count(); i++) {
+        blocks.emplace_back(block_from_mmap(tensor, tensor->block_by_id(i)));
+    }
+
     return torch::make_intrusive<TensorMapHolder>(
-        TensorMapHolder(metatensor::io::load(path, details::create_torch_array))
+        torch::make_intrusive<LabelsHolder>(tensor->keys()),
+        blocks
+    );
+}
+
+TorchTensorMap TensorMapHolder::load_mmap(const std::string& path) {
+    RECORD_FUNCTION("metatensor::TensorMap::load_mmap", std::vector<c10::IValue>());
+
+    return tensor_from_mmap(
+        std::make_shared<metatensor::TensorMap>(metatensor::io::load_mmap(path))
+    );
+}
+
+TorchTensorMap TensorMapHolder::load_shm(const std::string& name) {
+    RECORD_FUNCTION("metatensor::TensorMap::load_shm", std::vector<c10::IValue>());
+
+    return tensor_from_mmap(
+        std::make_shared<metatensor::TensorMap>(metatensor::io::load_shm(name))
+    );
+}
+
+void TensorMapHolder::remove_shm(const std::string& name) {
+    RECORD_FUNCTION("metatensor::TensorMap::remove_shm", std::vector<c10::IValue>());
+
+    return metatensor::io::remove_shm(name);
+}
+
+/// Convert an array loaded from a file to the given `dtype` and `device`. For
+/// CUDA devices, the conversion happens in a pinned staging buffer, and the
+/// copy to the device is asynchronous.
+static torch::Tensor loaded_array_to(
+    const torch::Tensor& array,
+    torch::Dtype dtype,
+    torch::Device device
+) {
+    if (device.is_cuda()) {
+        auto staging = torch::empty(
+            array.sizes(),
+            torch::TensorOptions().dtype(dtype).pinned_memory(true)
+        );
+        staging.copy_(array);
+        // the caching host allocator keeps the staging buffer alive until the
+        // copy is finished
+        return staging.to(device, dtype, /*non_blocking*/ true);
+    } else {
+        return array.to(device, dtype, /*non_blocking*/ false, /*copy*/ true);
+    }
+}
+
+/// Create a `TorchTensorBlock` with `dtype` and `device` from a block coming
+/// from `metatensor::io::load_mmap`.
+static TorchTensorBlock loaded_block_to(
+    TorchTensorBlock block,
+    torch::Dtype dtype,
+    torch::Device device
+) {
+    auto components = std::vector<TorchLabels>();
+    for (const auto& component: block->components()) {
+        components.emplace_back(component->to(device, /*non_blocking*/ true));
+    }
+
+    auto result = torch::make_intrusive<TensorBlockHolder>(
+        loaded_array_to(block->values(), dtype, device),
+        block->samples()->to(device, /*non_blocking*/ true),
+        std::move(components),
+        block->properties()->to(device, /*non_blocking*/ true)
+    );
+
+    for (const auto& parameter: block->gradients_list()) {
+        auto gradient = TensorBlockHolder::gradient(block, parameter);
+        result->add_gradient(parameter, loaded_block_to(gradient, dtype, device));
+    }
+
+    return result;
+}
+
+TorchTensorMap TensorMapHolder::load(
+    const std::string& path,
+    torch::optional<torch::Dtype> dtype,
+    torch::optional<torch::Device> device
+) {
+    RECORD_FUNCTION("metatensor::TensorMap::load", std::vector<c10::IValue>());
+
+    if (!dtype.has_value() && !device.has_value()) {
+        return torch::make_intrusive<TensorMapHolder>(
+            TensorMapHolder(metatensor::io::load(path, details::create_torch_array))
+        );
+    }
+
+    // go through memory mapping to avoid allocating and filling a full
+    // copy of the data before converting it. The mapped arrays use the dtype
+    // of the file, so the only conversion happens in `loaded_array_to`.
+    auto mmap = TensorMapHolder::load_mmap(path);
+    auto new_dtype = dtype.value_or(torch::kF64);
+    auto new_device = device.value_or(torch::kCPU);
+
+    auto blocks = std::vector<TorchTensorBlock>();
+    for (const auto& block: TensorMapHolder::blocks(mmap)) {
+        blocks.emplace_back(loaded_block_to(block, new_dtype, new_device));
+    }
+
+    return torch::make_intrusive<TensorMapHolder>(
+        mmap->keys()->to(new_device, /*non_blocking*/ true),
+        blocks
     );
 }
 
 TorchTensorMap TensorMapHolder::load_buffer(torch::Tensor buffer) {
+    RECORD_FUNCTION("metatensor::TensorMap::load_buffer", std::vector<c10::IValue>());
+
     if (buffer.scalar_type() != torch::kUInt8) {
         C10_THROW_ERROR(ValueError,
             "`buffer` must be a tensor of uint8, not " +
@@ -546,10 +1011,20 @@ TorchTensorMap TensorMapHolder::load_buffer(torch::Tensor buffer) {
 
 
 void TensorMapHolder::save(const std::string& path) const {
+    RECORD_FUNCTION("metatensor::TensorMap::save", std::vector<c10::IValue>());
+
     return metatensor::io::save(path, this->as_metatensor());
 }
 
+void TensorMapHolder::save_shm(const std::string& name) const {
+    RECORD_FUNCTION("metatensor::TensorMap::save_shm", std::vector<c10::IValue>());
+
+    return metatensor::io::save_shm(name, this->as_metatensor());
+}
+
 torch::Tensor TensorMapHolder::save_buffer() const {
+    RECORD_FUNCTION("metatensor::TensorMap::save_buffer", std::vector<c10::IValue>());
+
     auto buffer = metatensor::io::save_buffer(this->as_metatensor());
     // move the buffer to the heap so it can escape this function
     // `torch::from_blob` does not take ownership of the data,
@@ -62,4 +62,26 @@ TEST_CASE("Arrays") {
         CHECK((created_ptr->tensor().sizes() == std::vector<int64_t>{5, 6}));
         CHECK(created_ptr->tensor().dtype() == torch::kF64);
     }
+
+    SECTION("move samples") {
+        auto input = TorchDataArray(torch::arange(24, torch::TensorOptions().dtype(torch::kF64)).reshape({4, 3, 2}));
+        auto output = TorchDataArray(torch::zeros({3, 3, 5}, torch::TensorOptions().dtype(torch::kF64)));
+
+        auto samples = std::vector<mts_sample_mapping_t>{
+            {/*input*/ 3, /*output*/ 0},
+            {/*input*/ 1, /*output*/ 2},
+        };
+        output.move_samples_from(input, samples, 2, 4);
+
+        auto expected = torch::zeros({3, 3, 5}, torch::TensorOptions().dtype(torch::kF64));
+        expected.index_put_({0, torch::indexing::Ellipsis, torch::indexing::Slice(2, 4)}, input.tensor()[3]);
+        expected.index_put_({2, torch::indexing::Ellipsis, torch::indexing::Slice(2, 4)}, input.tensor()[1]);
+        CHECK(torch::all(output.tensor() == expected).item<bool>());
+
+        // moving all the properties at once
+        auto full = TorchDataArray(torch::zeros({2, 3, 2}, torch::TensorOptions().dtype(torch::kF64)));
+        full.move_samples_from(input, {{0, 1}, {2, 0}}, 0, 2);
+        CHECK(torch::all(full.tensor()[0] == input.tensor()[2]).item<bool>());
+        CHECK(torch::all(full.tensor()[1] == input.tensor()[0]).item<bool>());
+    }
 }
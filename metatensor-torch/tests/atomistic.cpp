@@ -15,7 +15,8 @@ TEST_CASE("Models metadata") {
     "class": "NeighborsListOptions",
     "cutoff": 4615159644819978768,
     "full_list": true,
-    "length_unit": ""
+    "length_unit": "",
+    "skin": 0
 })";
         CHECK(options->to_json() == expected);
 
@@ -28,6 +29,17 @@ TEST_CASE("Models metadata") {
         options = NeighborsListOptionsHolder::from_json(json);
         CHECK(options->cutoff() == 3.5426);
         CHECK(options->full_list() == false);
+        CHECK(options->skin() == 0.0);
+
+        // skin round-trips through JSON, and is ignored for equality
+        options->set_skin(0.25);
+        auto loaded = NeighborsListOptionsHolder::from_json(options->to_json());
+        CHECK(loaded->skin() == 0.25);
+        CHECK(loaded == torch::make_intrusive<NeighborsListOptionsHolder>(3.5426, false));
+
+        CHECK_THROWS_WITH(options->set_skin(-1.0),
+            StartsWith("the skin of a neighbors list must be a positive number or zero")
+        );
 
         CHECK_THROWS_WITH(
             NeighborsListOptionsHolder::from_json("{}"),
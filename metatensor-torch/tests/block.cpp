@@ -78,6 +78,113 @@ TEST_CASE("Blocks") {
         }
     }
 
+    SECTION("slice samples") {
+        auto values = torch::arange(8, torch::kFloat64).reshape({4, 2});
+        auto block = torch::make_intrusive<TensorBlockHolder>(
+            values,
+            LabelsHolder::create({"s"}, {{0}, {2}, {1}, {5}}),
+            std::vector<TorchLabels>{},
+            LabelsHolder::create({"p"}, {{0}, {1}})
+        );
+
+        auto gradient_values = torch::arange(8, torch::kFloat64).reshape({4, 2});
+        block->add_gradient("g", torch::make_intrusive<TensorBlockHolder>(
+            gradient_values,
+            LabelsHolder::create({"sample", "g"}, {{0, 1}, {1, 0}, {2, 1}, {3, 0}}),
+            std::vector<TorchLabels>{},
+            block->properties()
+        ));
+
+        auto slice = block->slice_samples(1, 3);
+        CHECK(*slice->samples() == metatensor::Labels({"s"}, {{2}, {1}}));
+        CHECK(slice->values().data_ptr() == values[1].data_ptr());
+        CHECK(torch::all(slice->values() == values.narrow(0, 1, 2)).item<bool>());
+
+        auto gradient = TensorBlockHolder::gradient(slice, "g");
+        CHECK(*gradient->samples() == metatensor::Labels({"sample", "g"}, {{0, 0}, {1, 1}}));
+        CHECK(gradient->values().data_ptr() == gradient_values[1].data_ptr());
+
+        auto blocks = block->split_samples({1, 1});
+        REQUIRE(blocks.size() == 3);
+        CHECK(blocks[0]->values().size(0) == 1);
+        CHECK(blocks[1]->values().size(0) == 0);
+        CHECK(blocks[2]->values().size(0) == 3);
+        CHECK(*TensorBlockHolder::gradient(blocks[2], "g")->samples() == metatensor::Labels(
+            {"sample", "g"}, {{0, 0}, {1, 1}, {2, 0}}
+        ));
+
+        CHECK_THROWS_WITH(
+            block->slice_samples(2, 5),
+            Catch::StartsWith("invalid range of samples [2, 5) for a block with 4 samples")
+        );
+    }
+
+    SECTION("memory usage") {
+        auto block = torch::make_intrusive<TensorBlockHolder>(
+            torch::zeros({3, 2}, torch::kFloat32),
+            LabelsHolder::create({"s"}, {{0}, {2}, {1}}),
+            std::vector<TorchLabels>{},
+            LabelsHolder::create({"p"}, {{0}, {1}})
+        );
+
+        block->add_gradient("g", torch::make_intrusive<TensorBlockHolder>(
+            torch::zeros({1, 2}, torch::kFloat32),
+            LabelsHolder::create({"sample", "g"}, {{0, 1}}),
+            std::vector<TorchLabels>{},
+            block->properties()
+        ));
+
+        auto usage = block->memory_usage();
+        CHECK(usage.at("values") == 3 * 2 * 4);
+        CHECK(usage.at("gradients_values") == 1 * 2 * 4);
+        CHECK(usage.at("gradients_metadata") > 0);
+
+        auto total = usage.at("total");
+        CHECK(total == usage.at("values") + usage.at("gradients_values") +
+            usage.at("labels_values") + usage.at("labels_positions") +
+            usage.at("gradients_metadata") + usage.at("metadata")
+        );
+    }
+
+    SECTION("lazy labels") {
+        // the values of lazy labels are never copied to the CPU, so we can
+        // use them on the meta device (which does not allow such copies)
+        auto samples = torch::make_intrusive<LabelsHolder>(
+            std::vector<std::string>{"s"},
+            torch::tensor({0, 2, 1}, torch::kInt32).reshape({3, 1}).to(torch::kMeta),
+            /*assume_unique*/ true
+        );
+        auto block = torch::make_intrusive<TensorBlockHolder>(
+            torch::full({3, 2}, 11.0, torch::TensorOptions().device(torch::kMeta)),
+            samples,
+            std::vector<TorchLabels>{},
+            LabelsHolder::create({"p"}, {{0}, {1}})->to(torch::kMeta)
+        );
+
+        CHECK(block->samples().get() == samples.get());
+        CHECK(block->device() == torch::kMeta);
+        CHECK(block->gradients_list().empty());
+        CHECK(samples->memory_usage().at("metadata") == 0);
+
+        CHECK(block->repr().find("samples (3): ['s']") != std::string::npos);
+        CHECK(samples->memory_usage().at("metadata") == 0);
+    }
+
+    SECTION("invalid shapes") {
+        CHECK_THROWS_WITH(
+            TensorBlockHolder(
+                torch::full({3, 2}, 11.0),
+                LabelsHolder::create({"s"}, {{0}, {2}}),
+                std::vector<TorchLabels>{},
+                LabelsHolder::create({"p"}, {{0}, {1}})
+            ),
+            Catch::StartsWith(
+                "cannot create TensorBlock: the array shape along axis 0 is 3 "
+                "but we have 2 sample labels"
+            )
+        );
+    }
+
     SECTION("different devices") {
         CHECK_THROWS_WITH(
             TensorBlockHolder(
@@ -49,6 +49,16 @@ TEST_CASE("Labels") {
 
         i = labels->position(std::vector<int64_t>{0, 4});
         CHECK_FALSE(i.has_value());
+
+        auto entries = torch::tensor({0, 1, 0, 4, 1, 1, 0, 0}, torch::kInt32).reshape({4, 2});
+        auto positions = labels->positions(entries);
+        CHECK(positions.scalar_type() == torch::kInt64);
+        CHECK(torch::all(positions == torch::tensor({2, -1, 3, 0})).item<bool>());
+
+        CHECK_THROWS_WITH(
+            labels->positions(torch::zeros({3, 3}, torch::kInt32)),
+            "entries passed to Labels::positions must have 2 columns, got 3"
+        );
     }
 
     SECTION("print") {
@@ -138,6 +148,72 @@ TEST_CASE("Labels") {
         CHECK(torch::all(std::get<2>(result) == expected).item<bool>());
     }
 
+    SECTION("set operations on device") {
+        if (!torch::cuda::is_available()) {
+            return;
+        }
+
+        auto device = torch::Device("cuda");
+        auto first = LabelsHolder::create({"aa", "bb"}, {{0, 1}, {1, 2}})->to(device);
+        auto second = LabelsHolder::create({"aa", "bb"}, {{2, 3}, {1, 2}, {4, 5}})->to(device);
+
+        auto union_ = first->union_and_mapping(second);
+        CHECK(std::get<0>(union_)->values().device() == device);
+        CHECK(std::get<1>(union_).device() == device);
+
+        auto expected = torch::tensor({0, 1, 1, 2, 2, 3, 4, 5}).reshape({4, 2});
+        CHECK(torch::all(std::get<0>(union_)->values().cpu() == expected).item<bool>());
+        CHECK(torch::all(std::get<1>(union_).cpu() == torch::tensor({0, 1})).item<bool>());
+        CHECK(torch::all(std::get<2>(union_).cpu() == torch::tensor({2, 1, 3})).item<bool>());
+
+        auto intersection = first->intersection_and_mapping(second);
+        CHECK(std::get<0>(intersection)->values().device() == device);
+
+        expected = torch::tensor({1, 2}).reshape({1, 2});
+        CHECK(torch::all(std::get<0>(intersection)->values().cpu() == expected).item<bool>());
+        CHECK(torch::all(std::get<1>(intersection).cpu() == torch::tensor({-1, 0})).item<bool>());
+        CHECK(torch::all(std::get<2>(intersection).cpu() == torch::tensor({-1, 0, -1})).item<bool>());
+
+        // the metatensor-core labels are created on demand
+        CHECK(std::get<0>(union_)->position(std::vector<int64_t>{4, 5}) == 3);
+    }
+
+    SECTION("lazy Labels with assume_unique") {
+        auto values = torch::tensor({0, 1, 1, 2}, torch::kInt32).reshape({2, 2});
+        auto labels = torch::make_intrusive<LabelsHolder>(
+            std::vector<std::string>{"aa", "bb"}, values, /*assume_unique*/ true
+        );
+
+        // the metatensor-core labels are not created yet
+        CHECK(labels->memory_usage().at("metadata") == 0);
+        CHECK(labels->count() == 2);
+
+        auto renamed = labels->rename("aa", "cc");
+        CHECK(renamed->memory_usage().at("metadata") == 0);
+
+        // and they are created on demand
+        CHECK(labels->position(std::vector<int64_t>{1, 2}) == 1);
+        CHECK(labels->memory_usage().at("metadata") != 0);
+        CHECK(renamed->as_metatensor().names()[0] == std::string("cc"));
+
+        CHECK_THROWS_WITH(
+            labels->rename("aa", "bb"),
+            "invalid parameter: labels names must be unique, got 'bb' multiple times"
+        );
+
+        // duplicated entries are detected when creating the metatensor-core
+        // labels, including for Labels derived from these
+        values = torch::tensor({0, 1, 0, 1}, torch::kInt32).reshape({2, 2});
+        labels = torch::make_intrusive<LabelsHolder>(
+            std::vector<std::string>{"aa", "bb"}, values, /*assume_unique*/ true
+        );
+        CHECK(labels->count() == 2);
+
+        auto message = Catch::Matchers::Contains("can not have the same label value multiple time");
+        CHECK_THROWS_WITH(labels->as_metatensor(), message);
+        CHECK_THROWS_WITH(labels->permute({1, 0})->as_metatensor(), message);
+    }
+
     SECTION("Labels keep the values tensor alive") {
         // see https://github.com/lab-cosmo/metatensor/issues/290 for the use case
         auto names = std::vector<std::string>{"a", "b"};
@@ -1,3 +1,5 @@
+#include <cstdio>
+
 #include <torch/torch.h>
 
 #include <metatensor.hpp>
@@ -24,6 +26,22 @@ TEST_CASE("TensorMap") {
         const auto values = block->values();
         CHECK(values[0][0][0].item<double>() == 3);
 
+        // blocks and their Labels are only created once
+        CHECK(TensorMapHolder::block_by_id(tensor, 2).get() == block.get());
+        CHECK(TensorMapHolder::blocks(tensor)[2].get() == block.get());
+        CHECK(block->samples().get() == block->samples().get());
+        CHECK(block->properties().get() == block->properties().get());
+        CHECK(tensor->keys().get() == tensor->keys().get());
+
+        // blocks keep the data alive after the TensorMap is gone
+        tensor = test_tensor_map();
+        block = TensorMapHolder::block_by_id(tensor, 2);
+        tensor.reset();
+        CHECK(block->values()[0][0][0].item<double>() == 3);
+        CHECK(block->samples()->count() == 4);
+
+        tensor = test_tensor_map();
+
         // block by selection
         auto selection = LabelsHolder::create({"key_1", "key_2"}, {{1, 0}});
         auto matching = tensor->blocks_matching(selection);
@@ -145,6 +163,17 @@ TEST_CASE("TensorMap") {
         CHECK(torch::all(block->values() == torch::full({4, 3, 1}, 4.0)).item<bool>());
     }
 
+    SECTION("join_samples") {
+        auto tensor = TensorMapHolder::join_samples({test_tensor_map(), test_tensor_map()}, "tensor");
+        CHECK(*tensor->keys() == *test_tensor_map()->keys());
+
+        auto block = TensorMapHolder::block_by_id(tensor, 0);
+        CHECK(*block->samples() == metatensor::Labels({"samples", "tensor"}, {
+            {0, 0}, {2, 0}, {4, 0}, {0, 1}, {2, 1}, {4, 1}
+        }));
+        CHECK(torch::all(block->values() == torch::full({6, 1, 1}, 1.0)).item<bool>());
+    }
+
     SECTION("component_to_properties") {
         auto tensor = test_tensor_map()->components_to_properties("component");
 
@@ -158,6 +187,61 @@ TEST_CASE("TensorMap") {
         CHECK(*block->properties() == metatensor::Labels({"component", "properties"}, {{0, 0}}));
     }
 
+    SECTION("moving to another device") {
+        auto tensor = test_tensor_map()->to(torch::nullopt, torch::kMeta, /*non_blocking*/ true);
+        CHECK(tensor->device() == torch::kMeta);
+        CHECK(tensor->keys()->device() == torch::kMeta);
+
+        auto block_1 = TensorMapHolder::block_by_id(tensor, 0);
+        auto block_2 = TensorMapHolder::block_by_id(tensor, 1);
+        auto gradient = TensorBlockHolder::gradient(block_1, "parameter");
+        CHECK(gradient->values().device() == torch::kMeta);
+
+        // labels shared between blocks are only moved once
+        auto components = block_1->components()[0]->values();
+        CHECK(components.is_same(block_2->components()[0]->values()));
+        CHECK(components.is_same(gradient->components()[0]->values()));
+        CHECK(gradient->properties()->values().is_same(block_1->properties()->values()));
+    }
+
+    SECTION("packed TensorMap") {
+        auto tensor = test_tensor_map();
+        CHECK_FALSE(tensor->packed_buffer().has_value());
+
+        auto packed = tensor->pack();
+        auto buffer = packed->packed_buffer().value();
+
+        int64_t numel = 0;
+        for (const auto& block: TensorMapHolder::blocks(tensor)) {
+            numel += block->values().numel();
+            for (const auto& [_, gradient]: TensorBlockHolder::gradients(block)) {
+                numel += gradient->values().numel();
+            }
+        }
+        CHECK(buffer.numel() == numel);
+
+        auto block = TensorMapHolder::block_by_id(packed, 0);
+        CHECK(torch::all(block->values() == 1.0).item<bool>());
+        CHECK(buffer[0].item<double>() == 1.0);
+
+        // the values of all blocks and gradients are views inside the buffer
+        buffer.fill_(42.0);
+        CHECK(torch::all(block->values() == 42.0).item<bool>());
+        auto gradient = TensorBlockHolder::gradient(TensorMapHolder::block_by_id(packed, 2), "parameter");
+        CHECK(torch::all(gradient->values() == 42.0).item<bool>());
+
+        // moving a packed TensorMap gives another packed TensorMap
+        auto moved = packed->to(torch::kF32, torch::nullopt);
+        auto moved_buffer = moved->packed_buffer().value();
+        CHECK(moved_buffer.scalar_type() == torch::kF32);
+        CHECK(moved_buffer.numel() == numel);
+
+        moved_buffer.fill_(3.0);
+        block = TensorMapHolder::block_by_id(moved, 1);
+        CHECK(torch::all(block->values() == 3.0).item<bool>());
+        CHECK(*block->samples() == *TensorMapHolder::block_by_id(tensor, 1)->samples());
+    }
+
     SECTION("different devices") {
         auto tensor = test_tensor_map();
         CHECK_THROWS_WITH(
@@ -204,6 +288,103 @@ TEST_CASE("TensorMap serialization") {
 
         CHECK(gradient->values().sizes() == std::vector<int64_t>{59, 3, 5, 3});
     }
+
+    SECTION("loading file with memory mapping") {
+        auto tensor = TensorMapHolder::load_mmap(DATA_NPZ);
+        CHECK(tensor->keys()->count() == 27);
+
+        auto block = TensorMapHolder::block_by_id(tensor, 21);
+        CHECK(block->values().sizes() == std::vector<int64_t>{9, 5, 3});
+
+        auto gradient = TensorBlockHolder::gradient(block, "positions");
+        CHECK(gradient->values().sizes() == std::vector<int64_t>{59, 3, 5, 3});
+
+        auto reference = TensorMapHolder::block_by_id(metatensor_torch::load(DATA_NPZ), 21);
+        CHECK(torch::all(block->values() == reference->values()).item<bool>());
+    }
+
+    SECTION("loading file with a different dtype") {
+        auto tensor = metatensor_torch::load(DATA_NPZ, torch::kF32);
+        CHECK(tensor->keys()->count() == 27);
+
+        auto block = TensorMapHolder::block_by_id(tensor, 21);
+        CHECK(block->values().scalar_type() == torch::kF32);
+
+        auto gradient = TensorBlockHolder::gradient(block, "positions");
+        CHECK(gradient->values().scalar_type() == torch::kF32);
+        CHECK(gradient->values().sizes() == std::vector<int64_t>{59, 3, 5, 3});
+
+        auto reference = TensorMapHolder::block_by_id(metatensor_torch::load(DATA_NPZ), 21);
+        CHECK(torch::all(block->values() == reference->values().to(torch::kF32)).item<bool>());
+    }
+
+    SECTION("saving and loading float32 data") {
+        auto tensor = metatensor_torch::load(DATA_NPZ)->to(torch::kF32);
+        auto buffer = tensor->save_buffer();
+
+        auto loaded = TensorMapHolder::load_buffer(buffer);
+        CHECK(loaded->keys()->count() == 27);
+
+        auto block = TensorMapHolder::block_by_id(loaded, 21);
+        CHECK(block->values().scalar_type() == torch::kF32);
+
+        auto reference = TensorMapHolder::block_by_id(tensor, 21);
+        CHECK(torch::all(block->values() == reference->values()).item<bool>());
+
+        auto gradient = TensorBlockHolder::gradient(block, "positions");
+        CHECK(gradient->values().scalar_type() == torch::kF32);
+    }
+
+    SECTION("writing blocks one at a time") {
+        auto tensor = metatensor_torch::load(DATA_NPZ);
+        auto keys = tensor->keys();
+
+        auto path = std::string("torch-test-writer.npz");
+        auto writer = torch::make_intrusive<TensorMapWriterHolder>(path, keys->names());
+        for (int64_t i=0; i<keys->count(); i++) {
+            auto key = keys->values()[i];
+            auto values = std::vector<int64_t>(
+                key.data_ptr<int32_t>(),
+                key.data_ptr<int32_t>() + key.size(0)
+            );
+            writer->add_block(values, TensorMapHolder::block_by_id(tensor, i));
+        }
+        writer->finish();
+
+        auto loaded = metatensor_torch::load(path);
+        CHECK(*loaded->keys() == *keys);
+
+        auto block = TensorMapHolder::block_by_id(loaded, 21);
+        auto reference = TensorMapHolder::block_by_id(tensor, 21);
+        CHECK(torch::all(block->values() == reference->values()).item<bool>());
+
+        // write a block in chunks of samples
+        writer = torch::make_intrusive<TensorMapWriterHolder>(path, std::vector<std::string>{"key"});
+        writer->begin_block({0}, {3, 2});
+        auto properties = LabelsHolder::create({"properties"}, {{0}, {1}});
+        writer->add_samples(torch::make_intrusive<TensorBlockHolder>(
+            torch::full({2, 2}, 1.0),
+            LabelsHolder::create({"samples"}, {{0}, {1}}),
+            std::vector<TorchLabels>{},
+            properties
+        ));
+        writer->add_samples(torch::make_intrusive<TensorBlockHolder>(
+            torch::full({1, 2}, 2.0),
+            LabelsHolder::create({"samples"}, {{2}}),
+            std::vector<TorchLabels>{},
+            properties
+        ));
+        writer->end_block();
+        writer->finish();
+
+        loaded = metatensor_torch::load(path);
+        block = TensorMapHolder::block_by_id(loaded, 0);
+        CHECK(*block->samples() == *LabelsHolder::create({"samples"}, {{0}, {1}, {2}}));
+        auto expected = torch::tensor({1.0, 1.0, 1.0, 1.0, 2.0, 2.0}, torch::kF64).reshape({3, 2});
+        CHECK(torch::all(block->values() == expected).item<bool>());
+
+        std::remove(path.c_str());
+    }
 }
 
 
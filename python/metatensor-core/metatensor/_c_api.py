@@ -26,6 +26,13 @@ MTS_IO_ERROR = 2
 MTS_SERIALIZATION_ERROR = 3
 MTS_BUFFER_SIZE_ERROR = 254
 MTS_INTERNAL_ERROR = 255
+MTS_DTYPE_F64 = 1
+MTS_DTYPE_F32 = 2
+MTS_DTYPE_F16 = 3
+MTS_DTYPE_BF16 = 4
+MTS_COMPRESSION_NONE = 0
+MTS_COMPRESSION_DEFLATE = 1
+MTS_COMPRESSION_ZSTD = 2
 
 
 mts_status_t = ctypes.c_int32
@@ -41,6 +48,10 @@ class mts_tensormap_t(ctypes.Structure):
     pass
 
 
+class mts_tensormap_writer_t(ctypes.Structure):
+    pass
+
+
 class mts_labels_t(ctypes.Structure):
     pass
 
@@ -76,10 +87,26 @@ mts_array_t._fields_ = [
     ("copy", CFUNCTYPE(mts_status_t, ctypes.c_void_p, POINTER(mts_array_t))),
     ("destroy", CFUNCTYPE(None, ctypes.c_void_p)),
     ("move_samples_from", CFUNCTYPE(mts_status_t, ctypes.c_void_p, ctypes.c_void_p, POINTER(mts_sample_mapping_t), c_uintptr_t, c_uintptr_t, c_uintptr_t)),
+    ("typed_data", CFUNCTYPE(mts_status_t, ctypes.c_void_p, POINTER(ctypes.c_void_p), POINTER(ctypes.c_int32))),
+    ("create_typed", CFUNCTYPE(mts_status_t, ctypes.c_void_p, POINTER(c_uintptr_t), c_uintptr_t, ctypes.c_int32, POINTER(mts_array_t))),
+]
+
+
+class mts_memory_usage_t(ctypes.Structure):
+    pass
+
+mts_memory_usage_t._fields_ = [
+    ("values", c_uintptr_t),
+    ("gradients_values", c_uintptr_t),
+    ("labels_values", c_uintptr_t),
+    ("labels_positions", c_uintptr_t),
+    ("gradients_metadata", c_uintptr_t),
+    ("metadata", c_uintptr_t),
 ]
 
 
 mts_create_array_callback_t = CFUNCTYPE(mts_status_t, POINTER(c_uintptr_t), c_uintptr_t, POINTER(mts_array_t))
+mts_profiling_callback_t = CFUNCTYPE(None, ctypes.c_char_p, ctypes.c_bool)
 
 
 def setup_functions(lib):
@@ -93,10 +120,24 @@ def setup_functions(lib):
     ]
     lib.mts_version.restype = ctypes.c_char_p
 
+    lib.mts_set_max_threads.argtypes = [
+        c_uintptr_t
+    ]
+    lib.mts_set_max_threads.restype = None
+
+    lib.mts_get_max_threads.argtypes = [
+    ]
+    lib.mts_get_max_threads.restype = c_uintptr_t
+
     lib.mts_last_error.argtypes = [
     ]
     lib.mts_last_error.restype = ctypes.c_char_p
 
+    lib.mts_set_profiling_callback.argtypes = [
+        mts_profiling_callback_t
+    ]
+    lib.mts_set_profiling_callback.restype = None
+
     lib.mts_labels_position.argtypes = [
         mts_labels_t,
         POINTER(ctypes.c_int32),
@@ -105,11 +146,25 @@ def setup_functions(lib):
     ]
     lib.mts_labels_position.restype = _check_status
 
+    lib.mts_labels_positions.argtypes = [
+        mts_labels_t,
+        POINTER(ctypes.c_int32),
+        c_uintptr_t,
+        POINTER(ctypes.c_int64),
+        c_uintptr_t,
+    ]
+    lib.mts_labels_positions.restype = _check_status
+
     lib.mts_labels_create.argtypes = [
         POINTER(mts_labels_t),
     ]
     lib.mts_labels_create.restype = _check_status
 
+    lib.mts_labels_create_assume_unique.argtypes = [
+        POINTER(mts_labels_t),
+    ]
+    lib.mts_labels_create_assume_unique.restype = _check_status
+
     lib.mts_labels_set_user_data.argtypes = [
         mts_labels_t,
         ctypes.c_void_p,
@@ -151,6 +206,12 @@ def setup_functions(lib):
     ]
     lib.mts_labels_intersection.restype = _check_status
 
+    lib.mts_labels_memory_usage.argtypes = [
+        mts_labels_t,
+        POINTER(mts_memory_usage_t),
+    ]
+    lib.mts_labels_memory_usage.restype = _check_status
+
     lib.mts_labels_free.argtypes = [
         POINTER(mts_labels_t),
     ]
@@ -188,6 +249,13 @@ def setup_functions(lib):
     ]
     lib.mts_block_copy.restype = POINTER(mts_block_t)
 
+    lib.mts_block_slice_samples.argtypes = [
+        POINTER(mts_block_t),
+        c_uintptr_t,
+        c_uintptr_t,
+    ]
+    lib.mts_block_slice_samples.restype = POINTER(mts_block_t)
+
     lib.mts_block_labels.argtypes = [
         POINTER(mts_block_t),
         c_uintptr_t,
@@ -222,6 +290,12 @@ def setup_functions(lib):
     ]
     lib.mts_block_gradients_list.restype = _check_status
 
+    lib.mts_block_memory_usage.argtypes = [
+        POINTER(mts_block_t),
+        POINTER(mts_memory_usage_t),
+    ]
+    lib.mts_block_memory_usage.restype = _check_status
+
     lib.mts_tensormap.argtypes = [
         mts_labels_t,
         POINTER(POINTER(mts_block_t)),
@@ -260,6 +334,14 @@ def setup_functions(lib):
     ]
     lib.mts_tensormap_blocks_matching.restype = _check_status
 
+    lib.mts_tensormap_blocks_matching_many.argtypes = [
+        POINTER(mts_tensormap_t),
+        POINTER(ctypes.c_int64),
+        c_uintptr_t,
+        mts_labels_t,
+    ]
+    lib.mts_tensormap_blocks_matching_many.restype = _check_status
+
     lib.mts_tensormap_keys_to_properties.argtypes = [
         POINTER(mts_tensormap_t),
         mts_labels_t,
@@ -281,6 +363,19 @@ def setup_functions(lib):
     ]
     lib.mts_tensormap_keys_to_samples.restype = POINTER(mts_tensormap_t)
 
+    lib.mts_tensormap_join_samples.argtypes = [
+        POINTER(POINTER(mts_tensormap_t)),
+        c_uintptr_t,
+        ctypes.c_char_p,
+    ]
+    lib.mts_tensormap_join_samples.restype = POINTER(mts_tensormap_t)
+
+    lib.mts_tensormap_memory_usage.argtypes = [
+        POINTER(mts_tensormap_t),
+        POINTER(mts_memory_usage_t),
+    ]
+    lib.mts_tensormap_memory_usage.restype = _check_status
+
     lib.mts_labels_load.argtypes = [
         ctypes.c_char_p,
         POINTER(mts_labels_t),
@@ -315,6 +410,30 @@ def setup_functions(lib):
     ]
     lib.mts_tensormap_load.restype = POINTER(mts_tensormap_t)
 
+    lib.mts_tensormap_load_selection.argtypes = [
+        ctypes.c_char_p,
+        mts_labels_t,
+        mts_create_array_callback_t,
+    ]
+    lib.mts_tensormap_load_selection.restype = POINTER(mts_tensormap_t)
+
+    lib.mts_tensormap_load_parallel.argtypes = [
+        ctypes.c_char_p,
+        c_uintptr_t,
+        mts_create_array_callback_t,
+    ]
+    lib.mts_tensormap_load_parallel.restype = POINTER(mts_tensormap_t)
+
+    lib.mts_tensormap_load_mmap.argtypes = [
+        ctypes.c_char_p,
+    ]
+    lib.mts_tensormap_load_mmap.restype = POINTER(mts_tensormap_t)
+
+    lib.mts_tensormap_load_shm.argtypes = [
+        ctypes.c_char_p,
+    ]
+    lib.mts_tensormap_load_shm.restype = POINTER(mts_tensormap_t)
+
     lib.mts_tensormap_load_buffer.argtypes = [
         ctypes.c_char_p,
         c_uintptr_t,
@@ -328,6 +447,26 @@ def setup_functions(lib):
     ]
     lib.mts_tensormap_save.restype = _check_status
 
+    lib.mts_tensormap_save_compressed.argtypes = [
+        ctypes.c_char_p,
+        POINTER(mts_tensormap_t),
+        ctypes.c_int32,
+        ctypes.c_int32,
+        c_uintptr_t,
+    ]
+    lib.mts_tensormap_save_compressed.restype = _check_status
+
+    lib.mts_tensormap_save_shm.argtypes = [
+        ctypes.c_char_p,
+        POINTER(mts_tensormap_t),
+    ]
+    lib.mts_tensormap_save_shm.restype = _check_status
+
+    lib.mts_tensormap_remove_shm.argtypes = [
+        ctypes.c_char_p,
+    ]
+    lib.mts_tensormap_remove_shm.restype = _check_status
+
     lib.mts_tensormap_save_buffer.argtypes = [
         POINTER(ctypes.c_char_p),
         POINTER(c_uintptr_t),
@@ -336,3 +475,48 @@ def setup_functions(lib):
         POINTER(mts_tensormap_t),
     ]
     lib.mts_tensormap_save_buffer.restype = _check_status
+
+    lib.mts_tensormap_writer.argtypes = [
+        ctypes.c_char_p,
+        POINTER(ctypes.c_char_p),
+        c_uintptr_t,
+    ]
+    lib.mts_tensormap_writer.restype = POINTER(mts_tensormap_writer_t)
+
+    lib.mts_tensormap_writer_add_block.argtypes = [
+        POINTER(mts_tensormap_writer_t),
+        POINTER(ctypes.c_int32),
+        c_uintptr_t,
+        POINTER(mts_block_t),
+    ]
+    lib.mts_tensormap_writer_add_block.restype = _check_status
+
+    lib.mts_tensormap_writer_begin_block.argtypes = [
+        POINTER(mts_tensormap_writer_t),
+        POINTER(ctypes.c_int32),
+        c_uintptr_t,
+        POINTER(c_uintptr_t),
+        c_uintptr_t,
+    ]
+    lib.mts_tensormap_writer_begin_block.restype = _check_status
+
+    lib.mts_tensormap_writer_add_samples.argtypes = [
+        POINTER(mts_tensormap_writer_t),
+        POINTER(mts_block_t),
+    ]
+    lib.mts_tensormap_writer_add_samples.restype = _check_status
+
+    lib.mts_tensormap_writer_end_block.argtypes = [
+        POINTER(mts_tensormap_writer_t),
+    ]
+    lib.mts_tensormap_writer_end_block.restype = _check_status
+
+    lib.mts_tensormap_writer_finish.argtypes = [
+        POINTER(mts_tensormap_writer_t),
+    ]
+    lib.mts_tensormap_writer_finish.restype = _check_status
+
+    lib.mts_tensormap_writer_free.argtypes = [
+        POINTER(mts_tensormap_writer_t),
+    ]
+    lib.mts_tensormap_writer_free.restype = _check_status
@@ -3,7 +3,15 @@ from typing import Union
 
 import numpy as np
 
-from .._c_api import c_uintptr_t, mts_array_t, mts_data_origin_t
+from .._c_api import (
+    MTS_DTYPE_BF16,
+    MTS_DTYPE_F16,
+    MTS_DTYPE_F32,
+    MTS_DTYPE_F64,
+    c_uintptr_t,
+    mts_array_t,
+    mts_data_origin_t,
+)
 from ..utils import catch_exceptions
 
 
@@ -198,6 +206,11 @@ class ArrayWrapper:
             _mts_array_move_samples_from
         )
 
+        mts_array.typed_data = mts_array.typed_data.__class__(_mts_array_typed_data)
+        mts_array.create_typed = mts_array.create_typed.__class__(
+            _mts_array_create_typed
+        )
+
         self._mts_array = mts_array
 
     def into_mts_array(self):
@@ -253,6 +266,81 @@ def _mts_array_data(this, data):
     data[0] = array.ctypes.data_as(ctypes.POINTER(ctypes.c_double))
 
 
+_NUMPY_DTYPES = {
+    np.dtype(np.float64): MTS_DTYPE_F64,
+    np.dtype(np.float32): MTS_DTYPE_F32,
+    np.dtype(np.float16): MTS_DTYPE_F16,
+}
+
+if HAS_TORCH:
+    _TORCH_DTYPES = {
+        torch.float64: MTS_DTYPE_F64,
+        torch.float32: MTS_DTYPE_F32,
+        torch.float16: MTS_DTYPE_F16,
+        torch.bfloat16: MTS_DTYPE_BF16,
+    }
+
+
+@catch_exceptions
+def _mts_array_typed_data(this, data, dtype):
+    array = _object_from_ptr(this).array
+
+    if _is_numpy_array(array):
+        if not array.data.c_contiguous:
+            raise ValueError("can not get data pointer for non contiguous array")
+
+        if array.dtype not in _NUMPY_DTYPES:
+            raise ValueError(f"can not get data pointer for array type {array.dtype}")
+
+        dtype[0] = _NUMPY_DTYPES[array.dtype]
+        data[0] = array.ctypes.data
+
+    elif _is_torch_array(array):
+        if array.device.type != "cpu":
+            raise ValueError("can only get data pointer for tensors on CPU")
+
+        if not array.is_contiguous():
+            raise ValueError("can not get data pointer for non contiguous tensor")
+
+        if array.dtype not in _TORCH_DTYPES:
+            raise ValueError(f"can not get data pointer for tensor type {array.dtype}")
+
+        dtype[0] = _TORCH_DTYPES[array.dtype]
+        data[0] = array.data_ptr()
+
+
+@catch_exceptions
+def _mts_array_create_typed(this, shape_ptr, shape_count, dtype, new_array):
+    wrapper = _object_from_ptr(this)
+
+    shape = []
+    for i in range(shape_count):
+        shape.append(shape_ptr[i])
+
+    if _is_numpy_array(wrapper.array):
+        for np_dtype, mts_dtype in _NUMPY_DTYPES.items():
+            if mts_dtype == dtype:
+                array = np.zeros(shape, dtype=np_dtype)
+                break
+        else:
+            # unsupported dtype, leave `new_array` untouched
+            return
+
+    elif _is_torch_array(wrapper.array):
+        for torch_dtype, mts_dtype in _TORCH_DTYPES.items():
+            if mts_dtype == dtype:
+                array = torch.zeros(
+                    shape, dtype=torch_dtype, device=wrapper.array.device
+                )
+                break
+        else:
+            # unsupported dtype, leave `new_array` untouched
+            return
+
+    new_wrapper = ArrayWrapper(array)
+    new_array[0] = new_wrapper.into_mts_array()
+
+
 @catch_exceptions
 def _mts_array_shape(this, shape_ptr, shape_count):
     wrapper = _object_from_ptr(this)
@@ -332,11 +420,29 @@ def _mts_array_move_samples_from(
     output = _object_from_ptr(this).array
     input = _object_from_ptr(input).array
 
+    if samples_count == 0:
+        return
+
     input_samples = []
     output_samples = []
+    contiguous = True
     for i in range(samples_count):
-        input_samples.append(samples_ptr[i].input)
-        output_samples.append(samples_ptr[i].output)
+        sample = samples_ptr[i]
+        input_samples.append(sample.input)
+        output_samples.append(sample.output)
+
+        if contiguous and i != 0:
+            if (
+                sample.input != input_samples[0] + i
+                or sample.output != output_samples[0] + i
+            ):
+                contiguous = False
+
+    if contiguous:
+        # the samples are moved as a contiguous range, use slices instead of
+        # integer indexing, which is faster and does not create a temporary copy
+        input_samples = slice(input_samples[0], input_samples[0] + samples_count)
+        output_samples = slice(output_samples[0], output_samples[0] + samples_count)
 
     properties = slice(property_start, property_end)
     output[output_samples, ..., properties] = input[input_samples, ..., :]
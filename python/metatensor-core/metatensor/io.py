@@ -69,8 +69,9 @@ def save(
     :param data: data to serialize and save
     :param use_numpy: should we use numpy or the native serializer implementation? Numpy
         should be able to process more dtypes than the native implementation, which is
-        limited to float64, but the native implementation is usually faster than going
-        through numpy. This is ignored when saving :py:class:`Labels`.
+        limited to float64, float32 and float16 (bfloat16 torch tensors are saved as
+        float32), but the native implementation is usually faster than going through
+        numpy. This is ignored when saving :py:class:`Labels`.
     """
     if isinstance(data, Labels):
         return _save_labels(file=file, labels=data)
@@ -121,8 +122,8 @@ def load(file: Union[str, pathlib.Path, BinaryIO], use_numpy=False) -> TensorMap
         opened in binary mode.
     :param use_numpy: should we use numpy or the native implementation? Numpy should be
         able to process more dtypes than the native implementation, which is limited to
-        float64, but the native implementation is usually faster than going through
-        numpy.
+        float64, float32 and float16, but the native implementation is usually faster
+        than going through numpy.
     """
     if use_numpy:
         return _read_npz(file)
@@ -554,6 +554,11 @@ class TensorMap:
         Move the given ``dimensions`` from the component labels to the property labels
         for each block.
 
+        ``dimensions`` can contain the names of a single component, or all the names
+        of multiple components. In the latter case, all the components are moved at
+        once, and the new properties contain the components in the order in which they
+        appear in ``dimensions``, followed by the old properties.
+
         :param dimensions: name of the component dimensions to move to the properties
         """
         c_dimensions = _list_or_str_to_array_c_char(dimensions)
@@ -596,8 +601,11 @@ class TensorMap:
         sample) for a given property in the merged block, then the value will be set to
         zero.
 
-        When using a non empty :py:class:`Labels` for ``keys_to_move``, the properties
-        labels of all the merged blocks must take the same values.
+        When using a non empty :py:class:`Labels` for ``keys_to_move`` with merged
+        blocks having different properties labels, each entry of ``keys_to_move`` is
+        followed by the properties of the block with this entry in its key. Entries
+        without such block use the properties of the blocks with this entry in the
+        other groups of merged blocks, which must then all be the same.
 
         The order of the samples in the merged blocks is controlled by ``sort_samples``.
         If ``sort_samples`` is :py:obj:`True`, samples are re-ordered to keep them
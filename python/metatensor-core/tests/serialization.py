@@ -142,6 +142,29 @@ def test_save_load_zero_length_block(
         metatensor.load(file, use_numpy=use_numpy_load)
 
 
+@pytest.mark.parametrize("dtype", (np.float32, np.float16))
+def test_save_load_dtype(dtype, tmpdir, tensor):
+    tensor = tensor.to(dtype=dtype)
+    file = "serialize-test-dtype.npz"
+
+    with tmpdir.as_cwd():
+        metatensor.save(file, tensor)
+
+        data = np.load(file)
+        assert data["blocks/0/values"].dtype == dtype
+
+        loaded = metatensor.load(file)
+
+    for block, loaded_block in zip(tensor.blocks(), loaded.blocks()):
+        assert loaded_block.values.dtype == dtype
+        np.testing.assert_equal(loaded_block.values, block.values)
+
+        for parameter, gradient in block.gradients():
+            loaded_gradient = loaded_block.gradient(parameter)
+            assert loaded_gradient.values.dtype == dtype
+            np.testing.assert_equal(loaded_gradient.values, gradient.values)
+
+
 def test_save_warning_errors(tmpdir, tensor):
     # does not have .npz ending and causes warning
     tmpfile = "serialize-test"
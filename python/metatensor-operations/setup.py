@@ -132,7 +132,7 @@ if __name__ == "__main__":
         install_requires.append(f"metatensor-core @ file://{METATENSOR_CORE}?{uuid}")
     else:
         # we are building from a sdist/installing from a wheel
-        install_requires.append("metatensor-core >=0.1.0,<0.2.0")
+        install_requires.append("metatensor-core >=0.2.0,<0.3.0")
 
     setup(
         version=create_version_number(METATENSOR_OPERATIONS_VERSION),
@@ -9,7 +9,7 @@ from . import utils  # noqa: F401
 if os.environ.get("METATENSOR_IMPORT_FOR_SPHINX", "0") != "0":
     from .documentation import Labels, LabelsEntry, TensorBlock, TensorMap
     from .documentation import load, load_labels, load_labels_buffer, load_buffer
-    from .documentation import save, save_buffer
+    from .documentation import save, save_buffer, TensorMapWriter
     from .documentation import version, dtype_name
 else:
     _load_library()
@@ -27,6 +27,7 @@ else:
     load_labels_buffer = torch.ops.metatensor.load_labels_buffer
     save = torch.ops.metatensor.save
     save_buffer = torch.ops.metatensor.save_buffer
+    TensorMapWriter = torch.classes.metatensor.TensorMapWriter
 
     try:
         import metatensor.operations  # noqa: F401
@@ -14,6 +14,7 @@ if os.environ.get("METATENSOR_IMPORT_FOR_SPHINX", "0") != "0":
         check_atomistic_model,
         load_model_extensions,
         register_autograd_neighbors,
+        split_outputs_per_system,
         unit_conversion_factor,
     )
 
@@ -31,7 +32,9 @@ else:
 
     register_autograd_neighbors = torch.ops.metatensor.register_autograd_neighbors
     unit_conversion_factor = torch.ops.metatensor.unit_conversion_factor
+    split_outputs_per_system = torch.ops.metatensor.split_outputs_per_system
 
 from .model import MetatensorAtomisticModel, ModelInterface  # noqa: F401
 from .model import load_atomistic_model  # noqa: F401
+from .cuda_graphs import CUDAGraphModel  # noqa: F401
 from .systems_to_torch import systems_to_torch  # noqa: F401
@@ -0,0 +1,239 @@
+import warnings
+from typing import Dict, List, Optional
+
+import torch
+
+from .. import TensorBlock, TensorMap
+from . import MetatensorAtomisticModel, ModelEvaluationOptions, System
+
+
+class CUDAGraphModel:
+    """
+    Evaluate a :py:class:`MetatensorAtomisticModel` by capturing its execution in a
+    CUDA graph, and then replaying the graph as long as the topology of the systems
+    does not change.
+
+    For small systems, the time required to launch all the kernels of a model can be
+    larger than the time spent doing the actual calculations. Replaying a CUDA graph
+    launches all the kernels with a single call, removing most of this overhead.
+
+    The graph is captured for a given topology: number of systems, types of the
+    atoms, neighbors lists options and pairs, and custom data metadata. When calling
+    this class with systems using the same topology as the captured graph, the
+    positions, cell, neighbors lists distances and custom data values are copied in
+    the static input buffers of the graph, and the graph is replayed. Otherwise, the
+    graph is captured again for the new topology.
+
+    The model is evaluated eagerly instead of using CUDA graphs if the systems are
+    not on a CUDA device, if the positions or cell of the systems require gradients,
+    or if capturing the graph failed for the current topology (for example because
+    the model synchronizes with the CPU in the middle of the calculation). In the
+    latter case, the capture is attempted again when the topology changes.
+
+    Creating :py:class:`Labels` on a CUDA device requires copies between the CPU and
+    the GPU, which are not allowed while capturing a graph. To be captured, models
+    should re-use :py:class:`Labels` created before the capture for their outputs.
+
+    .. warning::
+
+        When replaying a graph, the outputs are stored in the static output buffers
+        of the graph, which are overwritten by the next call. Make a copy of the
+        outputs if you need to keep them around.
+
+    :param model: model to evaluate
+    :param options: options to use for all evaluations of the model
+    :param warmup: number of evaluations of the model to run before capturing the
+        graph
+    """
+
+    def __init__(
+        self,
+        model: MetatensorAtomisticModel,
+        options: ModelEvaluationOptions,
+        warmup: int = 3,
+    ):
+        self._model = model
+        self._options = options
+        self._warmup = warmup
+
+        self._graph: Optional[torch.cuda.CUDAGraph] = None
+        # did the capture fail for the topology of `self._static_systems`?
+        self._capture_failed = False
+        self._static_systems: List[System] = []
+        self._static_outputs: Dict[str, TensorMap] = {}
+
+    def __call__(
+        self,
+        systems: List[System],
+        check_consistency: bool = False,
+    ) -> Dict[str, TensorMap]:
+        """
+        Run the model on the given ``systems``, replaying the captured CUDA graph if
+        possible.
+
+        :param systems: input systems for the model, containing all the neighbors
+            lists requested by the model
+        :param check_consistency: should we run additional checks on the inputs and
+            outputs? This is only used when evaluating the model eagerly
+        """
+        if not self._use_graphs(systems):
+            return self._model(systems, self._options, check_consistency)
+
+        same_topology = self._same_topology(systems)
+        if self._graph is not None and same_topology:
+            self._copy_inputs(systems)
+            self._graph.replay()
+            return self._static_outputs
+
+        if self._capture_failed and same_topology:
+            return self._model(systems, self._options, check_consistency)
+
+        try:
+            self._capture(systems)
+        except RuntimeError as e:
+            warnings.warn(
+                f"failed to capture a CUDA graph for this model ({e}), "
+                "falling back to eager execution",
+                stacklevel=2,
+            )
+            # keep the static systems around to remember which topology failed
+            self._capture_failed = True
+            self._graph = None
+            self._static_outputs = {}
+            return self._model(systems, self._options, check_consistency)
+
+        self._capture_failed = False
+        self._graph.replay()
+        return self._static_outputs
+
+    def _use_graphs(self, systems: List[System]) -> bool:
+        if len(systems) == 0:
+            return False
+
+        for system in systems:
+            if system.device.type != "cuda":
+                return False
+
+            if system.positions.requires_grad or system.cell.requires_grad:
+                return False
+
+        return True
+
+    def _same_topology(self, systems: List[System]) -> bool:
+        if len(systems) != len(self._static_systems):
+            return False
+
+        for system, static in zip(systems, self._static_systems):
+            if system.device != static.device or system.dtype != static.dtype:
+                return False
+
+            if len(system) != len(static):
+                return False
+
+            if not torch.equal(system.types, static.types):
+                return False
+
+            options = system.known_neighbors_lists()
+            if options != static.known_neighbors_lists():
+                return False
+
+            for nl_options in options:
+                neighbors = system.get_neighbors_list(nl_options)
+                static_neighbors = static.get_neighbors_list(nl_options)
+                if not _same_metadata(neighbors, static_neighbors):
+                    return False
+
+            names = system.known_data()
+            if sorted(names) != sorted(static.known_data()):
+                return False
+
+            for name in names:
+                if not _same_metadata(system.get_data(name), static.get_data(name)):
+                    return False
+
+        return True
+
+    def _copy_inputs(self, systems: List[System]):
+        with torch.no_grad():
+            for system, static in zip(systems, self._static_systems):
+                static.update_positions(system.positions)
+                static.update_cell(system.cell)
+
+                for options in system.known_neighbors_lists():
+                    values = static.get_neighbors_list(options).values
+                    values.copy_(system.get_neighbors_list(options).values)
+
+                for name in system.known_data():
+                    values = static.get_data(name).values
+                    values.copy_(system.get_data(name).values)
+
+    def _capture(self, systems: List[System]):
+        # release the previous graph before allocating a new one
+        self._graph = None
+        self._static_outputs = {}
+        self._static_systems = [_static_copy(system) for system in systems]
+
+        stream = torch.cuda.Stream()
+        stream.wait_stream(torch.cuda.current_stream())
+        with torch.cuda.stream(stream):
+            for _ in range(self._warmup):
+                self._model(self._static_systems, self._options, False)
+        torch.cuda.current_stream().wait_stream(stream)
+
+        graph = torch.cuda.CUDAGraph()
+        with torch.cuda.graph(graph):
+            outputs = self._model(self._static_systems, self._options, False)
+
+        self._graph = graph
+        self._static_outputs = outputs
+
+
+def _same_metadata(block: TensorBlock, static: TensorBlock) -> bool:
+    """
+    Check if ``block`` has the same metadata as ``static``, in which case the values of
+    ``block`` can be copied inside the values of ``static``.
+    """
+    if block.values.shape != static.values.shape:
+        return False
+
+    if block.values.dtype != static.values.dtype:
+        return False
+
+    if len(block.gradients_list()) != 0:
+        return False
+
+    return (
+        block.samples == static.samples
+        and block.components == static.components
+        and block.properties == static.properties
+    )
+
+
+def _static_copy(system: System) -> System:
+    """
+    Create a copy of ``system`` with newly allocated buffers, to be used as the static
+    inputs of a CUDA graph
+    """
+    static = System(
+        types=system.types.clone(),
+        positions=system.positions.clone(),
+        cell=system.cell.clone(),
+    )
+
+    for options in system.known_neighbors_lists():
+        neighbors = _static_block(system.get_neighbors_list(options))
+        static.add_neighbors_list(options, neighbors)
+
+    for name in system.known_data():
+        static.add_data(name, _static_block(system.get_data(name)))
+
+    return static
+
+
+def _static_block(block: TensorBlock) -> TensorBlock:
+    return TensorBlock(
+        values=block.values.clone(),
+        samples=block.samples,
+        components=block.components,
+        properties=block.properties,
+    )
@@ -2,7 +2,7 @@ from typing import Dict, List, Optional
 
 import torch
 
-from ..documentation import Labels, TensorBlock
+from ..documentation import Labels, TensorBlock, TensorMap
 
 
 class System:
@@ -64,6 +64,30 @@ class System:
     def cell(self) -> torch.Tensor:
         """Tensor of floating point values containing bounding box/cell of the system"""
 
+    def update_positions(self, positions: torch.Tensor):
+        """
+        Update the positions of this system in-place, copying the data from
+        ``positions`` inside the existing :py:attr:`positions` tensor.
+
+        This is intended for simulation engines re-using the same :py:class:`System`
+        for all the steps of a simulation. If ``positions`` have the same shape, dtype
+        and device as the existing positions, and neither of them requires gradients,
+        the data is copied without any validation or new allocation; otherwise this is
+        equivalent to setting :py:attr:`positions`, keeping the gradients flowing to
+        the new tensor.
+
+        :param positions: new positions of the particles in the system
+        """
+
+    def update_cell(self, cell: torch.Tensor):
+        """
+        Update the cell of this system in-place, copying the data from ``cell`` inside
+        the existing :py:attr:`cell` tensor. See :py:meth:`update_positions` for more
+        information.
+
+        :param cell: new cell of the system
+        """
+
     @property
     def device(self) -> torch.device:
         """get the device of all the arrays stored inside this :py:class:`System`"""
@@ -119,6 +143,67 @@ class System:
         :param neighbors: list of neighbors stored in a :py:class:`TensorBlock`
         """
 
+    def update_neighbors_list(
+        self,
+        options: "NeighborsListOptions",
+        values: torch.Tensor,
+        samples: Optional[Labels] = None,
+    ):
+        """
+        Replace the distance vectors of the existing neighbors list corresponding to
+        ``options`` with ``values``, without validating the metadata again.
+
+        The components and properties :py:class:`Labels` of the existing neighbors
+        list are re-used. If ``samples`` is ``None``, the set of pairs is assumed to be
+        unchanged and the existing samples are re-used as well.
+
+        As for :py:meth:`add_neighbors_list`, the new values should be registered with
+        :py:func:`register_autograd_neighbors` (using :py:meth:`get_neighbors_list`)
+        if gradients with respect to the positions or cell are required.
+
+        :param options: options of an existing neighbors list in this system
+        :param values: new distance vectors, with shape ``(len(samples), 3, 1)``
+        :param samples: new set of pairs for this neighbors list, using the same names
+            as in :py:meth:`add_neighbors_list`
+        """
+
+    def compute_neighbors_lists(
+        self,
+        options: List["NeighborsListOptions"],
+        length_unit: str = "",
+        previous: Optional["System"] = None,
+    ):
+        """
+        Compute the neighbors lists corresponding to all the given ``options`` with a
+        built-in cell list, and add them to this system.
+
+        A single neighbors list is computed with the largest cutoff, and all the other
+        lists are extracted from it. The calculation runs on the same device as the
+        system, and the resulting neighbors are registered with
+        :py:func:`register_autograd_neighbors`, so gradients with respect to the
+        positions and cell flow through them.
+
+        Systems with a cell full of zeros are treated as non-periodic, all other systems
+        are periodic in all three directions.
+
+        When running molecular dynamics, the pairs can be re-used between successive
+        steps by setting a Verlet :py:attr:`NeighborsListOptions.skin` and passing the
+        system from the previous step as ``previous``. The pairs are then only
+        searched again once an atom moved more than half of the skin, or if the cell
+        changed; otherwise only the distance vectors are re-computed.
+
+        Neighbors lists already present in this system are updated with
+        :py:meth:`update_neighbors_list` instead of being added again, so the same
+        system can also be passed as ``previous`` and re-used for every step.
+
+        :param options: options of the neighbors lists to compute
+        :param length_unit: unit of the positions and cell of this system, used to
+            convert the cutoff of each ``options`` with
+            :py:meth:`NeighborsListOptions.engine_cutoff`
+        :param previous: system for the previous step of a simulation, on which
+            :py:meth:`compute_neighbors_lists` was called with the same ``options``
+        """
+
     def get_neighbors_list(
         self,
         options: "NeighborsListOptions",
@@ -204,6 +289,21 @@ class NeighborsListOptions:
         ``j->i``) or a half neighbors list (contains only the pair ``i->j``)
         """
 
+    @property
+    def skin(self) -> float:
+        """
+        Verlet skin for this neighbors list, in model units. This is used by
+        :py:meth:`System.compute_neighbors_lists` to re-use the pairs of a neighbors
+        list between successive steps of a simulation, and is ignored when comparing
+        two :py:class:`NeighborsListOptions`. This is 0 by default.
+        """
+
+    def engine_skin(self, engine_length_unit: str) -> float:
+        """
+        Verlet skin for this neighbors list in engine units, see
+        :py:meth:`engine_cutoff`.
+        """
+
     def requestors(self) -> List[str]:
         """Get the list of modules requesting this neighbors list"""
 
@@ -475,6 +575,28 @@ def register_autograd_neighbors(
     """
 
 
+def split_outputs_per_system(
+    outputs: Dict[str, TensorMap], n_systems: int
+) -> List[Dict[str, TensorMap]]:
+    """
+    Split the ``outputs`` of a model evaluated on ``n_systems`` systems in a single
+    call into one dictionary of outputs per system.
+
+    This allows engines running multiple independent simulations (replicas,
+    path-integral beads, *etc.*) to evaluate the model once for all the systems, and
+    then dispatch the results to the corresponding simulation.
+
+    All the blocks in ``outputs`` must have a ``"system"`` sample dimension, and their
+    samples must be sorted by system. The values of the new blocks are views inside
+    the values of the original blocks, and the ``"system"`` dimension of the samples
+    keeps the index of the system in the batch.
+
+    :param outputs: outputs of the model, as returned by
+        :py:meth:`MetatensorAtomisticModel.forward`
+    :param n_systems: number of systems given to the model
+    """
+
+
 def unit_conversion_factor(quantity: str, from_unit: str, to_unit: str):
     """
     Get the multiplicative conversion factor from ``from_unit`` to ``to_unit``. Both
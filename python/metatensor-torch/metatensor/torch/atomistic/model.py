@@ -608,18 +608,24 @@ def _check_inputs(
                 f"['system', 'atom'], got {selected_atoms.names}"
             )
 
-        possible_atoms_values: List[List[int]] = []
-        for s, system in enumerate(systems):
-            for a in range(len(system)):
-                possible_atoms_values.append([s, a])
-
-        possible_atoms = Labels(
-            ["system", "atom"],
-            torch.tensor(possible_atoms_values, device=global_device),
+        # check the entries against the number of atoms in each system, without
+        # creating Labels for all the possible atoms in all the systems
+        n_atoms = torch.tensor(
+            [len(system) for system in systems], device=global_device
         )
-
-        intersection = selected_atoms.intersection(possible_atoms)
-        if len(intersection) != len(selected_atoms):
+        selected_system = selected_atoms.column("system").to(torch.int64)
+        selected_atom = selected_atoms.column("atom").to(torch.int64)
+
+        valid = (selected_system >= 0) & (selected_system < len(systems))
+        valid &= selected_atom >= 0
+
+        # only look up the number of atoms for entries with a valid system index,
+        # using the first system for the others. This is fine since `systems` is
+        # not empty here (we returned early above otherwise).
+        first_system = torch.zeros_like(selected_system)
+        system_index = torch.where(valid, selected_system, first_system)
+        valid &= selected_atom < n_atoms[system_index]
+        if not bool(torch.all(valid)):
             raise ValueError(
                 "invalid selected_atoms: there are entries that are not "
                 "possible for the current systems"
@@ -187,7 +187,12 @@ class Labels:
     True
     """
 
-    def __init__(self, names: StrSequence, values: torch.Tensor):
+    def __init__(
+        self,
+        names: StrSequence,
+        values: torch.Tensor,
+        assume_unique: bool = False,
+    ):
         """
         :param names: names of the dimensions in the new labels. A single string
                       is transformed into a list with one element, i.e.
@@ -195,6 +200,14 @@ class Labels:
 
         :param values: values of the labels, this needs to be a 2-dimensional
                        array of integers.
+
+        :param assume_unique: if ``True``, the entries in ``values`` are not
+            checked for uniqueness when creating the labels. The ``values`` then
+            stay on their device, and are only copied to the CPU (to build the
+            index used by :py:meth:`position` and similar functions) if an
+            operation requires them. This avoids a synchronization between the
+            CPU and the GPU when creating :py:class:`Labels` on GPU. The entries
+            are checked for duplicates when they are copied to the CPU.
         """
 
     @property
@@ -532,6 +545,32 @@ class Labels:
         labels.
         """
 
+    def positions(self, entries: torch.Tensor) -> torch.Tensor:
+        """
+        Get the positions of multiple ``entries`` in this set of :py:class:`Labels`,
+        in a single call.
+
+        This is equivalent to calling :py:meth:`position` for each row of
+        ``entries``, but much faster when looking up a large number of entries.
+
+        :param entries: 2-dimensional tensor of integers, where each row is an entry
+            to lookup
+        :returns: 1-dimensional tensor of ``int64`` on the same device as
+            ``entries``, containing the position of each entry, or ``-1`` if the
+            entry is not present in the labels.
+        """
+
+    def memory_usage(self) -> Dict[str, int]:
+        """
+        Get the memory used by these :py:class:`Labels`, in bytes.
+
+        The result contains one entry for each category of memory
+        (``"labels_values"``, ``"labels_positions"``, ``"metadata"``, ...), as well
+        as the sum of all categories in ``"total"``. Both the values stored by
+        metatensor-core and the values stored in a :py:class:`torch.Tensor` are
+        included.
+        """
+
     def union(self, other: "Labels") -> "Labels":
         """
         Take the union of these :py:class:`Labels` with ``other``.
@@ -709,6 +748,49 @@ class TensorBlock:
     def copy(self) -> "TensorBlock":
         """get a deep copy of this block, including all the data and metadata"""
 
+    def slice_samples(self, start: int, stop: int) -> "TensorBlock":
+        """
+        Get a new block containing the samples in the ``[start, stop)`` range of this
+        block, and the corresponding gradients.
+
+        The values of the new block are a view inside the values of this block,
+        sharing the same memory, and the new samples are not checked for duplicated
+        entries. Gradients are also views if the corresponding gradient rows are
+        contiguous (which is always the case if the gradient samples are sorted).
+
+        :param start: index of the first sample to include in the new block
+        :param stop: index one past the last sample to include in the new block
+        """
+
+    def split_samples(self, boundaries: List[int]) -> List["TensorBlock"]:
+        """
+        Split this block along the samples axis at the given ``boundaries``, using
+        :py:meth:`slice_samples`. The first block contains the samples in
+        ``[0, boundaries[0])``, and the last one the samples from
+        ``boundaries[-1]`` to the end of this block.
+
+        :param boundaries: increasing list of sample indexes where to split the block
+        """
+
+    def memory_usage(self) -> Dict[str, int]:
+        """
+        Get the memory used by this block and all its gradients, in bytes.
+
+        The result contains one entry for each category of memory:
+
+        - ``"values"`` and ``"gradients_values"`` for the size of the values
+          tensors of the block and its gradients;
+        - ``"labels_values"`` and ``"labels_positions"`` for the entries of the
+          samples, components and properties, and the hash maps used to find
+          entries in them;
+        - ``"gradients_metadata"`` for the labels only used by gradients;
+        - ``"metadata"`` for everything else;
+
+        as well as the sum of all categories in ``"total"``. Labels shared between
+        the values and the gradients (for example the properties) are only counted
+        once.
+        """
+
     def add_gradient(self, parameter: str, gradient: "TensorBlock"):
         """
         Add gradient with respect to ``parameter`` in this block.
@@ -891,6 +973,7 @@ class TensorBlock:
         dtype: Optional[torch.dtype] = None,
         device: Optional[torch.device] = None,
         arrays: Optional[str] = None,
+        non_blocking: bool = False,
     ) -> "TensorBlock":
         """
         Move all the arrays in this block (values, gradients and labels) to the given
@@ -903,6 +986,10 @@ class TensorBlock:
         :param arrays: new backend to use for the arrays. This parameter is here for
             compatibility with the pure Python API, can only be set  to ``"torch"`` or
             ``None`` and does nothing.
+        :param non_blocking: if ``True``, the data is copied asynchronously with
+            respect to the host when possible (e.g. from pinned CPU memory to a GPU),
+            in the same way as :py:meth:`torch.Tensor.to`. Labels shared between
+            the values and gradients are only moved once, and are always ready to use.
         """
 
 
@@ -974,6 +1061,61 @@ class TensorMap:
             .. _pytorch-115639: https://github.com/pytorch/pytorch/issues/115639
         """
 
+    @staticmethod
+    def load_selection(path: str, selection: Labels) -> "TensorMap":
+        """
+        Load only the blocks matching ``selection`` from a serialized
+        :py:class:`TensorMap` in the file at ``path``. The other blocks are not read
+        from the file.
+
+        :param path: Path of the file containing a saved :py:class:`TensorMap`
+        :param selection: :py:class:`Labels` with a single entry, following the same
+            rules as :py:meth:`TensorMap.blocks_matching`
+        """
+
+    @staticmethod
+    def load_mmap(path: str) -> "TensorMap":
+        """
+        Load a serialized :py:class:`TensorMap` from the file at ``path``, using
+        memory mapping to avoid copying the data.
+
+        The values and gradients of the returned :py:class:`TensorMap` are CPU
+        tensors pointing directly inside the mapped file, using the same dtype as the
+        data in the file. They can be modified, but modifications are never written
+        back to the file. The file should not be modified by other processes while
+        the :py:class:`TensorMap` is alive.
+
+        :param path: Path of the file containing a saved :py:class:`TensorMap`
+        """
+
+    @staticmethod
+    def load_shm(name: str) -> "TensorMap":
+        """
+        Load a :py:class:`TensorMap` from the shared memory segment with the given
+        ``name``, created by :py:meth:`TensorMap.save_shm` in this process or in
+        another one.
+
+        The values and gradients of the returned :py:class:`TensorMap` are CPU
+        tensors pointing directly inside the shared memory, without copying the
+        data. The segment is not removed after being loaded, and can be loaded
+        multiple times until it is removed with :py:meth:`TensorMap.remove_shm`.
+
+        :param name: name of the shared memory segment
+        """
+
+    @staticmethod
+    def remove_shm(name: str):
+        """
+        Remove the shared memory segment with the given ``name``, created by
+        :py:meth:`TensorMap.save_shm`.
+
+        On unix platforms, the tensors already loaded from this segment stay valid,
+        and the memory is released once all the tensors using it are destroyed. Other
+        platforms do not allow removing a segment while it is still in use.
+
+        :param name: name of the shared memory segment
+        """
+
     @staticmethod
     def load_buffer(buffer: torch.Tensor) -> "TensorMap":
         """
@@ -1006,6 +1148,18 @@ class TensorMap:
             overwritten
         """
 
+    def save_shm(self, name: str):
+        """
+        Save this :py:class:`TensorMap` to a shared memory segment, to be loaded
+        with :py:meth:`TensorMap.load_shm`, typically by another process. This can
+        be used to send data from data loader worker processes with a single copy
+        of the data.
+
+        :param name: name of the shared memory segment. If the segment already
+            exists, it will be overwritten. The segment should be removed with
+            :py:meth:`TensorMap.remove_shm` once it is no longer needed.
+        """
+
     def save_buffer(self) -> torch.Tensor:
         """
         Save this :py:class:`TensorMap` to an in-memory buffer, this is equivalent to
@@ -1083,8 +1237,12 @@ class TensorMap:
         block/missing sample) for a given property in the merged block, then the
         value will be set to zero.
 
-        When using a non empty :py:class:`Labels` for ``keys_to_move``, the
-        properties labels of all the merged blocks must take the same values.
+        When using a non empty :py:class:`Labels` for ``keys_to_move`` with merged
+        blocks having different properties labels, each entry of ``keys_to_move``
+        is followed by the properties of the block with this entry in its key.
+        Entries without such block use the properties of the blocks with this
+        entry in the other groups of merged blocks, which must then all be the
+        same.
 
         The order of the samples in the merged blocks is controlled by
         ``sort_samples``. If ``sort_samples`` is :py:obj:`True`, samples are
@@ -1102,10 +1260,63 @@ class TensorMap:
         Move the given ``dimensions`` from the component labels to the property
         labels for each block.
 
+        ``dimensions`` can contain the names of a single component, or all the
+        names of multiple components. In the latter case, all the components are
+        moved at once, and the new properties contain the components in the
+        order in which they appear in ``dimensions``, followed by the old
+        properties.
+
         :param dimensions: name of the component dimensions to move to the
             properties
         """
 
+    @staticmethod
+    def join_samples(
+        tensors: List["TensorMap"], new_dimension: Optional[str]
+    ) -> "TensorMap":
+        """
+        Join multiple ``tensors`` along the samples axis, merging the blocks with the
+        same key in all tensors. This is typically used to collate multiple
+        :py:class:`TensorMap` in a single batch.
+
+        All the tensors must have the same keys (potentially in a different order), and
+        the merged blocks must have the same sample names, components and properties.
+        The keys of the new :py:class:`TensorMap` are in the same order as the keys of
+        the first tensor.
+
+        :param tensors: the tensors to join
+        :param new_dimension: name of a new sample dimension, containing the index of
+            the tensor each sample comes from. If this is ``None``, the samples of the
+            merged blocks must all be different.
+        """
+
+    def slice_samples(self, start: int, stop: int) -> "TensorMap":
+        """
+        Get a new :py:class:`TensorMap` where each block contains the samples in the
+        ``[start, stop)`` range of the corresponding block in this tensor map. See
+        :py:meth:`TensorBlock.slice_samples` for more information.
+
+        :param start: index of the first sample to include in the new blocks
+        :param stop: index one past the last sample to include in the new blocks
+        """
+
+    def split_samples(self, boundaries: List[int]) -> List["TensorMap"]:
+        """
+        Split all the blocks in this :py:class:`TensorMap` along the samples axis at
+        the given ``boundaries``. See :py:meth:`TensorBlock.split_samples` for more
+        information.
+
+        :param boundaries: increasing list of sample indexes where to split the
+            blocks
+        """
+
+    def memory_usage(self) -> Dict[str, int]:
+        """
+        Get the memory used by this :py:class:`TensorMap` and all its blocks, in
+        bytes. See :py:meth:`TensorBlock.memory_usage` for the list of categories
+        in the result. Labels shared between multiple blocks are only counted once.
+        """
+
     def blocks_matching(self, selection: Labels) -> List[int]:
         """
         Get a (possibly empty) list of block indexes matching the ``selection``.
@@ -1230,6 +1441,7 @@ class TensorMap:
         dtype: Optional[torch.dtype] = None,
         device: Optional[torch.device] = None,
         arrays: Optional[str] = None,
+        non_blocking: bool = False,
     ) -> "TensorMap":
         """
         Move all the data (keys and blocks) in this :py:class:`TensorMap` to the given
@@ -1242,6 +1454,32 @@ class TensorMap:
         :param arrays: new backend to use for the arrays. This parameter is here for
             compatibility with the pure Python API, can only be set  to ``"torch"`` or
             ``None`` and does nothing.
+        :param non_blocking: if ``True``, the data is copied asynchronously with
+            respect to the host when possible (e.g. from pinned CPU memory to a GPU),
+            in the same way as :py:meth:`torch.Tensor.to`. Labels shared between
+            blocks are only moved once, and are always ready to use.
+        """
+
+    def pack(self) -> "TensorMap":
+        """
+        Get a copy of this :py:class:`TensorMap` where the values of all blocks and all
+        their gradients are views inside a single contiguous 1-dimensional tensor,
+        available with :py:attr:`packed_buffer`. The blocks are stored one after the
+        other in this buffer, each block followed by its gradients.
+
+        Calling :py:meth:`to` on a packed :py:class:`TensorMap` moves all the values
+        with a single copy, and returns another packed :py:class:`TensorMap`. The
+        buffer can also be used to apply an operation to all the values at once, for
+        example with :py:func:`torch.distributed.all_reduce`.
+        """
+
+    @property
+    def packed_buffer(self) -> Optional[torch.Tensor]:
+        """
+        Get the buffer containing the values of all blocks if this
+        :py:class:`TensorMap` was created by :py:meth:`pack` (or by calling
+        :py:meth:`to` on a packed :py:class:`TensorMap`), and ``None`` otherwise.
+        Modifying this buffer in-place modifies the values of all blocks.
         """
 
 
@@ -1258,7 +1496,11 @@ def dtype_name(dtype: torch.dtype) -> str:
     """
 
 
-def load(path: str) -> TensorMap:
+def load(
+    path: str,
+    dtype: Optional[torch.dtype] = None,
+    device: Optional[torch.device] = None,
+) -> TensorMap:
     """
     Load a previously saved :py:class:`TensorMap` from the given path.
 
@@ -1267,7 +1509,17 @@ def load(path: str) -> TensorMap:
     is stored as a ``.npy`` array. See the C API documentation for more
     information on the format.
 
+    If ``dtype`` or ``device`` are given, the values and gradients are created
+    directly with this dtype and on this device, without going through a full copy
+    of the data in ``float64`` on CPU. When loading data on a CUDA device, the copies
+    to the device are asynchronous, and overlap with reading the next arrays from the
+    file.
+
     :param path: path of the file to load
+    :param dtype: dtype of the values and gradients in the loaded
+        :py:class:`TensorMap`. Defaults to ``torch.float64``.
+    :param device: device where the loaded :py:class:`TensorMap` should be stored.
+        Defaults to the CPU.
     """
 
 
@@ -1319,3 +1571,70 @@ def save_buffer(data: Union[TensorMap, Labels]) -> torch.Tensor:
 
     :param data: data to serialize and save
     """
+
+
+class TensorMapWriter:
+    """
+    Write a :py:class:`TensorMap` to a file one block at a time, without having to
+    keep all the blocks in memory at the same time.
+
+    Blocks are written to the file as soon as they are added with
+    :py:meth:`add_block`, and the keys are written by :py:meth:`finish`. The
+    resulting file can be loaded with :py:func:`load`. A single block can also be
+    written in chunks of samples with :py:meth:`begin_block`,
+    :py:meth:`add_samples` and :py:meth:`end_block`.
+
+    If writing to the file fails, the writer can not be used anymore.
+    """
+
+    def __init__(self, path: str, keys_names: List[str]):
+        """
+        :param path: path of the file where to save the data. If the file already
+            exists, it is overwritten.
+        :param keys_names: names of the dimensions of the keys of the
+            :py:class:`TensorMap`
+        """
+
+    def add_block(self, key: List[int], block: TensorBlock):
+        """
+        Write ``block`` to the file, associated with the given ``key``.
+
+        All blocks must have the same samples, components and properties names, and
+        the same set of gradients. The data of the block must be on CPU.
+
+        :param key: values of the key for this block
+        :param block: block to write to the file
+        """
+
+    def begin_block(self, key: List[int], shape: List[int]):
+        """
+        Start writing a block associated with the given ``key`` in chunks of samples.
+
+        The chunks added with :py:meth:`add_samples` must contain exactly
+        ``shape[0]`` samples in total before calling :py:meth:`end_block`. Blocks
+        written this way can not contain gradients.
+
+        :param key: values of the key for this block
+        :param shape: total shape of the values of this block
+        """
+
+    def add_samples(self, chunk: TensorBlock):
+        """
+        Write the next samples of the block started with :py:meth:`begin_block`.
+
+        :param chunk: block containing the next samples, with the same components and
+            properties as the other chunks, and no gradients. The data must be on
+            CPU.
+        """
+
+    def end_block(self):
+        """
+        Finish writing the block started with :py:meth:`begin_block`, writing its
+        samples, components and properties to the file.
+        """
+
+    def finish(self):
+        """
+        Write the keys of all the blocks added so far to the file. No other blocks can
+        be added after calling this function.
+        """
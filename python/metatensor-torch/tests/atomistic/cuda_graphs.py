@@ -0,0 +1,146 @@
+import warnings
+from typing import Dict, List, Optional
+
+import pytest
+import torch
+
+from metatensor.torch import Labels, TensorBlock, TensorMap
+from metatensor.torch.atomistic import (
+    CUDAGraphModel,
+    MetatensorAtomisticModel,
+    ModelCapabilities,
+    ModelEvaluationOptions,
+    ModelMetadata,
+    ModelOutput,
+    System,
+)
+
+
+class SumPositions(torch.nn.Module):
+    """
+    Sum the positions of each system. All the Labels are created on the right device
+    before capturing CUDA graphs, since creating them during the capture is not
+    possible.
+    """
+
+    def __init__(self, device: str, synchronize_single: bool = False):
+        super().__init__()
+        self._samples_1 = Labels.range("system", 1).to(device)
+        self._samples_2 = Labels.range("system", 2).to(device)
+        self._properties = Labels("energy", torch.tensor([[0]])).to(device)
+        self._keys = Labels.single().to(device)
+        # synchronize with the CPU when running with a single system, making the
+        # capture of CUDA graphs fail
+        self._synchronize_single = synchronize_single
+
+    def forward(
+        self,
+        systems: List[System],
+        outputs: Dict[str, ModelOutput],
+        selected_atoms: Optional[Labels] = None,
+    ) -> Dict[str, TensorMap]:
+        energies = torch.stack([system.positions.sum() for system in systems])
+
+        if len(systems) == 1:
+            samples = self._samples_1
+            if self._synchronize_single:
+                energies = energies.cpu().to(energies.device)
+        else:
+            samples = self._samples_2
+
+        block = TensorBlock(
+            values=energies.reshape(-1, 1),
+            samples=samples,
+            components=torch.jit.annotate(List[Labels], []),
+            properties=self._properties,
+        )
+        return {"energy": TensorMap(self._keys, [block])}
+
+
+def _model(device, synchronize_single=False):
+    capabilities = ModelCapabilities(
+        length_unit="angstrom",
+        atomic_types=[1],
+        interaction_range=0.0,
+        outputs={"energy": ModelOutput(quantity="energy", unit="eV")},
+        supported_devices=["cpu", "cuda"],
+        dtype="float64",
+    )
+    model = MetatensorAtomisticModel(
+        SumPositions(device, synchronize_single).eval(),
+        ModelMetadata(),
+        capabilities,
+    )
+    model.to(device=device)
+
+    options = ModelEvaluationOptions(
+        length_unit="angstrom",
+        outputs={"energy": ModelOutput(quantity="energy", unit="eV")},
+    )
+    return CUDAGraphModel(model, options)
+
+
+def _system(device):
+    return System(
+        types=torch.ones(4, dtype=torch.int32, device=device),
+        positions=torch.rand(4, 3, dtype=torch.float64, device=device),
+        cell=torch.zeros(3, 3, dtype=torch.float64, device=device),
+    )
+
+
+def test_eager_on_cpu():
+    model = _model("cpu")
+    system = _system("cpu")
+
+    outputs = model([system])
+    assert torch.allclose(outputs["energy"].block().values, system.positions.sum())
+
+
+@pytest.mark.skipif(not torch.cuda.is_available(), reason="requires CUDA")
+def test_replay():
+    model = _model("cuda")
+    system = _system("cuda")
+
+    outputs = model([system])
+    assert model._graph is not None
+    assert torch.allclose(outputs["energy"].block().values, system.positions.sum())
+
+    # same topology, the new positions are copied in the static inputs
+    graph = model._graph
+    system.update_positions(torch.rand_like(system.positions))
+    outputs = model([system])
+    assert model._graph is graph
+    assert torch.allclose(outputs["energy"].block().values, system.positions.sum())
+
+    # new topology
+    systems = [_system("cuda"), _system("cuda")]
+    outputs = model(systems)
+    assert model._graph is not None
+    assert model._graph is not graph
+    expected = torch.stack([s.positions.sum() for s in systems]).reshape(-1, 1)
+    assert torch.allclose(outputs["energy"].block().values, expected)
+
+
+@pytest.mark.skipif(not torch.cuda.is_available(), reason="requires CUDA")
+def test_retry_capture():
+    model = _model("cuda", synchronize_single=True)
+    system = _system("cuda")
+
+    with pytest.warns(UserWarning, match="failed to capture a CUDA graph"):
+        outputs = model([system])
+    assert model._graph is None
+    assert torch.allclose(outputs["energy"].block().values, system.positions.sum())
+
+    # same topology, the model is evaluated eagerly without trying to capture again
+    with warnings.catch_warnings():
+        warnings.simplefilter("error")
+        outputs = model([system])
+    assert model._graph is None
+    assert torch.allclose(outputs["energy"].block().values, system.positions.sum())
+
+    # new topology, the capture is attempted again
+    systems = [_system("cuda"), _system("cuda")]
+    outputs = model(systems)
+    assert model._graph is not None
+    expected = torch.stack([s.positions.sum() for s in systems]).reshape(-1, 1)
+    assert torch.allclose(outputs["energy"].block().values, expected)
@@ -13,6 +13,7 @@ from metatensor.torch.atomistic import (
     NeighborsListOptions,
     System,
     check_atomistic_model,
+    split_outputs_per_system,
 )
 
 
@@ -232,3 +233,56 @@ def test_bad_capabilities():
     )
     with pytest.raises(ValueError, match=message):
         ModelCapabilities(outputs={"not-a-standard::": ModelOutput()})
+
+
+def test_split_outputs_per_system():
+    block = TensorBlock(
+        values=torch.arange(5, dtype=torch.float64).reshape(5, 1),
+        samples=Labels(
+            ["system", "atom"],
+            torch.tensor([[0, 0], [0, 1], [2, 0], [2, 1], [2, 2]]),
+        ),
+        components=[],
+        properties=Labels("energy", torch.tensor([[0]])),
+    )
+    outputs = {"energy": TensorMap(Labels("_", torch.tensor([[0]])), [block])}
+
+    splitted = split_outputs_per_system(outputs, 3)
+    assert len(splitted) == 3
+
+    first = splitted[0]["energy"].block()
+    assert first.samples == Labels(["system", "atom"], torch.tensor([[0, 0], [0, 1]]))
+    assert first.values.data_ptr() == block.values.data_ptr()
+
+    assert len(splitted[1]["energy"].block().samples) == 0
+
+    assert split_outputs_per_system(outputs, 0) == []
+
+    message = "`n_systems` must be zero or positive, got -1"
+    with pytest.raises(ValueError, match=message):
+        split_outputs_per_system(outputs, -1)
+
+    last = splitted[2]["energy"].block()
+    assert torch.all(last.values == torch.tensor([[2.0], [3.0], [4.0]]))
+
+    message = (
+        "invalid samples in 'energy' output: found a 'system' index larger than "
+        "the number of systems \\(2\\)"
+    )
+    with pytest.raises(ValueError, match=message):
+        split_outputs_per_system(outputs, 2)
+
+    unsorted = TensorBlock(
+        values=torch.zeros(2, 1),
+        samples=Labels("system", torch.tensor([[1], [0]])),
+        components=[],
+        properties=Labels("energy", torch.tensor([[0]])),
+    )
+    outputs = {"energy": TensorMap(Labels("_", torch.tensor([[0]])), [unsorted])}
+
+    message = (
+        "invalid samples in 'energy' output: the samples must be sorted by 'system' "
+        "to split the outputs per system"
+    )
+    with pytest.raises(ValueError, match=message):
+        split_outputs_per_system(outputs, 2)
@@ -160,3 +160,150 @@ def test_neighbors_autograd_errors():
     )
     with pytest.raises(ValueError, match=message):
         register_autograd_neighbors(system, neighbors, check_consistency=True)
+
+
+@pytest.mark.skipif(not HAVE_ASE, reason="this tests requires ASE neighbors list")
+@pytest.mark.parametrize("periodic", [True, False])
+def test_compute_neighbors_lists(periodic):
+    torch.manual_seed(0xDEADBEEF)
+    n_atoms = 30
+    cell_size = 5.0
+    positions = cell_size * torch.rand(n_atoms, 3, dtype=torch.float64)
+    if periodic:
+        cell = cell_size * torch.eye(3, dtype=torch.float64)
+        cell[1, 0] = 1.2
+    else:
+        cell = torch.zeros((3, 3), dtype=torch.float64)
+
+    atoms = ase.Atoms(
+        "C" * n_atoms,
+        positions=positions.numpy(),
+        cell=cell.numpy(),
+        pbc=periodic,
+    )
+
+    all_options = [
+        NeighborsListOptions(cutoff=3.5, full_list=True),
+        NeighborsListOptions(cutoff=3.5, full_list=False),
+        NeighborsListOptions(cutoff=2.0, full_list=False),
+        # larger than the cell, to check periodic images of the same atom
+        NeighborsListOptions(cutoff=6.0, full_list=True),
+    ]
+
+    system = System(torch.ones(n_atoms, dtype=torch.int32), positions, cell)
+    system.compute_neighbors_lists(all_options)
+
+    for options in all_options:
+        neighbors = system.get_neighbors_list(options)
+        expected = _compute_ase_neighbors(
+            atoms, options, dtype=torch.float64, device="cpu"
+        )
+
+        if options.full_list:
+            assert neighbors.samples.union(expected.samples) == neighbors.samples
+            assert len(neighbors.samples) == len(expected.samples)
+        else:
+            # the half list conventions can differ, compare the number of pairs
+            # and the distances
+            assert len(neighbors.samples) == len(expected.samples)
+
+        distances = torch.linalg.vector_norm(neighbors.values, dim=(1, 2))
+        expected_distances = torch.linalg.vector_norm(expected.values, dim=(1, 2))
+        assert torch.allclose(
+            torch.sort(distances).values, torch.sort(expected_distances).values
+        )
+
+        # the distance vectors must match the samples
+        register_autograd_neighbors(
+            System(torch.ones(n_atoms, dtype=torch.int32), positions, cell),
+            neighbors,
+            check_consistency=True,
+        )
+
+
+def _compute_pairs(system, options, previous):
+    """
+    Call ``system.compute_neighbors_lists``, and check if the pairs were computed
+    from scratch or re-used from ``previous``.
+    """
+    with torch.profiler.profile() as profiler:
+        system.compute_neighbors_lists([options], previous=previous)
+
+    return any(e.name == "metatensor::cell_list_pairs" for e in profiler.events())
+
+
+@pytest.mark.skipif(not HAVE_ASE, reason="this tests requires ASE neighbors list")
+def test_compute_neighbors_lists_skin():
+    torch.manual_seed(0xDEADBEEF)
+    n_atoms = 30
+    cell = 5.0 * torch.eye(3, dtype=torch.float64)
+    positions = 5.0 * torch.rand(n_atoms, 3, dtype=torch.float64)
+    types = torch.ones(n_atoms, dtype=torch.int32)
+
+    options = NeighborsListOptions(cutoff=2.5, full_list=False)
+    options.skin = 0.5
+
+    previous = System(types, positions, cell)
+    assert _compute_pairs(previous, options, previous=None)
+    assert len(previous.get_neighbors_list(options).samples) > 0
+
+    # small displacements (less than half of the skin) re-use the pairs, and only
+    # update the distances
+    for displacement in [0.1, 0.2]:
+        new_positions = positions + displacement * torch.rand(n_atoms, 3) / 2.0
+        system = System(types, new_positions, cell)
+        assert not _compute_pairs(system, options, previous=previous)
+
+        neighbors = system.get_neighbors_list(options)
+        atoms = ase.Atoms(
+            "C" * n_atoms, positions=new_positions.numpy(), cell=cell.numpy(), pbc=True
+        )
+        expected = _compute_ase_neighbors(
+            atoms, options, dtype=torch.float64, device="cpu"
+        )
+        assert len(neighbors.samples) == len(expected.samples)
+
+        register_autograd_neighbors(system, neighbors, check_consistency=True)
+        previous = system
+
+    # larger displacements compute the pairs again
+    system = System(types, positions + 0.3, cell)
+    assert _compute_pairs(system, options, previous=previous)
+
+
+def test_compute_neighbors_lists_persistent_system():
+    torch.manual_seed(0xDEADBEEF)
+    n_atoms = 30
+    cell = 5.0 * torch.eye(3, dtype=torch.float64)
+    positions = 5.0 * torch.rand(n_atoms, 3, dtype=torch.float64)
+    types = torch.ones(n_atoms, dtype=torch.int32)
+
+    options = NeighborsListOptions(cutoff=2.5, full_list=False)
+    options.skin = 0.5
+
+    system = System(types, positions.clone(), cell)
+    system.compute_neighbors_lists([options])
+    samples = system.get_neighbors_list(options).samples
+
+    # re-using the same system updates the existing neighbors list
+    data_ptr = system.positions.data_ptr()
+    new_positions = positions + 1e-3
+    system.update_positions(new_positions)
+    assert system.positions.data_ptr() == data_ptr
+    assert torch.all(system.positions == new_positions)
+
+    assert not _compute_pairs(system, options, previous=system)
+    neighbors = system.get_neighbors_list(options)
+    assert neighbors.samples == samples
+    register_autograd_neighbors(
+        System(types, new_positions, cell), neighbors, check_consistency=True
+    )
+
+    # large displacements create new pairs
+    new_positions = 5.0 * torch.rand(n_atoms, 3, dtype=torch.float64)
+    system.update_positions(new_positions)
+    assert _compute_pairs(system, options, previous=system)
+    neighbors = system.get_neighbors_list(options)
+    register_autograd_neighbors(
+        System(types, new_positions, cell), neighbors, check_consistency=True
+    )
@@ -96,6 +96,81 @@ def test_system(types, positions, cell, neighbors):
     ]
 
 
+def test_update(system, neighbors):
+    positions_ptr = system.positions.data_ptr()
+    cell_ptr = system.cell.data_ptr()
+
+    new_positions = torch.rand((8, 3))
+    system.update_positions(new_positions)
+    assert torch.all(system.positions == new_positions)
+    assert system.positions.data_ptr() == positions_ptr
+
+    new_cell = torch.tensor([[10.0, 0, 0], [0, 10.0, 0], [0, 0, 10]])
+    system.update_cell(new_cell)
+    assert torch.all(system.cell == new_cell)
+    assert system.cell.data_ptr() == cell_ptr
+
+    # tensors requiring gradients replace the existing ones, to keep the
+    # gradients flowing to them
+    new_positions = torch.rand((8, 3), requires_grad=True)
+    system.update_positions(new_positions)
+    assert system.positions.data_ptr() == new_positions.data_ptr()
+
+    system.positions.sum().backward()
+    assert new_positions.grad is not None
+
+    # and the same for tensors which are part of a computational graph
+    graph_positions = 2 * new_positions
+    system.update_positions(graph_positions)
+    assert system.positions.data_ptr() == graph_positions.data_ptr()
+
+    # the existing positions require gradients, but not the new ones
+    new_positions = torch.rand((8, 3))
+    system.update_positions(new_positions)
+    assert system.positions.data_ptr() == new_positions.data_ptr()
+    assert not system.positions.requires_grad
+
+    # different dtype falls back to the full validation
+    message = "new `positions` must have the same dtype as existing data"
+    with pytest.raises(ValueError, match=message):
+        system.update_positions(new_positions.to(torch.float64))
+
+    options = NeighborsListOptions(cutoff=3.5, full_list=False)
+    message = (
+        "No neighbors list for NeighborsListOptions\\(cutoff=3.500000, "
+        "full_list=False\\) was found, use `add_neighbors_list` to add it to this "
+        "system first"
+    )
+    with pytest.raises(ValueError, match=message):
+        system.update_neighbors_list(options, torch.zeros(2, 3, 1))
+
+    system.add_neighbors_list(options, neighbors)
+
+    values = torch.ones(2, 3, 1)
+    system.update_neighbors_list(options, values)
+    updated = system.get_neighbors_list(options)
+    assert torch.all(updated.values == values)
+    assert updated.samples == neighbors.samples
+    assert updated.properties == neighbors.properties
+
+    samples = Labels(
+        neighbors.samples.names,
+        torch.tensor([(0, 1, 0, 0, 0), (0, 2, 1, 0, -1), (2, 3, 0, 0, 0)]),
+    )
+    system.update_neighbors_list(options, torch.ones(3, 3, 1), samples)
+    assert system.get_neighbors_list(options).samples == samples
+
+    message = "`values` must be a \\(len\\(samples\\) x 3 x 1\\) tensor"
+    with pytest.raises(ValueError, match=message):
+        system.update_neighbors_list(options, torch.ones(2, 3, 1))
+
+    message = "invalid samples for `neighbors`: the samples names must be"
+    with pytest.raises(ValueError, match=message):
+        system.update_neighbors_list(
+            options, torch.ones(1, 3, 1), Labels.range("first_atom", 1)
+        )
+
+
 def test_custom_data(system):
     data = TensorBlock(
         values=torch.zeros(3, 10),
@@ -78,6 +78,33 @@ def test_constructor_errors():
         _ = Labels(names="not an ident", values=torch.tensor([[0]]))
 
 
+def test_assume_unique():
+    values = torch.tensor([[0, 0], [0, 1]])
+    labels = Labels(names=("a", "b"), values=values, assume_unique=True)
+    assert labels.names == ["a", "b"]
+    assert torch.all(labels.values == values)
+    assert labels.position([0, 1]) == 1
+
+    # the values are not copied to the CPU until they are needed, so we can
+    # create Labels on the meta device (which does not allow such copies)
+    labels = Labels(names=("a", "b"), values=values.to("meta"), assume_unique=True)
+    assert labels.device.type == "meta"
+    assert len(labels) == 2
+
+    renamed = labels.rename("a", "c")
+    assert renamed.names == ["c", "b"]
+    assert renamed.device.type == "meta"
+
+    appended = labels.append("d", torch.tensor([1, 2], device="meta"))
+    assert appended.names == ["a", "b", "d"]
+    assert appended.values.shape == (2, 3)
+
+    # names are still checked when creating the Labels
+    message = "invalid parameter: 'not an ident' is not a valid label name"
+    with pytest.raises(RuntimeError, match=message):
+        _ = Labels("not an ident", values=torch.tensor([[0]]), assume_unique=True)
+
+
 def test_view():
     labels = Labels(names=("aaa", "bbb"), values=torch.tensor([[1, 2], [3, 4]]))
 
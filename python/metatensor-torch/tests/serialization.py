@@ -67,6 +67,73 @@ def test_load(tensor_path):
     check_tensor(loaded)
 
 
+def test_load_dtype_device(tensor_path):
+    loaded = metatensor.torch.load(tensor_path, dtype=torch.float32)
+    check_tensor(loaded)
+
+    reference = metatensor.torch.load(tensor_path)
+    block = loaded.block(21)
+    assert block.values.dtype == torch.float32
+    assert torch.all(block.values == reference.block(21).values.to(torch.float32))
+
+    gradient = block.gradient("positions")
+    assert gradient.values.dtype == torch.float32
+
+    loaded = metatensor.torch.load(tensor_path, device="meta")
+    assert loaded.device.type == "meta"
+
+
+def test_load_float32_dtype(tmpdir, tensor_path):
+    reference = metatensor.torch.load(tensor_path).to(dtype=torch.float32)
+    tmpfile = "serialize-test-float32.npz"
+
+    with tmpdir.as_cwd():
+        reference.save(tmpfile)
+
+        # memory-mapped data keeps the dtype of the file
+        mapped = TensorMap.load_mmap(tmpfile)
+        assert mapped.block(21).values.dtype == torch.float32
+        assert torch.all(mapped.block(21).values == reference.block(21).values)
+
+        loaded = metatensor.torch.load(tmpfile, dtype=torch.float64)
+
+    check_tensor(loaded)
+    block = loaded.block(21)
+    assert block.values.dtype == torch.float64
+    assert torch.all(block.values == reference.block(21).values.to(torch.float64))
+
+    gradient = block.gradient("positions")
+    assert gradient.values.dtype == torch.float64
+    expected = reference.block(21).gradient("positions").values.to(torch.float64)
+    assert torch.all(gradient.values == expected)
+
+
+def test_shared_memory(tensor_path):
+    tensor = metatensor.torch.load(tensor_path)
+    name = f"test-shm-{os.getpid()}"
+
+    tensor.save_shm(name)
+    loaded = TensorMap.load_shm(name)
+    check_tensor(loaded)
+    assert torch.all(loaded.block(21).values == tensor.block(21).values)
+
+    # the segment can be loaded multiple times
+    again = TensorMap.load_shm(name)
+    check_tensor(again)
+
+    if os.name != "nt":
+        # tensors loaded from the segment stay valid after removing it
+        TensorMap.remove_shm(name)
+        assert torch.all(loaded.block(21).values == tensor.block(21).values)
+    else:
+        # the segment can only be removed once it is no longer mapped
+        del loaded, again
+        TensorMap.remove_shm(name)
+
+    with pytest.raises(RuntimeError):
+        TensorMap.load_shm(name)
+
+
 def test_load_buffer(tensor_path):
     buffer = torch.tensor(np.fromfile(tensor_path, dtype="uint8"))
 
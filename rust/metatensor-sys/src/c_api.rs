@@ -15,6 +15,13 @@ pub const MTS_IO_ERROR: i32 = 2;
 pub const MTS_SERIALIZATION_ERROR: i32 = 3;
 pub const MTS_BUFFER_SIZE_ERROR: i32 = 254;
 pub const MTS_INTERNAL_ERROR: i32 = 255;
+pub const MTS_DTYPE_F64: i32 = 1;
+pub const MTS_DTYPE_F32: i32 = 2;
+pub const MTS_DTYPE_F16: i32 = 3;
+pub const MTS_DTYPE_BF16: i32 = 4;
+pub const MTS_COMPRESSION_NONE: i32 = 0;
+pub const MTS_COMPRESSION_DEFLATE: i32 = 1;
+pub const MTS_COMPRESSION_ZSTD: i32 = 2;
 #[repr(C)]
 #[derive(Debug, Copy, Clone)]
 pub struct mts_block_t {
@@ -25,6 +32,11 @@ pub struct mts_block_t {
 pub struct mts_tensormap_t {
     _unused: [u8; 0],
 }
+#[repr(C)]
+#[derive(Debug, Copy, Clone)]
+pub struct mts_tensormap_writer_t {
+    _unused: [u8; 0],
+}
 pub type mts_status_t = i32;
 #[repr(C)]
 #[derive(Debug, Copy, Clone)]
@@ -204,6 +216,22 @@ pub struct mts_array_t {
             property_end: usize,
         ) -> mts_status_t,
     >,
+    pub typed_data: ::std::option::Option<
+        unsafe extern "C" fn(
+            array: *mut ::std::os::raw::c_void,
+            data: *mut *mut ::std::os::raw::c_void,
+            dtype: *mut i32,
+        ) -> mts_status_t,
+    >,
+    pub create_typed: ::std::option::Option<
+        unsafe extern "C" fn(
+            array: *const ::std::os::raw::c_void,
+            shape: *const usize,
+            shape_count: usize,
+            dtype: i32,
+            new_array: *mut mts_array_t,
+        ) -> mts_status_t,
+    >,
 }
 #[test]
 fn bindgen_test_layout_mts_array_t() {
@@ -211,7 +239,7 @@ fn bindgen_test_layout_mts_array_t() {
     let ptr = UNINIT.as_ptr();
     assert_eq!(
         ::std::mem::size_of::<mts_array_t>(),
-        80usize,
+        96usize,
         concat!("Size of: ", stringify!(mts_array_t))
     );
     assert_eq!(
@@ -319,6 +347,111 @@ fn bindgen_test_layout_mts_array_t() {
             stringify!(move_samples_from)
         )
     );
+    assert_eq!(
+        unsafe { ::std::ptr::addr_of!((*ptr).typed_data) as usize - ptr as usize },
+        80usize,
+        concat!(
+            "Offset of field: ",
+            stringify!(mts_array_t),
+            "::",
+            stringify!(typed_data)
+        )
+    );
+    assert_eq!(
+        unsafe { ::std::ptr::addr_of!((*ptr).create_typed) as usize - ptr as usize },
+        88usize,
+        concat!(
+            "Offset of field: ",
+            stringify!(mts_array_t),
+            "::",
+            stringify!(create_typed)
+        )
+    );
+}
+#[repr(C)]
+#[derive(Debug, Copy, Clone)]
+pub struct mts_memory_usage_t {
+    pub values: usize,
+    pub gradients_values: usize,
+    pub labels_values: usize,
+    pub labels_positions: usize,
+    pub gradients_metadata: usize,
+    pub metadata: usize,
+}
+#[test]
+fn bindgen_test_layout_mts_memory_usage_t() {
+    const UNINIT: ::std::mem::MaybeUninit<mts_memory_usage_t> = ::std::mem::MaybeUninit::uninit();
+    let ptr = UNINIT.as_ptr();
+    assert_eq!(
+        ::std::mem::size_of::<mts_memory_usage_t>(),
+        48usize,
+        concat!("Size of: ", stringify!(mts_memory_usage_t))
+    );
+    assert_eq!(
+        ::std::mem::align_of::<mts_memory_usage_t>(),
+        8usize,
+        concat!("Alignment of ", stringify!(mts_memory_usage_t))
+    );
+    assert_eq!(
+        unsafe { ::std::ptr::addr_of!((*ptr).values) as usize - ptr as usize },
+        0usize,
+        concat!(
+            "Offset of field: ",
+            stringify!(mts_memory_usage_t),
+            "::",
+            stringify!(values)
+        )
+    );
+    assert_eq!(
+        unsafe { ::std::ptr::addr_of!((*ptr).gradients_values) as usize - ptr as usize },
+        8usize,
+        concat!(
+            "Offset of field: ",
+            stringify!(mts_memory_usage_t),
+            "::",
+            stringify!(gradients_values)
+        )
+    );
+    assert_eq!(
+        unsafe { ::std::ptr::addr_of!((*ptr).labels_values) as usize - ptr as usize },
+        16usize,
+        concat!(
+            "Offset of field: ",
+            stringify!(mts_memory_usage_t),
+            "::",
+            stringify!(labels_values)
+        )
+    );
+    assert_eq!(
+        unsafe { ::std::ptr::addr_of!((*ptr).labels_positions) as usize - ptr as usize },
+        24usize,
+        concat!(
+            "Offset of field: ",
+            stringify!(mts_memory_usage_t),
+            "::",
+            stringify!(labels_positions)
+        )
+    );
+    assert_eq!(
+        unsafe { ::std::ptr::addr_of!((*ptr).gradients_metadata) as usize - ptr as usize },
+        32usize,
+        concat!(
+            "Offset of field: ",
+            stringify!(mts_memory_usage_t),
+            "::",
+            stringify!(gradients_metadata)
+        )
+    );
+    assert_eq!(
+        unsafe { ::std::ptr::addr_of!((*ptr).metadata) as usize - ptr as usize },
+        40usize,
+        concat!(
+            "Offset of field: ",
+            stringify!(mts_memory_usage_t),
+            "::",
+            stringify!(metadata)
+        )
+    );
 }
 pub type mts_realloc_buffer_t = ::std::option::Option<
     unsafe extern "C" fn(
@@ -334,10 +467,16 @@ pub type mts_create_array_callback_t = ::std::option::Option<
         array: *mut mts_array_t,
     ) -> mts_status_t,
 >;
+pub type mts_profiling_callback_t = ::std::option::Option<
+    unsafe extern "C" fn(name: *const ::std::os::raw::c_char, enter: bool),
+>;
 extern "C" {
     pub fn mts_disable_panic_printing();
     pub fn mts_version() -> *const ::std::os::raw::c_char;
+    pub fn mts_set_max_threads(n_threads: usize);
+    pub fn mts_get_max_threads() -> usize;
     pub fn mts_last_error() -> *const ::std::os::raw::c_char;
+    pub fn mts_set_profiling_callback(callback: mts_profiling_callback_t);
     #[must_use]
     pub fn mts_labels_position(
         labels: mts_labels_t,
@@ -346,8 +485,18 @@ extern "C" {
         result: *mut i64,
     ) -> mts_status_t;
     #[must_use]
+    pub fn mts_labels_positions(
+        labels: mts_labels_t,
+        values: *const i32,
+        values_count: usize,
+        result: *mut i64,
+        result_count: usize,
+    ) -> mts_status_t;
+    #[must_use]
     pub fn mts_labels_create(labels: *mut mts_labels_t) -> mts_status_t;
     #[must_use]
+    pub fn mts_labels_create_assume_unique(labels: *mut mts_labels_t) -> mts_status_t;
+    #[must_use]
     pub fn mts_labels_set_user_data(
         labels: mts_labels_t,
         user_data: *mut ::std::os::raw::c_void,
@@ -383,6 +532,11 @@ extern "C" {
         second_mapping_count: usize,
     ) -> mts_status_t;
     #[must_use]
+    pub fn mts_labels_memory_usage(
+        labels: mts_labels_t,
+        usage: *mut mts_memory_usage_t,
+    ) -> mts_status_t;
+    #[must_use]
     pub fn mts_labels_free(labels: *mut mts_labels_t) -> mts_status_t;
     #[must_use]
     pub fn mts_register_data_origin(
@@ -405,6 +559,11 @@ extern "C" {
     #[must_use]
     pub fn mts_block_free(block: *mut mts_block_t) -> mts_status_t;
     pub fn mts_block_copy(block: *const mts_block_t) -> *mut mts_block_t;
+    pub fn mts_block_slice_samples(
+        block: *const mts_block_t,
+        start: usize,
+        stop: usize,
+    ) -> *mut mts_block_t;
     #[must_use]
     pub fn mts_block_labels(
         block: *const mts_block_t,
@@ -431,6 +590,11 @@ extern "C" {
         parameters: *mut *const *const ::std::os::raw::c_char,
         parameters_count: *mut usize,
     ) -> mts_status_t;
+    #[must_use]
+    pub fn mts_block_memory_usage(
+        block: *const mts_block_t,
+        usage: *mut mts_memory_usage_t,
+    ) -> mts_status_t;
     pub fn mts_tensormap(
         keys: mts_labels_t,
         blocks: *mut *mut mts_block_t,
@@ -457,6 +621,13 @@ extern "C" {
         count: *mut usize,
         selection: mts_labels_t,
     ) -> mts_status_t;
+    #[must_use]
+    pub fn mts_tensormap_blocks_matching_many(
+        tensor: *const mts_tensormap_t,
+        block_selection: *mut i64,
+        count: usize,
+        selection: mts_labels_t,
+    ) -> mts_status_t;
     pub fn mts_tensormap_keys_to_properties(
         tensor: *const mts_tensormap_t,
         keys_to_move: mts_labels_t,
@@ -472,6 +643,16 @@ extern "C" {
         keys_to_move: mts_labels_t,
         sort_samples: bool,
     ) -> *mut mts_tensormap_t;
+    pub fn mts_tensormap_join_samples(
+        tensors: *const *const mts_tensormap_t,
+        tensors_count: usize,
+        new_dimension: *const ::std::os::raw::c_char,
+    ) -> *mut mts_tensormap_t;
+    #[must_use]
+    pub fn mts_tensormap_memory_usage(
+        tensor: *const mts_tensormap_t,
+        usage: *mut mts_memory_usage_t,
+    ) -> mts_status_t;
     #[must_use]
     pub fn mts_labels_load(
         path: *const ::std::os::raw::c_char,
@@ -500,6 +681,22 @@ extern "C" {
         path: *const ::std::os::raw::c_char,
         create_array: mts_create_array_callback_t,
     ) -> *mut mts_tensormap_t;
+    pub fn mts_tensormap_load_selection(
+        path: *const ::std::os::raw::c_char,
+        selection: mts_labels_t,
+        create_array: mts_create_array_callback_t,
+    ) -> *mut mts_tensormap_t;
+    pub fn mts_tensormap_load_parallel(
+        path: *const ::std::os::raw::c_char,
+        n_threads: usize,
+        create_array: mts_create_array_callback_t,
+    ) -> *mut mts_tensormap_t;
+    pub fn mts_tensormap_load_mmap(
+        path: *const ::std::os::raw::c_char,
+    ) -> *mut mts_tensormap_t;
+    pub fn mts_tensormap_load_shm(
+        name: *const ::std::os::raw::c_char,
+    ) -> *mut mts_tensormap_t;
     pub fn mts_tensormap_load_buffer(
         buffer: *const u8,
         buffer_count: usize,
@@ -511,6 +708,21 @@ extern "C" {
         tensor: *const mts_tensormap_t,
     ) -> mts_status_t;
     #[must_use]
+    pub fn mts_tensormap_save_compressed(
+        path: *const ::std::os::raw::c_char,
+        tensor: *const mts_tensormap_t,
+        compression: i32,
+        level: i32,
+        n_threads: usize,
+    ) -> mts_status_t;
+    #[must_use]
+    pub fn mts_tensormap_save_shm(
+        name: *const ::std::os::raw::c_char,
+        tensor: *const mts_tensormap_t,
+    ) -> mts_status_t;
+    #[must_use]
+    pub fn mts_tensormap_remove_shm(name: *const ::std::os::raw::c_char) -> mts_status_t;
+    #[must_use]
     pub fn mts_tensormap_save_buffer(
         buffer: *mut *mut u8,
         buffer_count: *mut usize,
@@ -518,4 +730,35 @@ extern "C" {
         realloc: mts_realloc_buffer_t,
         tensor: *const mts_tensormap_t,
     ) -> mts_status_t;
+    pub fn mts_tensormap_writer(
+        path: *const ::std::os::raw::c_char,
+        keys_names: *const *const ::std::os::raw::c_char,
+        keys_names_count: usize,
+    ) -> *mut mts_tensormap_writer_t;
+    #[must_use]
+    pub fn mts_tensormap_writer_add_block(
+        writer: *mut mts_tensormap_writer_t,
+        key: *const i32,
+        key_count: usize,
+        block: *const mts_block_t,
+    ) -> mts_status_t;
+    #[must_use]
+    pub fn mts_tensormap_writer_begin_block(
+        writer: *mut mts_tensormap_writer_t,
+        key: *const i32,
+        key_count: usize,
+        shape: *const usize,
+        shape_count: usize,
+    ) -> mts_status_t;
+    #[must_use]
+    pub fn mts_tensormap_writer_add_samples(
+        writer: *mut mts_tensormap_writer_t,
+        chunk: *const mts_block_t,
+    ) -> mts_status_t;
+    #[must_use]
+    pub fn mts_tensormap_writer_end_block(writer: *mut mts_tensormap_writer_t) -> mts_status_t;
+    #[must_use]
+    pub fn mts_tensormap_writer_finish(writer: *mut mts_tensormap_writer_t) -> mts_status_t;
+    #[must_use]
+    pub fn mts_tensormap_writer_free(writer: *mut mts_tensormap_writer_t) -> mts_status_t;
 }
@@ -87,6 +87,8 @@ impl mts_array_t {
             copy: None,
             destroy: None,
             move_samples_from: None,
+            typed_data: None,
+            create_typed: None,
         }
     }
 
@@ -198,7 +200,9 @@ impl mts_array_t {
             create: None,
             copy: None,
             destroy: None,
-            move_samples_from: None
+            move_samples_from: None,
+            typed_data: None,
+            create_typed: None,
         };
         unsafe {
             check_status_external(
@@ -354,12 +354,15 @@ impl TensorMap {
     /// 3` will produce a block with properties `a, p = (0, 1), (0, 2), (2, 1),
     /// (2, 3)`.
     ///
-    /// If `keys_to_move` contains entries, then the property labels must be the
-    /// same for all the merged blocks. In that case, the merged property labels
-    /// will contains each of the entries of `keys_to_move` and then the current
+    /// If `keys_to_move` contains entries, then the merged property labels will
+    /// contains each of the entries of `keys_to_move` and then the current
     /// property labels. For example, using `a=2, 3` in `keys_to_move`, and
     /// blocks with properties `p=1, 2` will result in `a, p = (2, 1), (2, 2),
-    /// (3, 1), (3, 2)`.
+    /// (3, 1), (3, 2)`. If the merged blocks have different property labels,
+    /// each entry of `keys_to_move` is followed by the properties of the block
+    /// with this entry in its key. Entries without such block use the
+    /// properties of the blocks with this entry in the other groups of merged
+    /// blocks, which must then all be the same.
     ///
     /// The new sample labels will contains all of the merged blocks sample
     /// labels. The order of the samples is controlled by `sort_samples`. If
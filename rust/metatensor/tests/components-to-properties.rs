@@ -121,3 +121,71 @@ fn multiple_components() {
 
     assert_eq!(gradient.values().as_array(), ArrayD::from_elem(vec![3, 3, 4], 11.0));
 }
+
+#[test]
+fn several_components_at_once() {
+    let data = ArrayD::from_shape_vec(vec![1, 2, 3, 2], vec![
+        1.0, -1.0, 2.0, -2.0, 3.0, -3.0,
+        4.0, -4.0, 5.0, -5.0, 6.0, -6.0,
+    ]).unwrap();
+
+    let components = [
+        example_labels(vec!["component_1"], vec![[0], [1]]),
+        example_labels(vec!["component_2"], vec![[0], [1], [2]]),
+    ];
+    let properties = example_labels(vec!["properties"], vec![[0], [1]]);
+
+    let mut block = TensorBlock::new(
+        data,
+        &example_labels(vec!["samples"], vec![[0]]),
+        &components,
+        &properties,
+    ).unwrap();
+
+    let gradient = TensorBlock::new(
+        ArrayD::from_elem(vec![2, 2, 3, 2], 11.0),
+        &example_labels(vec!["sample", "parameter"], vec![[0, 2], [0, 3]]),
+        &components,
+        &properties,
+    ).unwrap();
+
+    block.add_gradient("parameter", gradient).unwrap();
+
+    let tensor = TensorMap::new(Labels::single(), vec![block]).unwrap();
+    let tensor = tensor.components_to_properties(&["component_2", "component_1"]).unwrap();
+
+    let block = tensor.block_by_id(0);
+    assert_eq!(block.components().len(), 0);
+
+    assert_eq!(block.properties().names(), ["component_2", "component_1", "properties"]);
+    assert_eq!(block.properties().count(), 12);
+    assert_eq!(block.properties()[0], [0, 0, 0]);
+    assert_eq!(block.properties()[1], [0, 0, 1]);
+    assert_eq!(block.properties()[2], [0, 1, 0]);
+    assert_eq!(block.properties()[3], [0, 1, 1]);
+    assert_eq!(block.properties()[4], [1, 0, 0]);
+    assert_eq!(block.properties()[11], [2, 1, 1]);
+
+    let expected = ArrayD::from_shape_vec(vec![1, 12], vec![
+        1.0, -1.0, 4.0, -4.0, 2.0, -2.0, 5.0, -5.0, 3.0, -3.0, 6.0, -6.0,
+    ]).unwrap();
+    assert_eq!(block.values().as_array(), expected);
+
+    let gradient = block.gradient("parameter").unwrap();
+    assert_eq!(gradient.values().as_array(), ArrayD::from_elem(vec![2, 12], 11.0));
+
+    // components must be moved with all their dimensions
+    let tensor = TensorMap::new(Labels::single(), vec![TensorBlock::new(
+        ArrayD::from_elem(vec![1, 2, 2], 1.0),
+        &example_labels(vec!["samples"], vec![[0]]),
+        &[example_labels(vec!["a", "b"], vec![[0, 0], [1, 1]])],
+        &properties,
+    ).unwrap()]).unwrap();
+
+    let error = tensor.components_to_properties(&["a"]).unwrap_err();
+    assert_eq!(
+        error.message,
+        "invalid parameter: [a] does not correspond to the dimensions of one or more components: \
+        all the dimensions of a component must be moved together, and only once"
+    );
+}
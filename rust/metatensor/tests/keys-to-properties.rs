@@ -89,14 +89,33 @@ fn unsorted_samples() {
 
 #[test]
 fn user_provided_entries_different_properties() {
-    let keys_to_move = Labels::new(["key_1"], &[[0]]);
-    let result = example_tensor().keys_to_properties(&keys_to_move, false);
+    let keys_to_move = Labels::new(["key_1"], &[[0], [1], [2]]);
+    let tensor = example_tensor().keys_to_properties(&keys_to_move, true).unwrap();
 
-    assert_eq!(
-        result.unwrap_err().message,
-        "invalid parameter: can not provide values for the keys to move to \
-        properties if the blocks have different property labels"
-    );
+    assert_eq!(tensor.keys(), &example_labels(vec!["key_2"], vec![[0], [2], [3]]));
+
+    // each entry uses the properties of the blocks with this entry in their
+    // keys, and all the new blocks have the same properties
+    let properties = example_labels(vec!["key_1", "properties"], vec![
+        [0, 0], [1, 3], [1, 4], [1, 5], [2, 0]
+    ]);
+
+    let block = tensor.block_by_id(0);
+    assert_eq!(block.properties(), properties);
+    let expected = ArrayD::from_shape_vec(vec![5, 1, 5], vec![
+        1.0, 2.0, 2.0, 2.0, 0.0,
+        0.0, 2.0, 2.0, 2.0, 0.0,
+        1.0, 0.0, 0.0, 0.0, 0.0,
+        0.0, 2.0, 2.0, 2.0, 0.0,
+        1.0, 0.0, 0.0, 0.0, 0.0,
+    ]).unwrap();
+    assert_eq!(block.values().as_array(), expected);
+
+    let block = tensor.block_by_id(1);
+    assert_eq!(block.properties(), properties);
+    let mut expected = ArrayD::from_elem(vec![4, 3, 5], 0.0);
+    expected.slice_mut(ndarray::s![.., .., 4]).fill(3.0);
+    assert_eq!(block.values().as_array(), expected);
 }
 
 #[test]